@@ -288,7 +288,8 @@ class SSSDConfigTestSSSDService(unittest.TestCase):
             'command',
             'reconnection_retries',
             'fd_limit',
-            'client_idle_timeout']
+            'client_idle_timeout',
+            'result_cache_timeout']
 
         self.assertTrue(type(options) == dict,
                         "Options should be a dictionary")
@@ -514,6 +515,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'override_shell',
             'default_shell',
             'pwd_expiration_warning',
+            'max_auth_requests',
+            'max_id_requests',
+            'max_background_requests',
             'id_provider',
             'auth_provider',
             'access_provider',
@@ -603,7 +607,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_renew_interval',
              'krb5_use_fast',
              'krb5_fast_principal',
-             'krb5_canonicalize'])
+             'krb5_canonicalize',
+             'krb5_child_pool_size'])
 
         options = domain.list_options()
 
@@ -761,7 +766,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'krb5_renew_interval',
             'krb5_use_fast',
             'krb5_fast_principal',
-            'krb5_canonicalize']
+            'krb5_canonicalize',
+            'krb5_child_pool_size']
 
         self.assertTrue(type(options) == dict,
                         "Options should be a dictionary")
@@ -855,6 +861,9 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
             'override_shell',
             'default_shell',
             'pwd_expiration_warning',
+            'max_auth_requests',
+            'max_id_requests',
+            'max_background_requests',
             'id_provider',
             'auth_provider',
             'access_provider',
@@ -945,7 +954,8 @@ class SSSDConfigTestSSSDDomain(unittest.TestCase):
              'krb5_renew_interval',
              'krb5_use_fast',
              'krb5_fast_principal',
-             'krb5_canonicalize'])
+             'krb5_canonicalize',
+             'krb5_child_pool_size'])
 
         options = domain.list_options()
 
@@ -501,6 +501,50 @@ int sysdb_attrs_add_val(struct sysdb_attrs *attrs,
     return EOK;
 }
 
+int sysdb_attrs_add_vals(struct sysdb_attrs *attrs, const char *name,
+                         const struct ldb_val *vals, size_t num)
+{
+    struct ldb_message_element *el = NULL;
+    struct ldb_val *nvals;
+    uint8_t *buf;
+    size_t size = 0;
+    size_t i;
+    int ret;
+
+    if (num == 0) return EOK;
+
+    ret = sysdb_attrs_get_el(attrs, name, &el);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    for (i = 0; i < num; i++) {
+        size += vals[i].length + 1;
+    }
+
+    nvals = talloc_realloc(attrs->a, el->values,
+                           struct ldb_val, el->num_values + num);
+    if (!nvals) return ENOMEM;
+    el->values = nvals;
+
+    buf = talloc_size(nvals, size);
+    if (!buf) return ENOMEM;
+
+    /* NULL terminated like ldb_val_dup() does */
+    for (i = 0; i < num; i++) {
+        memcpy(buf, vals[i].data, vals[i].length);
+        buf[vals[i].length] = '\0';
+
+        nvals[el->num_values].data = buf;
+        nvals[el->num_values].length = vals[i].length;
+        el->num_values++;
+
+        buf += vals[i].length + 1;
+    }
+
+    return EOK;
+}
+
 int sysdb_attrs_add_string(struct sysdb_attrs *attrs,
                            const char *name, const char *str)
 {
@@ -770,6 +814,8 @@ int sysdb_transaction_start(struct sysdb_ctx *sysdb)
     ret = ldb_transaction_start(sysdb->ldb);
     if (ret != LDB_SUCCESS) {
         DEBUG(1, ("Failed to start ldb transaction! (%d)\n", ret));
+    } else {
+        sysdb->transaction_nesting++;
     }
     return sysdb_error_to_errno(ret);
 }
@@ -778,6 +824,9 @@ int sysdb_transaction_commit(struct sysdb_ctx *sysdb)
 {
     int ret;
 
+    /* ldb leaves the transaction even if this fails */
+    sysdb->transaction_nesting--;
+
     ret = ldb_transaction_commit(sysdb->ldb);
     if (ret != LDB_SUCCESS) {
         DEBUG(1, ("Failed to commit ldb transaction! (%d)\n", ret));
@@ -789,6 +838,9 @@ int sysdb_transaction_cancel(struct sysdb_ctx *sysdb)
 {
     int ret;
 
+    /* ldb leaves the transaction even if this fails */
+    sysdb->transaction_nesting--;
+
     ret = ldb_transaction_cancel(sysdb->ldb);
     if (ret != LDB_SUCCESS) {
         DEBUG(1, ("Failed to cancel ldb transaction! (%d)\n", ret));
@@ -1139,6 +1191,13 @@ int sysdb_domain_init_internal(TALLOC_CTX *mem_ctx,
             }
         }
 
+        if (strcmp(version, SYSDB_VERSION_0_15) == 0) {
+            ret = sysdb_upgrade_15(sysdb, &version);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+
         /* The version should now match SYSDB_VERSION.
          * If not, it means we didn't match any of the
          * known older versions. The DB might be
@@ -86,6 +86,7 @@
 #define SYSDB_LAST_UPDATE "lastUpdate"
 #define SYSDB_CACHE_EXPIRE "dataExpireTimestamp"
 #define SYSDB_INITGR_EXPIRE "initgrExpireTimestamp"
+#define SYSDB_INITGR_GIDS "initgrGIDs"
 
 #define SYSDB_AUTHORIZED_SERVICE "authorizedService"
 #define SYSDB_AUTHORIZED_HOST "authorizedHost"
@@ -248,6 +249,10 @@ struct range_info {
 /* values are copied in the structure, allocated on "attrs" */
 int sysdb_attrs_add_val(struct sysdb_attrs *attrs,
                         const char *name, const struct ldb_val *val);
+/* same as calling sysdb_attrs_add_val() for each value, but the data of
+ * all values ends up in one buffer owned by the values array */
+int sysdb_attrs_add_vals(struct sysdb_attrs *attrs, const char *name,
+                         const struct ldb_val *vals, size_t num);
 int sysdb_attrs_add_string(struct sysdb_attrs *attrs,
                            const char *name, const char *str);
 int sysdb_attrs_add_mem(struct sysdb_attrs *, const char *,
@@ -356,6 +361,41 @@ int sysdb_transaction_start(struct sysdb_ctx *sysdb);
 int sysdb_transaction_commit(struct sysdb_ctx *sysdb);
 int sysdb_transaction_cancel(struct sysdb_ctx *sysdb);
 
+/* Bulk ingest of many entries at once, e.g. during a full enumeration.
+ *
+ * For the entries stored in a batch of the session the memberof plugin
+ * does not maintain the memberof, memberuid and ghost attributes, and
+ * sysdb_add_user() does not search the groups for ghost entries of the new
+ * user. Both are done for the whole cache in a single pass when the
+ * session ends, either by sysdb_bulk_finish() or by freeing the session.
+ * Entries stored outside of a batch, e.g. by other requests while the
+ * session is active, are processed as usual. Only one session can be
+ * active per sysdb at a time. */
+struct sysdb_bulk;
+
+struct sysdb_bulk_stats {
+    uint64_t batches;       /* batches stored during the session */
+    uint64_t staged_users;  /* users added, checked for ghosts at the end */
+    uint64_t ghosts;        /* ghost entries replaced by real members */
+};
+
+errno_t sysdb_bulk_start(TALLOC_CTX *mem_ctx, struct sysdb_ctx *sysdb,
+                         struct sysdb_bulk **_bulk);
+
+/* Enclose the stores of a batch. sysdb_bulk_batch_start() must be called
+ * inside the transaction that stores the batch, sysdb_bulk_batch_end()
+ * before that transaction is committed or cancelled, without returning
+ * to the main loop in between. sysdb_bulk_batch_start() does nothing if
+ * no session is active. */
+errno_t sysdb_bulk_batch_start(struct sysdb_ctx *sysdb);
+
+void sysdb_bulk_batch_end(struct sysdb_ctx *sysdb);
+
+errno_t sysdb_bulk_finish(struct sysdb_bulk *bulk);
+
+void sysdb_bulk_get_stats(struct sysdb_bulk *bulk,
+                          struct sysdb_bulk_stats *stats);
+
 /* functions related to subdomains */
 errno_t sysdb_domain_create(struct sysdb_ctx *sysdb, const char *domain_name);
 
@@ -430,6 +470,33 @@ int sysdb_enumgrent(TALLOC_CTX *mem_ctx,
                     struct sss_domain_info *domain,
                     struct ldb_result **res);
 
+/* Enumeration cursors
+ *
+ * A cursor only holds the DNs of the entries to enumerate, the entries
+ * themselves are read a page at a time with sysdb_enum_cursor_fetch() so
+ * that enumerating a large domain does not need to keep all of it in memory.
+ * Fetching returns ENOENT once offset is past the end of the enumeration.
+ * Entries removed after the cursor was created are silently skipped.
+ */
+struct sysdb_enum_cursor;
+
+int sysdb_enumpwent_cursor(TALLOC_CTX *mem_ctx,
+                           struct sysdb_ctx *sysdb,
+                           struct sss_domain_info *domain,
+                           struct sysdb_enum_cursor **_cursor);
+
+int sysdb_enumgrent_cursor(TALLOC_CTX *mem_ctx,
+                           struct sysdb_ctx *sysdb,
+                           struct sss_domain_info *domain,
+                           struct sysdb_enum_cursor **_cursor);
+
+size_t sysdb_enum_cursor_count(struct sysdb_enum_cursor *cursor);
+
+int sysdb_enum_cursor_fetch(TALLOC_CTX *mem_ctx,
+                            struct sysdb_enum_cursor *cursor,
+                            size_t offset, size_t max,
+                            struct ldb_result **_res);
+
 struct sysdb_netgroup_ctx {
     enum {SYSDB_NETGROUP_TRIPLE_VAL, SYSDB_NETGROUP_GROUP_VAL} type;
     union {
@@ -454,6 +521,25 @@ int sysdb_initgroups(TALLOC_CTX *mem_ctx,
                      const char *name,
                      struct ldb_result **res);
 
+/* The gids a user is a member of are also kept on the user entry, together
+ * with a digest of the memberof values they were computed from, so that
+ * they can be read back without loading every group. The list is refreshed
+ * by sysdb_update_initgr_gids() and is ignored as soon as the memberships
+ * of the user change.
+ *
+ * sysdb_initgroups_gids() returns the same result as sysdb_initgroups()
+ * except that the group messages only contain SYSDB_GIDNUM. It falls back
+ * to sysdb_initgroups() if the stored list is missing or stale. */
+int sysdb_initgroups_gids(TALLOC_CTX *mem_ctx,
+                          struct sysdb_ctx *sysdb,
+                          struct sss_domain_info *domain,
+                          const char *name,
+                          struct ldb_result **res);
+
+errno_t sysdb_update_initgr_gids(struct sysdb_ctx *sysdb,
+                                 struct sss_domain_info *domain,
+                                 const char *name);
+
 int sysdb_get_user_attr(TALLOC_CTX *mem_ctx,
                         struct sysdb_ctx *sysdb,
                         struct sss_domain_info *domain,
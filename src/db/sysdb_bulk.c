@@ -0,0 +1,469 @@
+/*
+   SSSD
+
+   System Database - bulk ingest of many entries at once
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "db/sysdb_private.h"
+
+#define BULK_TABLE_INIT_SIZE 1024
+
+/* A user added during the session, its ghost entries are replaced by
+ * real members when the session ends */
+struct sysdb_bulk_user {
+    const char *name;
+    const char *orig_dn;
+    const char *userdn;
+    struct ldb_message_element *alias_el;
+
+    /* the transaction that added the user may have been cancelled */
+    enum { BULK_USER_UNCHECKED = 0,
+           BULK_USER_EXISTS,
+           BULK_USER_MISSING } status;
+
+    /* last group processed, a user can be listed by name and by alias */
+    struct ldb_message *last_group;
+};
+
+struct sysdb_bulk_domain {
+    struct sysdb_bulk_domain *prev;
+    struct sysdb_bulk_domain *next;
+
+    struct sss_domain_info *domain;
+    hash_table_t *users;    /* name and aliases -> sysdb_bulk_user */
+};
+
+struct sysdb_bulk {
+    struct sysdb_ctx *sysdb;
+
+    struct sysdb_bulk_domain *domains;
+    struct sysdb_bulk_stats stats;
+};
+
+static errno_t sysdb_bulk_end(struct sysdb_bulk *bulk);
+
+static int sysdb_bulk_destructor(struct sysdb_bulk *bulk)
+{
+    errno_t ret;
+
+    if (bulk->sysdb->bulk != bulk) {
+        return 0;
+    }
+
+    /* the batches stored so far are already committed, they need their
+     * memberships computed even if the caller gave up */
+    DEBUG(SSSDBG_TRACE_FUNC, ("Bulk session freed before it was finished\n"));
+    ret = sysdb_bulk_end(bulk);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to finish bulk session [%d]: %s\n",
+                                    ret, strerror(ret)));
+    }
+
+    return 0;
+}
+
+errno_t sysdb_bulk_start(TALLOC_CTX *mem_ctx, struct sysdb_ctx *sysdb,
+                         struct sysdb_bulk **_bulk)
+{
+    struct sysdb_bulk *bulk;
+
+    if (sysdb->bulk) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("A bulk session is already active\n"));
+        return EBUSY;
+    }
+
+    bulk = talloc_zero(mem_ctx, struct sysdb_bulk);
+    if (!bulk) return ENOMEM;
+
+    bulk->sysdb = sysdb;
+
+    sysdb->bulk = bulk;
+    talloc_set_destructor(bulk, sysdb_bulk_destructor);
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Bulk session started\n"));
+
+    *_bulk = bulk;
+    return EOK;
+}
+
+static errno_t sysdb_bulk_add_key(hash_table_t *table, const char *name,
+                                  struct sysdb_bulk_user *user)
+{
+    hash_value_t value;
+    hash_key_t key;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(name);
+    value.type = HASH_VALUE_PTR;
+    value.ptr = user;
+
+    hret = hash_enter(table, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unable to stage user [%s]: %s\n",
+                                  name, hash_error_string(hret)));
+        return EIO;
+    }
+
+    return EOK;
+}
+
+errno_t sysdb_bulk_stage_user(struct sysdb_bulk *bulk,
+                              struct sss_domain_info *domain,
+                              const char *name,
+                              const char *orig_dn,
+                              struct sysdb_attrs *attrs)
+{
+    struct sysdb_bulk_domain *bd;
+    struct sysdb_bulk_user *user;
+    struct ldb_message_element *alias_el;
+    struct ldb_dn *userdn;
+    errno_t ret;
+    int i;
+
+    DLIST_FOR_EACH(bd, bulk->domains) {
+        if (bd->domain == domain) break;
+    }
+
+    if (!bd) {
+        bd = talloc_zero(bulk, struct sysdb_bulk_domain);
+        if (!bd) return ENOMEM;
+
+        bd->domain = domain;
+        ret = sss_hash_create(bd, BULK_TABLE_INIT_SIZE, &bd->users);
+        if (ret != EOK) {
+            talloc_free(bd);
+            return ret;
+        }
+
+        DLIST_ADD(bulk->domains, bd);
+    }
+
+    user = talloc_zero(bd, struct sysdb_bulk_user);
+    if (!user) return ENOMEM;
+
+    user->name = talloc_strdup(user, name);
+    if (!user->name) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    if (orig_dn) {
+        user->orig_dn = talloc_strdup(user, orig_dn);
+        if (!user->orig_dn) {
+            ret = ENOMEM;
+            goto fail;
+        }
+    }
+
+    userdn = sysdb_user_dn(bulk->sysdb, user, domain, name);
+    if (!userdn) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    user->userdn = ldb_dn_get_linearized(userdn);
+    if (!user->userdn) {
+        ret = EINVAL;
+        goto fail;
+    }
+
+    ret = sysdb_attrs_get_el(attrs, SYSDB_NAME_ALIAS, &alias_el);
+    if (ret != EOK) goto fail;
+
+    user->alias_el = talloc_zero(user, struct ldb_message_element);
+    if (!user->alias_el) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    user->alias_el->name = SYSDB_NAME_ALIAS;
+    user->alias_el->num_values = alias_el->num_values;
+    user->alias_el->values = talloc_array(user->alias_el, struct ldb_val,
+                                          alias_el->num_values);
+    if (!user->alias_el->values) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    for (i = 0; i < alias_el->num_values; i++) {
+        user->alias_el->values[i] = ldb_val_dup(user->alias_el->values,
+                                                &alias_el->values[i]);
+        if (!user->alias_el->values[i].data) {
+            ret = ENOMEM;
+            goto fail;
+        }
+    }
+
+    ret = sysdb_bulk_add_key(bd->users, user->name, user);
+    if (ret != EOK) goto fail;
+
+    /* the user is owned by the table from now on */
+    for (i = 0; i < user->alias_el->num_values; i++) {
+        ret = sysdb_bulk_add_key(bd->users,
+                           (const char *)user->alias_el->values[i].data, user);
+        if (ret != EOK) return ret;
+    }
+
+    bulk->stats.staged_users++;
+    return EOK;
+
+fail:
+    talloc_free(user);
+    return ret;
+}
+
+/* The opaque is only set while a batch is stored synchronously, the stores
+ * of other requests never run in between */
+errno_t sysdb_bulk_batch_start(struct sysdb_ctx *sysdb)
+{
+    int lret;
+
+    if (!sysdb->bulk) return EOK;
+
+    if (sysdb->bulk_batch) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("A bulk batch is already active\n"));
+        return EBUSY;
+    }
+
+    if (sysdb->transaction_nesting == 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("A bulk batch needs a transaction\n"));
+        return EINVAL;
+    }
+
+    lret = ldb_set_opaque(sysdb->ldb, SYSDB_MEMBEROF_DEFER, sysdb->bulk);
+    if (lret != LDB_SUCCESS) {
+        return sysdb_error_to_errno(lret);
+    }
+
+    sysdb->bulk_batch = true;
+    sysdb->bulk->stats.batches++;
+    return EOK;
+}
+
+void sysdb_bulk_batch_end(struct sysdb_ctx *sysdb)
+{
+    if (!sysdb->bulk_batch) return;
+
+    ldb_set_opaque(sysdb->ldb, SYSDB_MEMBEROF_DEFER, NULL);
+    sysdb->bulk_batch = false;
+}
+
+static errno_t sysdb_bulk_check_user(TALLOC_CTX *mem_ctx,
+                                     struct sysdb_ctx *sysdb,
+                                     struct sysdb_bulk_user *user)
+{
+    const char *no_attrs[] = { NULL };
+    struct ldb_message **msgs;
+    struct ldb_dn *dn;
+    size_t count;
+    errno_t ret;
+
+    dn = ldb_dn_new(mem_ctx, sysdb->ldb, user->userdn);
+    if (!dn) return ENOMEM;
+
+    ret = sysdb_search_entry(mem_ctx, sysdb, dn, LDB_SCOPE_BASE, NULL,
+                             no_attrs, &count, &msgs);
+    talloc_free(dn);
+    if (ret == ENOENT) {
+        user->status = BULK_USER_MISSING;
+        return EOK;
+    } else if (ret != EOK) {
+        return ret;
+    }
+
+    talloc_free(msgs);
+    user->status = BULK_USER_EXISTS;
+    return EOK;
+}
+
+/* Replace the ghost entries of all users added during the session by real
+ * members with a single search, instead of one search per user */
+static errno_t sysdb_bulk_resolve_ghosts(struct sysdb_bulk *bulk,
+                                         struct sysdb_bulk_domain *bd)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { SYSDB_NAME, SYSDB_GHOST, SYSDB_ORIG_MEMBER, NULL };
+    struct ldb_message **groups;
+    struct ldb_message_element *el;
+    struct sysdb_bulk_user *user;
+    struct ldb_dn *basedn;
+    hash_value_t value;
+    hash_key_t key;
+    size_t count;
+    size_t i;
+    errno_t ret;
+    int hret;
+    int j;
+
+    if (hash_count(bd->users) == 0) return EOK;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) return ENOMEM;
+
+    basedn = ldb_dn_new_fmt(tmp_ctx, bulk->sysdb->ldb,
+                            SYSDB_TMPL_GROUP_BASE, bd->domain->name);
+    if (!basedn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_search_entry(tmp_ctx, bulk->sysdb, basedn, LDB_SCOPE_SUBTREE,
+                             "(&("SYSDB_GC")("SYSDB_GHOST"=*))",
+                             attrs, &count, &groups);
+    if (ret == ENOENT) {
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < count; i++) {
+        el = ldb_msg_find_element(groups[i], SYSDB_GHOST);
+        if (!el) continue;
+
+        for (j = 0; j < el->num_values; j++) {
+            key.type = HASH_KEY_STRING;
+            key.str = (char *)el->values[j].data;
+
+            hret = hash_lookup(bd->users, &key, &value);
+            if (hret != HASH_SUCCESS) continue;
+
+            user = talloc_get_type(value.ptr, struct sysdb_bulk_user);
+            if (user->last_group == groups[i]) continue;
+            user->last_group = groups[i];
+
+            if (user->status == BULK_USER_UNCHECKED) {
+                ret = sysdb_bulk_check_user(tmp_ctx, bulk->sysdb, user);
+                if (ret != EOK) goto done;
+            }
+            if (user->status == BULK_USER_MISSING) continue;
+
+            ret = sysdb_remove_ghost_from_group(bulk->sysdb, groups[i],
+                                                user->alias_el, user->name,
+                                                user->orig_dn, user->userdn);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      ("Unable to replace ghost [%s] in group [%s]\n",
+                       user->name, ldb_dn_get_linearized(groups[i]->dn)));
+                continue;
+            }
+            bulk->stats.ghosts++;
+        }
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t sysdb_bulk_rebuild_memberof(struct sysdb_ctx *sysdb)
+{
+    struct ldb_message *msg;
+    errno_t ret;
+    int lret;
+
+    msg = ldb_msg_new(NULL);
+    if (!msg) return ENOMEM;
+
+    msg->dn = ldb_dn_new(msg, sysdb->ldb, "@MEMBEROF-REBUILD");
+    if (!msg->dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* the memberof module intercepts this and recomputes memberof,
+     * memberuid and ghost inheritance of all entries */
+    lret = ldb_add(sysdb->ldb, msg);
+    ret = sysdb_error_to_errno(lret);
+
+done:
+    talloc_free(msg);
+    return ret;
+}
+
+static errno_t sysdb_bulk_end(struct sysdb_bulk *bulk)
+{
+    struct sysdb_ctx *sysdb = bulk->sysdb;
+    struct sysdb_bulk_domain *bd;
+    bool in_transaction = false;
+    errno_t ret;
+    errno_t sret;
+    int lret;
+
+    ret = sysdb_transaction_start(sysdb);
+    if (ret != EOK) goto done;
+    in_transaction = true;
+
+    /* deferred as well, the rebuild below takes care of the new members */
+    lret = ldb_set_opaque(sysdb->ldb, SYSDB_MEMBEROF_DEFER, bulk);
+    if (lret != LDB_SUCCESS) {
+        ret = sysdb_error_to_errno(lret);
+        goto done;
+    }
+
+    DLIST_FOR_EACH(bd, bulk->domains) {
+        ret = sysdb_bulk_resolve_ghosts(bulk, bd);
+        if (ret != EOK) goto done;
+    }
+
+    ldb_set_opaque(sysdb->ldb, SYSDB_MEMBEROF_DEFER, NULL);
+    sysdb->bulk = NULL;
+
+    ret = sysdb_bulk_rebuild_memberof(sysdb);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to rebuild memberships\n"));
+        goto done;
+    }
+
+    ret = sysdb_transaction_commit(sysdb);
+    if (ret != EOK) goto done;
+    in_transaction = false;
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Bulk session finished: %llu batches, "
+           "%llu users staged, %llu ghosts replaced\n",
+           (unsigned long long)bulk->stats.batches,
+           (unsigned long long)bulk->stats.staged_users,
+           (unsigned long long)bulk->stats.ghosts));
+
+done:
+    if (in_transaction) {
+        sret = sysdb_transaction_cancel(sysdb);
+        if (sret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Could not cancel transaction\n"));
+        }
+    }
+    ldb_set_opaque(sysdb->ldb, SYSDB_MEMBEROF_DEFER, NULL);
+    sysdb->bulk = NULL;
+    return ret;
+}
+
+errno_t sysdb_bulk_finish(struct sysdb_bulk *bulk)
+{
+    if (bulk->sysdb->bulk != bulk) {
+        return EINVAL;
+    }
+
+    return sysdb_bulk_end(bulk);
+}
+
+void sysdb_bulk_get_stats(struct sysdb_bulk *bulk,
+                          struct sysdb_bulk_stats *stats)
+{
+    *stats = bulk->stats;
+}
@@ -896,7 +896,7 @@ done:
     return ret;
 }
 
-static errno_t
+errno_t
 sysdb_remove_ghost_from_group(struct sysdb_ctx *sysdb,
                               struct ldb_message *group,
                               struct ldb_message_element *alias_el,
@@ -1199,9 +1199,14 @@ int sysdb_add_user(struct sysdb_ctx *sysdb,
     ret = sysdb_set_user_attr(sysdb, domain, name, attrs, SYSDB_MOD_REP);
     if (ret) goto done;
 
-    /* remove all ghost users */
-    ret = sysdb_remove_ghostattr_from_groups(sysdb, domain,
-                                             orig_dn, attrs, name);
+    /* remove all ghost users, during bulk ingest this is done for all
+     * users at once when the session ends */
+    if (sysdb->bulk && sysdb->bulk_batch) {
+        ret = sysdb_bulk_stage_user(sysdb->bulk, domain, name, orig_dn, attrs);
+    } else {
+        ret = sysdb_remove_ghostattr_from_groups(sysdb, domain,
+                                                 orig_dn, attrs, name);
+    }
     if (ret) goto done;
 
     ret = EOK;
@@ -1783,6 +1788,72 @@ fail:
 
 /* this function does not check that all user members are actually present */
 
+/* The initgroups gid lists stored on the members of a group are only
+ * checked against the memberships of the user, they must be dropped
+ * explicitly when the gid of the group changes */
+static errno_t sysdb_drop_initgr_gids(struct sysdb_ctx *sysdb,
+                                      struct sss_domain_info *domain,
+                                      struct ldb_dn *group_dn)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = { SYSDB_NAME, NULL };
+    char *remove_attrs[] = { discard_const(SYSDB_INITGR_GIDS), NULL };
+    struct ldb_message **msgs;
+    const char *user_name;
+    char *sanitized_dn;
+    char *filter;
+    size_t count;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    ret = sss_filter_sanitize(tmp_ctx, ldb_dn_get_linearized(group_dn),
+                              &sanitized_dn);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    filter = talloc_asprintf(tmp_ctx, "(&(%s=%s)(%s=*))",
+                             SYSDB_MEMBEROF, sanitized_dn, SYSDB_INITGR_GIDS);
+    if (!filter) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_search_users(tmp_ctx, sysdb, domain, filter, attrs,
+                             &count, &msgs);
+    if (ret == ENOENT) {
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    for (i = 0; i < count; i++) {
+        user_name = ldb_msg_find_attr_as_string(msgs[i], SYSDB_NAME, NULL);
+        if (!user_name) continue;
+
+        ret = sysdb_remove_attrs(sysdb, domain, user_name,
+                                 SYSDB_MEMBER_USER, remove_attrs);
+        if (ret != EOK) {
+            goto done;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Dropped the initgroups gid list of %u users "
+                              "after a gid change of [%s]\n",
+                              (unsigned int)count,
+                              ldb_dn_get_linearized(group_dn)));
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 int sysdb_store_group(struct sysdb_ctx *sysdb,
                       struct sss_domain_info *domain,
                       const char *name,
@@ -1869,6 +1940,11 @@ int sysdb_store_group(struct sysdb_ctx *sysdb,
     if (ret) goto done;
 
     ret = sysdb_set_group_attr(sysdb, domain, name, attrs, SYSDB_MOD_REP);
+    if (ret) goto done;
+
+    if (gid && gid != ldb_msg_find_attr_as_uint64(msg, SYSDB_GIDNUM, 0)) {
+        ret = sysdb_drop_initgr_gids(sysdb, domain, msg->dn);
+    }
 
 done:
     if (ret) {
@@ -23,6 +23,7 @@
 #ifndef __INT_SYS_DB_H__
 #define __INT_SYS_DB_H__
 
+#define SYSDB_VERSION_0_16 "0.16"
 #define SYSDB_VERSION_0_15 "0.15"
 #define SYSDB_VERSION_0_14 "0.14"
 #define SYSDB_VERSION_0_13 "0.13"
@@ -39,7 +40,7 @@
 #define SYSDB_VERSION_0_2 "0.2"
 #define SYSDB_VERSION_0_1 "0.1"
 
-#define SYSDB_VERSION SYSDB_VERSION_0_15
+#define SYSDB_VERSION SYSDB_VERSION_0_16
 
 #define SYSDB_BASE_LDIF \
      "dn: @ATTRIBUTES\n" \
@@ -65,6 +66,7 @@
      "@IDXATTR: servicePort\n" \
      "@IDXATTR: serviceProtocol\n" \
      "@IDXATTR: sudoUser\n" \
+     "@IDXATTR: sudoNetgroupUser\n" \
      "@IDXATTR: sshKnownHostsExpire\n" \
      "@IDXONE: 1\n" \
      "\n" \
@@ -85,8 +87,21 @@
 struct sysdb_ctx {
     struct ldb_context *ldb;
     char *ldb_file;
+
+    int transaction_nesting;
+    struct sysdb_bulk *bulk;
+    /* only the entries of a batch of the bulk session are deferred */
+    bool bulk_batch;
 };
 
+/* ldb opaque that makes the memberof module skip adds and modifies, the
+ * name must match MBOF_DEFER_OPAQUE in ldb_modules/memberof.c */
+#define SYSDB_MEMBEROF_DEFER "memberof_defer"
+
+/* ldb opaque that keeps the memberof module from using its group graph,
+ * must match MBOF_NOGRAPH_OPAQUE */
+#define SYSDB_MEMBEROF_NOGRAPH "memberof_nograph"
+
 /* Internal utility functions */
 int sysdb_get_db_file(TALLOC_CTX *mem_ctx,
                       const char *provider, const char *name,
@@ -117,6 +132,21 @@ int sysdb_upgrade_11(struct sysdb_ctx *sysdb, struct sss_domain_info *domain,
 int sysdb_upgrade_12(struct sysdb_ctx *sysdb, const char **ver);
 int sysdb_upgrade_13(struct sysdb_ctx *sysdb, const char **ver);
 int sysdb_upgrade_14(struct sysdb_ctx *sysdb, const char **ver);
+int sysdb_upgrade_15(struct sysdb_ctx *sysdb, const char **ver);
+
+/* Bulk ingest */
+errno_t sysdb_bulk_stage_user(struct sysdb_bulk *bulk,
+                              struct sss_domain_info *domain,
+                              const char *name,
+                              const char *orig_dn,
+                              struct sysdb_attrs *attrs);
+
+errno_t sysdb_remove_ghost_from_group(struct sysdb_ctx *sysdb,
+                                      struct ldb_message *group,
+                                      struct ldb_message_element *alias_el,
+                                      const char *name,
+                                      const char *orig_dn,
+                                      const char *userdn);
 
 int add_string(struct ldb_message *msg, int flags,
                const char *attr, const char *value);
@@ -21,6 +21,7 @@
 
 #include "util/util.h"
 #include "db/sysdb_private.h"
+#include "util/murmurhash3.h"
 #include "confdb/confdb.h"
 #include <time.h>
 #include <ctype.h>
@@ -382,6 +383,209 @@ done:
     return ret;
 }
 
+/* enumeration cursors */
+
+struct sysdb_enum_cursor {
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *domain;
+    const char **attrs;
+    const char *filter;
+    bool mpg;
+
+    char **dns;
+    size_t count;
+};
+
+static int sysdb_enum_cursor_new(TALLOC_CTX *mem_ctx,
+                                 struct sysdb_ctx *sysdb,
+                                 struct sss_domain_info *domain,
+                                 struct ldb_dn *base_dn,
+                                 const char *filter,
+                                 const char **attrs,
+                                 bool mpg,
+                                 struct sysdb_enum_cursor **_cursor)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *dn_attrs[] = { SYSDB_NAME, NULL };
+    struct sysdb_enum_cursor *cursor;
+    struct ldb_result *res;
+    size_t i;
+    int ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    cursor = talloc_zero(tmp_ctx, struct sysdb_enum_cursor);
+    if (!cursor) {
+        ret = ENOMEM;
+        goto done;
+    }
+    cursor->sysdb = sysdb;
+    cursor->domain = domain;
+    cursor->attrs = attrs;
+    cursor->filter = filter;
+    cursor->mpg = mpg;
+
+    /* only the DNs are kept, fetch as little as possible */
+    ret = ldb_search(sysdb->ldb, tmp_ctx, &res, base_dn,
+                     LDB_SCOPE_SUBTREE, dn_attrs, "%s", filter);
+    if (ret) {
+        ret = sysdb_error_to_errno(ret);
+        goto done;
+    }
+
+    cursor->dns = talloc_array(cursor, char *, res->count);
+    if (!cursor->dns) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    for (i = 0; i < res->count; i++) {
+        cursor->dns[i] = talloc_strdup(cursor->dns,
+                                       ldb_dn_get_linearized(res->msgs[i]->dn));
+        if (!cursor->dns[i]) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+    cursor->count = res->count;
+
+    *_cursor = talloc_steal(mem_ctx, cursor);
+    ret = EOK;
+
+done:
+    talloc_zfree(tmp_ctx);
+    return ret;
+}
+
+int sysdb_enumpwent_cursor(TALLOC_CTX *mem_ctx,
+                           struct sysdb_ctx *sysdb,
+                           struct sss_domain_info *domain,
+                           struct sysdb_enum_cursor **_cursor)
+{
+    static const char *attrs[] = SYSDB_PW_ATTRS;
+    struct ldb_dn *base_dn;
+    int ret;
+
+    base_dn = ldb_dn_new_fmt(NULL, sysdb->ldb,
+                             SYSDB_TMPL_USER_BASE, domain->name);
+    if (!base_dn) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_enum_cursor_new(mem_ctx, sysdb, domain, base_dn,
+                                SYSDB_PWENT_FILTER, attrs, false, _cursor);
+    talloc_free(base_dn);
+    return ret;
+}
+
+int sysdb_enumgrent_cursor(TALLOC_CTX *mem_ctx,
+                           struct sysdb_ctx *sysdb,
+                           struct sss_domain_info *domain,
+                           struct sysdb_enum_cursor **_cursor)
+{
+    static const char *attrs[] = SYSDB_GRSRC_ATTRS;
+    const char *filter;
+    struct ldb_dn *base_dn;
+    int ret;
+
+    if (domain->mpg) {
+        filter = SYSDB_GRENT_MPG_FILTER;
+        base_dn = ldb_dn_new_fmt(NULL, sysdb->ldb,
+                                 SYSDB_DOM_BASE, domain->name);
+    } else {
+        filter = SYSDB_GRENT_FILTER;
+        base_dn = ldb_dn_new_fmt(NULL, sysdb->ldb,
+                                 SYSDB_TMPL_GROUP_BASE, domain->name);
+    }
+    if (!base_dn) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_enum_cursor_new(mem_ctx, sysdb, domain, base_dn,
+                                filter, attrs, domain->mpg, _cursor);
+    talloc_free(base_dn);
+    return ret;
+}
+
+size_t sysdb_enum_cursor_count(struct sysdb_enum_cursor *cursor)
+{
+    return cursor->count;
+}
+
+int sysdb_enum_cursor_fetch(TALLOC_CTX *mem_ctx,
+                            struct sysdb_enum_cursor *cursor,
+                            size_t offset, size_t max,
+                            struct ldb_result **_res)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_dn *base_dn;
+    struct ldb_result *res;
+    char *sanitized;
+    char *filter;
+    size_t i;
+    int ret;
+
+    if (offset >= cursor->count || max == 0) {
+        return ENOENT;
+    }
+    if (max > cursor->count - offset) {
+        max = cursor->count - offset;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    /* the DN is always indexed, so this is a lookup per entry of the page
+     * rather than a scan of the whole domain */
+    filter = talloc_asprintf(tmp_ctx, "(&%s(|", cursor->filter);
+    for (i = offset; filter && i < offset + max; i++) {
+        ret = sss_filter_sanitize(tmp_ctx, cursor->dns[i], &sanitized);
+        if (ret != EOK) {
+            goto done;
+        }
+        filter = talloc_asprintf_append_buffer(filter, "(dn=%s)", sanitized);
+        talloc_free(sanitized);
+    }
+    if (filter) {
+        filter = talloc_asprintf_append_buffer(filter, "))");
+    }
+    if (!filter) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    base_dn = sysdb_domain_dn(cursor->sysdb, tmp_ctx, cursor->domain);
+    if (!base_dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_search(cursor->sysdb->ldb, tmp_ctx, &res, base_dn,
+                     LDB_SCOPE_SUBTREE, cursor->attrs, "%s", filter);
+    if (ret) {
+        ret = sysdb_error_to_errno(ret);
+        goto done;
+    }
+
+    if (cursor->mpg) {
+        ret = mpg_res_convert(res);
+        if (ret) {
+            goto done;
+        }
+    }
+
+    *_res = talloc_steal(mem_ctx, res);
+
+done:
+    talloc_zfree(tmp_ctx);
+    return ret;
+}
+
 int sysdb_initgroups(TALLOC_CTX *mem_ctx,
                      struct sysdb_ctx *sysdb,
                      struct sss_domain_info *domain,
@@ -482,6 +686,314 @@ done:
     return ret;
 }
 
+/* Version tag of the stored initgroups gid list, bump it if the format or
+ * the way the digest is computed changes */
+#define INITGR_GIDS_VERSION "1"
+
+/* Order independent digest of the memberof values of a user, any added or
+ * removed membership changes it */
+static char *sysdb_initgr_digest(TALLOC_CTX *mem_ctx,
+                                 struct ldb_message_element *el)
+{
+    uint32_t xor_hash = 0;
+    uint32_t sum_hash = 0;
+    uint32_t h;
+    unsigned int count = 0;
+    unsigned int i;
+
+    if (el) {
+        count = el->num_values;
+        for (i = 0; i < el->num_values; i++) {
+            h = murmurhash3((const char *)el->values[i].data,
+                            el->values[i].length, 1);
+            xor_hash ^= h;
+            h = murmurhash3((const char *)el->values[i].data,
+                            el->values[i].length, 2);
+            sum_hash += h;
+        }
+    }
+
+    return talloc_asprintf(mem_ctx, "%u:%08x:%08x",
+                           count, xor_hash, sum_hash);
+}
+
+/* Parses the stored list into an initgroups result made of the user entry
+ * followed by one message per gid. Returns ENOENT if the list is missing
+ * or does not match the current memberships of the user. */
+static errno_t sysdb_initgr_gids_res(TALLOC_CTX *mem_ctx,
+                                     struct ldb_context *ldb,
+                                     struct ldb_message *user,
+                                     struct ldb_result **_res)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ldb_result *res;
+    struct ldb_message *msg;
+    const char *stored;
+    const char *p;
+    char *digest;
+    char *endptr;
+    unsigned long gid;
+    size_t len;
+    size_t num;
+    errno_t ret;
+
+    stored = ldb_msg_find_attr_as_string(user, SYSDB_INITGR_GIDS, NULL);
+    if (!stored) {
+        return ENOENT;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    digest = sysdb_initgr_digest(tmp_ctx,
+                                 ldb_msg_find_element(user, SYSDB_MEMBEROF));
+    if (!digest) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* INITGR_GIDS_VERSION;digest;gid,gid,... */
+    p = stored;
+    len = strlen(INITGR_GIDS_VERSION);
+    if (strncmp(p, INITGR_GIDS_VERSION, len) != 0 || p[len] != ';') {
+        ret = ENOENT;
+        goto done;
+    }
+    p += len + 1;
+    len = strlen(digest);
+    if (strncmp(p, digest, len) != 0 || p[len] != ';') {
+        ret = ENOENT;
+        goto done;
+    }
+    p += len + 1;
+
+    num = 1;
+    if (*p) {
+        num++;
+        for (endptr = discard_const(p); *endptr; endptr++) {
+            if (*endptr == ',') num++;
+        }
+    }
+
+    res = talloc_zero(tmp_ctx, struct ldb_result);
+    if (!res) {
+        ret = ENOMEM;
+        goto done;
+    }
+    res->msgs = talloc_array(res, struct ldb_message *, num + 1);
+    if (!res->msgs) {
+        ret = ENOMEM;
+        goto done;
+    }
+    res->msgs[0] = talloc_steal(res->msgs, user);
+    res->count = 1;
+
+    while (*p) {
+        errno = 0;
+        gid = strtoul(p, &endptr, 10);
+        if (errno != 0 || endptr == p || gid == 0 ||
+            (*endptr != ',' && *endptr != '\0') || res->count >= num) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Malformed initgroups gid list [%s]\n", stored));
+            ret = ENOENT;
+            goto done;
+        }
+
+        msg = ldb_msg_new(res->msgs);
+        if (!msg) {
+            ret = ENOMEM;
+            goto done;
+        }
+        msg->dn = ldb_dn_new(msg, ldb, NULL);
+        ret = ldb_msg_add_fmt(msg, SYSDB_GIDNUM, "%lu", gid);
+        if (!msg->dn || ret != LDB_SUCCESS) {
+            ret = ENOMEM;
+            goto done;
+        }
+        res->msgs[res->count++] = msg;
+
+        p = (*endptr == ',') ? endptr + 1 : endptr;
+    }
+    res->msgs[res->count] = NULL;
+
+    *_res = talloc_steal(mem_ctx, res);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+int sysdb_initgroups_gids(TALLOC_CTX *mem_ctx,
+                          struct sysdb_ctx *sysdb,
+                          struct sss_domain_info *domain,
+                          const char *name,
+                          struct ldb_result **_res)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = {SYSDB_NAME, SYSDB_UIDNUM,
+                                  SYSDB_GIDNUM, SYSDB_GECOS,
+                                  SYSDB_HOMEDIR, SYSDB_SHELL,
+                                  SYSDB_DEFAULT_ATTRS,
+                                  SYSDB_MEMBEROF,
+                                  SYSDB_INITGR_GIDS,
+                                  NULL};
+    struct ldb_result *res;
+    const char *src_name;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    if (IS_SUBDOMAIN(domain) && domain->fqnames) {
+        src_name = talloc_asprintf(tmp_ctx, domain->names->fq_fmt,
+                                   name, domain->name);
+        if (!src_name) {
+            ret = ENOMEM;
+            goto done;
+        }
+    } else {
+        src_name = name;
+    }
+
+    ret = sysdb_get_user_attr(tmp_ctx, sysdb, domain, src_name, attrs, &res);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (res->count == 1) {
+        ret = sysdb_initgr_gids_res(mem_ctx, sysdb->ldb, res->msgs[0], _res);
+        if (ret == EOK) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  ("Using the stored initgroups gid list of [%s]\n", name));
+            goto done;
+        } else if (ret != ENOENT) {
+            goto done;
+        }
+    }
+
+    /* not stored, stale or not cached at all */
+    ret = sysdb_initgroups(mem_ctx, sysdb, domain, name, _res);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+errno_t sysdb_update_initgr_gids(struct sysdb_ctx *sysdb,
+                                 struct sss_domain_info *domain,
+                                 const char *name)
+{
+    TALLOC_CTX *tmp_ctx;
+    static const char *attrs[] = {SYSDB_NAME, SYSDB_MEMBEROF, NULL};
+    struct sysdb_attrs *gid_attrs;
+    struct ldb_result *groups;
+    struct ldb_result *user;
+    const char *user_name;
+    const char *src_name;
+    const char *sep;
+    char *digest;
+    char *value;
+    unsigned long gid;
+    unsigned int i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_initgroups(tmp_ctx, sysdb, domain, name, &groups);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    if (groups->count == 0) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    /* the stored name may differ from the requested one (aliases) */
+    user_name = ldb_msg_find_attr_as_string(groups->msgs[0], SYSDB_NAME, NULL);
+    if (!user_name) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    if (IS_SUBDOMAIN(domain) && domain->fqnames) {
+        src_name = talloc_asprintf(tmp_ctx, domain->names->fq_fmt,
+                                   name, domain->name);
+        if (!src_name) {
+            ret = ENOMEM;
+            goto done;
+        }
+    } else {
+        src_name = name;
+    }
+
+    /* sysdb_initgroups() does not return the memberof values */
+    ret = sysdb_get_user_attr(tmp_ctx, sysdb, domain, src_name, attrs, &user);
+    if (ret != EOK) {
+        goto done;
+    }
+    if (user->count != 1) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    digest = sysdb_initgr_digest(tmp_ctx,
+                                 ldb_msg_find_element(user->msgs[0],
+                                                      SYSDB_MEMBEROF));
+    if (!digest) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    value = talloc_asprintf(tmp_ctx, INITGR_GIDS_VERSION";%s;", digest);
+    sep = "";
+    for (i = 1; value && i < groups->count; i++) {
+        /* non-POSIX groups are skipped by the callers as well */
+        gid = ldb_msg_find_attr_as_uint64(groups->msgs[i], SYSDB_GIDNUM, 0);
+        if (gid == 0) continue;
+
+        value = talloc_asprintf_append_buffer(value, "%s%lu", sep, gid);
+        sep = ",";
+    }
+    if (!value) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    gid_attrs = sysdb_new_attrs(tmp_ctx);
+    if (!gid_attrs) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sysdb_attrs_add_string(gid_attrs, SYSDB_INITGR_GIDS, value);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = sysdb_set_user_attr(sysdb, domain, user_name,
+                              gid_attrs, SYSDB_MOD_REP);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL,
+          ("Stored %u initgroups gids for [%s]\n",
+           groups->count - 1, user_name));
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
 int sysdb_get_user_attr(TALLOC_CTX *mem_ctx,
                         struct sysdb_ctx *sysdb,
                         struct sss_domain_info *domain,
@@ -272,8 +272,8 @@ sysdb_get_sudo_filter(TALLOC_CTX *mem_ctx, const char *username,
     }
 
     if (flags & SYSDB_SUDO_FILTER_NGRS) {
-        specific_filter = talloc_asprintf_append(specific_filter, "(%s=+*)",
-                                                 SYSDB_SUDO_CACHE_AT_USER);
+        specific_filter = talloc_asprintf_append(specific_filter, "(%s=TRUE)",
+                                            SYSDB_SUDO_CACHE_AT_NETGROUP_USER);
         NULL_CHECK(specific_filter, ret, done);
     }
 
@@ -604,6 +604,37 @@ errno_t sysdb_sudo_get_last_full_refresh(struct sysdb_ctx *sysdb,
                                        SYSDB_SUDO_AT_LAST_FULL_REFRESH, value);
 }
 
+/* The value only has to differ from the previous one. It normally is the
+ * time of the change, but is incremented when the rules change more than
+ * once a second. Purging all rules removes the previous value, the time
+ * keeps it from starting over at a value used before. */
+errno_t sysdb_sudo_mark_changed(struct sysdb_ctx *sysdb,
+                                struct sss_domain_info *domain)
+{
+    time_t last;
+    time_t now;
+    errno_t ret;
+
+    ret = sysdb_sudo_get_refresh_time(sysdb, domain,
+                                      SYSDB_SUDO_AT_LAST_CHANGE, &last);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    now = time(NULL);
+    return sysdb_sudo_set_refresh_time(sysdb, domain,
+                                       SYSDB_SUDO_AT_LAST_CHANGE,
+                                       last < now ? now : last + 1);
+}
+
+errno_t sysdb_sudo_get_last_change(struct sysdb_ctx *sysdb,
+                                   struct sss_domain_info *domain,
+                                   time_t *value)
+{
+    return sysdb_sudo_get_refresh_time(sysdb, domain,
+                                       SYSDB_SUDO_AT_LAST_CHANGE, value);
+}
+
 /* ====================  Purge functions ==================== */
 
 static errno_t sysdb_sudo_purge_all(struct sysdb_ctx *sysdb,
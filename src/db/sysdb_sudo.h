@@ -31,6 +31,8 @@
  * should be true if we have downloaded all rules atleast once */
 #define SYSDB_SUDO_AT_REFRESHED      "refreshed"
 #define SYSDB_SUDO_AT_LAST_FULL_REFRESH "sudoLastFullRefreshTime"
+/* changes whenever the provider modifies the cached rules */
+#define SYSDB_SUDO_AT_LAST_CHANGE "sudoLastChange"
 
 /* sysdb attributes */
 #define SYSDB_SUDO_CACHE_OC            "sudoRule"
@@ -44,6 +46,9 @@
 #define SYSDB_SUDO_CACHE_AT_NOTBEFORE  "sudoNotBefore"
 #define SYSDB_SUDO_CACHE_AT_NOTAFTER   "sudoNotAfter"
 #define SYSDB_SUDO_CACHE_AT_ORDER      "sudoOrder"
+/* TRUE if one of the sudoUser values is a +netgroup, lets the netgroup
+ * rules be found through the index instead of a substring match */
+#define SYSDB_SUDO_CACHE_AT_NETGROUP_USER "sudoNetgroupUser"
 
 /* When constructing a sysdb filter, OR these values to include..   */
 #define SYSDB_SUDO_FILTER_NONE           0x00       /* no additional filter */
@@ -90,6 +95,12 @@ errno_t sysdb_sudo_get_last_full_refresh(struct sysdb_ctx *sysdb,
                                          struct sss_domain_info *domain,
                                          time_t *value);
 
+errno_t sysdb_sudo_mark_changed(struct sysdb_ctx *sysdb,
+                                struct sss_domain_info *domain);
+errno_t sysdb_sudo_get_last_change(struct sysdb_ctx *sysdb,
+                                   struct sss_domain_info *domain,
+                                   time_t *value);
+
 errno_t sysdb_sudo_purge_byname(struct sysdb_ctx *sysdb,
                                 struct sss_domain_info *domain,
                                 const char *name);
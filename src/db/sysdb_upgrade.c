@@ -25,6 +25,7 @@
 #include "util/util.h"
 #include "db/sysdb_private.h"
 #include "db/sysdb_autofs.h"
+#include "db/sysdb_sudo.h"
 
 struct upgrade_ctx {
     struct ldb_context *ldb;
@@ -1518,6 +1519,110 @@ done:
     return ret;
 }
 
+int sysdb_upgrade_15(struct sysdb_ctx *sysdb, const char **ver)
+{
+    struct upgrade_ctx *ctx;
+    struct ldb_message *msg;
+    struct ldb_result *res;
+    struct ldb_dn *basedn;
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    errno_t ret;
+    int i;
+
+    ret = commence_upgrade(sysdb, sysdb->ldb, SYSDB_VERSION_0_16, &ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* Add Index for sudoNetgroupUser */
+    msg = ldb_msg_new(ctx);
+    if (!msg) {
+        ret = ENOMEM;
+        goto done;
+    }
+    msg->dn = ldb_dn_new(msg, sysdb->ldb, "@INDEXLIST");
+    if (!msg->dn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_msg_add_empty(msg, "@IDXATTR", LDB_FLAG_MOD_ADD, NULL);
+    if (ret != LDB_SUCCESS) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_msg_add_string(msg, "@IDXATTR",
+                             SYSDB_SUDO_CACHE_AT_NETGROUP_USER);
+    if (ret != LDB_SUCCESS) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_modify(sysdb->ldb, msg);
+    if (ret != LDB_SUCCESS) {
+        ret = sysdb_error_to_errno(ret);
+        goto done;
+    }
+    talloc_zfree(msg);
+
+    /* mark the netgroup rules that are already cached */
+    basedn = ldb_dn_new(ctx, sysdb->ldb, SYSDB_BASE);
+    if (!basedn) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = ldb_search(sysdb->ldb, ctx, &res,
+                     basedn, LDB_SCOPE_SUBTREE, attrs,
+                     "(&(objectclass=%s)(%s=+*))",
+                     SYSDB_SUDO_CACHE_OC, SYSDB_SUDO_CACHE_AT_USER);
+    if (ret != LDB_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to search sudo rules\n"));
+        ret = EIO;
+        goto done;
+    }
+
+    for (i = 0; i < res->count; i++) {
+        msg = ldb_msg_new(ctx);
+        if (!msg) {
+            ret = ENOMEM;
+            goto done;
+        }
+        msg->dn = res->msgs[i]->dn;
+
+        ret = ldb_msg_add_empty(msg, SYSDB_SUDO_CACHE_AT_NETGROUP_USER,
+                                LDB_FLAG_MOD_REPLACE, NULL);
+        if (ret != LDB_SUCCESS) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_msg_add_string(msg, SYSDB_SUDO_CACHE_AT_NETGROUP_USER,
+                                 "TRUE");
+        if (ret != LDB_SUCCESS) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = ldb_modify(sysdb->ldb, msg);
+        if (ret != LDB_SUCCESS) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Failed to mark sudo rule %s\n",
+                  ldb_dn_get_linearized(res->msgs[i]->dn)));
+            ret = sysdb_error_to_errno(ret);
+            goto done;
+        }
+        talloc_zfree(msg);
+    }
+
+    /* conversion done, update version number */
+    ret = update_version(ctx);
+
+done:
+    ret = finish_upgrade(ret, &ctx, ver);
+    return ret;
+}
+
 /*
  * Example template for future upgrades.
  * Copy and change version numbers as appropriate.
@@ -37,6 +37,15 @@
 #define DB_CACHE_EXPIRE "dataExpireTimestamp"
 #define DB_OC "objectClass"
 
+/* Set by sysdb while it stores a batch of a bulk ingest, see
+ * sysdb_bulk_batch_start(). Adds and modifies are passed through untouched
+ * and the caller rebuilds all memberof, memberuid and ghost values once it
+ * is done. */
+#define MBOF_DEFER_OPAQUE "memberof_defer"
+
+/* when set, the group graph is neither built nor used */
+#define MBOF_NOGRAPH_OPAQUE "memberof_nograph"
+
 #ifndef MAX
 #define MAX(a,b) (((a) > (b)) ? (a) : (b))
 #endif
@@ -79,6 +88,41 @@ struct mbof_memberuid_op {
     struct ldb_message_element *el;
 };
 
+struct mbof_gop;
+
+/* a user or group entry in the cached membership graph */
+struct mbof_gnode {
+    struct ldb_dn *dn;
+    char *key;
+    const char *name;
+    bool is_group;
+
+    /* direct memberships, parents are always groups */
+    struct mbof_gnode **parents;
+    int num_parents;
+    struct mbof_gnode **children;
+    int num_children;
+
+    unsigned int mark;
+    struct mbof_gop *op;
+};
+
+struct mbof_graph {
+    hash_table_t *nodes;
+    uint64_t seq_num;
+    unsigned int gen;
+};
+
+/* memberof additions computed from the graph for a single entry */
+struct mbof_gop {
+    struct mbof_gnode *node;
+    struct mbof_dn_array *delta;
+};
+
+struct mbof_private {
+    struct mbof_graph *graph;
+};
+
 struct mbof_add_ctx {
     struct mbof_ctx *ctx;
 
@@ -94,6 +138,10 @@ struct mbof_add_ctx {
     struct mbof_memberuid_op *muops;
     int num_muops;
     int cur_muop;
+
+    struct mbof_gop *gops;
+    int num_gops;
+    int cur_gop;
 };
 
 struct mbof_del_ancestors_ctx {
@@ -306,6 +354,495 @@ static int mbof_append_muop(TALLOC_CTX *memctx,
 }
 
 
+/* group graph */
+
+/* Adding a member to a group changes the memberof attribute of the new
+ * member and of all its direct and indirect members. Discovering them one
+ * entry at a time costs a lookup per descendant even when most of them
+ * already carry all the new memberships.
+ *
+ * To avoid that the module keeps an in-memory copy of the member links
+ * between all user and group entries. The graph is built on first use with
+ * a single search and then kept up to date by the add, modify and delete
+ * operations. When members are added it is used to compute, for every
+ * descendant, exactly which memberof values are missing, so that only the
+ * entries that actually change are modified, one after the other, without
+ * any lookup in between.
+ *
+ * The cache is shared by all the processes that open the database, so the
+ * graph is only trusted if the database sequence number did not change
+ * since the last transaction committed by this process. It is dropped when
+ * a transaction is canceled, when memberof processing is deferred or
+ * recomputed, and whenever an operation cannot be reflected in the graph.
+ */
+
+static struct mbof_private *mbof_get_private(struct ldb_module *module)
+{
+    return talloc_get_type(ldb_module_get_private(module),
+                           struct mbof_private);
+}
+
+static void mbof_graph_drop(struct ldb_module *module)
+{
+    struct mbof_private *priv = mbof_get_private(module);
+
+    if (priv && priv->graph) {
+        ldb_debug(ldb_module_get_ctx(module), LDB_DEBUG_TRACE,
+                  "Dropping the memberof graph");
+        talloc_zfree(priv->graph);
+    }
+}
+
+static struct mbof_gnode *mbof_graph_find(struct mbof_graph *graph,
+                                          struct ldb_dn *dn)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(ldb_dn_get_casefold(dn));
+    if (!key.str) {
+        return NULL;
+    }
+
+    hret = hash_lookup(graph->nodes, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return talloc_get_type(value.ptr, struct mbof_gnode);
+}
+
+static int mbof_graph_add_node(struct mbof_graph *graph,
+                               struct ldb_dn *dn, bool is_group,
+                               const char *name,
+                               struct mbof_gnode **_node)
+{
+    struct mbof_gnode *node;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    node = mbof_graph_find(graph, dn);
+    if (node) {
+        node->is_group = is_group;
+        goto done;
+    }
+
+    node = talloc_zero(graph, struct mbof_gnode);
+    if (!node) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    node->dn = ldb_dn_copy(node, dn);
+    if (!node->dn) {
+        talloc_free(node);
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+    node->key = talloc_strdup(node, ldb_dn_get_casefold(node->dn));
+    if (!node->key) {
+        talloc_free(node);
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+    if (name) {
+        node->name = talloc_strdup(node, name);
+        if (!node->name) {
+            talloc_free(node);
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+    node->is_group = is_group;
+
+    key.type = HASH_KEY_STRING;
+    key.str = node->key;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = node;
+
+    hret = hash_enter(graph->nodes, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        talloc_free(node);
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+done:
+    if (_node) *_node = node;
+    return LDB_SUCCESS;
+}
+
+static int mbof_gnode_append(struct mbof_gnode *owner,
+                             struct mbof_gnode *node,
+                             struct mbof_gnode ***_list, int *_num)
+{
+    struct mbof_gnode **list = *_list;
+
+    /* grow geometrically, the array is full when num is a power of 2 */
+    if ((*_num & (*_num - 1)) == 0) {
+        list = talloc_realloc(owner, list, struct mbof_gnode *,
+                              MAX(4, *_num * 2));
+        if (!list) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+    list[*_num] = node;
+    (*_num)++;
+    *_list = list;
+
+    return LDB_SUCCESS;
+}
+
+static void mbof_gnode_remove(struct mbof_gnode *node,
+                              struct mbof_gnode **list, int *_num)
+{
+    int i;
+
+    for (i = 0; i < *_num; i++) {
+        if (list[i] == node) {
+            list[i] = list[*_num - 1];
+            (*_num)--;
+            return;
+        }
+    }
+}
+
+static int mbof_graph_link(struct mbof_gnode *parent,
+                           struct mbof_gnode *child, bool check)
+{
+    int ret;
+    int i;
+
+    if (check) {
+        /* parents lists are short, children lists can be huge */
+        for (i = 0; i < child->num_parents; i++) {
+            if (child->parents[i] == parent) {
+                return LDB_SUCCESS;
+            }
+        }
+    }
+
+    ret = mbof_gnode_append(child, parent,
+                            &child->parents, &child->num_parents);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+
+    return mbof_gnode_append(parent, child,
+                             &parent->children, &parent->num_children);
+}
+
+static void mbof_graph_unlink(struct mbof_gnode *parent,
+                              struct mbof_gnode *child)
+{
+    mbof_gnode_remove(parent, child->parents, &child->num_parents);
+    mbof_gnode_remove(child, parent->children, &parent->num_children);
+}
+
+static void mbof_graph_del_node(struct mbof_graph *graph,
+                                struct mbof_gnode *node)
+{
+    hash_key_t key;
+
+    while (node->num_parents) {
+        mbof_graph_unlink(node->parents[0], node);
+    }
+    while (node->num_children) {
+        mbof_graph_unlink(node, node->children[0]);
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = node->key;
+    hash_delete(graph->nodes, &key);
+
+    talloc_free(node);
+}
+
+/* Breadth first walk starting from (and including) the given nodes, either
+ * towards the parents or towards the children. All returned nodes are
+ * marked with graph->gen until the next walk. */
+static int mbof_graph_walk(TALLOC_CTX *mem_ctx, struct mbof_graph *graph,
+                           struct mbof_gnode **start, int num_start,
+                           bool up, struct mbof_gnode ***_nodes, int *_num)
+{
+    struct mbof_gnode **nodes;
+    struct mbof_gnode **next;
+    struct mbof_gnode *node;
+    int num_next;
+    int size;
+    int num;
+    int i, j;
+
+    graph->gen++;
+
+    size = num_start + 16;
+    nodes = talloc_array(mem_ctx, struct mbof_gnode *, size);
+    if (!nodes) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    num = 0;
+    for (i = 0; i < num_start; i++) {
+        if (start[i]->mark == graph->gen) continue;
+        start[i]->mark = graph->gen;
+        nodes[num] = start[i];
+        num++;
+    }
+
+    for (i = 0; i < num; i++) {
+        node = nodes[i];
+        next = up ? node->parents : node->children;
+        num_next = up ? node->num_parents : node->num_children;
+
+        for (j = 0; j < num_next; j++) {
+            if (next[j]->mark == graph->gen) continue;
+            next[j]->mark = graph->gen;
+
+            if (num == size) {
+                size *= 2;
+                nodes = talloc_realloc(mem_ctx, nodes,
+                                       struct mbof_gnode *, size);
+                if (!nodes) {
+                    return LDB_ERR_OPERATIONS_ERROR;
+                }
+            }
+            nodes[num] = next[j];
+            num++;
+        }
+    }
+
+    *_nodes = nodes;
+    *_num = num;
+    return LDB_SUCCESS;
+}
+
+static int mbof_graph_search(struct ldb_module *module, TALLOC_CTX *mem_ctx,
+                             const char *filter, const char **attrs,
+                             struct ldb_result **_res)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(module);
+    struct ldb_request *req;
+    struct ldb_result *res;
+    int ret;
+
+    res = talloc_zero(mem_ctx, struct ldb_result);
+    if (!res) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    ret = ldb_build_search_req(&req, ldb, res,
+                               NULL, LDB_SCOPE_SUBTREE,
+                               filter, attrs, NULL,
+                               res, ldb_search_default_callback,
+                               NULL);
+    if (ret != LDB_SUCCESS) {
+        talloc_free(res);
+        return ret;
+    }
+
+    ret = ldb_next_request(module, req);
+    if (ret == LDB_SUCCESS) {
+        ret = ldb_wait(req->handle, LDB_WAIT_ALL);
+    }
+    talloc_free(req);
+    if (ret != LDB_SUCCESS) {
+        talloc_free(res);
+        return ret;
+    }
+
+    *_res = res;
+    return LDB_SUCCESS;
+}
+
+static int mbof_graph_load(struct ldb_module *module,
+                           struct mbof_graph **_graph)
+{
+    static const char *attrs[] = { DB_OC, DB_NAME, DB_MEMBER, NULL };
+    static const char *filter = "(|(objectclass=user)(objectclass=group))";
+    struct ldb_context *ldb = ldb_module_get_ctx(module);
+    struct ldb_message_element *el;
+    struct mbof_gnode *parent;
+    struct mbof_gnode *child;
+    struct mbof_graph *graph;
+    struct ldb_result *res;
+    struct ldb_dn *valdn;
+    TALLOC_CTX *tmp_ctx;
+    unsigned long edges = 0;
+    unsigned int i, j;
+    int ret;
+
+    tmp_ctx = talloc_new(module);
+    if (!tmp_ctx) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    graph = talloc_zero(tmp_ctx, struct mbof_graph);
+    if (!graph) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+
+    ret = hash_create_ex(1024, &graph->nodes, 0, 0, 0, 0,
+                         hash_alloc, hash_free, graph, NULL, NULL);
+    if (ret != HASH_SUCCESS) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+
+    ret = mbof_graph_search(module, tmp_ctx, filter, attrs, &res);
+    if (ret != LDB_SUCCESS) {
+        goto done;
+    }
+
+    for (i = 0; i < res->count; i++) {
+        ret = mbof_graph_add_node(graph, res->msgs[i]->dn,
+                        entry_is_group_object(res->msgs[i]) == LDB_SUCCESS,
+                        ldb_msg_find_attr_as_string(res->msgs[i],
+                                                    DB_NAME, NULL),
+                        NULL);
+        if (ret != LDB_SUCCESS) {
+            goto done;
+        }
+    }
+
+    for (i = 0; i < res->count; i++) {
+        el = ldb_msg_find_element(res->msgs[i], DB_MEMBER);
+        if (!el || el->num_values == 0) continue;
+
+        parent = mbof_graph_find(graph, res->msgs[i]->dn);
+        if (!parent || !parent->is_group) continue;
+
+        for (j = 0; j < el->num_values; j++) {
+            valdn = ldb_dn_from_ldb_val(tmp_ctx, ldb, &el->values[j]);
+            if (!valdn) {
+                ret = LDB_ERR_OPERATIONS_ERROR;
+                goto done;
+            }
+            child = mbof_graph_find(graph, valdn);
+            talloc_free(valdn);
+            /* dangling members are not part of the graph */
+            if (!child) continue;
+
+            /* member values are unique, no need to check for duplicates */
+            ret = mbof_graph_link(parent, child, false);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
+            edges++;
+        }
+    }
+
+    ldb_debug(ldb, LDB_DEBUG_TRACE,
+              "Loaded memberof graph with %u entries and %lu links",
+              res->count, edges);
+
+    *_graph = talloc_steal(module, graph);
+    ret = LDB_SUCCESS;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* Returns the cached graph, building it if load is true. Returns NULL if
+ * there is no usable graph. */
+static struct mbof_graph *mbof_graph_get(struct ldb_module *module, bool load)
+{
+    struct mbof_private *priv = mbof_get_private(module);
+    int ret;
+
+    if (!priv) {
+        return NULL;
+    }
+
+    if (ldb_get_opaque(ldb_module_get_ctx(module),
+                       MBOF_NOGRAPH_OPAQUE) != NULL) {
+        mbof_graph_drop(module);
+        return NULL;
+    }
+
+    if (!priv->graph && load) {
+        ret = mbof_graph_load(module, &priv->graph);
+        if (ret != LDB_SUCCESS) {
+            ldb_debug(ldb_module_get_ctx(module), LDB_DEBUG_ERROR,
+                      "Failed to load the memberof graph (%d)", ret);
+            priv->graph = NULL;
+        }
+    }
+
+    return priv->graph;
+}
+
+/* track a newly added user or group entry */
+static void mbof_graph_add_entry(struct ldb_module *module,
+                                 struct ldb_message *entry)
+{
+    struct mbof_graph *graph;
+    bool is_group;
+    int ret;
+
+    graph = mbof_graph_get(module, false);
+    if (!graph) {
+        return;
+    }
+
+    is_group = (entry_is_group_object(entry) == LDB_SUCCESS);
+    if (!is_group && entry_is_user_object(entry) != LDB_SUCCESS) {
+        return;
+    }
+
+    ret = mbof_graph_add_node(graph, entry->dn, is_group,
+                              ldb_msg_find_attr_as_string(entry,
+                                                          DB_NAME, NULL),
+                              NULL);
+    if (ret != LDB_SUCCESS) {
+        mbof_graph_drop(module);
+    }
+}
+
+static void mbof_graph_del_entry(struct ldb_module *module,
+                                 struct ldb_dn *dn)
+{
+    struct mbof_graph *graph;
+    struct mbof_gnode *node;
+
+    graph = mbof_graph_get(module, false);
+    if (!graph) {
+        return;
+    }
+
+    node = mbof_graph_find(graph, dn);
+    if (node) {
+        mbof_graph_del_node(graph, node);
+    }
+}
+
+static void mbof_graph_del_members(struct ldb_module *module,
+                                   struct ldb_dn *dn,
+                                   struct mbof_dn_array *members)
+{
+    struct mbof_graph *graph;
+    struct mbof_gnode *parent;
+    struct mbof_gnode *child;
+    int i;
+
+    graph = mbof_graph_get(module, false);
+    if (!graph) {
+        return;
+    }
+
+    parent = mbof_graph_find(graph, dn);
+    if (!parent) {
+        return;
+    }
+
+    for (i = 0; i < members->num; i++) {
+        child = mbof_graph_find(graph, members->dns[i]);
+        if (child) {
+            mbof_graph_unlink(parent, child);
+        }
+    }
+}
+
+
 /* add operation */
 
 /* An add operation is quite simple.
@@ -460,6 +997,15 @@ static int mbof_add_cleanup_callback(struct ldb_request *req,
 static int mbof_add_muop(struct mbof_add_ctx *add_ctx);
 static int mbof_add_muop_callback(struct ldb_request *req,
                                   struct ldb_reply *ares);
+static int mbof_graph_add_members(struct mbof_add_ctx *add_ctx,
+                                  struct ldb_dn *parent_dn,
+                                  bool *handled);
+
+static bool mbof_is_deferred(struct ldb_module *module)
+{
+    return ldb_get_opaque(ldb_module_get_ctx(module),
+                          MBOF_DEFER_OPAQUE) != NULL;
+}
 
 static int memberof_add(struct ldb_module *module, struct ldb_request *req)
 {
@@ -499,6 +1045,11 @@ static int memberof_add(struct ldb_module *module, struct ldb_request *req)
         return LDB_ERR_UNWILLING_TO_PERFORM;
     }
 
+    if (mbof_is_deferred(module)) {
+        mbof_graph_drop(module);
+        return ldb_next_request(module, req);
+    }
+
     ctx = mbof_init(module, req);
     if (!ctx) {
         return LDB_ERR_OPERATIONS_ERROR;
@@ -572,6 +1123,7 @@ static int mbof_add_callback(struct ldb_request *req,
 {
     struct mbof_add_ctx *add_ctx;
     struct mbof_ctx *ctx;
+    bool handled;
     int ret;
 
     add_ctx = talloc_get_type(req->context, struct mbof_add_ctx);
@@ -600,6 +1152,7 @@ static int mbof_add_callback(struct ldb_request *req,
 
     case LDB_REPLY_DONE:
         if (add_ctx->terminate) {
+            mbof_graph_add_entry(ctx->module, add_ctx->msg);
             return ldb_module_done(ctx->req,
                                    ctx->ret_ctrls,
                                    ctx->ret_resp,
@@ -610,7 +1163,12 @@ static int mbof_add_callback(struct ldb_request *req,
             /* first operation */
             ctx->ret_ctrls = talloc_steal(ctx, ares->controls);
             ctx->ret_resp = talloc_steal(ctx, ares->response);
-            ret = mbof_next_add(add_ctx->add_list);
+
+            mbof_graph_add_entry(ctx->module, add_ctx->msg);
+            ret = mbof_graph_add_members(add_ctx, add_ctx->msg_dn, &handled);
+            if (ret == LDB_SUCCESS && !handled) {
+                ret = mbof_next_add(add_ctx->add_list);
+            }
         }
         else if (add_ctx->current_op->next) {
             /* next operation */
@@ -1129,17 +1687,470 @@ static int mbof_add_muop(struct mbof_add_ctx *add_ctx)
 
     ret = ldb_build_mod_req(&mod_req, ldb, add_ctx,
                             msg, NULL,
-                            add_ctx, mbof_add_muop_callback,
+                            add_ctx, mbof_add_muop_callback,
+                            ctx->req);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+
+    return ldb_next_request(ctx->module, mod_req);
+}
+
+static int mbof_add_muop_callback(struct ldb_request *req,
+                                  struct ldb_reply *ares)
+{
+    struct mbof_add_ctx *add_ctx;
+    struct mbof_ctx *ctx;
+    int ret;
+
+    add_ctx = talloc_get_type(req->context, struct mbof_add_ctx);
+    ctx = add_ctx->ctx;
+
+    if (!ares) {
+        return ldb_module_done(ctx->req, NULL, NULL,
+                               LDB_ERR_OPERATIONS_ERROR);
+    }
+    if (ares->error != LDB_SUCCESS) {
+        return ldb_module_done(ctx->req,
+                               ares->controls,
+                               ares->response,
+                               ares->error);
+    }
+
+    switch (ares->type) {
+    case LDB_REPLY_ENTRY:
+        /* shouldn't happen */
+        talloc_zfree(ares);
+        return ldb_module_done(ctx->req, NULL, NULL,
+                               LDB_ERR_OPERATIONS_ERROR);
+    case LDB_REPLY_REFERRAL:
+        /* ignore */
+        break;
+
+    case LDB_REPLY_DONE:
+        add_ctx->cur_muop++;
+        if (add_ctx->cur_muop < add_ctx->num_muops) {
+            ret = mbof_add_muop(add_ctx);
+        }
+        else {
+            return ldb_module_done(ctx->req,
+                                   ctx->ret_ctrls,
+                                   ctx->ret_resp,
+                                   LDB_SUCCESS);
+        }
+
+        if (ret != LDB_SUCCESS) {
+            talloc_zfree(ares);
+            return ldb_module_done(ctx->req, NULL, NULL, ret);
+        }
+    }
+
+    talloc_zfree(ares);
+    return LDB_SUCCESS;
+}
+
+
+
+/* add members using the group graph */
+
+static int mbof_graph_ghost_callback(struct ldb_request *req,
+                                     struct ldb_reply *ares);
+static int mbof_graph_next_mod(struct mbof_add_ctx *add_ctx);
+static int mbof_graph_mod_callback(struct ldb_request *req,
+                                   struct ldb_reply *ares);
+
+static int mbof_graph_ghost_search(struct mbof_add_ctx *add_ctx,
+                                   struct mbof_gnode **members,
+                                   int num_members)
+{
+    static const char *attrs[] = { DB_OC, DB_GHOST, NULL };
+    struct ldb_context *ldb;
+    struct ldb_request *req;
+    struct mbof_ctx *ctx;
+    char *clean_dn;
+    char *filter;
+    int ret;
+    int i;
+
+    ctx = add_ctx->ctx;
+    ldb = ldb_module_get_ctx(ctx->module);
+
+    filter = talloc_asprintf(add_ctx, "(&(%s=%s)(%s=*)(|",
+                             DB_OC, DB_GROUP_CLASS, DB_GHOST);
+    if (!filter) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    for (i = 0; i < num_members; i++) {
+        if (!members[i]->is_group) continue;
+
+        ret = sss_filter_sanitize(filter,
+                                  ldb_dn_get_linearized(members[i]->dn),
+                                  &clean_dn);
+        if (ret != 0) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+
+        filter = talloc_asprintf_append(filter,
+                                        "(distinguishedName=%s)(%s=%s)",
+                                        clean_dn, DB_MEMBEROF, clean_dn);
+        if (!filter) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+        talloc_free(clean_dn);
+    }
+
+    filter = talloc_asprintf_append(filter, "))");
+    if (!filter) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    ret = ldb_build_search_req(&req, ldb, add_ctx,
+                               NULL, LDB_SCOPE_SUBTREE,
+                               filter, attrs, NULL,
+                               add_ctx, mbof_graph_ghost_callback,
+                               ctx->req);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+
+    return ldb_request(ldb, req);
+}
+
+static void mbof_graph_clear_ops(struct mbof_add_ctx *add_ctx)
+{
+    int i;
+
+    for (i = 0; i < add_ctx->num_gops; i++) {
+        add_ctx->gops[i].node->op = NULL;
+    }
+}
+
+/* Computes the memberof values each new member and each of its descendants
+ * is missing, updates the graph and starts modifying the entries.
+ * Sets *handled to false if the graph cannot be used, in which case the
+ * caller has to proceed with the regular add operations. */
+static int mbof_graph_add_members(struct mbof_add_ctx *add_ctx,
+                                  struct ldb_dn *parent_dn,
+                                  bool *handled)
+{
+    struct ldb_context *ldb;
+    struct mbof_add_operation *addop;
+    struct mbof_gnode **members;
+    struct mbof_gnode **ancestors;
+    struct mbof_gnode **desc;
+    struct mbof_gnode **anc;
+    struct mbof_gnode *parent;
+    struct mbof_gnode *node;
+    struct mbof_graph *graph;
+    struct mbof_dn_array *delta;
+    struct mbof_ctx *ctx;
+    TALLOC_CTX *tmp_ctx;
+    bool ghosts = false;
+    int num_members;
+    int num_ancestors;
+    int num_desc;
+    int num_anc;
+    int i, j;
+    int ret;
+
+    ctx = add_ctx->ctx;
+    ldb = ldb_module_get_ctx(ctx->module);
+    *handled = false;
+
+    if (!add_ctx->add_list) {
+        return LDB_SUCCESS;
+    }
+
+    graph = mbof_graph_get(ctx->module, true);
+    if (!graph) {
+        return LDB_SUCCESS;
+    }
+
+    /* only member links of groups are tracked */
+    parent = mbof_graph_find(graph, parent_dn);
+    if (!parent || !parent->is_group) {
+        return LDB_SUCCESS;
+    }
+
+    tmp_ctx = talloc_new(add_ctx);
+    if (!tmp_ctx) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    num_members = 0;
+    for (addop = add_ctx->add_list; addop; addop = addop->next) {
+        num_members++;
+    }
+    members = talloc_array(tmp_ctx, struct mbof_gnode *, num_members);
+    if (!members) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+
+    for (i = 0, addop = add_ctx->add_list; addop; addop = addop->next, i++) {
+        members[i] = mbof_graph_find(graph, addop->entry_dn);
+        if (!members[i]) {
+            /* not a user or group, or a missing entry, the regular add
+             * operations will take care of it but we cannot follow */
+            mbof_graph_drop(ctx->module);
+            ret = LDB_SUCCESS;
+            goto done;
+        }
+
+        /* a graph loaded by this very operation already has the link */
+        mbof_graph_unlink(parent, members[i]);
+    }
+
+    /* the new parent and all its ancestors */
+    ret = mbof_graph_walk(tmp_ctx, graph, &parent, 1, true,
+                          &ancestors, &num_ancestors);
+    if (ret != LDB_SUCCESS) {
+        goto done;
+    }
+
+    /* the new members and all their descendants */
+    ret = mbof_graph_walk(tmp_ctx, graph, members, num_members, false,
+                          &desc, &num_desc);
+    if (ret != LDB_SUCCESS) {
+        goto done;
+    }
+
+    add_ctx->gops = talloc_zero_array(add_ctx, struct mbof_gop, num_desc);
+    if (!add_ctx->gops) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto done;
+    }
+
+    for (i = 0; i < num_desc; i++) {
+        node = desc[i];
+
+        ret = mbof_graph_walk(tmp_ctx, graph,
+                              node->parents, node->num_parents, true,
+                              &anc, &num_anc);
+        if (ret != LDB_SUCCESS) {
+            goto done;
+        }
+
+        delta = NULL;
+        for (j = 0; j < num_ancestors; j++) {
+            /* skip itself and memberships the entry already has */
+            if (ancestors[j] == node) continue;
+            if (ancestors[j]->mark == graph->gen) continue;
+
+            if (!delta) {
+                delta = talloc_zero(add_ctx->gops, struct mbof_dn_array);
+                if (!delta) {
+                    ret = LDB_ERR_OPERATIONS_ERROR;
+                    goto done;
+                }
+                delta->dns = talloc_array(delta, struct ldb_dn *,
+                                          num_ancestors);
+                if (!delta->dns) {
+                    ret = LDB_ERR_OPERATIONS_ERROR;
+                    goto done;
+                }
+            }
+            delta->dns[delta->num] = ancestors[j]->dn;
+            delta->num++;
+        }
+        talloc_free(anc);
+
+        if (!delta) continue;
+
+        add_ctx->gops[add_ctx->num_gops].node = node;
+        add_ctx->gops[add_ctx->num_gops].delta = delta;
+        node->op = &add_ctx->gops[add_ctx->num_gops];
+        add_ctx->num_gops++;
+
+        if (node->is_group) {
+            ghosts = true;
+            continue;
+        }
+
+        if (!node->name) {
+            ret = LDB_ERR_OPERATIONS_ERROR;
+            goto done;
+        }
+
+        for (j = 0; j < delta->num; j++) {
+            ret = mbof_append_muop(add_ctx, &add_ctx->muops,
+                                   &add_ctx->num_muops,
+                                   LDB_FLAG_MOD_ADD,
+                                   delta->dns[j], node->name,
+                                   DB_MEMBERUID);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
+        }
+    }
+
+    for (i = 0; i < num_members; i++) {
+        ret = mbof_graph_link(parent, members[i], true);
+        if (ret != LDB_SUCCESS) {
+            goto done;
+        }
+    }
+
+    ldb_debug(ldb, LDB_DEBUG_TRACE,
+              "Adding %d members to [%s] changes %d of %d entries",
+              num_members, ldb_dn_get_linearized(parent_dn),
+              add_ctx->num_gops, num_desc);
+
+    *handled = true;
+
+    if (ghosts) {
+        /* descendant groups may carry ghost users to propagate */
+        ret = mbof_graph_ghost_search(add_ctx, members, num_members);
+    } else {
+        mbof_graph_clear_ops(add_ctx);
+        ret = mbof_graph_next_mod(add_ctx);
+    }
+
+done:
+    if (ret != LDB_SUCCESS) {
+        mbof_graph_clear_ops(add_ctx);
+        mbof_graph_drop(ctx->module);
+    }
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int mbof_graph_ghost_callback(struct ldb_request *req,
+                                     struct ldb_reply *ares)
+{
+    struct ldb_message_element *ghel;
+    struct mbof_add_ctx *add_ctx;
+    struct mbof_graph *graph;
+    struct mbof_gnode *node;
+    struct mbof_ctx *ctx;
+    int ret;
+
+    add_ctx = talloc_get_type(req->context, struct mbof_add_ctx);
+    ctx = add_ctx->ctx;
+
+    if (!ares) {
+        ret = LDB_ERR_OPERATIONS_ERROR;
+        goto fail;
+    }
+    if (ares->error != LDB_SUCCESS) {
+        mbof_graph_clear_ops(add_ctx);
+        mbof_graph_drop(ctx->module);
+        return ldb_module_done(ctx->req,
+                               ares->controls,
+                               ares->response,
+                               ares->error);
+    }
+
+    switch (ares->type) {
+    case LDB_REPLY_ENTRY:
+        graph = mbof_graph_get(ctx->module, false);
+        if (!graph) {
+            ret = LDB_ERR_OPERATIONS_ERROR;
+            goto fail;
+        }
+
+        node = mbof_graph_find(graph, ares->message->dn);
+        ghel = ldb_msg_find_element(ares->message, DB_GHOST);
+        if (node && node->op && ghel) {
+            ret = mbof_add_fill_ghop_ex(add_ctx, ares->message,
+                                        node->op->delta,
+                                        ghel->values, ghel->num_values);
+            if (ret != LDB_SUCCESS) {
+                goto fail;
+            }
+        }
+        break;
+
+    case LDB_REPLY_REFERRAL:
+        /* ignore */
+        break;
+
+    case LDB_REPLY_DONE:
+        mbof_graph_clear_ops(add_ctx);
+
+        ret = mbof_graph_next_mod(add_ctx);
+        if (ret != LDB_SUCCESS) {
+            goto fail;
+        }
+    }
+
+    talloc_zfree(ares);
+    return LDB_SUCCESS;
+
+fail:
+    talloc_zfree(ares);
+    mbof_graph_clear_ops(add_ctx);
+    mbof_graph_drop(ctx->module);
+    return ldb_module_done(ctx->req, NULL, NULL, ret);
+}
+
+/* add the missing memberof values, one entry after the other */
+static int mbof_graph_next_mod(struct mbof_add_ctx *add_ctx)
+{
+    struct ldb_message_element *el;
+    struct ldb_request *mod_req;
+    struct ldb_context *ldb;
+    struct ldb_message *msg;
+    struct mbof_gop *gop;
+    struct mbof_ctx *ctx;
+    const char *val;
+    int ret;
+    int i;
+
+    ctx = add_ctx->ctx;
+    ldb = ldb_module_get_ctx(ctx->module);
+
+    if (add_ctx->cur_gop >= add_ctx->num_gops) {
+        /* all entries done, now parents memberuid and ghost attributes */
+        if (add_ctx->muops) {
+            return mbof_add_muop(add_ctx);
+        }
+        return ldb_module_done(ctx->req,
+                               ctx->ret_ctrls,
+                               ctx->ret_resp,
+                               LDB_SUCCESS);
+    }
+
+    gop = &add_ctx->gops[add_ctx->cur_gop];
+
+    msg = ldb_msg_new(add_ctx);
+    if (!msg) return LDB_ERR_OPERATIONS_ERROR;
+
+    msg->dn = gop->node->dn;
+
+    ret = ldb_msg_add_empty(msg, DB_MEMBEROF, LDB_FLAG_MOD_ADD, &el);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+    el->values = talloc_array(msg, struct ldb_val, gop->delta->num);
+    if (!el->values) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+    for (i = 0; i < gop->delta->num; i++) {
+        val = ldb_dn_get_linearized(gop->delta->dns[i]);
+        el->values[i].length = strlen(val);
+        el->values[i].data = (uint8_t *)talloc_strdup(el->values, val);
+        if (!el->values[i].data) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+    el->num_values = gop->delta->num;
+
+    ret = ldb_build_mod_req(&mod_req, ldb, add_ctx,
+                            msg, NULL,
+                            add_ctx, mbof_graph_mod_callback,
                             ctx->req);
     if (ret != LDB_SUCCESS) {
         return ret;
     }
+    talloc_steal(mod_req, msg);
 
     return ldb_next_request(ctx->module, mod_req);
 }
 
-static int mbof_add_muop_callback(struct ldb_request *req,
-                                  struct ldb_reply *ares)
+static int mbof_graph_mod_callback(struct ldb_request *req,
+                                   struct ldb_reply *ares)
 {
     struct mbof_add_ctx *add_ctx;
     struct mbof_ctx *ctx;
@@ -1149,10 +2160,12 @@ static int mbof_add_muop_callback(struct ldb_request *req,
     ctx = add_ctx->ctx;
 
     if (!ares) {
+        mbof_graph_drop(ctx->module);
         return ldb_module_done(ctx->req, NULL, NULL,
                                LDB_ERR_OPERATIONS_ERROR);
     }
     if (ares->error != LDB_SUCCESS) {
+        mbof_graph_drop(ctx->module);
         return ldb_module_done(ctx->req,
                                ares->controls,
                                ares->response,
@@ -1170,19 +2183,11 @@ static int mbof_add_muop_callback(struct ldb_request *req,
         break;
 
     case LDB_REPLY_DONE:
-        add_ctx->cur_muop++;
-        if (add_ctx->cur_muop < add_ctx->num_muops) {
-            ret = mbof_add_muop(add_ctx);
-        }
-        else {
-            return ldb_module_done(ctx->req,
-                                   ctx->ret_ctrls,
-                                   ctx->ret_resp,
-                                   LDB_SUCCESS);
-        }
-
+        add_ctx->cur_gop++;
+        ret = mbof_graph_next_mod(add_ctx);
         if (ret != LDB_SUCCESS) {
             talloc_zfree(ares);
+            mbof_graph_drop(ctx->module);
             return ldb_module_done(ctx->req, NULL, NULL, ret);
         }
     }
@@ -1193,7 +2198,6 @@ static int mbof_add_muop_callback(struct ldb_request *req,
 
 
 
-
 /* delete operations */
 
 /* The implementation of delete operations is a bit more complex than an add
@@ -1529,6 +2533,8 @@ static int mbof_orig_del_callback(struct ldb_request *req,
     ctx->ret_ctrls = talloc_steal(ctx, ares->controls);
     ctx->ret_resp = talloc_steal(ctx, ares->response);
 
+    mbof_graph_del_entry(ctx->module, del_ctx->first->entry_dn);
+
     /* prep following clean ops */
     if (del_ctx->first->num_parents) {
 
@@ -2891,6 +3897,11 @@ static int memberof_mod(struct ldb_module *module, struct ldb_request *req)
         return LDB_ERR_UNWILLING_TO_PERFORM;
     }
 
+    if (mbof_is_deferred(module)) {
+        mbof_graph_drop(module);
+        return ldb_next_request(module, req);
+    }
+
     ctx = mbof_init(module, req);
     if (!ctx) {
         return LDB_ERR_OPERATIONS_ERROR;
@@ -3386,6 +4397,12 @@ static int mbof_mod_process(struct mbof_mod_ctx *mod_ctx, bool *done)
         return ret;
     }
 
+    /* the original modify already happened, let the graph follow */
+    if (mod_ctx->mb_remove && mod_ctx->mb_remove->num) {
+        mbof_graph_del_members(ctx->module, mod_ctx->entry->dn,
+                               mod_ctx->mb_remove);
+    }
+
     /* Process the operations */
     /* if we have something to remove do it first */
     if ((mod_ctx->mb_remove && mod_ctx->mb_remove->num) ||
@@ -3624,6 +4641,7 @@ static int mbof_mod_add(struct mbof_mod_ctx *mod_ctx,
     struct mbof_add_ctx *add_ctx;
     struct ldb_context *ldb;
     struct mbof_ctx *ctx;
+    bool handled;
     int i, ret;
 
     ctx = mod_ctx->ctx;
@@ -3671,6 +4689,11 @@ static int mbof_mod_add(struct mbof_mod_ctx *mod_ctx,
             }
         }
 
+        ret = mbof_graph_add_members(add_ctx, mod_ctx->entry->dn, &handled);
+        if (ret != LDB_SUCCESS || handled) {
+            return ret;
+        }
+
         return mbof_next_add(add_ctx->add_list);
     }
 
@@ -3847,6 +4870,9 @@ struct mbof_member {
     bool orig_has_memberof;
     bool orig_has_memberuid;
     struct ldb_message_element *orig_members;
+    struct ldb_message_element *orig_memberofs;
+    struct ldb_message_element *orig_memberuids;
+    struct ldb_message_element *orig_ghosts;
 
     struct mbof_member **members;
 
@@ -3854,6 +4880,9 @@ struct mbof_member {
 
     struct ldb_message_element *memuids;
 
+    /* own ghosts plus the ghosts of all nested groups */
+    hash_table_t *ghosts;
+
     enum { MBOF_GROUP_TO_DO = 0,
            MBOF_GROUP_DONE,
            MBOF_USER,
@@ -3869,6 +4898,8 @@ struct mbof_rcmp_context {
 
     struct mbof_member *group_list;
     hash_table_t *group_table;
+
+    unsigned long num_updated;
 };
 
 static int mbof_steal_msg_el(TALLOC_CTX *memctx,
@@ -3907,6 +4938,7 @@ static int mbof_member_update(struct mbof_rcmp_context *ctx,
                               struct mbof_member *mem);
 static bool mbof_member_iter(hash_entry_t *item, void *user_data);
 static int mbof_add_memuid(struct mbof_member *grp, const char *user);
+static int mbof_rcmp_inherit_ghosts(struct mbof_member *grp);
 static int mbof_rcmp_update(struct mbof_rcmp_context *ctx);
 static int mbof_rcmp_mod_callback(struct ldb_request *req,
                                   struct ldb_reply *ares);
@@ -3921,6 +4953,9 @@ static int memberof_recompute_task(struct ldb_module *module,
     struct ldb_request *src_req;
     int ret;
 
+    /* links may have been changed without us following them */
+    mbof_graph_drop(module);
+
     ctx = talloc_zero(req, struct mbof_rcmp_context);
     if (!ctx) {
         return LDB_ERR_OPERATIONS_ERROR;
@@ -3984,8 +5019,13 @@ static int mbof_rcmp_usr_callback(struct ldb_request *req,
             usr->name = talloc_steal(usr, name);
         }
 
-        if (ldb_msg_find_element(ares->message, DB_MEMBEROF)) {
+        ret = mbof_steal_msg_el(usr, DB_MEMBEROF,
+                                ares->message, &usr->orig_memberofs);
+        if (ret == LDB_SUCCESS) {
             usr->orig_has_memberof = true;
+        } else if (ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
         }
 
         DLIST_ADD(ctx->user_list, usr);
@@ -4022,7 +5062,7 @@ static int mbof_rcmp_search_groups(struct mbof_rcmp_context *ctx)
 {
     struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
     static const char *attrs[] = { DB_MEMBEROF, DB_MEMBERUID,
-                                   DB_NAME, DB_MEMBER, NULL };
+                                   DB_NAME, DB_MEMBER, DB_GHOST, NULL };
     static const char *filter = "(objectclass=group)";
     struct ldb_request *req;
     int ret;
@@ -4090,12 +5130,22 @@ static int mbof_rcmp_grp_callback(struct ldb_request *req,
             grp->name = talloc_steal(grp, name);
         }
 
-        if (ldb_msg_find_element(ares->message, DB_MEMBEROF)) {
+        ret = mbof_steal_msg_el(grp, DB_MEMBEROF,
+                                ares->message, &grp->orig_memberofs);
+        if (ret == LDB_SUCCESS) {
             grp->orig_has_memberof = true;
+        } else if (ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
         }
 
-        if (ldb_msg_find_element(ares->message, DB_MEMBERUID)) {
+        ret = mbof_steal_msg_el(grp, DB_MEMBERUID,
+                                ares->message, &grp->orig_memberuids);
+        if (ret == LDB_SUCCESS) {
             grp->orig_has_memberuid = true;
+        } else if (ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
         }
 
         ret = mbof_steal_msg_el(grp, DB_MEMBER,
@@ -4105,6 +5155,13 @@ static int mbof_rcmp_grp_callback(struct ldb_request *req,
                                    LDB_ERR_OPERATIONS_ERROR);
         }
 
+        ret = mbof_steal_msg_el(grp, DB_GHOST,
+                                ares->message, &grp->orig_ghosts);
+        if (ret != LDB_SUCCESS && ret != LDB_ERR_NO_SUCH_ATTRIBUTE) {
+            return ldb_module_done(ctx->req, NULL, NULL,
+                                   LDB_ERR_OPERATIONS_ERROR);
+        }
+
         DLIST_ADD(ctx->group_list, grp);
 
         key.type = HASH_KEY_STRING;
@@ -4217,6 +5274,15 @@ static int mbof_rcmp_grp_callback(struct ldb_request *req,
             }
         }
 
+        /* pass the ghosts of every group on to all the groups it is
+         * (directly or indirectly) a member of */
+        for (iter = ctx->group_list; iter; iter = iter->next) {
+            ret = mbof_rcmp_inherit_ghosts(iter);
+            if (ret != LDB_SUCCESS) {
+                return ldb_module_done(ctx->req, NULL, NULL, ret);
+            }
+        }
+
         /* ok all done, now go on and modify the tree */
         return mbof_rcmp_update(ctx);
     }
@@ -4384,97 +5450,285 @@ static int mbof_add_memuid(struct mbof_member *grp, const char *user)
     return LDB_SUCCESS;
 }
 
-static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
+static int mbof_rcmp_add_val(hash_table_t *table, struct ldb_val *val)
+{
+    hash_value_t value;
+    hash_key_t key;
+    int ret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = (char *)val->data;
+    value.type = HASH_VALUE_PTR;
+    value.ptr = NULL;
+
+    ret = hash_enter(table, &key, &value);
+    if (ret != HASH_SUCCESS) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    return LDB_SUCCESS;
+}
+
+static int mbof_add_ghost(struct mbof_member *grp, struct ldb_val *ghost)
+{
+    int ret;
+
+    if (!grp->ghosts) {
+        ret = hash_create_ex(32, &grp->ghosts, 0, 0, 0, 0,
+                             hash_alloc, hash_free, grp, NULL, NULL);
+        if (ret != HASH_SUCCESS) {
+            return LDB_ERR_OPERATIONS_ERROR;
+        }
+    }
+
+    return mbof_rcmp_add_val(grp->ghosts, ghost);
+}
+
+static int mbof_rcmp_inherit_ghosts(struct mbof_member *grp)
+{
+    struct ldb_message_element *el = grp->orig_ghosts;
+    struct mbof_member *parent;
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    int j;
+    int ret;
+
+    if (!el || el->num_values == 0) {
+        return LDB_SUCCESS;
+    }
+
+    /* a group always keeps its own ghosts */
+    for (j = 0; j < el->num_values; j++) {
+        ret = mbof_add_ghost(grp, &el->values[j]);
+        if (ret != LDB_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (!grp->memberofs) {
+        return LDB_SUCCESS;
+    }
+
+    ret = hash_values(grp->memberofs, &count, &values);
+    if (ret != HASH_SUCCESS) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    for (i = 0; i < count; i++) {
+        parent = talloc_get_type(values[i].ptr, struct mbof_member);
+        for (j = 0; j < el->num_values; j++) {
+            ret = mbof_add_ghost(parent, &el->values[j]);
+            if (ret != LDB_SUCCESS) {
+                talloc_free(values);
+                return ret;
+            }
+        }
+    }
+
+    talloc_free(values);
+    return LDB_SUCCESS;
+}
+
+/* checks whether the values of el are exactly the keys of table, so that
+ * entries that are already correct are not written again */
+static bool mbof_rcmp_same_values(struct ldb_message_element *el,
+                                  hash_table_t *table)
+{
+    unsigned long count;
+    hash_key_t key;
+    int i;
+
+    count = table ? hash_count(table) : 0;
+    if ((el ? el->num_values : 0) != count) {
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        key.type = HASH_KEY_STRING;
+        key.str = (char *)el->values[i].data;
+        if (!hash_has_key(table, &key)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int mbof_rcmp_add_keys(struct ldb_message *msg, const char *name,
+                              int flags, hash_table_t *table)
 {
-    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
     struct ldb_message_element *el;
-    struct ldb_message *msg = NULL;
-    struct ldb_request *req;
-    struct mbof_member *x = NULL;
     hash_key_t *keys;
     unsigned long count;
-    int flags;
     int ret, i;
 
-    /* we process all users first and then all groups */
-    if (ctx->user_list) {
-        /* take the next entry and remove it from the list */
-        x = ctx->user_list;
-        DLIST_REMOVE(ctx->user_list, x);
+    ret = hash_keys(table, &count, &keys);
+    if (ret != HASH_SUCCESS) {
+        return LDB_ERR_OPERATIONS_ERROR;
     }
-    else if (ctx->group_list) {
-        /* take the next entry and remove it from the list */
-        x = ctx->group_list;
-        DLIST_REMOVE(ctx->group_list, x);
+
+    ret = ldb_msg_add_empty(msg, name, flags, &el);
+    if (ret != LDB_SUCCESS) {
+        return ret;
     }
-    else {
-        /* processing terminated, return */
-        ret = LDB_SUCCESS;
-        goto done;
+
+    el->values = talloc_array(el, struct ldb_val, count);
+    if (!el->values) {
+        return LDB_ERR_OPERATIONS_ERROR;
     }
+    el->num_values = count;
 
-    msg = ldb_msg_new(ctx);
-    if (!msg) {
-        ret = LDB_ERR_OPERATIONS_ERROR;
-        goto done;
+    for (i = 0; i < count; i++) {
+        el->values[i].data = (uint8_t *)keys[i].str;
+        el->values[i].length = strlen(keys[i].str);
     }
 
-    msg->dn = x->dn;
+    return LDB_SUCCESS;
+}
 
-    /* process memberof */
-    if (x->memberofs) {
-        ret = hash_keys(x->memberofs, &count, &keys);
-        if (ret != HASH_SUCCESS) {
-            ret = LDB_ERR_OPERATIONS_ERROR;
-            goto done;
-        }
+static int mbof_rcmp_memuids_changed(struct mbof_member *x, bool *_changed)
+{
+    hash_table_t *table;
+    int ret, i;
 
-        if (x->orig_has_memberof) {
-            flags = LDB_FLAG_MOD_REPLACE;
-        } else {
-            flags = LDB_FLAG_MOD_ADD;
-        }
+    if (!x->orig_memberuids ||
+        x->orig_memberuids->num_values != x->memuids->num_values) {
+        *_changed = true;
+        return LDB_SUCCESS;
+    }
 
-        ret = ldb_msg_add_empty(msg, DB_MEMBEROF, flags, &el);
+    ret = hash_create_ex(x->memuids->num_values, &table, 0, 0, 0, 0,
+                         hash_alloc, hash_free, x, NULL, NULL);
+    if (ret != HASH_SUCCESS) {
+        return LDB_ERR_OPERATIONS_ERROR;
+    }
+
+    for (i = 0; i < x->memuids->num_values; i++) {
+        ret = mbof_rcmp_add_val(table, &x->memuids->values[i]);
         if (ret != LDB_SUCCESS) {
+            hash_destroy(table);
+            return ret;
+        }
+    }
+
+    *_changed = !mbof_rcmp_same_values(x->orig_memberuids, table);
+    hash_destroy(table);
+    return LDB_SUCCESS;
+}
+
+static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
+{
+    struct ldb_context *ldb = ldb_module_get_ctx(ctx->module);
+    struct ldb_message *msg = NULL;
+    struct ldb_request *req;
+    struct mbof_member *x = NULL;
+    hash_key_t key;
+    bool changed;
+    int flags;
+    int ret, i;
+
+    /* we process all users first and then all groups, entries whose
+     * values did not change are skipped */
+    while (msg == NULL) {
+        if (ctx->user_list) {
+            /* take the next entry and remove it from the list */
+            x = ctx->user_list;
+            DLIST_REMOVE(ctx->user_list, x);
+        }
+        else if (ctx->group_list) {
+            /* take the next entry and remove it from the list */
+            x = ctx->group_list;
+            DLIST_REMOVE(ctx->group_list, x);
+        }
+        else {
+            /* processing terminated, return */
+            ldb_debug(ldb, LDB_DEBUG_TRACE,
+                      "memberof rebuild updated %lu entries",
+                      ctx->num_updated);
+            ret = LDB_SUCCESS;
             goto done;
         }
 
-        el->values = talloc_array(el, struct ldb_val, count);
-        if (!el->values) {
+        msg = ldb_msg_new(ctx);
+        if (!msg) {
             ret = LDB_ERR_OPERATIONS_ERROR;
             goto done;
         }
-        el->num_values = count;
 
-        for (i = 0; i < count; i++) {
-            el->values[i].data = (uint8_t *)keys[i].str;
-            el->values[i].length = strlen(keys[i].str);
+        msg->dn = x->dn;
+
+        /* process memberof */
+        if (x->memberofs) {
+            if (!mbof_rcmp_same_values(x->orig_memberofs, x->memberofs)) {
+                if (x->orig_has_memberof) {
+                    flags = LDB_FLAG_MOD_REPLACE;
+                } else {
+                    flags = LDB_FLAG_MOD_ADD;
+                }
+
+                ret = mbof_rcmp_add_keys(msg, DB_MEMBEROF,
+                                         flags, x->memberofs);
+                if (ret != LDB_SUCCESS) {
+                    goto done;
+                }
+            }
+        } else if (x->orig_has_memberof) {
+            ret = ldb_msg_add_empty(msg, DB_MEMBEROF,
+                                    LDB_FLAG_MOD_DELETE, NULL);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
         }
-    } else if (x->orig_has_memberof) {
-        ret = ldb_msg_add_empty(msg, DB_MEMBEROF, LDB_FLAG_MOD_DELETE, NULL);
-        if (ret != LDB_SUCCESS) {
-            goto done;
+
+        /* process memberuid */
+        if (x->memuids) {
+            ret = mbof_rcmp_memuids_changed(x, &changed);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
+
+            if (changed) {
+                if (x->orig_has_memberuid) {
+                    flags = LDB_FLAG_MOD_REPLACE;
+                } else {
+                    flags = LDB_FLAG_MOD_ADD;
+                }
+
+                ret = ldb_msg_add(msg, x->memuids, flags);
+                if (ret != LDB_SUCCESS) {
+                    goto done;
+                }
+            }
+        }
+        else if (x->orig_has_memberuid) {
+            ret = ldb_msg_add_empty(msg, DB_MEMBERUID,
+                                    LDB_FLAG_MOD_DELETE, NULL);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
         }
-    }
 
-    /* process memberuid */
-    if (x->memuids) {
-        if (x->orig_has_memberuid) {
-            flags = LDB_FLAG_MOD_REPLACE;
-        } else {
-            flags = LDB_FLAG_MOD_ADD;
+        /* process ghosts, a ghost that is a real member by now is stale */
+        if (x->ghosts && x->memuids) {
+            for (i = 0; i < x->memuids->num_values; i++) {
+                key.type = HASH_KEY_STRING;
+                key.str = (char *)x->memuids->values[i].data;
+                hash_delete(x->ghosts, &key);
+            }
         }
 
-        ret = ldb_msg_add(msg, x->memuids, flags);
-        if (ret != LDB_SUCCESS) {
-            goto done;
+        if (x->ghosts && !mbof_rcmp_same_values(x->orig_ghosts, x->ghosts)) {
+            ret = mbof_rcmp_add_keys(msg, DB_GHOST,
+                                     LDB_FLAG_MOD_REPLACE, x->ghosts);
+            if (ret != LDB_SUCCESS) {
+                goto done;
+            }
         }
-    }
-    else if (x->orig_has_memberuid) {
-        ret = ldb_msg_add_empty(msg, DB_MEMBERUID, LDB_FLAG_MOD_DELETE, NULL);
-        if (ret != LDB_SUCCESS) {
-            goto done;
+
+        if (msg->num_elements == 0) {
+            /* nothing to do for this entry */
+            talloc_zfree(msg);
         }
     }
 
@@ -4485,6 +5739,7 @@ static int mbof_rcmp_update(struct mbof_rcmp_context *ctx)
         goto done;
     }
     talloc_steal(req, msg);
+    ctx->num_updated++;
 
     /* fire next call */
     return ldb_next_request(ctx->module, req);
@@ -4538,11 +5793,88 @@ static int mbof_rcmp_mod_callback(struct ldb_request *req,
 
 
 
+/* renames are not tracked by the graph */
+static int memberof_rename(struct ldb_module *module, struct ldb_request *req)
+{
+    mbof_graph_drop(module);
+    return ldb_next_request(module, req);
+}
+
+
+/* transaction hooks, used to validate the group graph */
+
+static int mbof_seq_num(struct ldb_module *module, uint64_t *seq_num)
+{
+    return ldb_sequence_number(ldb_module_get_ctx(module),
+                               LDB_SEQ_HIGHEST_SEQ, seq_num);
+}
+
+static int memberof_start_trans(struct ldb_module *module)
+{
+    struct mbof_graph *graph;
+    uint64_t seq_num;
+    int ret;
+
+    ret = ldb_next_start_trans(module);
+    if (ret != LDB_SUCCESS) {
+        return ret;
+    }
+
+    graph = mbof_graph_get(module, false);
+    if (graph) {
+        /* someone else wrote to the database since our last commit */
+        ret = mbof_seq_num(module, &seq_num);
+        if (ret != LDB_SUCCESS || seq_num != graph->seq_num) {
+            mbof_graph_drop(module);
+        }
+    }
+
+    return LDB_SUCCESS;
+}
+
+static int memberof_prepare_commit(struct ldb_module *module)
+{
+    struct mbof_graph *graph;
+    int ret;
+
+    graph = mbof_graph_get(module, false);
+    if (graph) {
+        ret = mbof_seq_num(module, &graph->seq_num);
+        if (ret != LDB_SUCCESS) {
+            mbof_graph_drop(module);
+        }
+    }
+
+    return ldb_next_prepare_commit(module);
+}
+
+static int memberof_end_trans(struct ldb_module *module)
+{
+    int ret;
+
+    ret = ldb_next_end_trans(module);
+    if (ret != LDB_SUCCESS) {
+        mbof_graph_drop(module);
+    }
+
+    return ret;
+}
+
+static int memberof_del_trans(struct ldb_module *module)
+{
+    /* the graph may contain changes that are being rolled back */
+    mbof_graph_drop(module);
+
+    return ldb_next_del_trans(module);
+}
+
+
 /* module init code */
 
 static int memberof_init(struct ldb_module *module)
 {
     struct ldb_context *ldb = ldb_module_get_ctx(module);
+    struct mbof_private *priv;
     int ret;
 
     /* set syntaxes for member and memberof so that comparisons in filters and
@@ -4553,6 +5885,11 @@ static int memberof_init(struct ldb_module *module)
     ret = ldb_schema_attribute_add(ldb, DB_MEMBEROF, 0, LDB_SYNTAX_DN);
     if (ret != 0) return LDB_ERR_OPERATIONS_ERROR;
 
+    /* the group graph is built on first use */
+    priv = talloc_zero(module, struct mbof_private);
+    if (!priv) return LDB_ERR_OPERATIONS_ERROR;
+    ldb_module_set_private(module, priv);
+
     return ldb_next_init(module);
 }
 
@@ -4562,6 +5899,11 @@ const struct ldb_module_ops ldb_memberof_module_ops = {
     .add = memberof_add,
     .modify = memberof_mod,
     .del = memberof_del,
+    .rename = memberof_rename,
+    .start_transaction = memberof_start_trans,
+    .prepare_commit = memberof_prepare_commit,
+    .end_transaction = memberof_end_trans,
+    .del_transaction = memberof_del_trans,
 };
 
 int ldb_init_module(const char *version)
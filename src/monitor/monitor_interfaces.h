@@ -47,6 +47,7 @@
 #define MON_CLI_METHOD_ROTATE "rotateLogs"
 #define MON_CLI_METHOD_CLEAR_MEMCACHE "clearMemcache"
 #define MON_CLI_METHOD_CLEAR_ENUM_CACHE "clearEnumCache"
+#define MON_CLI_METHOD_MEMCACHE_STATS "memcacheStats" /* Applicable only to NSS */
 
 #define SSSD_SERVICE_PIPE "private/sbus-monitor"
 
@@ -48,3 +48,15 @@ ad_check_online(struct be_req *be_req)
 
     return sdap_do_online_check(be_req, ad_ctx->sdap_id_ctx);
 }
+
+void
+ad_refresh_hot_handler(struct be_req *breq)
+{
+    struct ad_id_ctx *ad_ctx;
+    struct be_ctx *be_ctx = be_req_get_be_ctx(breq);
+
+    ad_ctx = talloc_get_type(be_ctx->bet_info[BET_ID].pvt_bet_data,
+                             struct ad_id_ctx);
+
+    return sdap_handle_refresh_hot(breq, ad_ctx->sdap_id_ctx);
+}
@@ -28,4 +28,7 @@ ad_account_info_handler(struct be_req *breq);
 
 void
 ad_check_online(struct be_req *be_req);
+
+void
+ad_refresh_hot_handler(struct be_req *breq);
 #endif /* AD_ID_H_ */
@@ -55,6 +55,7 @@
 #define DP_METHOD_AUTOFSHANDLER "autofsHandler"
 #define DP_METHOD_HOSTHANDLER "hostHandler"
 #define DP_METHOD_GETDOMAINS "getDomains"
+#define DP_METHOD_REFRESHHOT "refreshHot"
 
 /* this is a reverse method sent from providers to
  * the nss responder to tell it to update the mmap
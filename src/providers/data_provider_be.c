@@ -85,6 +85,7 @@ static int be_sudo_handler(DBusMessage *message, struct sbus_connection *conn);
 static int be_autofs_handler(DBusMessage *message, struct sbus_connection *conn);
 static int be_host_handler(DBusMessage *message, struct sbus_connection *conn);
 static int be_get_subdomains(DBusMessage *message, struct sbus_connection *conn);
+static int be_refresh_hot(DBusMessage *message, struct sbus_connection *conn);
 
 struct sbus_method be_methods[] = {
     { DP_METHOD_REGISTER, client_registration },
@@ -94,6 +95,7 @@ struct sbus_method be_methods[] = {
     { DP_METHOD_AUTOFSHANDLER, be_autofs_handler },
     { DP_METHOD_HOSTHANDLER, be_host_handler },
     { DP_METHOD_GETDOMAINS, be_get_subdomains },
+    { DP_METHOD_REFRESHHOT, be_refresh_hot },
     { NULL, NULL }
 };
 
@@ -122,6 +124,9 @@ static struct bet_data bet_data[] = {
 #define REQ_PHASE_ACCESS 0
 #define REQ_PHASE_SELINUX 1
 
+/* How often the scheduler statistics are logged, if there was any request */
+#define BE_SCHED_STATS_INTERVAL 300
+
 struct be_req {
     struct be_client *becli;
     struct be_ctx *be_ctx;
@@ -135,8 +140,48 @@ struct be_req {
      * selinux provider is calling the callback.
      */
     int phase;
+
+    /* scheduling, see be_file_request() */
+    enum be_req_class req_class;
+    struct be_sched_ctx *sched;
+    struct be_req *prev, *next;
+    be_req_fn_t sched_fn;
+    bool running;
+    struct timeval queued_at;
+};
+
+struct be_sched_class {
+    const char *name;
+    /* maximum number of running requests, 0 means no limit */
+    int limit;
+    int running;
+    struct be_req *running_list;
+    int queued;
+    struct be_req *queue;
+
+    /* metrics */
+    uint64_t requests;
+    uint64_t delayed;       /* requests that could not start at once */
+    uint64_t total_wait_ms;
+    uint64_t max_wait_ms;
+    int max_queued;
 };
 
+struct be_sched_ctx {
+    struct be_ctx *be_ctx;
+    struct be_sched_class classes[BE_REQ_CLASS_NUM];
+    struct tevent_timer *dispatch_te;
+    bool active;
+};
+
+static void be_sched_detach(struct be_req *be_req);
+
+static int be_req_destructor(struct be_req *be_req)
+{
+    be_sched_detach(be_req);
+    return 0;
+}
+
 struct be_req *be_req_create(TALLOC_CTX *mem_ctx,
                              struct be_client *becli, struct be_ctx *be_ctx,
                              be_async_callback_t fn, void *pvt_fn_data)
@@ -150,6 +195,9 @@ struct be_req *be_req_create(TALLOC_CTX *mem_ctx,
     be_req->be_ctx = be_ctx;
     be_req->fn = fn;
     be_req->pvt = pvt_fn_data;
+    be_req->req_class = BE_REQ_CLASS_ID;
+
+    talloc_set_destructor(be_req, be_req_destructor);
 
     return be_req;
 }
@@ -167,27 +215,315 @@ void *be_req_get_data(struct be_req *be_req)
 void be_req_terminate(struct be_req *be_req,
                       int dp_err_type, int errnum, const char *errstr)
 {
+    /* the request is done, let the next one run */
+    be_sched_detach(be_req);
+
     if (be_req->fn == NULL) return;
     be_req->fn(be_req, dp_err_type, errnum, errstr);
 }
 
+/* =Request-scheduler====================================================== */
+
+static void be_sched_dispatch(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt);
+
+static int be_sched_ctx_destructor(struct be_sched_ctx *sched)
+{
+    struct be_sched_class *sc;
+    struct be_req *be_req;
+    int i;
+
+    /* requests may outlive the scheduler during shutdown */
+    for (i = 0; i < BE_REQ_CLASS_NUM; i++) {
+        sc = &sched->classes[i];
+        while ((be_req = sc->queue) != NULL) {
+            DLIST_REMOVE(sc->queue, be_req);
+            be_req->sched = NULL;
+        }
+        while ((be_req = sc->running_list) != NULL) {
+            DLIST_REMOVE(sc->running_list, be_req);
+            be_req->sched = NULL;
+        }
+    }
+
+    return 0;
+}
+
+static void be_sched_log_stats(struct be_sched_ctx *sched)
+{
+    struct be_sched_class *sc;
+    int i;
+
+    for (i = 0; i < BE_REQ_CLASS_NUM; i++) {
+        sc = &sched->classes[i];
+        if (sc->requests == 0) continue;
+
+        DEBUG(SSSDBG_TRACE_FUNC,
+              ("Requests of class [%s]: %llu started, %llu delayed, "
+               "wait %llu ms total, %llu ms max, queue %d now, %d max, "
+               "%d running\n", sc->name,
+               (unsigned long long)sc->requests,
+               (unsigned long long)sc->delayed,
+               (unsigned long long)sc->total_wait_ms,
+               (unsigned long long)sc->max_wait_ms,
+               sc->queued, sc->max_queued, sc->running));
+    }
+}
+
+static void be_sched_stats_handler(struct tevent_context *ev,
+                                   struct tevent_timer *te,
+                                   struct timeval tv, void *pvt)
+{
+    struct be_sched_ctx *sched = talloc_get_type(pvt, struct be_sched_ctx);
+
+    if (sched->active) {
+        be_sched_log_stats(sched);
+        sched->active = false;
+    }
+
+    tv = tevent_timeval_current_ofs(BE_SCHED_STATS_INTERVAL, 0);
+    te = tevent_add_timer(ev, sched, tv, be_sched_stats_handler, sched);
+    if (te == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unable to schedule the scheduler statistics\n"));
+    }
+}
+
+errno_t be_sched_init(struct be_ctx *be_ctx)
+{
+    struct be_sched_ctx *sched;
+    struct tevent_timer *te;
+    struct timeval tv;
+    static const struct {
+        const char *name;
+        const char *option;
+        int def;
+    } class_opts[BE_REQ_CLASS_NUM] = {
+        { "auth", CONFDB_DOMAIN_MAX_AUTH_REQUESTS, 0 },
+        { "id", CONFDB_DOMAIN_MAX_ID_REQUESTS, 0 },
+        { "background", CONFDB_DOMAIN_MAX_BACKGROUND_REQUESTS, 1 },
+    };
+    errno_t ret;
+    int i;
+
+    sched = talloc_zero(be_ctx, struct be_sched_ctx);
+    if (!sched) return ENOMEM;
+    sched->be_ctx = be_ctx;
+
+    for (i = 0; i < BE_REQ_CLASS_NUM; i++) {
+        sched->classes[i].name = class_opts[i].name;
+
+        ret = confdb_get_int(be_ctx->cdb, be_ctx->conf_path,
+                             class_opts[i].option, class_opts[i].def,
+                             &sched->classes[i].limit);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to read [%s]: %d [%s]\n",
+                                        class_opts[i].option,
+                                        ret, strerror(ret)));
+            talloc_free(sched);
+            return ret;
+        }
+        if (sched->classes[i].limit < 0) {
+            sched->classes[i].limit = 0;
+        }
+
+        DEBUG(SSSDBG_CONF_SETTINGS, ("Running at most %d requests of class "
+                                     "[%s] at once (0 means no limit)\n",
+                                     sched->classes[i].limit,
+                                     sched->classes[i].name));
+    }
+
+    talloc_set_destructor(sched, be_sched_ctx_destructor);
+
+    tv = tevent_timeval_current_ofs(BE_SCHED_STATS_INTERVAL, 0);
+    te = tevent_add_timer(be_ctx->ev, sched, tv,
+                          be_sched_stats_handler, sched);
+    if (te == NULL) {
+        talloc_free(sched);
+        return ENOMEM;
+    }
+
+    be_ctx->sched = sched;
+    return EOK;
+}
+
+/* Make sure be_sched_dispatch() runs in the next loop iteration, so that
+ * the requests that arrive at the same time are started by priority */
+static void be_sched_kick(struct be_sched_ctx *sched)
+{
+    struct timeval tv;
+    int i;
+
+    if (sched->dispatch_te != NULL) return;
+
+    for (i = 0; i < BE_REQ_CLASS_NUM; i++) {
+        if (sched->classes[i].queue != NULL) break;
+    }
+    if (i == BE_REQ_CLASS_NUM) return;
 
-struct be_async_req {
-    be_req_fn_t fn;
-    struct be_req *req;
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+
+    sched->dispatch_te = tevent_add_timer(sched->be_ctx->ev, sched, tv,
+                                          be_sched_dispatch, sched);
+    if (sched->dispatch_te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to schedule queued requests\n"));
+    }
+}
+
+static errno_t be_sched_enqueue(struct be_sched_ctx *sched,
+                                struct be_req *be_req, be_req_fn_t fn)
+{
+    struct be_sched_class *sc = &sched->classes[be_req->req_class];
+
+    if (be_req->sched != NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Bug: request is already scheduled\n"));
+        return EINVAL;
+    }
+
+    be_req->sched = sched;
+    be_req->sched_fn = fn;
+    be_req->running = false;
+    be_req->queued_at = tevent_timeval_current();
+
+    DLIST_ADD_END(sc->queue, be_req, struct be_req *);
+    sc->queued++;
+    if (sc->queued > sc->max_queued) {
+        sc->max_queued = sc->queued;
+    }
+
+    be_sched_kick(sched);
+
+    if (sched->dispatch_te == NULL) {
+        DLIST_REMOVE(sc->queue, be_req);
+        sc->queued--;
+        be_req->sched = NULL;
+        return EIO;
+    }
+
+    return EOK;
+}
+
+/* Remove a request from the scheduler, whether it is waiting or running */
+static void be_sched_detach(struct be_req *be_req)
+{
+    struct be_sched_ctx *sched = be_req->sched;
+    struct be_sched_class *sc;
+
+    if (sched == NULL) return;
+
+    sc = &sched->classes[be_req->req_class];
+    if (be_req->running) {
+        DLIST_REMOVE(sc->running_list, be_req);
+        sc->running--;
+    } else {
+        DLIST_REMOVE(sc->queue, be_req);
+        sc->queued--;
+    }
+    be_req->sched = NULL;
+    be_req->running = false;
+
+    be_sched_kick(sched);
+}
+
+static void be_sched_dispatch(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt)
+{
+    struct be_sched_ctx *sched = talloc_get_type(pvt, struct be_sched_ctx);
+    struct be_sched_class *sc;
+    struct be_req *be_req;
+    struct timeval now;
+    struct timeval wait;
+    uint64_t wait_ms;
+    int i;
+
+    sched->dispatch_te = NULL;
+
+    for (i = 0; i < BE_REQ_CLASS_NUM; i++) {
+        sc = &sched->classes[i];
+
+        while ((be_req = sc->queue) != NULL &&
+               (sc->limit == 0 || sc->running < sc->limit)) {
+            DLIST_REMOVE(sc->queue, be_req);
+            sc->queued--;
+            DLIST_ADD(sc->running_list, be_req);
+            sc->running++;
+            be_req->running = true;
+
+            now = tevent_timeval_current();
+            wait = tevent_timeval_until(&be_req->queued_at, &now);
+            wait_ms = wait.tv_sec * 1000 + wait.tv_usec / 1000;
+            sc->requests++;
+            sc->total_wait_ms += wait_ms;
+            if (wait_ms > sc->max_wait_ms) {
+                sc->max_wait_ms = wait_ms;
+            }
+            if (wait_ms > 0) {
+                sc->delayed++;
+                DEBUG(SSSDBG_TRACE_INTERNAL,
+                      ("Starting request of class [%s] after %llu ms, "
+                       "%d more queued\n", sc->name,
+                       (unsigned long long)wait_ms, sc->queued));
+            }
+            sched->active = true;
+
+            /* may complete or file new requests right away */
+            be_req->sched_fn(be_req);
+        }
+    }
+}
+
+struct be_sched_slot_state {
+    struct be_req *be_req;
 };
 
-static void be_async_req_handler(struct tevent_context *ev,
-                                 struct tevent_timer *te,
-                                 struct timeval tv, void *pvt)
+static void be_sched_slot_start(struct be_req *be_req)
 {
-    struct be_async_req *async_req;
+    struct tevent_req *req = talloc_get_type(be_req->pvt, struct tevent_req);
 
-    async_req = talloc_get_type(pvt, struct be_async_req);
+    tevent_req_done(req);
+}
+
+struct tevent_req *be_sched_slot_send(TALLOC_CTX *mem_ctx,
+                                      struct be_ctx *be_ctx,
+                                      enum be_req_class req_class)
+{
+    struct be_sched_slot_state *state;
+    struct tevent_req *req;
+    errno_t ret;
+
+    req = tevent_req_create(mem_ctx, &state, struct be_sched_slot_state);
+    if (req == NULL) return NULL;
+
+    /* freed together with the request, which ends the slot */
+    state->be_req = be_req_create(state, NULL, be_ctx, NULL, req);
+    if (state->be_req == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    state->be_req->req_class = req_class;
 
-    async_req->fn(async_req->req);
+    ret = be_sched_enqueue(be_ctx->sched, state->be_req, be_sched_slot_start);
+    if (ret != EOK) goto fail;
+
+    return req;
+
+fail:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, be_ctx->ev);
+    return req;
 }
 
+errno_t be_sched_slot_recv(struct tevent_req *req)
+{
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+
 struct be_spy {
     TALLOC_CTX *freectx;
     struct be_spy *double_agent;
@@ -272,33 +608,15 @@ static errno_t be_file_request(TALLOC_CTX *mem_ctx,
                                be_req_fn_t fn)
 {
     errno_t ret;
-    struct be_async_req *areq;
-    struct tevent_timer *te;
-    struct timeval tv;
 
     if (!fn || !be_req) return EINVAL;
 
     ret = be_spy_create(mem_ctx, be_req);
     if (ret != EOK) return ret;
 
-    areq = talloc(be_req, struct be_async_req);
-    if (!areq) {
-        return ENOMEM;
-    }
-    areq->fn = fn;
-    areq->req = be_req;
-
-    /* fire immediately */
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
-
-    te = tevent_add_timer(be_req->be_ctx->ev, be_req,
-                          tv, be_async_req_handler, areq);
-    if (te == NULL) {
-        return EIO;
-    }
-
-    return EOK;
+    /* the request is started from the main loop, in order of priority,
+     * once its class is below its concurrency limit */
+    return be_sched_enqueue(be_req->be_ctx->sched, be_req, fn);
 }
 
 bool be_is_offline(struct be_ctx *ctx)
@@ -657,6 +975,18 @@ static void acctinfo_initgroups_callback(struct be_req *be_req,
     pr->orig_errnum = errnum;
     pr->orig_errstr = errstr;
 
+    if (dp_err_type == DP_ERR_OK && errnum == EOK) {
+        /* the memberships were just refreshed, store the gids so that the
+         * next lookups do not need to load all the groups */
+        ret = sysdb_update_initgr_gids(be_req->be_ctx->domain->sysdb,
+                                       be_req->be_ctx->domain, pr->user);
+        if (ret != EOK && ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Unable to store the initgroups gids of [%s]: %d [%s]\n",
+                   pr->user, ret, strerror(ret)));
+        }
+    }
+
     if (!be_req->be_ctx->nss_cli || !be_req->be_ctx->nss_cli->conn) {
         DEBUG(SSSDBG_MINOR_FAILURE, ("NSS Service not conected\n"));
         ret = EACCES;
@@ -715,8 +1045,9 @@ static errno_t be_initgroups_prereq(struct be_req *be_req)
     const char *tmpstr;
     int i;
 
-    ret = sysdb_initgroups(be_req, be_req->be_ctx->domain->sysdb,
-                           be_req->be_ctx->domain, ar->filter_value, &res);
+    ret = sysdb_initgroups_gids(be_req, be_req->be_ctx->domain->sysdb,
+                                be_req->be_ctx->domain, ar->filter_value,
+                                &res);
     if (ret && ret != ENOENT) {
         return ret;
     }
@@ -1195,6 +1526,7 @@ static int be_pam_handler(DBusMessage *message, struct sbus_connection *conn)
         dbus_message_unref(reply);
         return ENOMEM;
     }
+    be_req->req_class = BE_REQ_CLASS_AUTH;
 
     dbus_error_init(&dbus_error);
 
@@ -1422,6 +1754,7 @@ static int be_sudo_handler(DBusMessage *message, struct sbus_connection *conn)
     switch (sudo_req->type) {
     case BE_REQ_SUDO_FULL:
         /* no arguments required */
+        be_req->req_class = BE_REQ_CLASS_BACKGROUND;
         break;
     case BE_REQ_SUDO_RULES:
         /* additional arguments:
@@ -1914,6 +2247,343 @@ done:
     return EOK;
 }
 
+/* =Refresh-ahead========================================================== */
+
+static void be_refresh_hot_callback(struct be_req *be_req,
+                                    int dp_err_type,
+                                    int errnum,
+                                    const char *errstr)
+{
+    if (dp_err_type != DP_ERR_OK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Refresh of frequently used entries failed [%d]: %s\n",
+               errnum, errstr ? errstr : strerror(errnum)));
+    }
+
+    talloc_free(be_req);
+}
+
+/* names checked with a single sysdb search */
+#define BE_REFRESH_BATCH 100
+
+/* Only entries that are about to expire are worth refreshing, the others
+ * were already refreshed by a regular lookup. Entries that are gone are
+ * looked up the regular way. Adds the names of the entries that need a
+ * refresh to rr. */
+static errno_t be_refresh_add_expiring(struct be_refresh_req *rr,
+                                       struct sss_domain_info *dom,
+                                       const char **names, size_t num_names,
+                                       time_t limit)
+{
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct ldb_message **msgs;
+    TALLOC_CTX *tmp_ctx;
+    const char *name;
+    char *sanitized;
+    char *filter;
+    size_t max_names;
+    size_t count;
+    size_t i;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) return ENOMEM;
+
+    filter = talloc_asprintf(tmp_ctx, "(&(!(%s=0))(%s<=%lld)(|",
+                             SYSDB_CACHE_EXPIRE, SYSDB_CACHE_EXPIRE,
+                             (long long)limit);
+    for (i = 0; filter && i < num_names; i++) {
+        ret = sss_filter_sanitize(tmp_ctx, names[i], &sanitized);
+        if (ret != EOK) goto done;
+
+        filter = talloc_asprintf_append_buffer(filter, "(%s=%s)",
+                                               SYSDB_NAME, sanitized);
+    }
+    if (filter) {
+        filter = talloc_asprintf_append_buffer(filter, "))");
+    }
+    if (!filter) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    switch (rr->entry_type) {
+    case BE_REQ_USER:
+        ret = sysdb_search_users(tmp_ctx, dom->sysdb, dom, filter, attrs,
+                                 &count, &msgs);
+        break;
+    case BE_REQ_GROUP:
+        ret = sysdb_search_groups(tmp_ctx, dom->sysdb, dom, filter, attrs,
+                                  &count, &msgs);
+        break;
+    case BE_REQ_NETGROUP:
+        ret = sysdb_search_netgroups(tmp_ctx, dom->sysdb, dom, filter, attrs,
+                                     &count, &msgs);
+        break;
+    default:
+        ret = EINVAL;
+        break;
+    }
+    if (ret == ENOENT) {
+        ret = EOK;
+        goto done;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    /* names is sized for every name the responder sent */
+    max_names = talloc_array_length(rr->names) - 1;
+    for (i = 0; i < count && rr->num_names < max_names; i++) {
+        name = ldb_msg_find_attr_as_string(msgs[i], SYSDB_NAME, NULL);
+        if (name == NULL) continue;
+
+        rr->names[rr->num_names] = talloc_strdup(rr->names, name);
+        if (!rr->names[rr->num_names]) {
+            ret = ENOMEM;
+            goto done;
+        }
+        rr->num_names++;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* The refresh handlers of the providers work on the domain of the back end
+ * only, entries of a subdomain are refreshed one by one through the account
+ * handler, which knows how to reach the subdomain */
+static void be_refresh_hot_subdom(struct be_client *becli,
+                                  struct sss_domain_info *dom,
+                                  struct be_refresh_req *rr)
+{
+    struct be_ctx *be_ctx = becli->bectx;
+    struct be_acct_req *ar;
+    struct be_req *be_req;
+    size_t i;
+    errno_t ret;
+
+    for (i = 0; i < rr->num_names; i++) {
+        be_req = be_req_create(becli, becli, be_ctx,
+                               be_refresh_hot_callback, NULL);
+        if (!be_req) return;
+        be_req->req_class = BE_REQ_CLASS_BACKGROUND;
+
+        ar = talloc_zero(be_req, struct be_acct_req);
+        if (!ar) {
+            talloc_free(be_req);
+            return;
+        }
+        ar->entry_type = rr->entry_type;
+        ar->attr_type = BE_ATTR_CORE;
+        ar->filter_type = BE_FILTER_NAME;
+        ar->filter_value = talloc_strdup(ar, rr->names[i]);
+        ar->domain = talloc_strdup(ar, dom->name);
+        if (!ar->filter_value || !ar->domain) {
+            talloc_free(be_req);
+            return;
+        }
+
+        ret = be_file_account_request(be_req, ar);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Failed to file refresh of [%s] [%d]: %s\n",
+                   rr->names[i], ret, strerror(ret)));
+            talloc_free(be_req);
+        }
+    }
+}
+
+static int be_refresh_hot(DBusMessage *message, struct sbus_connection *conn)
+{
+    struct be_refresh_req *req;
+    struct be_req *be_req = NULL;
+    struct be_client *becli;
+    struct be_ctx *be_ctx;
+    struct sss_domain_info *dom;
+    DBusMessage *reply;
+    DBusMessageIter iter;
+    dbus_bool_t dbret;
+    void *user_data;
+    uint32_t entry_type;
+    uint32_t window;
+    const char *domain;
+    uint32_t num_names;
+    const char **names;
+    uint32_t batch;
+    time_t limit;
+    dbus_uint16_t err_maj = DP_ERR_OK;
+    dbus_uint32_t err_min = EOK;
+    const char *err_msg = "Success";
+    uint32_t i;
+    int ret;
+
+    user_data = sbus_conn_get_private_data(conn);
+    if (!user_data) return EINVAL;
+    becli = talloc_get_type(user_data, struct be_client);
+    if (!becli) return EINVAL;
+    be_ctx = becli->bectx;
+
+    /* request data:
+     * entry_type, window, domain, num_names, names[num_names]
+     */
+    dbus_message_iter_init(message, &iter);
+
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32) goto fail;
+    dbus_message_iter_get_basic(&iter, &entry_type);
+    dbus_message_iter_next(&iter);
+
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32) goto fail;
+    dbus_message_iter_get_basic(&iter, &window);
+    dbus_message_iter_next(&iter);
+
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) goto fail;
+    dbus_message_iter_get_basic(&iter, &domain);
+    dbus_message_iter_next(&iter);
+
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32) goto fail;
+    dbus_message_iter_get_basic(&iter, &num_names);
+
+    /* the responder does not wait for the refresh to finish */
+    reply = dbus_message_new_method_return(message);
+    if (!reply) return ENOMEM;
+
+    if (be_ctx->offstat.offline) {
+        err_maj = DP_ERR_OFFLINE;
+        err_min = EAGAIN;
+        err_msg = "Offline";
+    } else if (be_ctx->bet_info[BET_ID].bet_ops == NULL ||
+               be_ctx->bet_info[BET_ID].bet_ops->refresh == NULL) {
+        err_maj = DP_ERR_FATAL;
+        err_min = ENODEV;
+        err_msg = "Refresh is not supported by the back end";
+    }
+
+    dbret = dbus_message_append_args(reply,
+                                     DBUS_TYPE_UINT16, &err_maj,
+                                     DBUS_TYPE_UINT32, &err_min,
+                                     DBUS_TYPE_STRING, &err_msg,
+                                     DBUS_TYPE_INVALID);
+    if (!dbret) {
+        dbus_message_unref(reply);
+        return EIO;
+    }
+    sbus_conn_send_reply(conn, reply);
+    dbus_message_unref(reply);
+
+    if (err_maj != DP_ERR_OK || num_names == 0) {
+        return EOK;
+    }
+
+    switch (entry_type) {
+    case BE_REQ_USER:
+    case BE_REQ_GROUP:
+    case BE_REQ_NETGROUP:
+        break;
+    default:
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Invalid refresh entry type %u\n", entry_type));
+        return EOK;
+    }
+
+    dom = find_subdomain_by_name(be_ctx->domain, domain, true);
+    if (dom == NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unknown domain [%s], not refreshing\n", domain));
+        return EOK;
+    }
+
+    be_req = be_req_create(becli, becli, be_ctx,
+                           be_refresh_hot_callback, NULL);
+    if (!be_req) return ENOMEM;
+    be_req->req_class = BE_REQ_CLASS_BACKGROUND;
+
+    req = talloc_zero(be_req, struct be_refresh_req);
+    if (!req) {
+        talloc_free(be_req);
+        return ENOMEM;
+    }
+    req->entry_type = entry_type;
+
+    req->names = talloc_array(req, char *, num_names + 1);
+    if (!req->names) {
+        talloc_free(be_req);
+        return ENOMEM;
+    }
+
+    /* the strings belong to the message */
+    names = talloc_array(be_req, const char *, num_names);
+    if (!names) {
+        talloc_free(be_req);
+        return ENOMEM;
+    }
+
+    for (i = 0; i < num_names; i++) {
+        if (!dbus_message_iter_next(&iter) ||
+            dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Failed, to parse the message!\n"));
+            talloc_free(be_req);
+            return EOK;
+        }
+        dbus_message_iter_get_basic(&iter, &names[i]);
+    }
+
+    limit = time(NULL) + window;
+    for (i = 0; i < num_names; i += batch) {
+        batch = num_names - i;
+        if (batch > BE_REFRESH_BATCH) {
+            batch = BE_REFRESH_BATCH;
+        }
+
+        ret = be_refresh_add_expiring(req, dom, names + i, batch, limit);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE,
+                  ("Unable to check the expiration of frequently used "
+                   "entries [%d]: %s\n", ret, strerror(ret)));
+            talloc_free(be_req);
+            return EOK;
+        }
+    }
+    req->names[req->num_names] = NULL;
+    talloc_zfree(names);
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("%u of %u frequently used entries of type %u in [%s] need a "
+           "refresh\n", (unsigned int)req->num_names, num_names,
+           entry_type, dom->name));
+
+    if (req->num_names == 0) {
+        talloc_free(be_req);
+        return EOK;
+    }
+
+    if (dom != be_ctx->domain) {
+        be_refresh_hot_subdom(becli, dom, req);
+        talloc_free(be_req);
+        return EOK;
+    }
+
+    be_req->req_data = req;
+
+    ret = be_file_request(be_ctx->bet_info[BET_ID].pvt_bet_data,
+                          be_req,
+                          be_ctx->bet_info[BET_ID].bet_ops->refresh);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Failed to file refresh request [%d]: %s\n",
+               ret, strerror(ret)));
+        talloc_free(be_req);
+    }
+
+    return EOK;
+
+fail:
+    DEBUG(SSSDBG_CRIT_FAILURE, ("Failed, to parse the message!\n"));
+    return EIO;
+}
+
 static int be_client_destructor(void *ctx)
 {
     struct be_client *becli = talloc_get_type(ctx, struct be_client);
@@ -2028,6 +2698,9 @@ static errno_t be_file_check_online_request(struct be_req *req)
     req->be_ctx->offstat.went_offline = time(NULL);
     reset_fo(req->be_ctx);
 
+    /* going back online should not wait for a long enumeration */
+    req->req_class = BE_REQ_CLASS_AUTH;
+
     ret = be_file_request(req->be_ctx, req,
                           req->be_ctx->bet_info[BET_ID].bet_ops->check_online);
     if (ret != EOK) {
@@ -2523,6 +3196,13 @@ int be_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = be_sched_init(ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              ("fatal error setting up the request scheduler\n"));
+        goto fail;
+    }
+
     ret = be_srv_init(ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_FATAL_FAILURE, ("fatal error setting up server bus\n"));
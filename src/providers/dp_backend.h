@@ -33,6 +33,7 @@
 #define BE_SRV_IDENTIFIER  "_srv_"
 
 struct be_ctx;
+struct be_sched_ctx;
 struct bet_ops;
 struct be_req;
 
@@ -43,6 +44,17 @@ typedef void (*be_async_callback_t)(struct be_req *, int, int, const char *);
 
 typedef void (*be_callback_t)(void *);
 
+/* Requests are started in the order of their class, the lower the value the
+ * higher the priority. Within a class requests are started in order of
+ * arrival. */
+enum be_req_class {
+    BE_REQ_CLASS_AUTH = 0,
+    BE_REQ_CLASS_ID,
+    BE_REQ_CLASS_BACKGROUND,
+
+    BE_REQ_CLASS_NUM
+};
+
 enum bet_type {
     BET_NULL = 0,
     BET_ID,
@@ -131,12 +143,18 @@ struct be_ctx {
     struct bet_info bet_info[BET_MAX];
 
     size_t check_online_ref_count;
+
+    /* orders the requests filed with be_file_request() */
+    struct be_sched_ctx *sched;
 };
 
 struct bet_ops {
     be_req_fn_t check_online;
     be_req_fn_t handler;
     be_req_fn_t finalize;
+    /* optional, refreshes a batch of frequently used entries, the request
+     * data is a struct be_refresh_req */
+    be_req_fn_t refresh;
 };
 
 struct be_acct_req {
@@ -148,6 +166,12 @@ struct be_acct_req {
     char *domain;
 };
 
+struct be_refresh_req {
+    int entry_type;
+    size_t num_names;
+    char **names;
+};
+
 struct be_sudo_req {
     uint32_t type;
     char **rules;
@@ -269,6 +293,18 @@ void *be_req_get_data(struct be_req *be_req);
 void be_req_terminate(struct be_req *be_req,
                       int dp_err_type, int errnum, const char *errstr);
 
+/* Request scheduler, reads the limits of the classes from the domain */
+errno_t be_sched_init(struct be_ctx *be_ctx);
+
+/* For work the back end starts on its own, e.g. from a timer. Finishes once
+ * a request of the class may start, the slot counts as a running request
+ * of the class until the tevent request is freed. */
+struct tevent_req *be_sched_slot_send(TALLOC_CTX *mem_ctx,
+                                      struct be_ctx *be_ctx,
+                                      enum be_req_class req_class);
+
+errno_t be_sched_slot_recv(struct tevent_req *req);
+
 /* Request account information */
 struct tevent_req *
 be_get_account_info_send(TALLOC_CTX *mem_ctx,
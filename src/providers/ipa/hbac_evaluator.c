@@ -294,6 +294,546 @@ static errno_t hbac_evaluate_element(struct hbac_rule_element *rule_el,
     return EOK;
 }
 
+/* Compiled rule sets
+ *
+ * Each name and group listed in a rule element is case-folded once and
+ * hashed to the set of rules that list it. Evaluating a request then only
+ * folds the few names in the request, looks them up and intersects the
+ * rule sets of the four elements instead of comparing every rule string.
+ */
+
+#define HBAC_WORD_BITS 32
+
+enum hbac_compiled_element_type {
+    HBAC_CEL_USERS = 0,
+    HBAC_CEL_SERVICES,
+    HBAC_CEL_TARGETHOSTS,
+    HBAC_CEL_SRCHOSTS,
+
+    HBAC_CEL_NUM
+};
+
+struct hbac_index_entry {
+    char *key;
+    uint32_t *rules;
+    struct hbac_index_entry *next;
+};
+
+struct hbac_index {
+    size_t size;
+    struct hbac_index_entry **buckets;
+};
+
+struct hbac_compiled_element {
+    /* rules with category ALL */
+    uint32_t *all;
+    struct hbac_index names;
+    struct hbac_index groups;
+    /* rules listing a name or group that is not valid UTF-8, they fail
+     * when the request has a name or groups to compare it with */
+    uint32_t *bad_names;
+    uint32_t *bad_groups;
+};
+
+struct hbac_compiled_rules {
+    size_t num_rules;
+    size_t num_words;
+    char **rule_names;
+
+    /* enabled rules that can be evaluated */
+    uint32_t *enabled;
+    /* enabled rules missing an element, evaluation fails when one is
+     * reached */
+    uint32_t *broken;
+
+    struct hbac_compiled_element el[HBAC_CEL_NUM];
+};
+
+static struct hbac_rule_element *
+hbac_rule_get_element(struct hbac_rule *rule,
+                      enum hbac_compiled_element_type type)
+{
+    switch (type) {
+    case HBAC_CEL_USERS:
+        return rule->users;
+    case HBAC_CEL_SERVICES:
+        return rule->services;
+    case HBAC_CEL_TARGETHOSTS:
+        return rule->targethosts;
+    case HBAC_CEL_SRCHOSTS:
+        return rule->srchosts;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+static struct hbac_request_element *
+hbac_req_get_element(struct hbac_eval_req *req,
+                     enum hbac_compiled_element_type type)
+{
+    switch (type) {
+    case HBAC_CEL_USERS:
+        return req->user;
+    case HBAC_CEL_SERVICES:
+        return req->service;
+    case HBAC_CEL_TARGETHOSTS:
+        return req->targethost;
+    case HBAC_CEL_SRCHOSTS:
+        return req->srchost;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+static errno_t hbac_fold(const char *s, char **_folded)
+{
+    uint8_t *folded;
+    size_t len;
+    char *key;
+
+    errno = 0;
+    folded = sss_utf8_casefold((const uint8_t *) s, strlen(s), &len);
+    if (folded == NULL) {
+        return errno == EILSEQ ? EILSEQ : ENOMEM;
+    }
+
+    key = malloc(len + 1);
+    if (key == NULL) {
+        sss_utf8_free(folded);
+        return ENOMEM;
+    }
+    memcpy(key, folded, len);
+    key[len] = '\0';
+    sss_utf8_free(folded);
+
+    *_folded = key;
+    return EOK;
+}
+
+/* FNV-1a */
+static uint32_t hbac_hash(const char *key)
+{
+    uint32_t h = 2166136261U;
+
+    for (; *key; key++) {
+        h ^= (uint8_t) *key;
+        h *= 16777619U;
+    }
+    return h;
+}
+
+static size_t hbac_count(const char **list)
+{
+    size_t n = 0;
+
+    if (list == NULL) return 0;
+    while (list[n]) n++;
+    return n;
+}
+
+static errno_t hbac_index_init(struct hbac_index *index, size_t num_keys)
+{
+    /* power of two, at least twice the number of keys */
+    index->size = 16;
+    while (index->size < 2 * num_keys) index->size *= 2;
+
+    index->buckets = calloc(index->size, sizeof(struct hbac_index_entry *));
+    if (index->buckets == NULL) return ENOMEM;
+
+    return EOK;
+}
+
+static uint32_t *hbac_index_lookup(struct hbac_index *index, const char *key)
+{
+    struct hbac_index_entry *entry;
+
+    if (index->buckets == NULL) return NULL;
+
+    entry = index->buckets[hbac_hash(key) & (index->size - 1)];
+    for (; entry; entry = entry->next) {
+        if (strcmp(entry->key, key) == 0) {
+            return entry->rules;
+        }
+    }
+    return NULL;
+}
+
+/* key is taken over by the index */
+static errno_t hbac_index_add(struct hbac_index *index, size_t num_words,
+                              char *key, size_t rule)
+{
+    struct hbac_index_entry *entry;
+    uint32_t *rules;
+    size_t b;
+
+    rules = hbac_index_lookup(index, key);
+    if (rules != NULL) {
+        free(key);
+        rules[rule / HBAC_WORD_BITS] |= 1U << (rule % HBAC_WORD_BITS);
+        return EOK;
+    }
+
+    entry = malloc(sizeof(struct hbac_index_entry));
+    if (entry == NULL) {
+        free(key);
+        return ENOMEM;
+    }
+
+    entry->rules = calloc(num_words, sizeof(uint32_t));
+    if (entry->rules == NULL) {
+        free(entry);
+        free(key);
+        return ENOMEM;
+    }
+
+    entry->key = key;
+    entry->rules[rule / HBAC_WORD_BITS] |= 1U << (rule % HBAC_WORD_BITS);
+
+    b = hbac_hash(key) & (index->size - 1);
+    entry->next = index->buckets[b];
+    index->buckets[b] = entry;
+
+    return EOK;
+}
+
+static void hbac_index_free(struct hbac_index *index)
+{
+    struct hbac_index_entry *entry;
+    size_t i;
+
+    if (index->buckets == NULL) return;
+
+    for (i = 0; i < index->size; i++) {
+        while ((entry = index->buckets[i]) != NULL) {
+            index->buckets[i] = entry->next;
+            free(entry->key);
+            free(entry->rules);
+            free(entry);
+        }
+    }
+    free(index->buckets);
+    index->buckets = NULL;
+}
+
+/* Names that cannot be folded are left out and the rule is added to bad */
+static errno_t hbac_index_add_list(struct hbac_index *index, size_t num_words,
+                                   const char **list, size_t rule,
+                                   uint32_t *bad)
+{
+    char *key;
+    errno_t ret;
+    size_t i;
+
+    if (list == NULL) return EOK;
+
+    for (i = 0; list[i]; i++) {
+        ret = hbac_fold(list[i], &key);
+        if (ret == EILSEQ) {
+            bad[rule / HBAC_WORD_BITS] |= 1U << (rule % HBAC_WORD_BITS);
+            continue;
+        } else if (ret != EOK) {
+            return ret;
+        }
+
+        ret = hbac_index_add(index, num_words, key, rule);
+        if (ret != EOK) return ret;
+    }
+
+    return EOK;
+}
+
+static errno_t hbac_compile_rule(struct hbac_compiled_rules *compiled,
+                                 struct hbac_rule *rule, size_t r)
+{
+    struct hbac_compiled_element *cel;
+    struct hbac_rule_element *rule_el;
+    uint32_t word = r / HBAC_WORD_BITS;
+    uint32_t bit = 1U << (r % HBAC_WORD_BITS);
+    errno_t ret;
+    int e;
+
+    if (!rule->enabled) return EOK;
+
+    for (e = 0; e < HBAC_CEL_NUM; e++) {
+        if (hbac_rule_get_element(rule, e) == NULL) {
+            compiled->broken[word] |= bit;
+            return EOK;
+        }
+    }
+
+    for (e = 0; e < HBAC_CEL_NUM; e++) {
+        cel = &compiled->el[e];
+        rule_el = hbac_rule_get_element(rule, e);
+
+        if (rule_el->category & HBAC_CATEGORY_ALL) {
+            cel->all[word] |= bit;
+            continue;
+        }
+
+        ret = hbac_index_add_list(&cel->names, compiled->num_words,
+                                  rule_el->names, r, cel->bad_names);
+        if (ret != EOK) return ret;
+
+        ret = hbac_index_add_list(&cel->groups, compiled->num_words,
+                                  rule_el->groups, r, cel->bad_groups);
+        if (ret != EOK) return ret;
+    }
+
+    compiled->enabled[word] |= bit;
+    return EOK;
+}
+
+enum hbac_error_code hbac_compile_rules(struct hbac_rule **rules,
+                                        struct hbac_compiled_rules **compiled)
+{
+    struct hbac_compiled_rules *c;
+    struct hbac_rule_element *rule_el;
+    size_t num_names[HBAC_CEL_NUM] = { 0 };
+    size_t num_groups[HBAC_CEL_NUM] = { 0 };
+    size_t i;
+    errno_t ret;
+    int e;
+
+    if (rules == NULL || compiled == NULL) return HBAC_ERROR_UNKNOWN;
+
+    c = calloc(1, sizeof(struct hbac_compiled_rules));
+    if (c == NULL) return HBAC_ERROR_OUT_OF_MEMORY;
+
+    for (i = 0; rules[i]; i++) {
+        for (e = 0; e < HBAC_CEL_NUM; e++) {
+            rule_el = hbac_rule_get_element(rules[i], e);
+            if (rule_el == NULL) continue;
+            num_names[e] += hbac_count(rule_el->names);
+            num_groups[e] += hbac_count(rule_el->groups);
+        }
+    }
+    c->num_rules = i;
+    c->num_words = (c->num_rules + HBAC_WORD_BITS - 1) / HBAC_WORD_BITS;
+    if (c->num_words == 0) c->num_words = 1;
+
+    c->rule_names = calloc(c->num_rules + 1, sizeof(char *));
+    c->enabled = calloc(c->num_words, sizeof(uint32_t));
+    c->broken = calloc(c->num_words, sizeof(uint32_t));
+    if (!c->rule_names || !c->enabled || !c->broken) goto oom;
+
+    for (e = 0; e < HBAC_CEL_NUM; e++) {
+        c->el[e].all = calloc(c->num_words, sizeof(uint32_t));
+        c->el[e].bad_names = calloc(c->num_words, sizeof(uint32_t));
+        c->el[e].bad_groups = calloc(c->num_words, sizeof(uint32_t));
+        if (!c->el[e].all || !c->el[e].bad_names || !c->el[e].bad_groups) {
+            goto oom;
+        }
+
+        ret = hbac_index_init(&c->el[e].names, num_names[e]);
+        if (ret != EOK) goto oom;
+        ret = hbac_index_init(&c->el[e].groups, num_groups[e]);
+        if (ret != EOK) goto oom;
+    }
+
+    for (i = 0; i < c->num_rules; i++) {
+        c->rule_names[i] = strdup(rules[i]->name ? rules[i]->name : "");
+        if (c->rule_names[i] == NULL) goto oom;
+
+        ret = hbac_compile_rule(c, rules[i], i);
+        if (ret != EOK) goto oom;
+    }
+
+    *compiled = c;
+    return HBAC_SUCCESS;
+
+oom:
+    hbac_free_compiled_rules(c);
+    return HBAC_ERROR_OUT_OF_MEMORY;
+}
+
+/* ORs the rules listing key into acc */
+static errno_t hbac_match_key(struct hbac_index *index, size_t num_words,
+                              const char *name, uint32_t *acc)
+{
+    uint32_t *rules;
+    char *key;
+    errno_t ret;
+    size_t w;
+
+    ret = hbac_fold(name, &key);
+    if (ret != EOK) return ret;
+
+    rules = hbac_index_lookup(index, key);
+    free(key);
+
+    if (rules != NULL) {
+        for (w = 0; w < num_words; w++) {
+            acc[w] |= rules[w];
+        }
+    }
+
+    return EOK;
+}
+
+static errno_t hbac_match_element(struct hbac_compiled_rules *compiled,
+                                  struct hbac_compiled_element *cel,
+                                  struct hbac_request_element *req_el,
+                                  uint32_t *acc)
+{
+    errno_t ret;
+    size_t i;
+
+    memcpy(acc, cel->all, compiled->num_words * sizeof(uint32_t));
+
+    if (req_el == NULL) return EOK;
+
+    if (req_el->name != NULL) {
+        ret = hbac_match_key(&cel->names, compiled->num_words,
+                             req_el->name, acc);
+        if (ret != EOK) return ret;
+    }
+
+    if (req_el->groups != NULL) {
+        for (i = 0; req_el->groups[i]; i++) {
+            ret = hbac_match_key(&cel->groups, compiled->num_words,
+                                 req_el->groups[i], acc);
+            if (ret != EOK) return ret;
+        }
+    }
+
+    return EOK;
+}
+
+enum hbac_eval_result
+hbac_evaluate_compiled(struct hbac_compiled_rules *compiled,
+                       struct hbac_eval_req *hbac_req,
+                       struct hbac_info **info)
+{
+    enum hbac_eval_result result = HBAC_EVAL_DENY;
+    enum hbac_error_code code = HBAC_SUCCESS;
+    struct hbac_request_element *req_el;
+    uint32_t *acc = NULL;
+    uint32_t *bad = NULL;
+    uint32_t matched;
+    uint32_t failed = 0;
+    uint32_t m = 0;
+    size_t w = 0;
+    size_t r;
+    errno_t ret;
+    int e;
+
+    if (info) {
+        *info = malloc(sizeof(struct hbac_info));
+        if (!*info) {
+            return HBAC_EVAL_OOM;
+        }
+        (*info)->code = HBAC_ERROR_UNKNOWN;
+        (*info)->rule_name = NULL;
+    }
+
+    acc = malloc(HBAC_CEL_NUM * compiled->num_words * sizeof(uint32_t));
+    bad = calloc(HBAC_CEL_NUM * compiled->num_words, sizeof(uint32_t));
+    if (acc == NULL || bad == NULL) {
+        result = HBAC_EVAL_ERROR;
+        code = HBAC_ERROR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    for (e = 0; e < HBAC_CEL_NUM; e++) {
+        req_el = hbac_req_get_element(hbac_req, e);
+        ret = hbac_match_element(compiled, &compiled->el[e], req_el,
+                                 acc + e * compiled->num_words);
+        if (ret != EOK) {
+            result = HBAC_EVAL_ERROR;
+            code = ret == ENOMEM ? HBAC_ERROR_OUT_OF_MEMORY
+                                 : HBAC_ERROR_UNPARSEABLE_RULE;
+            goto done;
+        }
+
+        if (req_el == NULL) continue;
+
+        /* an invalid rule name only fails a rule if it is compared */
+        for (w = 0; w < compiled->num_words; w++) {
+            if (req_el->name != NULL) {
+                bad[e * compiled->num_words + w] |=
+                                            compiled->el[e].bad_names[w];
+            }
+            if (req_el->groups != NULL && req_el->groups[0] != NULL) {
+                bad[e * compiled->num_words + w] |=
+                                            compiled->el[e].bad_groups[w];
+            }
+        }
+    }
+
+    /* Rules are still decided in order: the first rule that either
+     * matches or cannot be evaluated settles the result. Like
+     * hbac_evaluate_rule(), a rule fails in the first element it does not
+     * match if that element has an invalid name to compare.
+     */
+    for (w = 0; w < compiled->num_words; w++) {
+        matched = compiled->enabled[w];
+        failed = compiled->broken[w];
+        for (e = 0; e < HBAC_CEL_NUM; e++) {
+            failed |= matched & bad[e * compiled->num_words + w]
+                              & ~acc[e * compiled->num_words + w];
+            matched &= acc[e * compiled->num_words + w];
+        }
+        m = matched | failed;
+        if (m != 0) break;
+    }
+
+    if (m == 0) goto done;
+
+    for (r = 0; !(m & (1U << r)); r++) ;
+    code = HBAC_SUCCESS;
+    if (failed & (1U << r)) {
+        result = HBAC_EVAL_ERROR;
+        code = HBAC_ERROR_UNPARSEABLE_RULE;
+    } else {
+        result = HBAC_EVAL_ALLOW;
+    }
+    r += w * HBAC_WORD_BITS;
+
+    if (info) {
+        (*info)->rule_name = strdup(compiled->rule_names[r]);
+        if (!(*info)->rule_name && result == HBAC_EVAL_ALLOW) {
+            result = HBAC_EVAL_ERROR;
+            code = HBAC_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+done:
+    if (info && result != HBAC_EVAL_DENY) {
+        (*info)->code = code;
+    }
+    free(acc);
+    free(bad);
+    return result;
+}
+
+void hbac_free_compiled_rules(struct hbac_compiled_rules *compiled)
+{
+    size_t i;
+    int e;
+
+    if (compiled == NULL) return;
+
+    for (e = 0; e < HBAC_CEL_NUM; e++) {
+        free(compiled->el[e].all);
+        free(compiled->el[e].bad_names);
+        free(compiled->el[e].bad_groups);
+        hbac_index_free(&compiled->el[e].names);
+        hbac_index_free(&compiled->el[e].groups);
+    }
+
+    if (compiled->rule_names) {
+        for (i = 0; i < compiled->num_rules; i++) {
+            free(compiled->rule_names[i]);
+        }
+        free(compiled->rule_names);
+    }
+    free(compiled->enabled);
+    free(compiled->broken);
+    free(compiled);
+}
+
 const char *hbac_result_string(enum hbac_eval_result result)
 {
     switch(result) {
@@ -576,6 +576,8 @@ static void hbac_sysdb_save(struct tevent_req *req)
      */
     hbac_clear_rule_data(hbac_ctx);
 
+    /* The rules have to be compiled again */
+    talloc_zfree(access_ctx->compiled);
 
     access_ctx->last_update = time(NULL);
 
@@ -594,36 +596,105 @@ fail:
     ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
 }
 
-void ipa_hbac_evaluate_rules(struct hbac_ctx *hbac_ctx)
+struct ipa_hbac_compiled {
+    struct hbac_compiled_rules *rules;
+    /* DENY rules are present, access is denied to everybody */
+    bool deny;
+};
+
+static int ipa_hbac_compiled_destructor(struct ipa_hbac_compiled *compiled)
+{
+    hbac_free_compiled_rules(compiled->rules);
+    return 0;
+}
+
+static errno_t ipa_hbac_compile_rules(struct hbac_ctx *hbac_ctx,
+                                      struct ipa_hbac_compiled **_compiled)
 {
     struct be_ctx *be_ctx = be_req_get_be_ctx(hbac_ctx->be_req);
-    errno_t ret;
+    struct ipa_hbac_compiled *compiled;
     struct hbac_rule **hbac_rules;
-    struct hbac_eval_req *eval_req;
-    enum hbac_eval_result result;
-    struct hbac_info *info;
+    enum hbac_error_code hret;
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) return ENOMEM;
+
+    compiled = talloc_zero(tmp_ctx, struct ipa_hbac_compiled);
+    if (compiled == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    talloc_set_destructor(compiled, ipa_hbac_compiled_destructor);
 
     /* Get HBAC rules from the sysdb */
     ret = hbac_get_cached_rules(hbac_ctx, be_ctx->domain,
                                 &hbac_ctx->rule_count, &hbac_ctx->rules);
     if (ret != EOK) {
         DEBUG(1, ("Could not retrieve rules from the cache\n"));
-        ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
+        goto done;
     }
 
-    ret = hbac_ctx_to_rules(hbac_ctx, hbac_ctx,
-                            &hbac_rules, &eval_req);
+    ret = hbac_ctx_to_rules(tmp_ctx, hbac_ctx, &hbac_rules);
     if (ret == EPERM) {
+        compiled->deny = true;
+    } else if (ret != EOK) {
+        DEBUG(1, ("Could not construct HBAC rules\n"));
+        goto done;
+    } else {
+        hret = hbac_compile_rules(hbac_rules, &compiled->rules);
+        if (hret != HBAC_SUCCESS) {
+            DEBUG(1, ("Could not compile HBAC rules: %s\n",
+                      hbac_error_string(hret)));
+            ret = ENOMEM;
+            goto done;
+        }
+        DEBUG(SSSDBG_TRACE_FUNC, ("Compiled %u HBAC rules\n",
+                                  (unsigned int) hbac_ctx->rule_count));
+    }
+
+    *_compiled = talloc_steal(hbac_ctx->access_ctx, compiled);
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+void ipa_hbac_evaluate_rules(struct hbac_ctx *hbac_ctx)
+{
+    struct ipa_access_ctx *access_ctx = hbac_ctx->access_ctx;
+    errno_t ret;
+    struct hbac_eval_req *eval_req;
+    enum hbac_eval_result result;
+    struct hbac_info *info;
+
+    /* The rules only change when they are downloaded again, so they
+     * are converted and compiled once and reused until then */
+    if (access_ctx->compiled == NULL) {
+        ret = ipa_hbac_compile_rules(hbac_ctx, &access_ctx->compiled);
+        if (ret != EOK) {
+            ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
+            return;
+        }
+    }
+
+    if (access_ctx->compiled->deny) {
         DEBUG(1, ("DENY rules detected. Denying access to all users\n"));
         ipa_access_reply(hbac_ctx, PAM_PERM_DENIED);
         return;
-    } else if (ret != EOK) {
-        DEBUG(1, ("Could not construct HBAC rules\n"));
+    }
+
+    ret = hbac_ctx_to_eval_request(hbac_ctx, hbac_ctx, &eval_req);
+    if (ret != EOK) {
+        DEBUG(1, ("Could not construct eval request\n"));
         ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
         return;
     }
 
-    result = hbac_evaluate(hbac_rules, eval_req, &info);
+    result = hbac_evaluate_compiled(access_ctx->compiled->rules,
+                                    eval_req, &info);
     if (result == HBAC_EVAL_ALLOW) {
         DEBUG(3, ("Access granted by HBAC rule [%s]\n",
                   info->rule_name));
@@ -633,7 +704,7 @@ void ipa_hbac_evaluate_rules(struct hbac_ctx *hbac_ctx)
     } else if (result == HBAC_EVAL_ERROR) {
         DEBUG(1, ("Error [%s] occurred in rule [%s]\n",
                   hbac_error_string(info->code),
-                  info->rule_name));
+                  info->rule_name ? info->rule_name : "(none)"));
         hbac_free_info(info);
         ipa_access_reply(hbac_ctx, PAM_SYSTEM_ERR);
         return;
@@ -39,6 +39,10 @@ struct ipa_access_ctx {
     time_t last_update;
     struct sdap_access_ctx *sdap_access_ctx;
 
+    /* The cached rules compiled for evaluation, dropped whenever
+     * new rules are saved */
+    struct ipa_hbac_compiled *compiled;
+
     struct sdap_attr_map *host_map;
     struct sdap_attr_map *hostgroup_map;
     struct sdap_search_base **host_search_bases;
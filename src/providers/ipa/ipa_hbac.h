@@ -259,6 +259,52 @@ enum hbac_eval_result hbac_evaluate(struct hbac_rule **rules,
                                     struct hbac_eval_req *hbac_req,
                                     struct hbac_info **info);
 
+/**
+ * Opaque type contained in hbac_evaluator.c
+ */
+struct hbac_compiled_rules;
+
+/**
+ * @brief Compile a set of HBAC rules for repeated evaluation
+ *
+ * Names and groups of all rule elements are case-folded and indexed
+ * once, so that #hbac_evaluate_compiled only needs to look up the
+ * names of the request. The compiled set does not reference the
+ * rules, they may be freed afterwards.
+ *
+ * @param[in] rules     A NULL-terminated list of rules to compile
+ * @param[out] compiled The compiled rule set, to be freed with
+ *                      #hbac_free_compiled_rules
+ * @return
+ *  - #HBAC_SUCCESS: The rules were compiled
+ *  - #HBAC_ERROR_OUT_OF_MEMORY: Insufficient memory
+ *  - #HBAC_ERROR_UNKNOWN: Invalid arguments
+ */
+enum hbac_error_code hbac_compile_rules(struct hbac_rule **rules,
+                                        struct hbac_compiled_rules **compiled);
+
+/**
+ * @brief Evaluate an authorization request against a compiled rule set
+ *
+ * The result is the same as that of #hbac_evaluate for the rules
+ * the set was compiled from.
+ *
+ * @param[in] compiled A rule set returned by #hbac_compile_rules
+ * @param[in] hbac_req A user authorization request
+ * @param[out] info    Extended information, see #hbac_evaluate
+ * @return See #hbac_evaluate
+ */
+enum hbac_eval_result
+hbac_evaluate_compiled(struct hbac_compiled_rules *compiled,
+                       struct hbac_eval_req *hbac_req,
+                       struct hbac_info **info);
+
+/**
+ * @brief Free a rule set returned by #hbac_compile_rules
+ * @param compiled The compiled rule set
+ */
+void hbac_free_compiled_rules(struct hbac_compiled_rules *compiled);
+
 /**
  * @brief Display result of hbac evaluation in human-readable form
  * @param[in] result Return value of #hbac_evaluate
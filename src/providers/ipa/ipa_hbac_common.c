@@ -200,24 +200,17 @@ hbac_attrs_to_rule(TALLOC_CTX *mem_ctx,
                    size_t index,
                    struct hbac_rule **rule);
 
-static errno_t
-hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
-                         struct hbac_ctx *hbac_ctx,
-                         struct hbac_eval_req **request);
-
 errno_t
 hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
                   struct hbac_ctx *hbac_ctx,
-                  struct hbac_rule ***rules,
-                  struct hbac_eval_req **request)
+                  struct hbac_rule ***rules)
 {
     errno_t ret;
     struct hbac_rule **new_rules;
-    struct hbac_eval_req *new_request = NULL;
     size_t i;
     TALLOC_CTX *tmp_ctx = NULL;
 
-    if (!rules || !request) return EINVAL;
+    if (!rules) return EINVAL;
 
     tmp_ctx = talloc_new(mem_ctx);
     if (tmp_ctx == NULL) return ENOMEM;
@@ -242,15 +235,7 @@ hbac_ctx_to_rules(TALLOC_CTX *mem_ctx,
     }
     new_rules[i] = NULL;
 
-    /* Create the eval request */
-    ret = hbac_ctx_to_eval_request(tmp_ctx, hbac_ctx, &new_request);
-    if (ret != EOK) {
-        DEBUG(1, ("Could not construct eval request\n"));
-        goto done;
-    }
-
     *rules = talloc_steal(mem_ctx, new_rules);
-    *request = talloc_steal(mem_ctx, new_request);
     ret = EOK;
 
 done:
@@ -419,7 +404,7 @@ hbac_eval_host_element(TALLOC_CTX *mem_ctx,
                        const char *hostname,
                        struct hbac_request_element **host_element);
 
-static errno_t
+errno_t
 hbac_ctx_to_eval_request(TALLOC_CTX *mem_ctx,
                          struct hbac_ctx *hbac_ctx,
                          struct hbac_eval_req **request)
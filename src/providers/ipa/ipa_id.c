@@ -331,3 +331,22 @@ void ipa_check_online(struct be_req *be_req)
 
     return sdap_do_online_check(be_req, ipa_ctx->sdap_id_ctx);
 }
+
+void ipa_refresh_hot_handler(struct be_req *breq)
+{
+    struct be_ctx *be_ctx = be_req_get_be_ctx(breq);
+    struct ipa_id_ctx *ipa_ctx;
+    struct be_refresh_req *rr;
+
+    ipa_ctx = talloc_get_type(be_ctx->bet_info[BET_ID].pvt_bet_data,
+                              struct ipa_id_ctx);
+
+    /* IPA netgroups are not plain LDAP netgroups, they are refreshed by the
+     * regular lookups only */
+    rr = talloc_get_type(be_req_get_data(breq), struct be_refresh_req);
+    if (rr && rr->entry_type == BE_REQ_NETGROUP) {
+        return sdap_handler_done(breq, DP_ERR_OK, EOK, NULL);
+    }
+
+    return sdap_handle_refresh_hot(breq, ipa_ctx->sdap_id_ctx);
+}
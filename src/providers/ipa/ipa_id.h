@@ -49,6 +49,8 @@ int ipa_get_netgroups_recv(struct tevent_req *req,
 
 void ipa_check_online(struct be_req *be_req);
 
+void ipa_refresh_hot_handler(struct be_req *breq);
+
 struct tevent_req *ipa_s2n_get_acct_info_send(TALLOC_CTX *mem_ctx,
                                               struct tevent_context *ev,
                                               struct sdap_options *opts,
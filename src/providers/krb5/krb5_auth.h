@@ -76,6 +76,13 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
 int handle_child_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
                       uint8_t **buf, ssize_t *len);
 
+/* Used by a persistent krb5_child to read the requests of the backend and
+ * to send the replies, see krb5_child_frame.c */
+errno_t k5c_recv_frame(TALLOC_CTX *mem_ctx, int fd,
+                       uint8_t **_buf, size_t *_len,
+                       bool *_run_as_user);
+errno_t k5c_send_frame(int fd, uint8_t *buf, size_t len);
+
 struct krb5_child_response {
     int32_t msg_status;
     struct tgt_times tgtt;
@@ -27,6 +27,10 @@
 #include <sys/stat.h>
 #include <popt.h>
 
+#ifdef HAVE_PRCTL
+#include <sys/prctl.h>
+#endif
+
 #include <security/pam_modules.h>
 
 #include "util/util.h"
@@ -62,6 +66,8 @@ struct krb5_req {
 };
 
 static krb5_context krb5_error_ctx;
+/* Only set in a persistent krb5_child, see k5c_persistent_loop() */
+static krb5_context k5c_persistent_ctx;
 #define KRB5_CHILD_DEBUG(level, error) KRB5_DEBUG(level, krb5_error_ctx, error)
 
 static krb5_error_code get_changepw_options(krb5_context ctx,
@@ -1709,7 +1715,8 @@ static krb5_error_code check_fast_ccache(TALLOC_CTX *mem_ctx,
                                          const char *primary,
                                          const char *realm,
                                          const char *keytab_name,
-                                         char **fast_ccname)
+                                         char **fast_ccname,
+                                         time_t *_endtime)
 {
     TALLOC_CTX *tmp_ctx = NULL;
     krb5_error_code kerr;
@@ -1783,6 +1790,14 @@ static krb5_error_code check_fast_ccache(TALLOC_CTX *mem_ctx,
         goto done;
     }
 
+    if (_endtime != NULL) {
+        memset(&tgtt, 0, sizeof(tgtt));
+        kerr = get_tgt_times(ctx, ccname, server_princ, client_princ, &tgtt);
+        if (kerr != 0) {
+            goto done;
+        }
+    }
+
     kerr = 0;
 
 done:
@@ -1795,6 +1810,9 @@ done:
 
     if (kerr == 0) {
         *fast_ccname = talloc_steal(mem_ctx, ccname);
+        if (_endtime != NULL) {
+            *_endtime = tgtt.endtime;
+        }
     }
     talloc_free(tmp_ctx);
 
@@ -1828,7 +1846,8 @@ static errno_t k5c_recv_data(struct krb5_req *kr, int fd, uint32_t *offline)
     return ret;
 }
 
-static int k5c_setup_fast(struct krb5_req *kr, char *lifetime_str, bool demand)
+static krb5_error_code k5c_get_fast_ccname(struct krb5_req *kr,
+                                           time_t *_endtime)
 {
     krb5_principal fast_princ_struct;
     krb5_data *realm_data;
@@ -1837,9 +1856,6 @@ static int k5c_setup_fast(struct krb5_req *kr, char *lifetime_str, bool demand)
     krb5_error_code kerr;
     char *tmp_str;
 
-    DEBUG(SSSDBG_CONF_SETTINGS, ("%s is set to [%s]\n",
-                                 SSSD_KRB5_LIFETIME, lifetime_str));
-
     tmp_str = getenv(SSSD_KRB5_FAST_PRINCIPAL);
     if (tmp_str) {
         DEBUG(SSSDBG_CONF_SETTINGS, ("%s is set to [%s]\n",
@@ -1874,13 +1890,31 @@ static int k5c_setup_fast(struct krb5_req *kr, char *lifetime_str, bool demand)
     }
 
     kerr = check_fast_ccache(kr, kr->ctx, fast_principal, fast_principal_realm,
-                             kr->keytab, &kr->fast_ccname);
+                             kr->keytab, &kr->fast_ccname, _endtime);
     if (kerr != 0) {
         DEBUG(1, ("check_fast_ccache failed.\n"));
         KRB5_CHILD_DEBUG(SSSDBG_CRIT_FAILURE, kerr);
         return kerr;
     }
 
+    return 0;
+}
+
+static int k5c_setup_fast(struct krb5_req *kr, char *lifetime_str, bool demand)
+{
+    krb5_error_code kerr;
+
+    DEBUG(SSSDBG_CONF_SETTINGS, ("%s is set to [%s]\n",
+                                 SSSD_KRB5_LIFETIME, lifetime_str));
+
+    /* A persistent krb5_child may already have checked the FAST ccache */
+    if (kr->fast_ccname == NULL) {
+        kerr = k5c_get_fast_ccname(kr, NULL);
+        if (kerr != 0) {
+            return kerr;
+        }
+    }
+
     kerr = sss_krb5_get_init_creds_opt_set_fast_ccache_name(kr->ctx,
                                                             kr->options,
                                                             kr->fast_ccname);
@@ -1919,10 +1953,16 @@ static int k5c_setup(struct krb5_req *kr, uint32_t offline)
               ("Cannot read [%s] from environment.\n", SSSD_KRB5_REALM));
     }
 
-    kerr = krb5_init_context(&kr->ctx);
-    if (kerr != 0) {
-        KRB5_CHILD_DEBUG(SSSDBG_CRIT_FAILURE, kerr);
-        return kerr;
+    if (k5c_persistent_ctx != NULL) {
+        /* inherited from the persistent krb5_child, no need to read the
+         * configuration again */
+        kr->ctx = k5c_persistent_ctx;
+    } else {
+        kerr = krb5_init_context(&kr->ctx);
+        if (kerr != 0) {
+            KRB5_CHILD_DEBUG(SSSDBG_CRIT_FAILURE, kerr);
+            return kerr;
+        }
     }
 
     /* Set the global error context */
@@ -2040,6 +2080,271 @@ static int k5c_setup(struct krb5_req *kr, uint32_t offline)
     return kerr;
 }
 
+/* Set up the request and run the command, the reply is written to fd. If
+ * no reply can be sent an error is returned and the caller has to exit
+ * with a failure. */
+static errno_t k5c_handle_request(struct krb5_req *kr, uint32_t offline,
+                                  int fd)
+{
+    errno_t ret;
+
+    ret = k5c_setup(kr, offline);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("krb5_child_setup failed.\n"));
+        goto done;
+    }
+
+    switch(kr->pd->cmd) {
+    case SSS_PAM_AUTHENTICATE:
+        /* If we are offline, we need to create an empty ccache file */
+        if (offline) {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform offline auth\n"));
+            ret = create_empty_ccache(kr);
+        } else {
+            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform online auth\n"));
+            ret = tgt_req_child(kr);
+        }
+        break;
+    case SSS_PAM_CHAUTHTOK:
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change\n"));
+        ret = changepw_child(kr, false);
+        break;
+    case SSS_PAM_CHAUTHTOK_PRELIM:
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change checks\n"));
+        ret = changepw_child(kr, true);
+        break;
+    case SSS_PAM_ACCT_MGMT:
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform account management\n"));
+        ret = kuserok_child(kr);
+        break;
+    case SSS_CMD_RENEW:
+        if (offline) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot renew TGT while offline\n"));
+            ret = KRB5_KDC_UNREACH;
+            goto done;
+        }
+        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform ticket renewal\n"));
+        ret = renew_tgt_child(kr);
+        break;
+    default:
+        DEBUG(1, ("PAM command [%d] not supported.\n", kr->pd->cmd));
+        ret = EINVAL;
+        goto done;
+    }
+
+    ret = k5c_send_data(kr, fd, ret);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to send reply\n"));
+    }
+
+done:
+    return ret;
+}
+
+/* The FAST ccache is checked once by the persistent krb5_child and then
+ * reused until the TGT in it expires */
+static struct {
+    char *ccname;
+    time_t endtime;
+} k5c_fast_cache;
+
+static void k5c_persistent_fast(struct krb5_req *kr)
+{
+    krb5_error_code kerr;
+    char *use_fast_str;
+    time_t endtime = 0;
+
+    use_fast_str = getenv(SSSD_KRB5_USE_FAST);
+    if (use_fast_str == NULL || strcasecmp(use_fast_str, "never") == 0) {
+        return;
+    }
+
+    if (k5c_fast_cache.ccname == NULL || k5c_fast_cache.endtime <= time(NULL)) {
+        talloc_zfree(k5c_fast_cache.ccname);
+
+        kr->ctx = k5c_persistent_ctx;
+        kerr = k5c_get_fast_ccname(kr, &endtime);
+        kr->ctx = NULL;
+        if (kerr != 0) {
+            /* the request checks again and reports the error */
+            talloc_zfree(kr->fast_ccname);
+            return;
+        }
+
+        k5c_fast_cache.ccname = talloc_steal(NULL, kr->fast_ccname);
+        k5c_fast_cache.endtime = endtime;
+    }
+
+    kr->fast_ccname = talloc_strdup(kr, k5c_fast_cache.ccname);
+}
+
+/* Each request is handled by a forked copy of the persistent krb5_child
+ * because switching to the user cannot be undone, the krb5 context and the
+ * FAST ccache are inherited. Returns the reply of the request, which is
+ * empty if it failed without sending one. */
+static errno_t k5c_persistent_request(struct krb5_req *kr, uint32_t offline,
+                                      bool run_as_user,
+                                      uint8_t **_buf, size_t *_len)
+{
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    uint8_t chunk[CHILD_MSG_CHUNK];
+    ssize_t size;
+    int pipefd[2];
+    pid_t ppid;
+    pid_t pid;
+    int status;
+    errno_t ret;
+
+    ppid = getpid();
+
+    ret = pipe(pipefd);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("pipe failed [%d][%s].\n",
+                                    ret, strerror(ret)));
+        return ret;
+    }
+
+    pid = fork();
+    if (pid == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("fork failed [%d][%s].\n",
+                                    ret, strerror(ret)));
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return ret;
+    } else if (pid == 0) {
+        close(pipefd[0]);
+        debug_prg_name = talloc_asprintf(kr, "[sssd[krb5_child[%d]]]",
+                                         getpid());
+
+        ret = EOK;
+        if (run_as_user) {
+            ret = become_user(kr->uid, kr->gid);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_CRIT_FAILURE, ("become_user failed.\n"));
+            }
+        }
+
+#ifdef HAVE_PRCTL
+        /* The backend only kills the process group of a worker that was
+         * not collected yet, the copy must not outlive the worker. Set
+         * after become_user(), changing the credentials resets it. */
+        if (ret == EOK && prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0) != 0) {
+            ret = errno;
+            DEBUG(SSSDBG_CRIT_FAILURE, ("prctl failed [%d][%s].\n",
+                                        ret, strerror(ret)));
+        }
+#endif
+        if (ret == EOK && getppid() != ppid) {
+            /* the worker is already gone */
+            ret = ECHILD;
+        }
+
+        if (ret == EOK) {
+            ret = k5c_handle_request(kr, offline, pipefd[1]);
+        }
+        _exit(ret == EOK ? 0 : -1);
+    }
+
+    close(pipefd[1]);
+
+    ret = EOK;
+    while ((size = sss_atomic_read_s(pipefd[0], chunk,
+                                     CHILD_MSG_CHUNK)) > 0) {
+        buf = talloc_realloc(kr, buf, uint8_t, len + size);
+        if (buf == NULL) {
+            ret = ENOMEM;
+            break;
+        }
+        safealign_memcpy(&buf[len], chunk, size, &len);
+    }
+    if (size == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("read failed [%d][%s].\n",
+                                    ret, strerror(ret)));
+    }
+    close(pipefd[0]);
+
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+
+    if (ret != EOK) {
+        return ret;
+    }
+
+    *_buf = buf;
+    *_len = len;
+    return EOK;
+}
+
+/* Serve requests until the backend closes the pipe */
+static errno_t k5c_persistent_loop(void)
+{
+    struct krb5_req *kr;
+    uint32_t offline;
+    bool run_as_user;
+    uint8_t *buf;
+    size_t len;
+    errno_t ret;
+
+    ret = krb5_init_context(&k5c_persistent_ctx);
+    if (ret != 0) {
+        KRB5_CHILD_DEBUG(SSSDBG_CRIT_FAILURE, ret);
+        return ret;
+    }
+    krb5_error_ctx = k5c_persistent_ctx;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("krb5_child waiting for requests.\n"));
+
+    while (1) {
+        kr = talloc_zero(NULL, struct krb5_req);
+        if (kr == NULL) {
+            ret = ENOMEM;
+            break;
+        }
+
+        ret = k5c_recv_frame(kr, STDIN_FILENO, &buf, &len, &run_as_user);
+        if (ret == ENOENT) {
+            ret = EOK;
+            break;
+        } else if (ret != EOK) {
+            break;
+        }
+
+        ret = unpack_buffer(buf, len, kr, &offline);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("unpack_buffer failed.\n"));
+            len = 0;
+        } else {
+            /* the FAST ccache needs the privileges of the worker, only do
+             * it for requests that would keep them anyway */
+            if (!offline && !run_as_user) {
+                k5c_persistent_fast(kr);
+            }
+
+            ret = k5c_persistent_request(kr, offline, run_as_user,
+                                         &buf, &len);
+            if (ret != EOK) {
+                len = 0;
+            }
+        }
+
+        ret = k5c_send_frame(STDOUT_FILENO, buf, len);
+        if (ret != EOK) {
+            break;
+        }
+
+        talloc_free(kr);
+    }
+
+    talloc_free(kr);
+    talloc_zfree(k5c_fast_cache.ccname);
+    krb5_free_context(k5c_persistent_ctx);
+    k5c_persistent_ctx = NULL;
+    return ret;
+}
+
 int main(int argc, const char *argv[])
 {
     struct krb5_req *kr = NULL;
@@ -2102,61 +2407,19 @@ int main(int argc, const char *argv[])
 
     DEBUG(SSSDBG_TRACE_FUNC, ("krb5_child started.\n"));
 
-    ret = k5c_recv_data(kr, STDIN_FILENO, &offline);
-    if (ret != EOK) {
+    if (getenv(SSSD_KRB5_CHILD_PERSISTENT) != NULL) {
+        ret = k5c_persistent_loop();
         goto done;
     }
 
-    close(STDIN_FILENO);
-
-    ret = k5c_setup(kr, offline);
+    ret = k5c_recv_data(kr, STDIN_FILENO, &offline);
     if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("krb5_child_setup failed.\n"));
         goto done;
     }
 
-    switch(kr->pd->cmd) {
-    case SSS_PAM_AUTHENTICATE:
-        /* If we are offline, we need to create an empty ccache file */
-        if (offline) {
-            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform offline auth\n"));
-            ret = create_empty_ccache(kr);
-        } else {
-            DEBUG(SSSDBG_TRACE_FUNC, ("Will perform online auth\n"));
-            ret = tgt_req_child(kr);
-        }
-        break;
-    case SSS_PAM_CHAUTHTOK:
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change\n"));
-        ret = changepw_child(kr, false);
-        break;
-    case SSS_PAM_CHAUTHTOK_PRELIM:
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform password change checks\n"));
-        ret = changepw_child(kr, true);
-        break;
-    case SSS_PAM_ACCT_MGMT:
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform account management\n"));
-        ret = kuserok_child(kr);
-        break;
-    case SSS_CMD_RENEW:
-        if (offline) {
-            DEBUG(SSSDBG_CRIT_FAILURE, ("Cannot renew TGT while offline\n"));
-            ret = KRB5_KDC_UNREACH;
-            goto done;
-        }
-        DEBUG(SSSDBG_TRACE_FUNC, ("Will perform ticket renewal\n"));
-        ret = renew_tgt_child(kr);
-        break;
-    default:
-        DEBUG(1, ("PAM command [%d] not supported.\n", kr->pd->cmd));
-        ret = EINVAL;
-        goto done;
-    }
+    close(STDIN_FILENO);
 
-    ret = k5c_send_data(kr, STDOUT_FILENO, ret);
-    if (ret != EOK) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to send reply\n"));
-    }
+    ret = k5c_handle_request(kr, offline, STDOUT_FILENO);
 
 done:
     krb5_cleanup(kr);
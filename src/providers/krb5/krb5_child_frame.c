@@ -0,0 +1,103 @@
+/*
+    SSSD
+
+    Kerberos 5 Backend Module -- framing of the requests and replies of a
+    persistent krb5_child
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "util/child_common.h"
+#include "providers/krb5/krb5_auth.h"
+
+/* A frame sent by the backend to a persistent krb5_child:
+ * uint32_t length of the rest of the frame
+ * uint32_t whether the request must be handled with the privileges of
+ *          the user
+ * uint8_t[] the same data a krb5_child started for a single request reads
+ *
+ * The reply is framed with a uint32_t length only. Returns ENOENT if the
+ * backend closed the pipe. */
+errno_t k5c_recv_frame(TALLOC_CTX *mem_ctx, int fd,
+                       uint8_t **_buf, size_t *_len,
+                       bool *_run_as_user)
+{
+    uint32_t header[2];
+    uint8_t *buf;
+    ssize_t len;
+    errno_t ret;
+
+    errno = 0;
+    len = sss_atomic_read_s(fd, header, sizeof(header));
+    if (len == 0) {
+        return ENOENT;
+    } else if (len != sizeof(header)) {
+        ret = len == -1 ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("read failed [%d][%s].\n", ret, strerror(ret)));
+        return ret;
+    }
+
+    if (header[0] < sizeof(uint32_t)
+            || header[0] - sizeof(uint32_t) > IN_BUF_SIZE) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Invalid frame length [%u].\n",
+                                    header[0]));
+        return EINVAL;
+    }
+
+    buf = talloc_size(mem_ctx, header[0] - sizeof(uint32_t));
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    errno = 0;
+    len = sss_atomic_read_s(fd, buf, header[0] - sizeof(uint32_t));
+    if (len != header[0] - sizeof(uint32_t)) {
+        ret = len == -1 ? errno : EIO;
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("read failed [%d][%s].\n", ret, strerror(ret)));
+        talloc_free(buf);
+        return ret;
+    }
+
+    *_buf = buf;
+    *_len = len;
+    *_run_as_user = header[1] != 0;
+    return EOK;
+}
+
+errno_t k5c_send_frame(int fd, uint8_t *buf, size_t len)
+{
+    uint32_t frame_len = len;
+    ssize_t written;
+    errno_t ret;
+
+    errno = 0;
+    written = sss_atomic_write_s(fd, &frame_len, sizeof(frame_len));
+    if (written == sizeof(frame_len) && len > 0) {
+        errno = 0;
+        written = sss_atomic_write_s(fd, buf, len);
+        if (written == len) {
+            return EOK;
+        }
+    } else if (written == sizeof(frame_len)) {
+        return EOK;
+    }
+
+    ret = written == -1 ? errno : EIO;
+    DEBUG(SSSDBG_CRIT_FAILURE, ("write failed [%d][%s].\n",
+                                ret, strerror(ret)));
+    return ret;
+}
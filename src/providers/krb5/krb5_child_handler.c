@@ -24,6 +24,7 @@
 
 #include "util/util.h"
 #include "util/child_common.h"
+#include "util/dlinklist.h"
 #include "providers/krb5/krb5_common.h"
 #include "providers/krb5/krb5_auth.h"
 #include "src/providers/krb5/krb5_utils.h"
@@ -38,6 +39,9 @@
 
 #define KRB5_CHILD KRB5_CHILD_DIR"/krb5_child"
 
+/* Replies of krb5_child are small, anything bigger is a broken child */
+#define KRB5_CHILD_MAX_FRAME (1024*1024)
+
 #define TIME_T_MAX LONG_MAX
 #define int64_to_time_t(val) ((time_t)((val) < TIME_T_MAX ? val : TIME_T_MAX))
 
@@ -56,6 +60,50 @@ struct handle_child_state {
     pid_t child_pid;
 
     struct io *io;
+
+    /* only used if the request is handled by a persistent krb5_child */
+    struct krb5_child_worker *worker;
+    struct krb5_child_waiter *waiter;
+    struct tevent_req *subreq;
+    uint8_t *frame;
+    size_t frame_len;
+};
+
+struct krb5_child_worker {
+    struct krb5_child_worker *prev;
+    struct krb5_child_worker *next;
+
+    struct krb5_child_pool *pool;
+    pid_t pid;
+    struct io *io;
+    struct tevent_req *req;     /* NULL if the worker is idle */
+};
+
+struct krb5_child_waiter {
+    struct krb5_child_waiter *prev;
+    struct krb5_child_waiter *next;
+
+    struct krb5_child_pool *pool;
+    struct tevent_req *req;
+};
+
+/* Persistent krb5_child processes serving one request at a time. Requests
+ * that arrive while all of them are busy wait in order of arrival. */
+struct krb5_child_pool {
+    struct krb5_ctx *krb5_ctx;
+    struct tevent_context *ev;
+
+    struct krb5_child_worker *idle;
+    struct krb5_child_worker *busy;
+    size_t num_workers;
+    size_t max_workers;
+
+    struct krb5_child_waiter *waiting;
+};
+
+struct krb5_child_exit_watch {
+    struct krb5_child_pool *pool;
+    pid_t pid;
 };
 
 static int child_io_destructor(void *ptr)
@@ -220,6 +268,8 @@ static errno_t create_send_buffer(struct krb5child_req *kr,
 }
 
 
+static void krb5_child_worker_discard(struct krb5_child_worker *worker);
+
 static void krb5_child_timeout(struct tevent_context *ev,
                                struct tevent_timer *te,
                                struct timeval tv, void *pvt)
@@ -235,6 +285,15 @@ static void krb5_child_timeout(struct tevent_context *ev,
 
     DEBUG(9, ("timeout for child [%d] reached.\n", state->child_pid));
 
+    if (state->worker != NULL) {
+        /* the worker is in an unknown state, do not reuse it */
+        talloc_zfree(state->subreq);
+        krb5_child_worker_discard(state->worker);
+        state->worker = NULL;
+        tevent_req_error(req, ETIMEDOUT);
+        return;
+    }
+
     ret = kill(state->child_pid, SIGKILL);
     if (ret == -1) {
         DEBUG(1, ("kill failed [%d][%s].\n", errno, strerror(errno)));
@@ -335,6 +394,514 @@ static errno_t fork_child(struct tevent_req *req)
     return EOK;
 }
 
+/* Reading the reply of a persistent krb5_child, the pipe stays open so the
+ * reply is prefixed with its length instead of being terminated by EOF */
+
+struct read_frame_state {
+    int fd;
+    uint32_t header;
+    size_t header_read;
+    uint8_t *buf;
+    size_t len;
+};
+
+static void read_frame_handler(struct tevent_context *ev,
+                               struct tevent_fd *fde,
+                               uint16_t flags, void *pvt);
+
+static struct tevent_req *read_frame_send(TALLOC_CTX *mem_ctx,
+                                          struct tevent_context *ev, int fd)
+{
+    struct tevent_req *req;
+    struct read_frame_state *state;
+    struct tevent_fd *fde;
+
+    req = tevent_req_create(mem_ctx, &state, struct read_frame_state);
+    if (req == NULL) return NULL;
+
+    state->fd = fd;
+
+    fde = tevent_add_fd(ev, state, fd, TEVENT_FD_READ,
+                        read_frame_handler, req);
+    if (fde == NULL) {
+        DEBUG(1, ("tevent_add_fd failed.\n"));
+        talloc_zfree(req);
+        return NULL;
+    }
+
+    return req;
+}
+
+static void read_frame_handler(struct tevent_context *ev,
+                               struct tevent_fd *fde,
+                               uint16_t flags, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct read_frame_state *state = tevent_req_data(req,
+                                                   struct read_frame_state);
+    uint8_t *dest;
+    size_t want;
+    ssize_t size;
+    errno_t err;
+
+    if (state->header_read < sizeof(state->header)) {
+        dest = (uint8_t *) &state->header + state->header_read;
+        want = sizeof(state->header) - state->header_read;
+    } else {
+        dest = state->buf + state->len;
+        want = state->header - state->len;
+    }
+
+    size = read(state->fd, dest, want);
+    if (size == -1) {
+        err = errno;
+        if (err == EAGAIN || err == EINTR) return;
+
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("read failed [%d][%s].\n", err, strerror(err)));
+        tevent_req_error(req, err);
+        return;
+    } else if (size == 0) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("krb5_child closed the pipe.\n"));
+        tevent_req_error(req, EPIPE);
+        return;
+    }
+
+    if (state->header_read < sizeof(state->header)) {
+        state->header_read += size;
+        if (state->header_read < sizeof(state->header)) return;
+
+        if (state->header > KRB5_CHILD_MAX_FRAME) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Reply of krb5_child too large "
+                                        "[%u].\n", state->header));
+            tevent_req_error(req, EINVAL);
+            return;
+        }
+
+        state->buf = talloc_size(state, state->header);
+        if (state->buf == NULL) {
+            tevent_req_error(req, ENOMEM);
+            return;
+        }
+    } else {
+        state->len += size;
+    }
+
+    if (state->len == state->header) {
+        tevent_req_done(req);
+    }
+}
+
+static int read_frame_recv(struct tevent_req *req, TALLOC_CTX *mem_ctx,
+                           uint8_t **buf, ssize_t *len)
+{
+    struct read_frame_state *state = tevent_req_data(req,
+                                                   struct read_frame_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    *buf = talloc_steal(mem_ctx, state->buf);
+    *len = state->len;
+
+    return EOK;
+}
+
+static void krb5_child_worker_exited(int child_status,
+                                     struct tevent_signal *sige,
+                                     void *pvt)
+{
+    struct krb5_child_exit_watch *watch;
+    struct krb5_child_worker *worker;
+
+    watch = talloc_get_type(pvt, struct krb5_child_exit_watch);
+
+    DLIST_FOR_EACH(worker, watch->pool->idle) {
+        if (worker->pid == watch->pid) break;
+    }
+    if (worker == NULL) {
+        DLIST_FOR_EACH(worker, watch->pool->busy) {
+            if (worker->pid == watch->pid) break;
+        }
+    }
+
+    if (worker != NULL) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Persistent krb5_child [%d] exited.\n",
+                                     worker->pid));
+        /* a busy worker is discarded when reading the reply fails */
+        if (worker->req == NULL) {
+            krb5_child_worker_discard(worker);
+        }
+    }
+
+    talloc_free(watch);
+}
+
+static errno_t krb5_child_worker_spawn(struct krb5_child_pool *pool,
+                                       struct krb5_child_worker **_worker)
+{
+    struct krb5_child_worker *worker;
+    struct krb5_child_exit_watch *watch;
+    int pipefd_to_child[2];
+    int pipefd_from_child[2];
+    pid_t pid;
+    int ret;
+    errno_t err;
+
+    ret = pipe(pipefd_from_child);
+    if (ret == -1) {
+        err = errno;
+        DEBUG(1, ("pipe failed [%d][%s].\n", errno, strerror(errno)));
+        return err;
+    }
+    ret = pipe(pipefd_to_child);
+    if (ret == -1) {
+        err = errno;
+        DEBUG(1, ("pipe failed [%d][%s].\n", errno, strerror(errno)));
+        close(pipefd_from_child[0]);
+        close(pipefd_from_child[1]);
+        return err;
+    }
+
+    pid = fork();
+
+    if (pid == 0) { /* child */
+        /* The worker forks a copy of itself for every request, in its own
+         * process group they can all be killed together */
+        ret = setpgid(0, 0);
+        if (ret == -1) {
+            DEBUG(1, ("setpgid failed.\n"));
+            _exit(-1);
+        }
+
+        /* The worker keeps its privileges, it switches to the user in a
+         * separate process for every request */
+        ret = setenv(SSSD_KRB5_CHILD_PERSISTENT, "1", 1);
+        if (ret == -1) {
+            DEBUG(1, ("setenv failed.\n"));
+            _exit(-1);
+        }
+
+        err = exec_child(pool, pipefd_to_child, pipefd_from_child,
+                         KRB5_CHILD, pool->krb5_ctx->child_debug_fd);
+        DEBUG(1, ("Could not exec KRB5 child: [%d][%s].\n",
+                  err, strerror(err)));
+        _exit(-1);
+    } else if (pid < 0) { /* error */
+        err = errno;
+        DEBUG(1, ("fork failed [%d][%s].\n", errno, strerror(errno)));
+        close(pipefd_from_child[0]);
+        close(pipefd_from_child[1]);
+        close(pipefd_to_child[0]);
+        close(pipefd_to_child[1]);
+        return err;
+    }
+
+    close(pipefd_from_child[1]);
+    close(pipefd_to_child[0]);
+
+    /* also set here, the worker could be discarded before it ran */
+    ret = setpgid(pid, pid);
+    if (ret == -1 && errno != EACCES) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("setpgid failed [%d][%s].\n",
+                                     errno, strerror(errno)));
+    }
+
+    worker = talloc_zero(pool, struct krb5_child_worker);
+    watch = talloc_zero(pool, struct krb5_child_exit_watch);
+    if (worker == NULL || watch == NULL
+            || (worker->io = talloc(worker, struct io)) == NULL) {
+        close(pipefd_from_child[0]);
+        close(pipefd_to_child[1]);
+        kill(pid, SIGKILL);
+        talloc_free(worker);
+        talloc_free(watch);
+        return ENOMEM;
+    }
+
+    worker->pool = pool;
+    worker->pid = pid;
+    worker->io->read_from_child_fd = pipefd_from_child[0];
+    worker->io->write_to_child_fd = pipefd_to_child[1];
+    talloc_set_destructor((void *) worker->io, child_io_destructor);
+    fd_nonblocking(worker->io->read_from_child_fd);
+    fd_nonblocking(worker->io->write_to_child_fd);
+
+    /* the watch outlives the worker so that an exit is noticed even after
+     * the worker was discarded */
+    watch->pool = pool;
+    watch->pid = pid;
+    ret = child_handler_setup(pool->ev, pid, krb5_child_worker_exited, watch);
+    if (ret != EOK) {
+        DEBUG(1, ("Could not set up child signal handler\n"));
+        kill(pid, SIGKILL);
+        talloc_free(worker);
+        talloc_free(watch);
+        return ret;
+    }
+
+    pool->num_workers++;
+    DEBUG(SSSDBG_TRACE_FUNC, ("Started persistent krb5_child [%d], "
+                              "%u of %u running.\n", pid,
+                              (unsigned int) pool->num_workers,
+                              (unsigned int) pool->max_workers));
+
+    *_worker = worker;
+    return EOK;
+}
+
+static void handle_child_pool_start(struct tevent_req *req,
+                                    struct krb5_child_worker *worker);
+
+/* Hand idle workers, or new ones if the pool is not full yet, to the
+ * waiting requests */
+static void krb5_child_pool_dispatch(struct krb5_child_pool *pool)
+{
+    struct krb5_child_worker *worker;
+    struct krb5_child_waiter *waiter;
+    struct tevent_req *req;
+    errno_t ret;
+
+    while (pool->waiting != NULL) {
+        waiter = pool->waiting;
+        req = waiter->req;
+
+        if (pool->idle != NULL) {
+            worker = pool->idle;
+            DLIST_REMOVE(pool->idle, worker);
+        } else if (pool->num_workers < pool->max_workers) {
+            ret = krb5_child_worker_spawn(pool, &worker);
+            if (ret != EOK) {
+                DLIST_REMOVE(pool->waiting, waiter);
+                waiter->pool = NULL;
+                tevent_req_error(req, ret);
+                continue;
+            }
+        } else {
+            return;
+        }
+
+        DLIST_REMOVE(pool->waiting, waiter);
+        waiter->pool = NULL;
+        handle_child_pool_start(req, worker);
+    }
+}
+
+/* A worker that exited stays a zombie until it is collected by the SIGCHLD
+ * handler, its pid can not be reused before. Checked without collecting it. */
+static bool krb5_child_worker_collected(struct krb5_child_worker *worker)
+{
+    siginfo_t info;
+    int ret;
+
+    memset(&info, 0, sizeof(info));
+    ret = waitid(P_PID, worker->pid, &info, WEXITED | WNOHANG | WNOWAIT);
+    return (ret == -1 && errno == ECHILD);
+}
+
+static void krb5_child_worker_discard(struct krb5_child_worker *worker)
+{
+    struct krb5_child_pool *pool = worker->pool;
+    int ret;
+
+    if (worker->req != NULL) {
+        DLIST_REMOVE(pool->busy, worker);
+    } else {
+        DLIST_REMOVE(pool->idle, worker);
+    }
+    pool->num_workers--;
+
+    /* Kill the copy handling the request as well. Once the worker was
+     * collected its pid may belong to another process group, the copy is
+     * killed by the kernel when the worker exits in that case. */
+    if (krb5_child_worker_collected(worker)) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("krb5_child [%d] already collected.\n",
+                                  worker->pid));
+    } else {
+        ret = kill(-worker->pid, SIGKILL);
+        if (ret == -1 && errno != ESRCH) {
+            DEBUG(1, ("kill failed [%d][%s].\n", errno, strerror(errno)));
+        }
+    }
+
+    talloc_free(worker);
+
+    krb5_child_pool_dispatch(pool);
+}
+
+static void krb5_child_worker_release(struct krb5_child_worker *worker)
+{
+    struct krb5_child_pool *pool = worker->pool;
+
+    DLIST_REMOVE(pool->busy, worker);
+    worker->req = NULL;
+    DLIST_ADD(pool->idle, worker);
+
+    krb5_child_pool_dispatch(pool);
+}
+
+static int krb5_child_waiter_destructor(struct krb5_child_waiter *waiter)
+{
+    if (waiter->pool != NULL) {
+        DLIST_REMOVE(waiter->pool->waiting, waiter);
+    }
+    return 0;
+}
+
+static int handle_child_pool_destructor(struct handle_child_state *state)
+{
+    /* The request went away while the worker was still busy with it, the
+     * reply would be read by the next request */
+    if (state->worker != NULL) {
+        talloc_zfree(state->subreq);
+        krb5_child_worker_discard(state->worker);
+        state->worker = NULL;
+    }
+    return 0;
+}
+
+static errno_t krb5_child_pool_init(struct krb5_ctx *krb5_ctx,
+                                    struct tevent_context *ev,
+                                    int pool_size)
+{
+    struct krb5_child_pool *pool;
+
+    pool = talloc_zero(krb5_ctx, struct krb5_child_pool);
+    if (pool == NULL) {
+        return ENOMEM;
+    }
+
+    pool->krb5_ctx = krb5_ctx;
+    pool->ev = ev;
+    pool->max_workers = pool_size;
+
+    krb5_ctx->child_pool = pool;
+    return EOK;
+}
+
+/* Queue the request for a persistent krb5_child */
+static errno_t handle_child_pool_queue(struct tevent_req *req,
+                                       struct io_buffer *buf)
+{
+    struct handle_child_state *state = tevent_req_data(req,
+                                                     struct handle_child_state);
+    struct krb5_child_pool *pool = state->kr->krb5_ctx->child_pool;
+    uint32_t run_as_user;
+    size_t rp = 0;
+
+    run_as_user = state->kr->run_as_user ? 1 : 0;
+
+    state->frame_len = 2*sizeof(uint32_t) + buf->size;
+    state->frame = talloc_size(state, state->frame_len);
+    if (state->frame == NULL) {
+        return ENOMEM;
+    }
+    SAFEALIGN_SET_UINT32(&state->frame[rp],
+                         state->frame_len - sizeof(uint32_t), &rp);
+    SAFEALIGN_COPY_UINT32(&state->frame[rp], &run_as_user, &rp);
+    safealign_memcpy(&state->frame[rp], buf->data, buf->size, &rp);
+
+    state->waiter = talloc_zero(state, struct krb5_child_waiter);
+    if (state->waiter == NULL) {
+        return ENOMEM;
+    }
+    state->waiter->req = req;
+    state->waiter->pool = pool;
+    talloc_set_destructor(state->waiter, krb5_child_waiter_destructor);
+    talloc_set_destructor(state, handle_child_pool_destructor);
+
+    DLIST_ADD_END(pool->waiting, state->waiter, struct krb5_child_waiter *);
+
+    return EOK;
+}
+
+static void handle_child_pool_step(struct tevent_req *subreq);
+static void handle_child_pool_done(struct tevent_req *subreq);
+
+static void handle_child_pool_start(struct tevent_req *req,
+                                    struct krb5_child_worker *worker)
+{
+    struct handle_child_state *state = tevent_req_data(req,
+                                                     struct handle_child_state);
+    errno_t ret;
+
+    worker->req = req;
+    DLIST_ADD(worker->pool->busy, worker);
+    state->worker = worker;
+    state->child_pid = worker->pid;
+
+    ret = activate_child_timeout_handler(req, state->ev,
+                  dp_opt_get_int(state->kr->krb5_ctx->opts, KRB5_AUTH_TIMEOUT));
+    if (ret != EOK) {
+        DEBUG(1, ("activate_child_timeout_handler failed.\n"));
+    }
+
+    state->subreq = write_pipe_send(state, state->ev,
+                                    state->frame, state->frame_len,
+                                    worker->io->write_to_child_fd);
+    if (state->subreq == NULL) {
+        state->worker = NULL;
+        krb5_child_worker_release(worker);
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(state->subreq, handle_child_pool_step, req);
+}
+
+static void handle_child_pool_step(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct handle_child_state *state = tevent_req_data(req,
+                                                    struct handle_child_state);
+    int ret;
+
+    ret = write_pipe_recv(subreq);
+    talloc_zfree(subreq);
+    state->subreq = NULL;
+    if (ret != EOK) {
+        krb5_child_worker_discard(state->worker);
+        state->worker = NULL;
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    state->subreq = read_frame_send(state, state->ev,
+                                    state->worker->io->read_from_child_fd);
+    if (state->subreq == NULL) {
+        krb5_child_worker_discard(state->worker);
+        state->worker = NULL;
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(state->subreq, handle_child_pool_done, req);
+}
+
+static void handle_child_pool_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct handle_child_state *state = tevent_req_data(req,
+                                                    struct handle_child_state);
+    struct krb5_child_worker *worker = state->worker;
+    int ret;
+
+    talloc_zfree(state->timeout_handler);
+
+    ret = read_frame_recv(subreq, state, &state->buf, &state->len);
+    talloc_zfree(subreq);
+    state->subreq = NULL;
+    state->worker = NULL;
+    if (ret != EOK) {
+        krb5_child_worker_discard(worker);
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    krb5_child_worker_release(worker);
+
+    tevent_req_done(req);
+}
+
 static void handle_child_step(struct tevent_req *subreq);
 static void handle_child_done(struct tevent_req *subreq);
 
@@ -345,6 +912,7 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
     struct tevent_req *req, *subreq;
     struct handle_child_state *state;
     int ret;
+    int pool_size;
     struct io_buffer *buf = NULL;
 
     req = tevent_req_create(mem_ctx, &state, struct handle_child_state);
@@ -375,6 +943,30 @@ struct tevent_req *handle_child_send(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    pool_size = dp_opt_get_int(kr->krb5_ctx->opts, KRB5_CHILD_POOL_SIZE);
+    if (pool_size > 0) {
+        if (kr->krb5_ctx->child_pool == NULL) {
+            ret = krb5_child_pool_init(kr->krb5_ctx, ev, pool_size);
+            if (ret != EOK) {
+                DEBUG(1, ("krb5_child_pool_init failed.\n"));
+                goto fail;
+            }
+        }
+
+        ret = handle_child_pool_queue(req, buf);
+        if (ret != EOK) {
+            DEBUG(1, ("handle_child_pool_queue failed.\n"));
+            goto fail;
+        }
+
+        krb5_child_pool_dispatch(kr->krb5_ctx->child_pool);
+        if (!tevent_req_is_in_progress(req)) {
+            /* failed before the caller could set the callback */
+            tevent_req_post(req, ev);
+        }
+        return req;
+    }
+
     ret = fork_child(req);
     if (ret != EOK) {
         DEBUG(1, ("fork_child failed.\n"));
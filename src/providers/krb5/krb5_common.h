@@ -40,6 +40,7 @@
 #define SSSD_KRB5_USE_FAST "SSSD_KRB5_USE_FAST"
 #define SSSD_KRB5_FAST_PRINCIPAL "SSSD_KRB5_FAST_PRINCIPAL"
 #define SSSD_KRB5_CANONICALIZE "SSSD_KRB5_CANONICALIZE"
+#define SSSD_KRB5_CHILD_PERSISTENT "SSSD_KRB5_CHILD_PERSISTENT"
 
 #define KDCINFO_TMPL PUBCONF_PATH"/kdcinfo.%s"
 #define KPASSWDINFO_TMPL PUBCONF_PATH"/kpasswdinfo.%s"
@@ -65,6 +66,7 @@ enum krb5_opts {
     KRB5_USE_FAST,
     KRB5_FAST_PRINCIPAL,
     KRB5_CANONICALIZE,
+    KRB5_CHILD_POOL_SIZE,
 
     KRB5_OPTS
 };
@@ -87,6 +89,7 @@ struct fo_service;
 struct deferred_auth_ctx;
 struct renew_tgt_ctx;
 struct sss_krb5_cc_be;
+struct krb5_child_pool;
 
 struct krb5_ctx {
     /* opts taken from kinit */
@@ -126,6 +129,9 @@ struct krb5_ctx {
     bool use_fast;
 
     hash_table_t *wait_queue_hash;
+
+    /* persistent krb5_child processes, NULL if krb5_child_pool_size is 0 */
+    struct krb5_child_pool *child_pool;
 };
 
 struct remove_info_files_ctx {
@@ -87,6 +87,10 @@ void sdap_account_info_handler(struct be_req *breq);
 void sdap_handle_account_info(struct be_req *breq, struct sdap_id_ctx *ctx);
 int sdap_id_setup_tasks(struct sdap_id_ctx *ctx);
 
+/* refresh of frequently used entries */
+void sdap_refresh_hot_handler(struct be_req *breq);
+void sdap_handle_refresh_hot(struct be_req *breq, struct sdap_id_ctx *ctx);
+
 /* auth */
 void sdap_pam_auth_handler(struct be_req *breq);
 
@@ -46,13 +46,14 @@ static void ldap_id_enumerate_timeout(struct tevent_context *ev,
                                       struct tevent_timer *te,
                                       struct timeval tv, void *pvt);
 
+static void ldap_id_enumerate_start(struct tevent_req *slot);
+
 static void ldap_id_enumerate_timer(struct tevent_context *ev,
                                     struct tevent_timer *tt,
                                     struct timeval tv, void *pvt)
 {
     struct sdap_id_ctx *ctx = talloc_get_type(pvt, struct sdap_id_ctx);
-    struct tevent_timer *timeout;
-    struct tevent_req *req;
+    struct tevent_req *slot;
     int delay;
     errno_t ret;
 
@@ -65,8 +66,49 @@ static void ldap_id_enumerate_timer(struct tevent_context *ev,
         return;
     }
 
-    req = ldap_id_enumerate_send(ev, ctx);
+    /* the enumeration waits for the queued PAM and identity requests */
+    slot = be_sched_slot_send(ctx, ctx->be, BE_REQ_CLASS_BACKGROUND);
+    if (!slot) {
+        DEBUG(1, ("Failed to schedule enumeration, retrying later!\n"));
+        /* schedule starting from now, not the last run */
+        delay = dp_opt_get_int(ctx->opts->basic, SDAP_ENUM_REFRESH_TIMEOUT);
+        tv = tevent_timeval_current_ofs(delay, 0);
+        ret = ldap_id_enumerate_set_timer(ctx, tv);
+        if (ret != EOK) {
+            DEBUG(1, ("Error setting up enumerate timer\n"));
+        }
+        return;
+    }
+    tevent_req_set_callback(slot, ldap_id_enumerate_start, ctx);
+}
+
+static void ldap_id_enumerate_start(struct tevent_req *slot)
+{
+    struct sdap_id_ctx *ctx = tevent_req_callback_data(slot,
+                                                       struct sdap_id_ctx);
+    struct tevent_timer *timeout;
+    struct tevent_req *req;
+    struct timeval tv;
+    int delay;
+    errno_t ret;
+
+    ret = be_sched_slot_recv(slot);
+    if (ret != EOK) {
+        talloc_zfree(slot);
+        DEBUG(1, ("Failed to schedule enumeration, retrying later!\n"));
+        /* schedule starting from now, not the last run */
+        delay = dp_opt_get_int(ctx->opts->basic, SDAP_ENUM_REFRESH_TIMEOUT);
+        tv = tevent_timeval_current_ofs(delay, 0);
+        ret = ldap_id_enumerate_set_timer(ctx, tv);
+        if (ret != EOK) {
+            DEBUG(1, ("Error setting up enumerate timer\n"));
+        }
+        return;
+    }
+
+    req = ldap_id_enumerate_send(ctx->be->ev, ctx);
     if (!req) {
+        talloc_zfree(slot);
         DEBUG(1, ("Failed to schedule enumeration, retrying later!\n"));
         /* schedule starting from now, not the last run */
         delay = dp_opt_get_int(ctx->opts->basic, SDAP_ENUM_REFRESH_TIMEOUT);
@@ -79,6 +121,9 @@ static void ldap_id_enumerate_timer(struct tevent_context *ev,
     }
     tevent_req_set_callback(req, ldap_id_enumerate_reschedule, ctx);
 
+    /* other background work may start once the enumeration is freed */
+    talloc_steal(req, slot);
+
     /* if enumeration takes so long, either we try to enumerate too
      * frequently, or something went seriously wrong */
     delay = dp_opt_get_int(ctx->opts->basic, SDAP_ENUM_REFRESH_TIMEOUT);
@@ -183,6 +228,9 @@ struct global_enum_state {
     struct sdap_id_op *op;
 
     bool purge;
+
+    /* only set for full enumerations, see ldap_id_enum_bulk_start() */
+    struct sysdb_bulk *bulk;
 };
 
 static struct tevent_req *enum_users_send(TALLOC_CTX *memctx,
@@ -218,6 +266,7 @@ struct tevent_req *ldap_id_enumerate_send(struct tevent_context *ev,
         talloc_zfree(req);
         return NULL;
     }
+    sdap_id_op_set_bulk(state->op, true);
 
     ctx->last_enum = tevent_timeval_current();
 
@@ -254,6 +303,49 @@ static int ldap_id_enumerate_retry(struct tevent_req *req)
     return EOK;
 }
 
+/* A full enumeration stores every user and group, so the memberships are
+ * computed once at the end instead of each time an entry is stored.
+ * Incremental enumerations only store the few entries that changed. */
+static void ldap_id_enum_bulk_start(struct global_enum_state *state)
+{
+    struct sdap_server_opts *srv_opts = state->ctx->srv_opts;
+    errno_t ret;
+
+    if (state->bulk) {
+        /* retrying after a connection failure */
+        return;
+    }
+
+    if (!state->purge && srv_opts
+            && srv_opts->max_user_value && srv_opts->max_group_value) {
+        return;
+    }
+
+    ret = sysdb_bulk_start(state, state->ctx->be->domain->sysdb,
+                           &state->bulk);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unable to start bulk session, entries will be stored one "
+               "by one [%d]: %s\n", ret, strerror(ret)));
+        state->bulk = NULL;
+    }
+}
+
+static void ldap_id_enum_bulk_finish(struct global_enum_state *state)
+{
+    errno_t ret;
+
+    if (!state->bulk) return;
+
+    ret = sysdb_bulk_finish(state->bulk);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Unable to compute group memberships [%d]: %s\n",
+               ret, strerror(ret)));
+    }
+    talloc_zfree(state->bulk);
+}
+
 static void ldap_id_enumerate_connect_done(struct tevent_req *subreq)
 {
     struct tevent_req *req = tevent_req_callback_data(subreq,
@@ -276,6 +368,8 @@ static void ldap_id_enumerate_connect_done(struct tevent_req *subreq)
         return;
     }
 
+    ldap_id_enum_bulk_start(state);
+
     subreq = enum_users_send(state, state->ev,
                              state->ctx, state->op,
                              state->purge);
@@ -388,6 +482,9 @@ static void ldap_id_enum_groups_done(struct tevent_req *subreq)
         }
     }
 
+    /* users and groups are stored, services do not need the session */
+    ldap_id_enum_bulk_finish(state);
+
     subreq = enum_services_send(state, state->ev, state->ctx,
                                 state->op, state->purge);
     if (!subreq) {
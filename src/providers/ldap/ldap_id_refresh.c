@@ -0,0 +1,457 @@
+/*
+    SSSD
+
+    LDAP Identity Backend Module - refresh of frequently used entries
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+
+#include "util/util.h"
+#include "db/sysdb.h"
+#include "providers/ldap/ldap_common.h"
+#include "providers/ldap/sdap_async.h"
+
+/* Number of names looked up with a single search. Groups are always
+ * refreshed one at a time, because a group search that returns more than
+ * one entry does not resolve nested members. */
+#define SDAP_REFRESH_BATCH 50
+
+struct sdap_refresh_hot_state {
+    struct tevent_context *ev;
+    struct sdap_id_ctx *ctx;
+    struct sdap_id_op *op;
+    struct sysdb_ctx *sysdb;
+    struct sss_domain_info *domain;
+
+    int entry_type;
+    char **names;
+    size_t num_names;
+    size_t next;
+    size_t batch;
+
+    char *filter;
+    const char **attrs;
+
+    int dp_error;
+};
+
+static errno_t sdap_refresh_hot_next(struct tevent_req *req);
+static int sdap_refresh_hot_retry(struct tevent_req *req);
+static void sdap_refresh_hot_connect_done(struct tevent_req *subreq);
+static void sdap_refresh_hot_done(struct tevent_req *subreq);
+
+struct tevent_req *sdap_refresh_hot_send(TALLOC_CTX *memctx,
+                                         struct tevent_context *ev,
+                                         struct sdap_id_ctx *ctx,
+                                         int entry_type,
+                                         char **names,
+                                         size_t num_names)
+{
+    struct tevent_req *req;
+    struct sdap_refresh_hot_state *state;
+    const char *member_filter[2];
+    int ret;
+
+    req = tevent_req_create(memctx, &state, struct sdap_refresh_hot_state);
+    if (!req) return NULL;
+
+    state->ev = ev;
+    state->ctx = ctx;
+    state->dp_error = DP_ERR_FATAL;
+    state->sysdb = ctx->be->domain->sysdb;
+    state->domain = ctx->be->domain;
+    state->entry_type = entry_type;
+    state->names = names;
+    state->num_names = num_names;
+
+    state->op = sdap_id_op_create(state, state->ctx->conn_cache);
+    if (!state->op) {
+        DEBUG(2, ("sdap_id_op_create failed\n"));
+        ret = ENOMEM;
+        goto fail;
+    }
+    /* keep the refresh away from interactive lookups */
+    sdap_id_op_set_bulk(state->op, true);
+
+    switch (entry_type) {
+    case BE_REQ_USER:
+        state->batch = SDAP_REFRESH_BATCH;
+        ret = build_attrs_from_map(state, ctx->opts->user_map, SDAP_OPTS_USER,
+                                   NULL, &state->attrs, NULL);
+        break;
+    case BE_REQ_GROUP:
+        state->batch = 1;
+        member_filter[0] = ctx->opts->group_map[SDAP_AT_GROUP_MEMBER].name;
+        member_filter[1] = NULL;
+        ret = build_attrs_from_map(state, ctx->opts->group_map,
+                                   SDAP_OPTS_GROUP,
+                                   state->domain->ignore_group_members ?
+                                       member_filter : NULL,
+                                   &state->attrs, NULL);
+        break;
+    case BE_REQ_NETGROUP:
+        state->batch = SDAP_REFRESH_BATCH;
+        ret = build_attrs_from_map(state, ctx->opts->netgroup_map,
+                                   SDAP_OPTS_NETGROUP,
+                                   NULL, &state->attrs, NULL);
+        break;
+    default:
+        ret = EINVAL;
+        break;
+    }
+    if (ret != EOK) goto fail;
+
+    ret = sdap_refresh_hot_next(req);
+    if (ret == EOK) {
+        /* nothing to refresh */
+        state->dp_error = DP_ERR_OK;
+        tevent_req_done(req);
+        tevent_req_post(req, ev);
+    } else if (ret != EAGAIN) {
+        goto fail;
+    }
+
+    return req;
+
+fail:
+    tevent_req_error(req, ret);
+    tevent_req_post(req, ev);
+    return req;
+}
+
+/* Builds (|(attr=name1)(attr=name2)...) for the next batch of names */
+static errno_t sdap_refresh_hot_names(TALLOC_CTX *mem_ctx,
+                                      struct sdap_refresh_hot_state *state,
+                                      const char *attr_name,
+                                      char **_filter)
+{
+    char *clean_name;
+    char *filter;
+    size_t i;
+    errno_t ret;
+
+    filter = talloc_strdup(mem_ctx, "(|");
+    if (!filter) return ENOMEM;
+
+    for (i = state->next;
+         i < state->num_names && i < state->next + state->batch; i++) {
+        ret = sss_filter_sanitize(mem_ctx, state->names[i], &clean_name);
+        if (ret != EOK) {
+            talloc_free(filter);
+            return ret;
+        }
+
+        filter = talloc_asprintf_append_buffer(filter, "(%s=%s)",
+                                               attr_name, clean_name);
+        talloc_free(clean_name);
+        if (!filter) return ENOMEM;
+    }
+
+    filter = talloc_asprintf_append_buffer(filter, ")");
+    if (!filter) return ENOMEM;
+
+    *_filter = filter;
+    return EOK;
+}
+
+/* Returns EAGAIN if a search for the next batch was started and EOK if all
+ * names were refreshed */
+static errno_t sdap_refresh_hot_next(struct tevent_req *req)
+{
+    struct sdap_refresh_hot_state *state = tevent_req_data(req,
+                                            struct sdap_refresh_hot_state);
+    struct sdap_options *opts = state->ctx->opts;
+    char *names;
+    errno_t ret;
+
+    if (state->next >= state->num_names) {
+        return EOK;
+    }
+
+    talloc_zfree(state->filter);
+
+    switch (state->entry_type) {
+    case BE_REQ_USER:
+        ret = sdap_refresh_hot_names(state, state,
+                                     opts->user_map[SDAP_AT_USER_NAME].name,
+                                     &names);
+        if (ret != EOK) return ret;
+
+        state->filter = talloc_asprintf(state, "(&%s(objectclass=%s))",
+                                        names,
+                                        opts->user_map[SDAP_OC_USER].name);
+        break;
+    case BE_REQ_GROUP:
+        ret = sdap_refresh_hot_names(state, state,
+                                     opts->group_map[SDAP_AT_GROUP_NAME].name,
+                                     &names);
+        if (ret != EOK) return ret;
+
+        /* same conditions as a lookup by name */
+        if (dp_opt_get_bool(opts->basic, SDAP_ID_MAPPING)) {
+            state->filter = talloc_asprintf(state,
+                                    "(&%s(objectclass=%s)(%s=*))",
+                                    names,
+                                    opts->group_map[SDAP_OC_GROUP].name,
+                                    opts->group_map[SDAP_AT_GROUP_NAME].name);
+        } else {
+            state->filter = talloc_asprintf(state,
+                                    "(&%s(objectclass=%s)(%s=*)(&(%s=*)(!(%s=0))))",
+                                    names,
+                                    opts->group_map[SDAP_OC_GROUP].name,
+                                    opts->group_map[SDAP_AT_GROUP_NAME].name,
+                                    opts->group_map[SDAP_AT_GROUP_GID].name,
+                                    opts->group_map[SDAP_AT_GROUP_GID].name);
+        }
+        break;
+    case BE_REQ_NETGROUP:
+        ret = sdap_refresh_hot_names(state, state,
+                                opts->netgroup_map[SDAP_AT_NETGROUP_NAME].name,
+                                &names);
+        if (ret != EOK) return ret;
+
+        state->filter = talloc_asprintf(state, "(&%s(objectclass=%s))",
+                                    names,
+                                    opts->netgroup_map[SDAP_OC_NETGROUP].name);
+        break;
+    default:
+        return EINVAL;
+    }
+
+    talloc_free(names);
+    if (!state->filter) {
+        DEBUG(2, ("Failed to build the refresh filter\n"));
+        return ENOMEM;
+    }
+
+    ret = sdap_refresh_hot_retry(req);
+    if (ret != EOK) return ret;
+
+    return EAGAIN;
+}
+
+static int sdap_refresh_hot_retry(struct tevent_req *req)
+{
+    struct sdap_refresh_hot_state *state = tevent_req_data(req,
+                                            struct sdap_refresh_hot_state);
+    struct tevent_req *subreq;
+    int ret = EOK;
+
+    subreq = sdap_id_op_connect_send(state->op, state, &ret);
+    if (!subreq) {
+        return ret;
+    }
+
+    tevent_req_set_callback(subreq, sdap_refresh_hot_connect_done, req);
+    return EOK;
+}
+
+static void sdap_refresh_hot_connect_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_refresh_hot_state *state = tevent_req_data(req,
+                                            struct sdap_refresh_hot_state);
+    int timeout;
+    int dp_error = DP_ERR_FATAL;
+    int ret;
+
+    ret = sdap_id_op_connect_recv(subreq, &dp_error);
+    talloc_zfree(subreq);
+
+    if (ret != EOK) {
+        state->dp_error = dp_error;
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    timeout = dp_opt_get_int(state->ctx->opts->basic, SDAP_SEARCH_TIMEOUT);
+
+    switch (state->entry_type) {
+    case BE_REQ_USER:
+        /* search all bases, the names of a batch may be spread over them */
+        subreq = sdap_get_users_send(state, state->ev,
+                                     state->domain, state->sysdb,
+                                     state->ctx->opts,
+                                     state->ctx->opts->user_search_bases,
+                                     sdap_id_op_handle(state->op),
+                                     state->attrs, state->filter,
+                                     timeout, false);
+        break;
+    case BE_REQ_GROUP:
+        subreq = sdap_get_groups_send(state, state->ev,
+                                      state->domain, state->sysdb,
+                                      state->ctx->opts,
+                                      state->ctx->opts->group_search_bases,
+                                      sdap_id_op_handle(state->op),
+                                      state->attrs, state->filter,
+                                      timeout, false);
+        break;
+    case BE_REQ_NETGROUP:
+        subreq = sdap_get_netgroups_send(state, state->ev,
+                                     state->domain, state->sysdb,
+                                     state->ctx->opts,
+                                     state->ctx->opts->netgroup_search_bases,
+                                     sdap_id_op_handle(state->op),
+                                     state->attrs, state->filter,
+                                     timeout);
+        break;
+    default:
+        tevent_req_error(req, EINVAL);
+        return;
+    }
+
+    if (!subreq) {
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+    tevent_req_set_callback(subreq, sdap_refresh_hot_done, req);
+}
+
+static void sdap_refresh_hot_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_refresh_hot_state *state = tevent_req_data(req,
+                                            struct sdap_refresh_hot_state);
+    size_t count;
+    struct sysdb_attrs **netgroups;
+    int dp_error = DP_ERR_FATAL;
+    int ret;
+
+    switch (state->entry_type) {
+    case BE_REQ_USER:
+        ret = sdap_get_users_recv(subreq, NULL, NULL);
+        break;
+    case BE_REQ_GROUP:
+        ret = sdap_get_groups_recv(subreq, NULL, NULL);
+        break;
+    default:
+        ret = sdap_get_netgroups_recv(subreq, state, NULL,
+                                      &count, &netgroups);
+        break;
+    }
+    talloc_zfree(subreq);
+
+    ret = sdap_id_op_done(state->op, ret, &dp_error);
+    if (dp_error == DP_ERR_OK && ret != EOK) {
+        /* retry */
+        ret = sdap_refresh_hot_retry(req);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+        }
+        return;
+    }
+
+    /* entries that are gone are removed by the next regular lookup */
+    if (ret && ret != ENOENT) {
+        state->dp_error = dp_error;
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    state->next += state->batch;
+
+    ret = sdap_refresh_hot_next(req);
+    if (ret == EAGAIN) {
+        return;
+    } else if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Refreshed %u frequently used entries\n",
+                              (unsigned int)state->num_names));
+
+    state->dp_error = DP_ERR_OK;
+    tevent_req_done(req);
+}
+
+int sdap_refresh_hot_recv(struct tevent_req *req, int *dp_error_out)
+{
+    struct sdap_refresh_hot_state *state = tevent_req_data(req,
+                                            struct sdap_refresh_hot_state);
+
+    if (dp_error_out) {
+        *dp_error_out = state->dp_error;
+    }
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    return EOK;
+}
+
+/* =Refresh-Call========================================================== */
+
+static void sdap_refresh_hot_handler_done(struct tevent_req *req);
+
+void sdap_refresh_hot_handler(struct be_req *breq)
+{
+    struct be_ctx *be_ctx = be_req_get_be_ctx(breq);
+    struct sdap_id_ctx *ctx;
+
+    ctx = talloc_get_type(be_ctx->bet_info[BET_ID].pvt_bet_data,
+                          struct sdap_id_ctx);
+    if (!ctx) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Could not get sdap ctx\n"));
+        return sdap_handler_done(breq, DP_ERR_FATAL,
+                                 EINVAL, "Invalid request data\n");
+    }
+    return sdap_handle_refresh_hot(breq, ctx);
+}
+
+void sdap_handle_refresh_hot(struct be_req *breq, struct sdap_id_ctx *ctx)
+{
+    struct be_ctx *be_ctx = be_req_get_be_ctx(breq);
+    struct be_refresh_req *rr;
+    struct tevent_req *req;
+
+    if (be_is_offline(ctx->be)) {
+        return sdap_handler_done(breq, DP_ERR_OFFLINE, EAGAIN, "Offline");
+    }
+
+    rr = talloc_get_type(be_req_get_data(breq), struct be_refresh_req);
+    if (!rr) {
+        return sdap_handler_done(breq, DP_ERR_FATAL,
+                                 EINVAL, "Invalid request data\n");
+    }
+
+    req = sdap_refresh_hot_send(breq, be_ctx->ev, ctx, rr->entry_type,
+                                rr->names, rr->num_names);
+    if (!req) {
+        return sdap_handler_done(breq, DP_ERR_FATAL, ENOMEM, "Out of memory");
+    }
+
+    tevent_req_set_callback(req, sdap_refresh_hot_handler_done, breq);
+}
+
+static void sdap_refresh_hot_handler_done(struct tevent_req *req)
+{
+    struct be_req *breq = tevent_req_callback_data(req, struct be_req);
+    int dp_error = DP_ERR_FATAL;
+    int ret;
+
+    ret = sdap_refresh_hot_recv(req, &dp_error);
+    talloc_zfree(req);
+
+    if (ret != EOK) {
+        if (dp_error == DP_ERR_OK) dp_error = DP_ERR_FATAL;
+        return sdap_handler_done(breq, dp_error, ret,
+                                 "Refresh of frequently used entries failed");
+    }
+
+    sdap_handler_done(breq, DP_ERR_OK, EOK, NULL);
+}
@@ -37,7 +37,8 @@ static void sdap_shutdown(struct be_req *req);
 struct bet_ops sdap_id_ops = {
     .handler = sdap_account_info_handler,
     .finalize = sdap_shutdown,
-    .check_online = sdap_check_online
+    .check_online = sdap_check_online,
+    .refresh = sdap_refresh_hot_handler
 };
 
 /* Auth Handler */
@@ -113,6 +113,8 @@ struct dp_option default_basic_opts[] = {
     { "ldap_groups_use_matching_rule_in_chain", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ldap_initgroups_use_matching_rule_in_chain", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
     { "ldap_rfc2307_fallback_to_local_users", DP_OPT_BOOL, BOOL_FALSE, BOOL_FALSE },
+    { "ldap_group_nesting_parallel_searches", DP_OPT_NUMBER, { .number = 5 }, NULL_NUMBER },
+    { "ldap_connection_pool_size", DP_OPT_NUMBER, { .number = 2 }, NULL_NUMBER },
     DP_OPTION_TERMINATOR
 };
 
@@ -100,7 +100,9 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
     struct sysdb_attrs *attrs;
     BerElement *ber = NULL;
     struct berval **vals;
-    struct ldb_val v;
+    struct ldb_val *v = NULL;
+    size_t v_size = 0;
+    size_t num_v;
     char *str;
     int lerrno;
     int a, i, ret;
@@ -249,6 +251,23 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
                     ret = EINVAL;
                     goto done;
                 }
+
+                /* Collect the values in a scratch array that is reused for
+                 * all attributes of the entry and add them at once, large
+                 * member lists would otherwise cost one allocation and one
+                 * array resize per value */
+                for (i = 0; vals[i]; i++) ;
+                if (i > v_size) {
+                    v_size = i;
+                    v = talloc_realloc(tmp_ctx, v, struct ldb_val, v_size);
+                    if (!v) {
+                        ldap_value_free_len(vals);
+                        ret = ENOMEM;
+                        goto done;
+                    }
+                }
+
+                num_v = 0;
                 for (i = 0; vals[i]; i++) {
                     if (vals[i]->bv_len == 0) {
                         DEBUG(SSSDBG_MINOR_FAILURE,
@@ -257,22 +276,24 @@ int sdap_parse_entry(TALLOC_CTX *memctx,
                         continue;
                     }
                     if (base64) {
-                        v.data = (uint8_t *)sss_base64_encode(attrs,
+                        v[num_v].data = (uint8_t *)sss_base64_encode(tmp_ctx,
                                 (uint8_t *)vals[i]->bv_val, vals[i]->bv_len);
-                        if (!v.data) {
+                        if (!v[num_v].data) {
+                            ldap_value_free_len(vals);
                             ret = ENOMEM;
                             goto done;
                         }
-                        v.length = strlen((const char *)v.data);
+                        v[num_v].length = strlen((const char *)v[num_v].data);
                     } else {
-                        v.data = (uint8_t *)vals[i]->bv_val;
-                        v.length = vals[i]->bv_len;
+                        v[num_v].data = (uint8_t *)vals[i]->bv_val;
+                        v[num_v].length = vals[i]->bv_len;
                     }
-
-                    ret = sysdb_attrs_add_val(attrs, name, &v);
-                    if (ret) goto done;
+                    num_v++;
                 }
+
+                ret = sysdb_attrs_add_vals(attrs, name, v, num_v);
                 ldap_value_free_len(vals);
+                if (ret) goto done;
             }
         }
 
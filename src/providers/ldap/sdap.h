@@ -217,6 +217,8 @@ enum sdap_basic_opt {
     SDAP_AD_MATCHING_RULE_GROUPS,
     SDAP_AD_MATCHING_RULE_INITGROUPS,
     SDAP_RFC2307_FALLBACK_TO_LOCAL_USERS,
+    SDAP_NESTING_PARALLEL_SEARCHES,
+    SDAP_CONNECTION_POOL_SIZE,
 
     SDAP_OPTS_BASIC /* opts counter */
 };
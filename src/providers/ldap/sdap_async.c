@@ -1083,6 +1083,10 @@ typedef errno_t (*sdap_parse_cb)(struct sdap_handle *sh,
                                  struct sdap_msg *msg,
                                  void *pvt);
 
+/* called after the last entry of every page, before the next page is
+ * requested */
+typedef errno_t (*sdap_page_cb)(void *pvt);
+
 struct sdap_get_generic_ext_state {
     struct tevent_context *ev;
     struct sdap_options *opts;
@@ -1104,6 +1108,7 @@ struct sdap_get_generic_ext_state {
     LDAPControl **clientctrls;
 
     sdap_parse_cb parse_cb;
+    sdap_page_cb page_cb;
     void *cb_data;
 
     bool allow_paging;
@@ -1131,6 +1136,7 @@ sdap_get_generic_ext_send(TALLOC_CTX *memctx,
                           int timeout,
                           bool allow_paging,
                           sdap_parse_cb parse_cb,
+                          sdap_page_cb page_cb,
                           void *cb_data)
 {
     errno_t ret;
@@ -1156,6 +1162,7 @@ sdap_get_generic_ext_send(TALLOC_CTX *memctx,
     state->cookie.bv_len = 0;
     state->cookie.bv_val = NULL;
     state->parse_cb = parse_cb;
+    state->page_cb = page_cb;
     state->cb_data = cb_data;
     state->clientctrls = clientctrls;
 
@@ -1399,6 +1406,16 @@ static void sdap_get_generic_ext_done(struct sdap_op *op,
         }
         ldap_memfree(errmsg);
 
+        if (state->page_cb) {
+            ret = state->page_cb(state->cb_data);
+            if (ret != EOK) {
+                DEBUG(1, ("page processing callback failed.\n"));
+                ldap_controls_free(returned_controls);
+                tevent_req_error(req, ret);
+                return;
+            }
+        }
+
         /* Determine if there are more pages to retrieve */
         page_control = ldap_control_find(LDAP_CONTROL_PAGEDRESULTS,
                                          returned_controls, NULL );
@@ -1502,7 +1519,8 @@ struct tevent_req *sdap_get_generic_send(TALLOC_CTX *memctx,
     subreq = sdap_get_generic_ext_send(state, ev, opts, sh, search_base,
                                        scope, filter, attrs, false, NULL,
                                        NULL, 0, timeout, allow_paging,
-                                       sdap_get_generic_parse_entry, state);
+                                       sdap_get_generic_parse_entry, NULL,
+                                       state);
     if (!subreq) {
         talloc_zfree(req);
         return NULL;
@@ -1574,6 +1592,150 @@ int sdap_get_generic_recv(struct tevent_req *req,
     return EOK;
 }
 
+/* ==Generic Search, one page at a time======================== */
+struct sdap_get_generic_paged_state {
+    struct sdap_attr_map *map;
+    int map_num_attrs;
+
+    sdap_page_fn_t page_fn;
+    void *page_pvt;
+
+    /* only holds the entries of the current page */
+    struct sdap_reply sreply;
+    size_t total_count;
+};
+
+static errno_t sdap_get_generic_paged_parse_entry(struct sdap_handle *sh,
+                                                  struct sdap_msg *msg,
+                                                  void *pvt);
+static errno_t sdap_get_generic_paged_page(void *pvt);
+static void sdap_get_generic_paged_done(struct tevent_req *subreq);
+
+struct tevent_req *sdap_get_generic_paged_send(TALLOC_CTX *memctx,
+                                               struct tevent_context *ev,
+                                               struct sdap_options *opts,
+                                               struct sdap_handle *sh,
+                                               const char *search_base,
+                                               int scope,
+                                               const char *filter,
+                                               const char **attrs,
+                                               struct sdap_attr_map *map,
+                                               int map_num_attrs,
+                                               int timeout,
+                                               sdap_page_fn_t page_fn,
+                                               void *page_pvt)
+{
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    struct sdap_get_generic_paged_state *state = NULL;
+
+    req = tevent_req_create(memctx, &state,
+                            struct sdap_get_generic_paged_state);
+    if (!req) return NULL;
+
+    state->map = map;
+    state->map_num_attrs = map_num_attrs;
+    state->page_fn = page_fn;
+    state->page_pvt = page_pvt;
+
+    subreq = sdap_get_generic_ext_send(state, ev, opts, sh, search_base,
+                                       scope, filter, attrs, false, NULL,
+                                       NULL, 0, timeout, true,
+                                       sdap_get_generic_paged_parse_entry,
+                                       sdap_get_generic_paged_page,
+                                       state);
+    if (!subreq) {
+        talloc_zfree(req);
+        return NULL;
+    }
+    tevent_req_set_callback(subreq, sdap_get_generic_paged_done, req);
+
+    return req;
+}
+
+static errno_t sdap_get_generic_paged_parse_entry(struct sdap_handle *sh,
+                                                  struct sdap_msg *msg,
+                                                  void *pvt)
+{
+    errno_t ret;
+    struct sysdb_attrs *attrs;
+    struct sdap_get_generic_paged_state *state =
+                talloc_get_type(pvt, struct sdap_get_generic_paged_state);
+
+    ret = sdap_parse_entry(state, sh, msg,
+                           state->map, state->map_num_attrs,
+                           &attrs, NULL);
+    if (ret != EOK) {
+        DEBUG(3, ("sdap_parse_entry failed [%d]: %s\n", ret, strerror(ret)));
+        return ret;
+    }
+
+    ret = add_to_reply(state, &state->sreply, attrs);
+    if (ret != EOK) {
+        talloc_free(attrs);
+        DEBUG(1, ("add_to_reply failed.\n"));
+        return ret;
+    }
+
+    return EOK;
+}
+
+/* Hands the page over and frees it, so that at most one page of entries
+ * is held in memory */
+static errno_t sdap_get_generic_paged_page(void *pvt)
+{
+    errno_t ret = EOK;
+    struct sdap_get_generic_paged_state *state =
+                talloc_get_type(pvt, struct sdap_get_generic_paged_state);
+
+    if (state->sreply.reply_count > 0) {
+        DEBUG(SSSDBG_TRACE_INTERNAL, ("Processing a page of %u entries\n",
+                                      (unsigned int)state->sreply.reply_count));
+
+        ret = state->page_fn(state->sreply.reply, state->sreply.reply_count,
+                             state->page_pvt);
+        state->total_count += state->sreply.reply_count;
+    }
+
+    talloc_zfree(state->sreply.reply);
+    state->sreply.reply_count = 0;
+    state->sreply.reply_max = 0;
+
+    return ret;
+}
+
+static void sdap_get_generic_paged_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    int ret;
+
+    ret = sdap_get_generic_ext_recv(subreq);
+    talloc_zfree(subreq);
+    if (ret) {
+        DEBUG(4, ("sdap_get_generic_ext_recv failed [%d]: %s\n",
+                  ret, strerror(ret)));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+int sdap_get_generic_paged_recv(struct tevent_req *req, size_t *total_count)
+{
+    struct sdap_get_generic_paged_state *state = tevent_req_data(req,
+                                        struct sdap_get_generic_paged_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (total_count) {
+        *total_count = state->total_count;
+    }
+
+    return EOK;
+}
+
 /* ==OpenLDAP deref search============================================== */
 static int sdap_x_deref_create_control(struct sdap_handle *sh,
                                        const char *deref_attr,
@@ -1636,7 +1798,7 @@ sdap_x_deref_search_send(TALLOC_CTX *memctx, struct tevent_context *ev,
                                        LDAP_SCOPE_BASE, NULL, attrs,
                                        false, state->ctrls, NULL, 0, timeout,
                                        true, sdap_x_deref_parse_entry,
-                                       state);
+                                       NULL, state);
     if (!subreq) {
         talloc_zfree(req);
         return NULL;
@@ -1861,7 +2023,7 @@ sdap_asq_search_send(TALLOC_CTX *memctx, struct tevent_context *ev,
                                        LDAP_SCOPE_BASE, NULL, attrs,
                                        false, state->ctrls, NULL, 0, timeout,
                                        true, sdap_asq_search_parse_entry,
-                                       state);
+                                       NULL, state);
     if (!subreq) {
         talloc_zfree(req);
         return NULL;
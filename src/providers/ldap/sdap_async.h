@@ -161,6 +161,27 @@ int sdap_get_generic_recv(struct tevent_req *req,
                          TALLOC_CTX *mem_ctx, size_t *reply_count,
                          struct sysdb_attrs ***reply_list);
 
+/* Like sdap_get_generic_send() but the entries are passed to page_fn one
+ * page at a time and freed when it returns, instead of being collected.
+ * Paging is always requested. */
+typedef errno_t (*sdap_page_fn_t)(struct sysdb_attrs **entries,
+                                  size_t count, void *pvt);
+
+struct tevent_req *sdap_get_generic_paged_send(TALLOC_CTX *memctx,
+                                               struct tevent_context *ev,
+                                               struct sdap_options *opts,
+                                               struct sdap_handle *sh,
+                                               const char *search_base,
+                                               int scope,
+                                               const char *filter,
+                                               const char **attrs,
+                                               struct sdap_attr_map *map,
+                                               int map_num_attrs,
+                                               int timeout,
+                                               sdap_page_fn_t page_fn,
+                                               void *page_pvt);
+int sdap_get_generic_paged_recv(struct tevent_req *req, size_t *total_count);
+
 bool sdap_has_deref_support(struct sdap_handle *sh, struct sdap_options *opts);
 
 struct tevent_req *
@@ -722,6 +722,7 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
                             int num_groups,
                             bool populate_members,
                             hash_table_t *ghosts,
+                            bool enumeration,
                             char **_usn_value)
 {
     TALLOC_CTX *tmpctx;
@@ -765,6 +766,15 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
     }
     in_transaction = true;
 
+    /* the groups of an enumeration are a batch of its bulk session */
+    if (enumeration) {
+        ret = sysdb_bulk_batch_start(sysdb);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to start bulk batch\n"));
+            goto done;
+        }
+    }
+
     if (twopass && !populate_members) {
         saved_groups = talloc_array(tmpctx, struct sysdb_attrs *,
                                     num_groups);
@@ -827,6 +837,7 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
         }
     }
 
+    sysdb_bulk_batch_end(sysdb);
     ret = sysdb_transaction_commit(sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to commit transaction!\n"));
@@ -840,6 +851,7 @@ static int sdap_save_groups(TALLOC_CTX *memctx,
 
 done:
     if (in_transaction) {
+        sysdb_bulk_batch_end(sysdb);
         sret = sysdb_transaction_cancel(sysdb);
         if (sret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to cancel transaction\n"));
@@ -1686,7 +1698,7 @@ static void sdap_get_groups_process(struct tevent_req *subreq)
                   "to allow unrolling of nested groups.\n"));
         ret = sdap_save_groups(state, state->sysdb, state->dom, state->opts,
                                state->groups, state->count, false,
-                               NULL, NULL);
+                               NULL, state->enumeration, NULL);
         if (ret) {
             DEBUG(2, ("Failed to store groups.\n"));
             tevent_req_error(req, ret);
@@ -1742,7 +1754,7 @@ static void sdap_get_groups_done(struct tevent_req *subreq)
         ret = sdap_save_groups(state, state->sysdb, state->dom, state->opts,
                                state->groups, state->count,
                                !state->dom->ignore_group_members, NULL,
-                               &state->higher_usn);
+                               state->enumeration, &state->higher_usn);
         if (ret) {
             DEBUG(2, ("Failed to store groups.\n"));
             tevent_req_error(req, ret);
@@ -1865,7 +1877,7 @@ static void sdap_ad_match_rule_members_process(struct tevent_req *subreq)
     /* Now save the group, users and ghosts to the cache */
     ret = sdap_save_groups(tmp_ctx, state->sysdb, state->dom,
                            state->opts, state->groups, 1,
-                           false, ghosts, NULL);
+                           false, ghosts, false, NULL);
     if (ret != EOK) {
         DEBUG(SSSDBG_MINOR_FAILURE,
               ("Could not save group to the cache: [%s]\n",
@@ -1941,7 +1953,7 @@ static void sdap_nested_done(struct tevent_req *subreq)
     }
 
     ret = sdap_save_groups(state, state->sysdb, state->dom, state->opts,
-                           groups, group_count, false, ghosts,
+                           groups, group_count, false, ghosts, false,
                            &state->higher_usn);
     if (ret != EOK) {
         goto fail;
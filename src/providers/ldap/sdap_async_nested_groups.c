@@ -758,6 +758,9 @@ sdap_nested_group_process_send(TALLOC_CTX *mem_ctx,
     struct tevent_req *subreq = NULL;
     struct ldb_message_element *members = NULL;
     const char *orig_dn = NULL;
+    struct timeval start_time;
+    struct timeval elapsed;
+    struct timeval now;
     errno_t ret;
 
     req = tevent_req_create(mem_ctx, &state,
@@ -801,14 +804,19 @@ sdap_nested_group_process_send(TALLOC_CTX *mem_ctx,
     }
 
     /* get members that need to be refreshed */
+    start_time = tevent_timeval_current();
     ret = sdap_nested_group_split_members(state, state->group_ctx,
                                           state->nesting_level, members,
                                           &state->missing,
                                           &state->num_missing_total,
                                           &state->num_missing_groups);
+    now = tevent_timeval_current();
+    elapsed = tevent_timeval_until(&start_time, &now);
 
-    DEBUG(SSSDBG_TRACE_INTERNAL, ("Looking up %d/%d members of group [%s]\n",
-          state->num_missing_total, members->num_values, orig_dn));
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("Looking up %d/%d members of group [%s], "
+          "cache checked in %ld ms\n", state->num_missing_total,
+          members->num_values, orig_dn,
+          (long)(elapsed.tv_sec * 1000 + elapsed.tv_usec / 1000)));
 
     if (state->num_missing_total == 0) {
         ret = EOK; /* we're done */
@@ -1027,24 +1035,257 @@ static errno_t sdap_nested_group_recurse_recv(struct tevent_req *req)
     return EOK;
 }
 
+/* Members of a known type stored in the same container are looked up with
+ * one onelevel search that matches all of their RDNs */
+#define SDAP_NESTED_GROUP_BATCH_SIZE 50
+
+struct sdap_nested_group_batch {
+    enum sdap_nested_group_dn_type type;
+    const char *base_dn;
+    const char *search_filter;      /* filter of the search base or NULL */
+    struct sdap_nested_group_member **members;
+    const char **rdn_filters;       /* (rdn=value) of each member */
+    int num_members;
+};
+
+struct sdap_nested_group_job {
+    struct tevent_req *req;
+    struct sdap_nested_group_member *member;    /* single lookup */
+    struct sdap_nested_group_batch *batch;      /* batched lookup */
+};
+
 struct sdap_nested_group_single_state {
     struct tevent_context *ev;
     struct sdap_nested_group_ctx *group_ctx;
-    struct sdap_nested_group_member *members;
     int nesting_level;
 
-    struct sdap_nested_group_member *current_member;
-    int num_members;
-    int member_index;
+    struct sdap_nested_group_batch *batches;
+    int num_batches;
+    int batch_index;
+
+    struct sdap_nested_group_member **singles;
+    int num_singles;
+    int single_index;
+
+    int num_running;
+    int max_running;
+    int num_searches;
+    struct timeval start_time;
 
     struct sysdb_attrs **nested_groups;
     int num_groups;
 };
 
+static struct tevent_req *
+sdap_nested_group_lookup_batch_send(TALLOC_CTX *mem_ctx,
+                                    struct tevent_context *ev,
+                                    struct sdap_nested_group_ctx *group_ctx,
+                                    struct sdap_nested_group_batch *batch);
+
+static errno_t
+sdap_nested_group_lookup_batch_recv(TALLOC_CTX *mem_ctx,
+                                    struct tevent_req *req,
+                                    struct sysdb_attrs ***_entries,
+                                    int *_num_unmatched);
+
 static errno_t sdap_nested_group_single_step(struct tevent_req *req);
 static void sdap_nested_group_single_step_done(struct tevent_req *subreq);
 static void sdap_nested_group_single_done(struct tevent_req *subreq);
 
+/* Split the DN of a member into the container it is stored in and a filter
+ * matching its RDN. Returns EINVAL if the DN cannot be used in a batch. */
+static errno_t
+sdap_nested_group_batch_key(TALLOC_CTX *mem_ctx,
+                            struct sdap_nested_group_ctx *group_ctx,
+                            const char *member_dn,
+                            const char **_base_dn,
+                            const char **_base_key,
+                            const char **_rdn_filter)
+{
+    TALLOC_CTX *tmp_ctx = NULL;
+    struct ldb_dn *dn = NULL;
+    struct ldb_dn *parent = NULL;
+    const struct ldb_val *rdn_val = NULL;
+    const char *rdn_name = NULL;
+    const char *base_dn = NULL;
+    const char *base_key = NULL;
+    char *value = NULL;
+    char *sanitized = NULL;
+    const char *c;
+    errno_t ret;
+
+    /* multi-valued RDNs cannot be matched by a single attribute */
+    for (c = member_dn; *c != '\0' && *c != ','; c++) {
+        if (*c == '\\' && *(c + 1) != '\0') {
+            c++;
+        } else if (*c == '+') {
+            return EINVAL;
+        }
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    dn = ldb_dn_new(tmp_ctx, sysdb_ctx_get_ldb(group_ctx->domain->sysdb),
+                    member_dn);
+    if (dn == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (!ldb_dn_validate(dn) || ldb_dn_get_comp_num(dn) < 2) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    rdn_name = ldb_dn_get_rdn_name(dn);
+    rdn_val = ldb_dn_get_rdn_val(dn);
+    parent = ldb_dn_get_parent(tmp_ctx, dn);
+    if (rdn_name == NULL || rdn_val == NULL || parent == NULL) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    base_dn = ldb_dn_get_linearized(parent);
+    base_key = ldb_dn_get_casefold(parent);
+    if (base_dn == NULL || base_key == NULL) {
+        ret = EINVAL;
+        goto done;
+    }
+
+    value = talloc_strndup(tmp_ctx, (const char *)rdn_val->data,
+                           rdn_val->length);
+    if (value == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_filter_sanitize(tmp_ctx, value, &sanitized);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    *_rdn_filter = talloc_asprintf(mem_ctx, "(%s=%s)", rdn_name, sanitized);
+    *_base_dn = talloc_strdup(mem_ctx, base_dn);
+    *_base_key = talloc_strdup(mem_ctx, base_key);
+    if (*_rdn_filter == NULL || *_base_dn == NULL || *_base_key == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static errno_t
+sdap_nested_group_single_add(struct sdap_nested_group_single_state *state,
+                             hash_table_t *batch_table,
+                             struct sdap_nested_group_member *member)
+{
+    TALLOC_CTX *tmp_ctx = NULL;
+    struct sdap_nested_group_batch *batch = NULL;
+    const char *member_filter = NULL;
+    const char *rdn_filter = NULL;
+    const char *base_dn = NULL;
+    const char *base_key = NULL;
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+    errno_t ret;
+
+    switch (member->type) {
+    case SDAP_NESTED_GROUP_DN_USER:
+        if (state->group_ctx->opts->schema_type == SDAP_SCHEMA_IPA_V1) {
+            /* the user is guessed from its DN without any search */
+            goto single;
+        }
+        member_filter = member->user_filter;
+        break;
+    case SDAP_NESTED_GROUP_DN_GROUP:
+        member_filter = member->group_filter;
+        break;
+    case SDAP_NESTED_GROUP_DN_UNKNOWN:
+        goto single;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    ret = sdap_nested_group_batch_key(state, state->group_ctx, member->dn,
+                                      &base_dn, &base_key, &rdn_filter);
+    if (ret == EINVAL) {
+        talloc_free(tmp_ctx);
+        goto single;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = talloc_asprintf(tmp_ctx, "%d|%s|%s", member->type,
+                              member_filter ? member_filter : "", base_key);
+    if (key.str == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    hret = hash_lookup(batch_table, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        batch = &state->batches[value.ul];
+    } else if (hret != HASH_ERROR_KEY_NOT_FOUND) {
+        ret = EIO;
+        goto done;
+    }
+
+    if (batch == NULL || batch->num_members >= SDAP_NESTED_GROUP_BATCH_SIZE) {
+        /* start a new batch, a full one is no longer found by the key */
+        batch = &state->batches[state->num_batches];
+        batch->type = member->type;
+        batch->base_dn = base_dn;
+        batch->search_filter = member_filter;
+        batch->members = talloc_zero_array(state->batches,
+                                           struct sdap_nested_group_member *,
+                                           SDAP_NESTED_GROUP_BATCH_SIZE);
+        batch->rdn_filters = talloc_zero_array(state->batches, const char *,
+                                               SDAP_NESTED_GROUP_BATCH_SIZE);
+        if (batch->members == NULL || batch->rdn_filters == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        value.type = HASH_VALUE_ULONG;
+        value.ul = state->num_batches;
+        hret = hash_enter(batch_table, &key, &value);
+        if (hret != HASH_SUCCESS) {
+            ret = EIO;
+            goto done;
+        }
+
+        state->num_batches++;
+    }
+
+    batch->members[batch->num_members] = member;
+    batch->rdn_filters[batch->num_members] = rdn_filter;
+    batch->num_members++;
+
+    ret = EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+
+single:
+    state->singles[state->num_singles] = member;
+    state->num_singles++;
+    return EOK;
+}
+
 static struct tevent_req *
 sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
                               struct tevent_context *ev,
@@ -1056,7 +1297,9 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
 {
     struct sdap_nested_group_single_state *state = NULL;
     struct tevent_req *req = NULL;
+    hash_table_t *batch_table = NULL;
     errno_t ret;
+    int i;
 
     req = tevent_req_create(mem_ctx, &state,
                             struct sdap_nested_group_single_state);
@@ -1067,11 +1310,14 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
 
     state->ev = ev;
     state->group_ctx = group_ctx;
-    state->members = members;
     state->nesting_level = nesting_level;
-    state->current_member = NULL;
-    state->num_members = num_members;
-    state->member_index = 0;
+    state->start_time = tevent_timeval_current();
+    state->max_running = dp_opt_get_int(group_ctx->opts->basic,
+                                        SDAP_NESTING_PARALLEL_SEARCHES);
+    if (state->max_running < 1) {
+        state->max_running = 1;
+    }
+
     state->nested_groups = talloc_zero_array(state, struct sysdb_attrs *,
                                              num_groups_max);
     if (state->nested_groups == NULL) {
@@ -1080,7 +1326,37 @@ sdap_nested_group_single_send(TALLOC_CTX *mem_ctx,
     }
     state->num_groups = 0; /* we will count exact number of the groups */
 
-    /* process each member individually */
+    /* every member ends up either in a batch or in the list of single
+     * lookups, members a batch fails to match are looked up again singly */
+    state->batches = talloc_zero_array(state, struct sdap_nested_group_batch,
+                                       num_members);
+    state->singles = talloc_zero_array(state,
+                                       struct sdap_nested_group_member *,
+                                       num_members);
+    if (state->batches == NULL || state->singles == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    ret = sss_hash_create(state, 32, &batch_table);
+    if (ret != EOK) {
+        goto immediately;
+    }
+
+    for (i = 0; i < num_members; i++) {
+        ret = sdap_nested_group_single_add(state, batch_table, &members[i]);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to batch member [%s] "
+                  "[%d]: %s\n", members[i].dn, ret, strerror(ret)));
+            goto immediately;
+        }
+    }
+    talloc_zfree(batch_table);
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("%d members will be looked up in %d "
+          "batches and %d single lookups, %d at once\n", num_members,
+          state->num_batches, state->num_singles, state->max_running));
+
     ret = sdap_nested_group_single_step(req);
     if (ret != EAGAIN) {
         goto immediately;
@@ -1099,129 +1375,110 @@ immediately:
     return req;
 }
 
+/* Start lookups until max_running of them are in flight. Returns EOK once
+ * all members were processed. */
 static errno_t sdap_nested_group_single_step(struct tevent_req *req)
 {
     struct sdap_nested_group_single_state *state = NULL;
+    struct sdap_nested_group_member *member = NULL;
+    struct sdap_nested_group_job *job = NULL;
     struct tevent_req *subreq = NULL;
 
     state = tevent_req_data(req, struct sdap_nested_group_single_state);
 
-    if (state->member_index >= state->num_members) {
-        /* we're done */
-        return EOK;
-    }
-
-    state->current_member = &state->members[state->member_index];
-    state->member_index++;
+    while (state->num_running < state->max_running) {
+        job = talloc_zero(state, struct sdap_nested_group_job);
+        if (job == NULL) {
+            return ENOMEM;
+        }
+        job->req = req;
+
+        if (state->batch_index < state->num_batches) {
+            job->batch = &state->batches[state->batch_index];
+            state->batch_index++;
+
+            subreq = sdap_nested_group_lookup_batch_send(job, state->ev,
+                                                         state->group_ctx,
+                                                         job->batch);
+        } else if (state->single_index < state->num_singles) {
+            member = state->singles[state->single_index];
+            job->member = member;
+            state->single_index++;
+
+            switch (member->type) {
+            case SDAP_NESTED_GROUP_DN_USER:
+                subreq = sdap_nested_group_lookup_user_send(job, state->ev,
+                                                            state->group_ctx,
+                                                            member);
+                break;
+            case SDAP_NESTED_GROUP_DN_GROUP:
+                subreq = sdap_nested_group_lookup_group_send(job, state->ev,
+                                                             state->group_ctx,
+                                                             member);
+                break;
+            case SDAP_NESTED_GROUP_DN_UNKNOWN:
+                subreq = sdap_nested_group_lookup_unknown_send(job, state->ev,
+                                                             state->group_ctx,
+                                                             member);
+                break;
+            }
+        } else {
+            talloc_free(job);
+            break;
+        }
 
-    switch (state->current_member->type) {
-    case SDAP_NESTED_GROUP_DN_USER:
-        subreq = sdap_nested_group_lookup_user_send(state, state->ev,
-                                                    state->group_ctx,
-                                                    state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_GROUP:
-        subreq = sdap_nested_group_lookup_group_send(state, state->ev,
-                                                     state->group_ctx,
-                                                     state->current_member);
-        break;
-    case SDAP_NESTED_GROUP_DN_UNKNOWN:
-        subreq = sdap_nested_group_lookup_unknown_send(state, state->ev,
-                                                   state->group_ctx,
-                                                   state->current_member);
-        break;
-    }
+        if (subreq == NULL) {
+            talloc_free(job);
+            return ENOMEM;
+        }
 
-    if (subreq == NULL) {
-        return ENOMEM;
+        tevent_req_set_callback(subreq, sdap_nested_group_single_step_done,
+                                job);
+        state->num_running++;
+        state->num_searches++;
     }
 
-    tevent_req_set_callback(subreq, sdap_nested_group_single_step_done, req);
-
-    return EAGAIN;
+    return state->num_running > 0 ? EAGAIN : EOK;
 }
 
 static errno_t
-sdap_nested_group_single_step_process(struct tevent_req *subreq)
+sdap_nested_group_single_save(struct sdap_nested_group_single_state *state,
+                              enum sdap_nested_group_dn_type type,
+                              struct sysdb_attrs *entry,
+                              bool check_nesting)
 {
-    struct sdap_nested_group_single_state *state = NULL;
-    struct tevent_req *req = NULL;
-    struct sysdb_attrs *entry = NULL;
-    enum sdap_nested_group_dn_type type = SDAP_NESTED_GROUP_DN_UNKNOWN;
     const char *orig_dn = NULL;
     errno_t ret;
 
-    req = tevent_req_callback_data(subreq, struct tevent_req);
-    state = tevent_req_data(req, struct sdap_nested_group_single_state);
-
-    /* set correct type if possible */
-    if (state->current_member->type == SDAP_NESTED_GROUP_DN_UNKNOWN) {
-        ret = sdap_nested_group_lookup_unknown_recv(state, subreq,
-                                                    &entry, &type);
-        if (ret != EOK) {
-            goto done;
-        }
-
-        if (entry != NULL) {
-            state->current_member->type = type;
-        }
-    }
-
-    switch (state->current_member->type) {
+    switch (type) {
     case SDAP_NESTED_GROUP_DN_USER:
-        if (entry == NULL) {
-            /* type was not unknown, receive data */
-            ret = sdap_nested_group_lookup_user_recv(state, subreq, &entry);
-            if (ret != EOK) {
-                goto done;
-            }
-
-            if (entry == NULL) {
-                /* user not found, continue */
-                break;
-            }
-        }
-
         /* save user in hash table */
         ret = sdap_nested_group_hash_user(state->group_ctx, entry);
         if (ret == EEXIST) {
             DEBUG(SSSDBG_TRACE_FUNC, ("User was looked up twice, "
                                       "this shouldn't have happened.\n"));
-            goto done;
+            return ret;
         } else if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to save user in hash table "
                                         "[%d]: %s\n", ret, strerror(ret)));
-            goto done;
+            return ret;
         }
         break;
     case SDAP_NESTED_GROUP_DN_GROUP:
-        if (entry == NULL) {
-            /* type was not unknown, receive data */
-            ret = sdap_nested_group_lookup_group_recv(state, subreq, &entry);
+        /* if the type was unknown we had to pull the group, but we don't
+         * want to process it if we have reached the nesting level */
+        if (check_nesting
+                && state->nesting_level >= state->group_ctx->max_nesting_level) {
+            ret = sysdb_attrs_get_string(entry, SYSDB_ORIG_DN, &orig_dn);
             if (ret != EOK) {
-                goto done;
-            }
-
-            if (entry == NULL) {
-                /* group not found, continue */
-                break;
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      ("The entry has no originalDN\n"));
+                orig_dn = "invalid";
             }
-        } else {
-            /* the type was unknown so we had to pull the group,
-             * but we don't want to process it if we have reached
-             * the nesting level */
-            if (state->nesting_level >= state->group_ctx->max_nesting_level) {
-                ret = sysdb_attrs_get_string(entry, SYSDB_ORIG_DN, &orig_dn);
-                if (ret != EOK) {
-                    DEBUG(SSSDBG_MINOR_FAILURE,
-                          ("The entry has no originalDN\n"));
-                    orig_dn = "invalid";
-                }
 
-                DEBUG(SSSDBG_TRACE_ALL, ("[%s] is outside nesting limit "
-                      "(level %d), skipping\n", orig_dn, state->nesting_level));
-                break;
-            }
+            DEBUG(SSSDBG_TRACE_ALL, ("[%s] is outside nesting limit "
+                  "(level %d), skipping\n", orig_dn, state->nesting_level));
+            break;
         }
 
         /* save group in hash table */
@@ -1229,41 +1486,122 @@ sdap_nested_group_single_step_process(struct tevent_req *subreq)
         if (ret == EEXIST) {
             DEBUG(SSSDBG_TRACE_FUNC, ("Group was looked up twice, "
                                       "this shouldn't have happened.\n"));
-            goto done;
+            return ret;
         } else if (ret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to save group in hash table "
                                         "[%d]: %s\n", ret, strerror(ret)));
-            goto done;
+            return ret;
         }
 
         /* remember the group for later processing */
         state->nested_groups[state->num_groups] = entry;
         state->num_groups++;
-
         break;
     case SDAP_NESTED_GROUP_DN_UNKNOWN:
         /* not found in users nor nested_groups, continue */
         break;
     }
 
-    ret = EOK;
+    return EOK;
+}
 
-done:
-    return ret;
+static errno_t
+sdap_nested_group_single_member_process(struct tevent_req *subreq,
+                                   struct sdap_nested_group_single_state *state,
+                                   struct sdap_nested_group_member *member)
+{
+    struct sysdb_attrs *entry = NULL;
+    enum sdap_nested_group_dn_type type = SDAP_NESTED_GROUP_DN_UNKNOWN;
+    errno_t ret;
+
+    switch (member->type) {
+    case SDAP_NESTED_GROUP_DN_UNKNOWN:
+        ret = sdap_nested_group_lookup_unknown_recv(state, subreq,
+                                                    &entry, &type);
+        if (ret != EOK || entry == NULL) {
+            return ret;
+        }
+
+        /* set correct type */
+        member->type = type;
+        return sdap_nested_group_single_save(state, type, entry, true);
+    case SDAP_NESTED_GROUP_DN_USER:
+        ret = sdap_nested_group_lookup_user_recv(state, subreq, &entry);
+        break;
+    case SDAP_NESTED_GROUP_DN_GROUP:
+        ret = sdap_nested_group_lookup_group_recv(state, subreq, &entry);
+        break;
+    default:
+        return EINVAL;
+    }
+
+    if (ret != EOK || entry == NULL) {
+        /* error or not found */
+        return ret;
+    }
+
+    return sdap_nested_group_single_save(state, member->type, entry, false);
+}
+
+static errno_t
+sdap_nested_group_single_batch_process(struct tevent_req *subreq,
+                                   struct sdap_nested_group_single_state *state,
+                                   struct sdap_nested_group_batch *batch)
+{
+    struct sysdb_attrs **entries = NULL;
+    int num_unmatched;
+    errno_t ret;
+    int i;
+
+    ret = sdap_nested_group_lookup_batch_recv(state, subreq, &entries,
+                                              &num_unmatched);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    for (i = 0; i < batch->num_members; i++) {
+        if (entries[i] != NULL) {
+            ret = sdap_nested_group_single_save(state, batch->type,
+                                                entries[i], false);
+            if (ret != EOK) {
+                return ret;
+            }
+        } else if (num_unmatched > 0) {
+            /* the server returned the DN in a different form than the
+             * member attribute, look the member up by its DN */
+            state->singles[state->num_singles] = batch->members[i];
+            state->num_singles++;
+        }
+    }
+
+    talloc_free(entries);
+    return EOK;
 }
 
 static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
 {
     struct sdap_nested_group_single_state *state = NULL;
+    struct sdap_nested_group_job *job = NULL;
     struct tevent_req *req = NULL;
+    struct timeval elapsed;
+    struct timeval now;
     errno_t ret;
 
-    req = tevent_req_callback_data(subreq, struct tevent_req);
+    job = tevent_req_callback_data(subreq, struct sdap_nested_group_job);
+    req = job->req;
     state = tevent_req_data(req, struct sdap_nested_group_single_state);
 
+    state->num_running--;
+
     /* process direct members */
-    ret = sdap_nested_group_single_step_process(subreq);
-    talloc_zfree(subreq);
+    if (job->batch != NULL) {
+        ret = sdap_nested_group_single_batch_process(subreq, state,
+                                                     job->batch);
+    } else {
+        ret = sdap_nested_group_single_member_process(subreq, state,
+                                                      job->member);
+    }
+    talloc_zfree(job);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Error processing direct membership "
                                     "[%d]: %s\n", ret, strerror(ret)));
@@ -1272,8 +1610,15 @@ static void sdap_nested_group_single_step_done(struct tevent_req *subreq)
 
     ret = sdap_nested_group_single_step(req);
     if (ret == EOK) {
+        now = tevent_timeval_current();
+        elapsed = tevent_timeval_until(&state->start_time, &now);
+        DEBUG(SSSDBG_TRACE_FUNC, ("Direct members looked up with %d "
+              "searches in %ld ms\n", state->num_searches,
+              (long)(elapsed.tv_sec * 1000 + elapsed.tv_usec / 1000)));
+
         /* we have processed all direct members,
          * now recurse and process nested groups */
+        state->start_time = tevent_timeval_current();
         subreq = sdap_nested_group_recurse_send(state, state->ev,
                                                 state->group_ctx,
                                                 state->nested_groups,
@@ -1307,10 +1652,14 @@ done:
 
 static void sdap_nested_group_single_done(struct tevent_req *subreq)
 {
+    struct sdap_nested_group_single_state *state = NULL;
     struct tevent_req *req = NULL;
+    struct timeval elapsed;
+    struct timeval now;
     errno_t ret;
 
     req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_single_state);
 
     /* all nested groups are completed */
     ret = sdap_nested_group_recurse_recv(subreq);
@@ -1319,8 +1668,15 @@ static void sdap_nested_group_single_done(struct tevent_req *subreq)
         DEBUG(SSSDBG_CRIT_FAILURE, ("Error processing nested groups "
                                     "[%d]: %s", ret, strerror(ret)));
         tevent_req_error(req, ret);
+        return;
     }
 
+    now = tevent_timeval_current();
+    elapsed = tevent_timeval_until(&state->start_time, &now);
+    DEBUG(SSSDBG_TRACE_FUNC, ("%d nested groups at level %d processed "
+          "in %ld ms\n", state->num_groups, state->nesting_level + 1,
+          (long)(elapsed.tv_sec * 1000 + elapsed.tv_usec / 1000)));
+
     tevent_req_done(req);
 
     return;
@@ -1733,6 +2089,222 @@ static errno_t sdap_nested_group_lookup_group_recv(TALLOC_CTX *mem_ctx,
      return EOK;
 }
 
+struct sdap_nested_group_lookup_batch_state {
+    struct sdap_nested_group_batch *batch;
+    struct sysdb_attrs **entries;
+    int num_unmatched;
+};
+
+static void sdap_nested_group_lookup_batch_done(struct tevent_req *subreq);
+
+static struct tevent_req *
+sdap_nested_group_lookup_batch_send(TALLOC_CTX *mem_ctx,
+                                    struct tevent_context *ev,
+                                    struct sdap_nested_group_ctx *group_ctx,
+                                    struct sdap_nested_group_batch *batch)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
+    struct sdap_attr_map *map = NULL;
+    size_t map_num;
+    const char **attrs = NULL;
+    const char *base_filter = NULL;
+    const char *filter = NULL;
+    char *rdn_filter = NULL;
+    errno_t ret;
+    int i;
+
+    req = tevent_req_create(mem_ctx, &state,
+                            struct sdap_nested_group_lookup_batch_state);
+    if (req == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("tevent_req_create() failed\n"));
+        return NULL;
+    }
+
+    state->batch = batch;
+
+    /* request the same attributes as a single lookup of the member */
+    if (batch->type == SDAP_NESTED_GROUP_DN_USER) {
+        map = group_ctx->opts->user_map;
+        map_num = SDAP_OPTS_USER;
+
+        attrs = talloc_array(state, const char *, 3);
+        if (attrs == NULL) {
+            ret = ENOMEM;
+            goto immediately;
+        }
+
+        attrs[0] = "objectClass";
+        attrs[1] = map[SDAP_AT_USER_NAME].name;
+        attrs[2] = NULL;
+
+        base_filter = talloc_asprintf(state, "(objectclass=%s)",
+                                      map[SDAP_OC_USER].name);
+    } else {
+        map = group_ctx->opts->group_map;
+        map_num = SDAP_OPTS_GROUP;
+
+        ret = build_attrs_from_map(state, map, SDAP_OPTS_GROUP, NULL,
+                                   &attrs, NULL);
+        if (ret != EOK) {
+            goto immediately;
+        }
+
+        base_filter = talloc_asprintf(state, "(&(objectclass=%s)(%s=*))",
+                                      map[SDAP_OC_GROUP].name,
+                                      map[SDAP_AT_GROUP_NAME].name);
+    }
+    if (base_filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    rdn_filter = talloc_strdup(state, "(|");
+    for (i = 0; i < batch->num_members && rdn_filter != NULL; i++) {
+        rdn_filter = talloc_strdup_append_buffer(rdn_filter,
+                                                 batch->rdn_filters[i]);
+    }
+    if (rdn_filter != NULL) {
+        rdn_filter = talloc_asprintf(state, "(&%s%s)", base_filter,
+                                     talloc_strdup_append_buffer(rdn_filter,
+                                                                 ")"));
+    }
+    if (rdn_filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    /* use search base filter if needed */
+    filter = sdap_get_id_specific_filter(state, rdn_filter,
+                                         batch->search_filter);
+    if (filter == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("Looking up %d members under [%s]\n",
+                                  batch->num_members, batch->base_dn));
+
+    /* search */
+    subreq = sdap_get_generic_send(state, ev, group_ctx->opts, group_ctx->sh,
+                                   batch->base_dn, LDAP_SCOPE_ONELEVEL,
+                                   filter, attrs, map, map_num,
+                                   dp_opt_get_int(group_ctx->opts->basic,
+                                                  SDAP_SEARCH_TIMEOUT),
+                                   false);
+    if (subreq == NULL) {
+        ret = ENOMEM;
+        goto immediately;
+    }
+
+    tevent_req_set_callback(subreq, sdap_nested_group_lookup_batch_done, req);
+
+    return req;
+
+immediately:
+    if (ret == EOK) {
+        tevent_req_done(req);
+    } else {
+        tevent_req_error(req, ret);
+    }
+    tevent_req_post(req, ev);
+
+    return req;
+}
+
+static void sdap_nested_group_lookup_batch_done(struct tevent_req *subreq)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    struct tevent_req *req = NULL;
+    struct sysdb_attrs **entries = NULL;
+    const char *orig_dn = NULL;
+    size_t count = 0;
+    errno_t ret;
+    size_t i;
+    int j;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    ret = sdap_get_generic_recv(subreq, state, &count, &entries);
+    talloc_zfree(subreq);
+    if (ret == ENOENT) {
+        count = 0;
+    } else if (ret != EOK) {
+        goto done;
+    }
+
+    state->entries = talloc_zero_array(state, struct sysdb_attrs *,
+                                       state->batch->num_members);
+    if (state->entries == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    /* the RDN filters may match other entries in the container as well,
+     * only entries with the DN of a member are used */
+    for (i = 0; i < count; i++) {
+        ret = sysdb_attrs_get_string(entries[i], SYSDB_ORIG_DN, &orig_dn);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_MINOR_FAILURE, ("The entry has no originalDN\n"));
+            state->num_unmatched++;
+            continue;
+        }
+
+        for (j = 0; j < state->batch->num_members; j++) {
+            if (state->entries[j] == NULL
+                    && strcasecmp(orig_dn, state->batch->members[j]->dn) == 0) {
+                state->entries[j] = talloc_steal(state->entries, entries[i]);
+                break;
+            }
+        }
+
+        if (j == state->batch->num_members) {
+            state->num_unmatched++;
+        }
+    }
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("%u entries found for %d members under "
+          "[%s], %d not matched\n", (unsigned int)count,
+          state->batch->num_members,
+          state->batch->base_dn, state->num_unmatched));
+
+    ret = EOK;
+
+done:
+    talloc_free(entries);
+
+    if (ret != EOK) {
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    tevent_req_done(req);
+}
+
+static errno_t
+sdap_nested_group_lookup_batch_recv(TALLOC_CTX *mem_ctx,
+                                    struct tevent_req *req,
+                                    struct sysdb_attrs ***_entries,
+                                    int *_num_unmatched)
+{
+    struct sdap_nested_group_lookup_batch_state *state = NULL;
+    state = tevent_req_data(req, struct sdap_nested_group_lookup_batch_state);
+
+    TEVENT_REQ_RETURN_ON_ERROR(req);
+
+    if (_entries != NULL) {
+        *_entries = talloc_steal(mem_ctx, state->entries);
+    }
+
+    if (_num_unmatched != NULL) {
+        *_num_unmatched = state->num_unmatched;
+    }
+
+    return EOK;
+}
+
 struct sdap_nested_group_lookup_unknown_state {
     struct tevent_context *ev;
     struct sdap_nested_group_ctx *group_ctx;
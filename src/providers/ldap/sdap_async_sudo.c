@@ -45,6 +45,8 @@ struct sdap_sudo_refresh_state {
     const char *ldap_filter;    /* search */
     const char *sysdb_filter;   /* delete */
 
+    bool bulk;
+
     int dp_error;
     int error;
     char *highest_usn;
@@ -108,7 +110,8 @@ struct tevent_req *sdap_sudo_refresh_send(TALLOC_CTX *mem_ctx,
                                           struct sdap_options *opts,
                                           struct sdap_id_conn_cache *conn_cache,
                                           const char *ldap_filter,
-                                          const char *sysdb_filter)
+                                          const char *sysdb_filter,
+                                          bool bulk)
 {
     struct tevent_req *req;
     struct sdap_sudo_refresh_state *state;
@@ -133,6 +136,7 @@ struct tevent_req *sdap_sudo_refresh_send(TALLOC_CTX *mem_ctx,
     state->domain = be_ctx->domain;
     state->ldap_filter = talloc_strdup(state, ldap_filter);
     state->sysdb_filter = talloc_strdup(state, sysdb_filter);
+    state->bulk = bulk;
     state->dp_error = DP_ERR_OK;
     state->error = EOK;
     state->highest_usn = NULL;
@@ -213,6 +217,7 @@ static int sdap_sudo_refresh_retry(struct tevent_req *req)
             state->error = EIO;
             return EIO;
         }
+        sdap_id_op_set_bulk(state->sdap_op, state->bulk);
     }
 
     subreq = sdap_id_op_connect_send(state->sdap_op, state, &ret);
@@ -504,6 +509,17 @@ static void sdap_sudo_refresh_load_done(struct tevent_req *subreq)
         goto done;
     }
 
+    /* let the responder drop the rule sets it has cached */
+    if (state->sysdb_filter != NULL || rules_count > 0) {
+        ret = sysdb_sudo_mark_changed(state->sysdb, state->domain);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Unable to mark sudo rules as "
+                                      "changed [%d]: %s\n",
+                                      ret, strerror(ret)));
+            goto done;
+        }
+    }
+
     /* commit transaction */
     ret = sysdb_transaction_commit(state->sysdb);
     if (ret != EOK) {
@@ -23,6 +23,7 @@
 #include <talloc.h>
 
 #include "util/util.h"
+#include "providers/ldap/ldap_common.h"
 #include "providers/ldap/sdap.h"
 #include "providers/ldap/sdap_id_op.h"
 #include "providers/ldap/sdap_sudo.h"
@@ -33,6 +34,8 @@ struct sdap_sudo_timer_state {
     time_t timeout;          /* relative time how many seconds wait before
                                 canceling fn request */
     sdap_sudo_timer_fn_t fn; /* request executed on 'when' */
+    bool background;         /* wait for a background slot of the back end
+                                before fn is executed */
 
     struct tevent_req *subreq;
     struct tevent_timer *timer_timeout;
@@ -42,6 +45,10 @@ static void sdap_sudo_timer(struct tevent_context *ev,
                             struct tevent_timer *tt,
                             struct timeval tv, void *pvt);
 
+static void sdap_sudo_timer_slot_done(struct tevent_req *subreq);
+
+static void sdap_sudo_timer_issue(struct tevent_req *req);
+
 static void sdap_sudo_timer_done(struct tevent_req *subreq);
 
 static void sdap_sudo_timer_timeout(struct tevent_context *ev,
@@ -53,6 +60,7 @@ struct tevent_req * sdap_sudo_timer_send(TALLOC_CTX *mem_ctx,
                                          struct sdap_sudo_ctx *sudo_ctx,
                                          struct timeval when,
                                          time_t timeout,
+                                         bool background,
                                          sdap_sudo_timer_fn_t fn)
 {
     struct tevent_req *req = NULL;
@@ -71,6 +79,7 @@ struct tevent_req * sdap_sudo_timer_send(TALLOC_CTX *mem_ctx,
     state->sudo_ctx = sudo_ctx;
     state->timeout = timeout;
     state->fn = fn;
+    state->background = background;
 
     /* set timer */
     timer = tevent_add_timer(ev, req, when, sdap_sudo_timer, req);
@@ -112,11 +121,55 @@ static void sdap_sudo_timer(struct tevent_context *ev,
                             struct timeval tv, void *pvt)
 {
     struct tevent_req *req = NULL;
+    struct tevent_req *subreq = NULL;
     struct sdap_sudo_timer_state *state = NULL;
 
     req = talloc_get_type(pvt, struct tevent_req);
     state = tevent_req_data(req, struct sdap_sudo_timer_state);
 
+    if (!state->background) {
+        sdap_sudo_timer_issue(req);
+        return;
+    }
+
+    /* the slot is allocated on state, it is held until this request
+     * is freed */
+    subreq = be_sched_slot_send(state, state->sudo_ctx->id_ctx->be,
+                                BE_REQ_CLASS_BACKGROUND);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to schedule timed request!\n"));
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    tevent_req_set_callback(subreq, sdap_sudo_timer_slot_done, req);
+}
+
+static void sdap_sudo_timer_slot_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+
+    ret = be_sched_slot_recv(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to schedule timed request "
+                                    "[%d]: %s\n", ret, strerror(ret)));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    sdap_sudo_timer_issue(req);
+}
+
+static void sdap_sudo_timer_issue(struct tevent_req *req)
+{
+    struct sdap_sudo_timer_state *state = NULL;
+    struct timeval tv;
+
+    state = tevent_req_data(req, struct sdap_sudo_timer_state);
+
     /* issue request */
     state->subreq = state->fn(state, state->sudo_ctx);
     if (state->subreq == NULL) {
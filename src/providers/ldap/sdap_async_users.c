@@ -410,6 +410,7 @@ int sdap_save_users(TALLOC_CTX *memctx,
                     struct sdap_options *opts,
                     struct sysdb_attrs **users,
                     int num_users,
+                    bool enumeration,
                     char **_usn_value)
 {
     TALLOC_CTX *tmpctx;
@@ -438,6 +439,15 @@ int sdap_save_users(TALLOC_CTX *memctx,
     }
     in_transaction = true;
 
+    /* the users of an enumeration are a batch of its bulk session */
+    if (enumeration) {
+        ret = sysdb_bulk_batch_start(sysdb);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to start bulk batch\n"));
+            goto done;
+        }
+    }
+
     now = time(NULL);
     for (i = 0; i < num_users; i++) {
         usn_value = NULL;
@@ -469,6 +479,7 @@ int sdap_save_users(TALLOC_CTX *memctx,
         }
     }
 
+    sysdb_bulk_batch_end(sysdb);
     ret = sysdb_transaction_commit(sysdb);
     if (ret) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to commit transaction!\n"));
@@ -482,6 +493,7 @@ int sdap_save_users(TALLOC_CTX *memctx,
 
 done:
     if (in_transaction) {
+        sysdb_bulk_batch_end(sysdb);
         sret = sysdb_transaction_cancel(sysdb);
         if (sret != EOK) {
             DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to cancel transaction\n"));
@@ -516,6 +528,9 @@ struct sdap_get_users_state {
 
 static errno_t sdap_get_users_next_base(struct tevent_req *req);
 static void sdap_get_users_process(struct tevent_req *subreq);
+static errno_t sdap_get_users_save_page(struct sysdb_attrs **users,
+                                        size_t count, void *pvt);
+static void sdap_get_users_paged_done(struct tevent_req *subreq);
 
 struct tevent_req *sdap_get_users_send(TALLOC_CTX *memctx,
                                        struct tevent_context *ev,
@@ -588,6 +603,25 @@ static errno_t sdap_get_users_next_base(struct tevent_req *req)
           ("Searching for users with base [%s]\n",
            state->search_bases[state->base_iter]->basedn));
 
+    if (state->enumeration) {
+        /* Store every page as it arrives instead of holding the whole
+         * enumeration in memory */
+        subreq = sdap_get_generic_paged_send(
+                state, state->ev, state->opts, state->sh,
+                state->search_bases[state->base_iter]->basedn,
+                state->search_bases[state->base_iter]->scope,
+                state->filter, state->attrs,
+                state->opts->user_map, SDAP_OPTS_USER,
+                state->timeout,
+                sdap_get_users_save_page, req);
+        if (!subreq) {
+            return ENOMEM;
+        }
+        tevent_req_set_callback(subreq, sdap_get_users_paged_done, req);
+
+        return EOK;
+    }
+
     subreq = sdap_get_generic_send(
             state, state->ev, state->opts, state->sh,
             state->search_bases[state->base_iter]->basedn,
@@ -677,13 +711,86 @@ static void sdap_get_users_process(struct tevent_req *subreq)
     ret = sdap_save_users(state, state->sysdb,
                           state->dom, state->opts,
                           state->users, state->count,
-                          &state->higher_usn);
+                          state->enumeration, &state->higher_usn);
+    if (ret) {
+        DEBUG(2, ("Failed to store users.\n"));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    DEBUG(9, ("Saving %d Users - Done\n", state->count));
+
+    tevent_req_done(req);
+}
+
+static errno_t sdap_get_users_save_page(struct sysdb_attrs **users,
+                                        size_t count, void *pvt)
+{
+    struct tevent_req *req = talloc_get_type(pvt, struct tevent_req);
+    struct sdap_get_users_state *state = tevent_req_data(req,
+                                            struct sdap_get_users_state);
+    char *usn_value = NULL;
+    errno_t ret;
+
+    ret = sdap_save_users(state, state->sysdb,
+                          state->dom, state->opts,
+                          users, count,
+                          state->enumeration, &usn_value);
     if (ret) {
         DEBUG(2, ("Failed to store users.\n"));
+        return ret;
+    }
+
+    if (usn_value) {
+        if (state->higher_usn == NULL
+                || (strlen(usn_value) > strlen(state->higher_usn))
+                || (strcmp(usn_value, state->higher_usn) > 0)) {
+            talloc_zfree(state->higher_usn);
+            state->higher_usn = usn_value;
+        } else {
+            talloc_zfree(usn_value);
+        }
+    }
+
+    state->count += count;
+    return EOK;
+}
+
+static void sdap_get_users_paged_done(struct tevent_req *subreq)
+{
+    struct tevent_req *req = tevent_req_callback_data(subreq,
+                                                      struct tevent_req);
+    struct sdap_get_users_state *state = tevent_req_data(req,
+                                            struct sdap_get_users_state);
+    size_t count;
+    int ret;
+
+    ret = sdap_get_generic_paged_recv(subreq, &count);
+    talloc_zfree(subreq);
+    if (ret) {
         tevent_req_error(req, ret);
         return;
     }
 
+    DEBUG(6, ("Search for users, stored %u results.\n",
+              (unsigned int)count));
+
+    state->base_iter++;
+    if (state->search_bases[state->base_iter]) {
+        /* There are more search bases to try */
+        ret = sdap_get_users_next_base(req);
+        if (ret != EOK) {
+            tevent_req_error(req, ret);
+        }
+        return;
+    }
+
+    /* Return ENOENT if no users were found in any base */
+    if (state->count == 0) {
+        tevent_req_error(req, ENOENT);
+        return;
+    }
+
     DEBUG(9, ("Saving %d Users - Done\n", state->count));
 
     tevent_req_done(req);
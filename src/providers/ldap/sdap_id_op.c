@@ -26,14 +26,19 @@
 #include "providers/ldap/sdap_async.h"
 #include "providers/ldap/sdap_id_op.h"
 
+/* The first slot of the connection pool is reserved for interactive
+ * operations, bulk operations are spread over the other ones */
+#define SDAP_ID_INTERACTIVE_SLOT 0
+
 /* LDAP async connection cache */
 struct sdap_id_conn_cache {
     struct sdap_id_ctx *id_ctx;
 
     /* list of all open connections */
     struct sdap_id_conn_data *connections;
-    /* cached (current) connection */
-    struct sdap_id_conn_data *cached_connection;
+    /* cached (current) connections, one per pool slot */
+    struct sdap_id_conn_data **cached_connections;
+    int num_slots;
 };
 
 /* LDAP async operation tracker:
@@ -48,6 +53,8 @@ struct sdap_id_op {
     struct sdap_id_conn_data *conn_data;
     /* number of reconnects for this operation */
     int reconnect_retry_count;
+    /* bulk operations do not use the interactive connection */
+    bool bulk;
     /* connection request
      * It is required as we need to know which requests to notify
      * when shared connection request to sdap_handle completes.
@@ -72,6 +79,9 @@ struct sdap_id_conn_data {
     int notify_lock;
     /* list of operations using connect */
     struct sdap_id_op *ops;
+    int num_ops;
+    /* pool slot the connection was made for */
+    int slot;
     /* A flag which is signalizing that this
      * connection will be disconnected and should
      * not be used any more */
@@ -82,6 +92,8 @@ static void sdap_id_conn_cache_be_offline_cb(void *pvt);
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt);
 
 static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data);
+static bool sdap_id_conn_is_cached(struct sdap_id_conn_data *conn_data);
+static void sdap_id_conn_uncache(struct sdap_id_conn_data *conn_data);
 static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data);
 static bool sdap_is_connection_expired(struct sdap_id_conn_data *conn_data, int timeout);
 static bool sdap_can_reuse_connection(struct sdap_id_conn_data *conn_data);
@@ -115,6 +127,21 @@ int sdap_id_conn_cache_create(TALLOC_CTX *memctx,
 
     conn_cache->id_ctx = id_ctx;
 
+    conn_cache->num_slots = dp_opt_get_int(id_ctx->opts->basic,
+                                           SDAP_CONNECTION_POOL_SIZE);
+    if (conn_cache->num_slots < 1) {
+        conn_cache->num_slots = 1;
+    }
+    conn_cache->cached_connections = talloc_zero_array(conn_cache,
+                                                 struct sdap_id_conn_data *,
+                                                 conn_cache->num_slots);
+    if (!conn_cache->cached_connections) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    DEBUG(SSSDBG_CONF_SETTINGS, ("Using up to %d LDAP connections\n",
+                                 conn_cache->num_slots));
+
     ret = be_add_offline_cb(conn_cache, id_ctx->be,
                             sdap_id_conn_cache_be_offline_cb, conn_cache,
                             NULL);
@@ -139,28 +166,59 @@ fail:
     return ret;
 }
 
+/* Drop all cached connections, e.g. when the server is changed */
+static void sdap_id_conn_cache_release_all(struct sdap_id_conn_cache *conn_cache)
+{
+    struct sdap_id_conn_data *cached_connection;
+    int i;
+
+    for (i = 0; i < conn_cache->num_slots; i++) {
+        cached_connection = conn_cache->cached_connections[i];
+        if (cached_connection != NULL) {
+            conn_cache->cached_connections[i] = NULL;
+            sdap_id_release_conn_data(cached_connection);
+        }
+    }
+}
+
 /* Callback on BE going offline */
 static void sdap_id_conn_cache_be_offline_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        conn_cache->cached_connection = NULL;
-        sdap_id_release_conn_data(cached_connection);
-    }
+    sdap_id_conn_cache_release_all(conn_cache);
 }
 
 /* Callback for attempt to reconnect to primary server */
 static void sdap_id_conn_cache_fo_reconnect_cb(void *pvt)
 {
     struct sdap_id_conn_cache *conn_cache = talloc_get_type(pvt, struct sdap_id_conn_cache);
-    struct sdap_id_conn_data *cached_connection = conn_cache->cached_connection;
+    struct sdap_id_conn_data *cached_connection;
+    int i;
 
     /* Release any cached connection on going offline */
-    if (cached_connection != NULL) {
-        cached_connection->disconnecting = true;
+    for (i = 0; i < conn_cache->num_slots; i++) {
+        cached_connection = conn_cache->cached_connections[i];
+        if (cached_connection != NULL) {
+            cached_connection->disconnecting = true;
+        }
+    }
+}
+
+/* Check whether the connection is the cached one of its pool slot */
+static bool sdap_id_conn_is_cached(struct sdap_id_conn_data *conn_data)
+{
+    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
+
+    return conn_cache->cached_connections[conn_data->slot] == conn_data;
+}
+
+/* Stop handing the connection out to new operations */
+static void sdap_id_conn_uncache(struct sdap_id_conn_data *conn_data)
+{
+    if (sdap_id_conn_is_cached(conn_data)) {
+        conn_data->conn_cache->cached_connections[conn_data->slot] = NULL;
     }
 }
 
@@ -174,7 +232,7 @@ static void sdap_id_release_conn_data(struct sdap_id_conn_data *conn_data)
     }
 
     conn_cache = conn_data->conn_cache;
-    if (conn_data == conn_cache->cached_connection) {
+    if (sdap_id_conn_is_cached(conn_data)) {
         return;
     }
 
@@ -194,6 +252,7 @@ static int sdap_id_conn_data_destroy(struct sdap_id_conn_data *conn_data)
         op->conn_data = NULL;
         DLIST_REMOVE(conn_data->ops, op);
     }
+    conn_data->num_ops = 0;
 
     return 0;
 }
@@ -274,12 +333,11 @@ static void sdap_id_conn_data_expire_handler(struct tevent_context *ev,
 {
     struct sdap_id_conn_data *conn_data = talloc_get_type(pvt,
                                                           struct sdap_id_conn_data);
-    struct sdap_id_conn_cache *conn_cache = conn_data->conn_cache;
 
     DEBUG(3, ("connection is about to expire, releasing it\n"));
 
-    if (conn_cache->cached_connection == conn_data) {
-        conn_cache->cached_connection = NULL;
+    if (sdap_id_conn_is_cached(conn_data)) {
+        sdap_id_conn_uncache(conn_data);
 
         sdap_id_release_conn_data(conn_data);
     }
@@ -299,6 +357,12 @@ struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx, struct sdap_id_conn_cac
     return op;
 }
 
+/* Mark the operation as bulk work */
+void sdap_id_op_set_bulk(struct sdap_id_op *op, bool bulk)
+{
+    op->bulk = bulk;
+}
+
 /* Attach/detach connection to sdap_id_op */
 static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn_data *conn_data)
 {
@@ -314,12 +378,14 @@ static void sdap_id_op_hook_conn_data(struct sdap_id_op *op, struct sdap_id_conn
 
     if (current) {
         DLIST_REMOVE(current->ops, op);
+        current->num_ops--;
     }
 
     op->conn_data = conn_data;
 
     if (conn_data) {
         DLIST_ADD_END(conn_data->ops, op, struct sdap_id_op*);
+        conn_data->num_ops++;
     }
 
     if (current) {
@@ -445,6 +511,39 @@ done:
     return req;
 }
 
+/* Choose the pool slot for an operation. Interactive operations always use
+ * their own slot. Bulk operations use the least busy of the other slots,
+ * an unused slot counts as idle so that new connections are opened before
+ * operations are stacked on the existing ones. */
+static int sdap_id_op_pick_slot(struct sdap_id_op *op)
+{
+    struct sdap_id_conn_cache *conn_cache = op->conn_cache;
+    struct sdap_id_conn_data *conn_data;
+    int best_slot = -1;
+    int best_load = 0;
+    int load;
+    int i;
+
+    if (!op->bulk || conn_cache->num_slots == 1) {
+        return SDAP_ID_INTERACTIVE_SLOT;
+    }
+
+    for (i = SDAP_ID_INTERACTIVE_SLOT + 1; i < conn_cache->num_slots; i++) {
+        conn_data = conn_cache->cached_connections[i];
+        load = conn_data ? conn_data->num_ops : 0;
+
+        /* on a tie prefer a connection that is already open */
+        if (best_slot == -1 || load < best_load ||
+            (load == best_load && conn_data &&
+             !conn_cache->cached_connections[best_slot])) {
+            best_slot = i;
+            best_load = load;
+        }
+    }
+
+    return best_slot;
+}
+
 /* Begin a connection retry to LDAP server */
 static int sdap_id_op_connect_step(struct tevent_req *req)
 {
@@ -456,9 +555,12 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
     int ret = EOK;
     struct sdap_id_conn_data *conn_data;
     struct tevent_req *subreq = NULL;
+    int slot;
+
+    slot = sdap_id_op_pick_slot(op);
 
     /* Try to reuse context cached connection */
-    conn_data = conn_cache->cached_connection;
+    conn_data = conn_cache->cached_connections[slot];
     if (conn_data) {
         if (conn_data->connect_req) {
             DEBUG(9, ("waiting for connection to complete\n"));
@@ -473,11 +575,11 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
         }
 
         DEBUG(9, ("releasing expired cached connection\n"));
-        conn_cache->cached_connection = NULL;
+        conn_cache->cached_connections[slot] = NULL;
         sdap_id_release_conn_data(conn_data);
     }
 
-    DEBUG(9, ("beginning to connect\n"));
+    DEBUG(9, ("beginning to connect (slot %d)\n", slot));
 
     conn_data = talloc_zero(conn_cache, struct sdap_id_conn_data);
     if (!conn_data) {
@@ -488,6 +590,7 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
     talloc_set_destructor(conn_data, sdap_id_conn_data_destroy);
 
     conn_data->conn_cache = conn_cache;
+    conn_data->slot = slot;
     subreq = sdap_cli_connect_send(conn_data, state->ev,
                                    state->id_ctx->opts,
                                    state->id_ctx->be,
@@ -503,7 +606,7 @@ static int sdap_id_op_connect_step(struct tevent_req *req)
     conn_data->connect_req = subreq;
 
     DLIST_ADD(conn_cache->connections, conn_data);
-    conn_cache->cached_connection = conn_data;
+    conn_cache->cached_connections[slot] = conn_data;
 
     sdap_id_op_hook_conn_data(op, conn_data);
 
@@ -629,9 +732,7 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
             bool retry = false;
 
             /* drop connection from cache now */
-            if (conn_cache->cached_connection == conn_data) {
-                conn_cache->cached_connection = NULL;
-            }
+            sdap_id_conn_uncache(conn_data);
 
             if (can_retry) {
                 /* determining whether retry is possible */
@@ -688,15 +789,13 @@ static void sdap_id_op_connect_done(struct tevent_req *subreq)
         conn_data->sh->connected &&
         !be_is_offline(conn_cache->id_ctx->be)) {
         DEBUG(9, ("caching successful connection after %d notifies\n", notify_count));
-        conn_cache->cached_connection = conn_data;
+        conn_cache->cached_connections[conn_data->slot] = conn_data;
 
         /* Run any post-connection routines */
         be_run_online_cb(conn_cache->id_ctx->be);
 
     } else {
-        if (conn_cache->cached_connection == conn_data) {
-            conn_cache->cached_connection = NULL;
-        }
+        sdap_id_conn_uncache(conn_data);
 
         sdap_id_release_conn_data(conn_data);
     }
@@ -799,9 +898,10 @@ int sdap_id_op_done(struct sdap_id_op *op, int retval, int *dp_err_out)
     }
 
     if (communication_error && current_conn != 0
-            && current_conn == op->conn_cache->cached_connection) {
-        /* do not reuse failed connection */
-        op->conn_cache->cached_connection = NULL;
+            && sdap_id_conn_is_cached(current_conn)) {
+        /* do not reuse failed connection, nor the other connections to
+         * the same server */
+        sdap_id_conn_cache_release_all(op->conn_cache);
 
         DEBUG(5, ("communication error on cached connection, moving to next server\n"));
         be_fo_try_next_server(op->conn_cache->id_ctx->be,
@@ -43,6 +43,12 @@ int sdap_id_conn_cache_create(TALLOC_CTX *memctx,
 /* Create an operation object */
 struct sdap_id_op *sdap_id_op_create(TALLOC_CTX *memctx, struct sdap_id_conn_cache *cache);
 
+/* Mark an operation as bulk work (enumeration, full refresh). Bulk
+ * operations are kept off the connection used by interactive lookups if
+ * the connection pool is larger than one. Must be called before
+ * sdap_id_op_connect_send(). */
+void sdap_id_op_set_bulk(struct sdap_id_op *op, bool bulk);
+
 /* Begin to connect to LDAP server. */
 struct tevent_req *sdap_id_op_connect_send(struct sdap_id_op *op,
                                            TALLOC_CTX *memctx,
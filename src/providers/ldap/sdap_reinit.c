@@ -31,10 +31,13 @@
 struct sdap_reinit_cleanup_state {
     struct sss_domain_info *domain;
     struct sysdb_ctx *sysdb;
+    struct tevent_context *ev;
+    struct sdap_id_ctx *id_ctx;
 };
 
 static errno_t sdap_reinit_clear_usn(struct sysdb_ctx *sysdb,
                                      struct sss_domain_info *domain);
+static void sdap_reinit_cleanup_enumerate(struct tevent_req *subreq);
 static void sdap_reinit_cleanup_done(struct tevent_req *subreq);
 static errno_t sdap_reinit_delete_records(struct sysdb_ctx *sysdb,
                                           struct sss_domain_info *domain);
@@ -65,6 +68,8 @@ struct tevent_req* sdap_reinit_cleanup_send(TALLOC_CTX *mem_ctx,
 
     state->sysdb = be_ctx->domain->sysdb;
     state->domain = be_ctx->domain;
+    state->ev = be_ctx->ev;
+    state->id_ctx = id_ctx;
 
     if (!be_ctx->domain->enumerate) {
         /* enumeration is disabled, this whole process is meaningless */
@@ -79,14 +84,15 @@ struct tevent_req* sdap_reinit_cleanup_send(TALLOC_CTX *mem_ctx,
         goto immediately;
     }
 
-    subreq = ldap_id_enumerate_send(be_ctx->ev, id_ctx);
+    /* the enumeration waits for the queued PAM and identity requests */
+    subreq = be_sched_slot_send(state, be_ctx, BE_REQ_CLASS_BACKGROUND);
     if (subreq == NULL) {
-        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to issue enumeration request\n"));
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to schedule enumeration\n"));
         ret = ENOMEM;
         goto immediately;
     }
 
-    tevent_req_set_callback(subreq, sdap_reinit_cleanup_done, req);
+    tevent_req_set_callback(subreq, sdap_reinit_cleanup_enumerate, req);
 
     return req;
 
@@ -195,6 +201,35 @@ done:
     return ret;
 }
 
+static void sdap_reinit_cleanup_enumerate(struct tevent_req *subreq)
+{
+    struct tevent_req *req = NULL;
+    struct sdap_reinit_cleanup_state *state = NULL;
+    errno_t ret;
+
+    req = tevent_req_callback_data(subreq, struct tevent_req);
+    state = tevent_req_data(req, struct sdap_reinit_cleanup_state);
+
+    /* the slot is allocated on state, it is held until the cleanup
+     * request is freed */
+    ret = be_sched_slot_recv(subreq);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to schedule enumeration "
+                                    "[%d]: %s\n", ret, strerror(ret)));
+        tevent_req_error(req, ret);
+        return;
+    }
+
+    subreq = ldap_id_enumerate_send(state->ev, state->id_ctx);
+    if (subreq == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to issue enumeration request\n"));
+        tevent_req_error(req, ENOMEM);
+        return;
+    }
+
+    tevent_req_set_callback(subreq, sdap_reinit_cleanup_done, req);
+}
+
 static void sdap_reinit_cleanup_done(struct tevent_req *subreq)
 {
     struct tevent_req *req = NULL;
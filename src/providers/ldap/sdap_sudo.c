@@ -586,7 +586,7 @@ static struct tevent_req *sdap_sudo_full_refresh_send(TALLOC_CTX *mem_ctx,
 
     subreq = sdap_sudo_refresh_send(state, id_ctx->be, id_ctx->opts,
                                     id_ctx->conn_cache,
-                                    ldap_full_filter, sysdb_filter);
+                                    ldap_full_filter, sysdb_filter, true);
     if (subreq == NULL) {
         ret = ENOMEM;
         goto immediately;
@@ -766,7 +766,7 @@ static struct tevent_req *sdap_sudo_rules_refresh_send(TALLOC_CTX *mem_ctx,
     }
 
     subreq = sdap_sudo_refresh_send(req, be_ctx, opts, conn_cache,
-                                    ldap_full_filter, sysdb_filter);
+                                    ldap_full_filter, sysdb_filter, false);
     if (subreq == NULL) {
         ret = ENOMEM;
         goto immediately;
@@ -902,7 +902,7 @@ static struct tevent_req *sdap_sudo_smart_refresh_send(TALLOC_CTX *mem_ctx,
 
     subreq = sdap_sudo_refresh_send(state, id_ctx->be, id_ctx->opts,
                                     id_ctx->conn_cache,
-                                    ldap_full_filter, NULL);
+                                    ldap_full_filter, NULL, false);
     if (subreq == NULL) {
         ret = ENOMEM;
         goto immediately;
@@ -1249,8 +1249,11 @@ static int sdap_sudo_schedule_refresh(TALLOC_CTX *mem_ctx,
 
 
 
+    /* full refresh downloads all rules, so it must not delay the
+     * PAM and identity requests of the back end */
     req = sdap_sudo_timer_send(mem_ctx, sudo_ctx->id_ctx->be->ev, sudo_ctx,
-                               when, timeout, send_fn);
+                               when, timeout,
+                               refresh == SDAP_SUDO_REFRESH_FULL, send_fn);
     if (req == NULL) {
         return ENOMEM;
     }
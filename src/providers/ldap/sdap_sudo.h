@@ -50,13 +50,16 @@ int sdap_sudo_init(struct be_ctx *be_ctx,
                    struct bet_ops **ops,
                    void **pvt_data);
 
-/* sdap async interface */
+/* sdap async interface
+ * bulk is set for refreshes that download all rules, see
+ * sdap_id_op_set_bulk() */
 struct tevent_req *sdap_sudo_refresh_send(TALLOC_CTX *mem_ctx,
                                           struct be_ctx *be_ctx,
                                           struct sdap_options *opts,
                                           struct sdap_id_conn_cache *conn_cache,
                                           const char *ldap_filter,
-                                          const char *sysdb_filter);
+                                          const char *sysdb_filter,
+                                          bool bulk);
 
 int sdap_sudo_refresh_recv(TALLOC_CTX *mem_ctx,
                            struct tevent_req *req,
@@ -75,6 +78,7 @@ struct tevent_req * sdap_sudo_timer_send(TALLOC_CTX *mem_ctx,
                                          struct sdap_sudo_ctx *sudo_ctx,
                                          struct timeval when,
                                          time_t timeout,
+                                         bool background,
                                          sdap_sudo_timer_fn_t fn);
 
 int sdap_sudo_timer_recv(TALLOC_CTX *mem_ctx,
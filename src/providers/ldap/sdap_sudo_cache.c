@@ -54,6 +54,34 @@ static errno_t sdap_sudo_get_usn(TALLOC_CTX *mem_ctx,
     return EOK;
 }
 
+/* Rules for +netgroup users can not be found through the sudoUser index,
+ * flag them so that the responder does not need a substring search */
+static errno_t sdap_sudo_set_netgroup_user(struct sysdb_attrs *attrs,
+                                           struct sdap_attr_map *map)
+{
+    struct ldb_message_element *el;
+    bool netgroup = false;
+    errno_t ret;
+    int i;
+
+    ret = sysdb_attrs_get_el_ext(attrs, map[SDAP_AT_SUDO_USER].sys_name,
+                                 false, &el);
+    if (ret == EOK) {
+        for (i = 0; i < el->num_values; i++) {
+            if (el->values[i].length > 0 && el->values[i].data[0] == '+') {
+                netgroup = true;
+                break;
+            }
+        }
+    } else if (ret != ENOENT) {
+        return ret;
+    }
+
+    /* always set, the rule may have lost its last netgroup */
+    return sysdb_attrs_add_bool(attrs, SYSDB_SUDO_CACHE_AT_NETGROUP_USER,
+                                netgroup);
+}
+
 static errno_t
 sdap_save_native_sudorule(TALLOC_CTX *mem_ctx,
                           struct sysdb_ctx *sysdb_ctx,
@@ -83,6 +111,13 @@ sdap_save_native_sudorule(TALLOC_CTX *mem_ctx,
         return ret;
     }
 
+    ret = sdap_sudo_set_netgroup_user(attrs, map);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Could not flag netgroup rule [%d]: %s\n",
+              ret, strerror(ret)));
+        return ret;
+    }
+
     ret = sdap_sudo_get_usn(mem_ctx, attrs, map, rule_name, _usn);
     if (ret != EOK && ret != ENOENT) {
         DEBUG(SSSDBG_OP_FAILURE, ("Could not read USN from %s\n", rule_name));
@@ -20,22 +20,62 @@
 */
 
 #include "util/util.h"
+#include "util/murmurhash3.h"
 #include "confdb/confdb.h"
 #include "responder/common/responder.h"
-#include <fcntl.h>
 #include <time.h>
-#include "tdb.h"
 
-#define NC_ENTRY_PREFIX "NCE/"
-#define NC_USER_PREFIX NC_ENTRY_PREFIX"USER"
-#define NC_GROUP_PREFIX NC_ENTRY_PREFIX"GROUP"
-#define NC_NETGROUP_PREFIX NC_ENTRY_PREFIX"NETGR"
-#define NC_SERVICE_PREFIX NC_ENTRY_PREFIX"SERVICE"
-#define NC_UID_PREFIX NC_ENTRY_PREFIX"UID"
-#define NC_GID_PREFIX NC_ENTRY_PREFIX"GID"
+/* must be a power of 2 */
+#define NC_TABLE_INIT_SIZE 1024
 
+enum sss_nc_type {
+    NC_USER = 0,
+    NC_GROUP,
+    NC_NETGROUP,
+    NC_SERVICE,
+    NC_UID,
+    NC_GID,
+};
+
+/* only used for debug messages */
+static const char *nc_type_prefix[] = {
+    "NCE/USER", "NCE/GROUP", "NCE/NETGR", "NCE/SERVICE", "NCE/UID", "NCE/GID"
+};
+
+enum sss_nc_slot_state {
+    NC_SLOT_EMPTY = 0,
+    NC_SLOT_USED,
+    NC_SLOT_DELETED,
+};
+
+struct sss_nc_key {
+    enum sss_nc_type type;
+    const char *domain;
+    const char *name;
+    uint32_t id;
+    uint32_t hash;
+};
+
+struct sss_nc_entry {
+    enum sss_nc_slot_state state;
+    enum sss_nc_type type;
+    uint32_t hash;
+    uint32_t id;
+    /* domain and name share the same allocation, name follows domain */
+    char *domain;
+    char *name;
+    /* 0 means the entry is permanent */
+    time_t timestamp;
+};
+
+/* The negative cache is an open addressing hash table with linear probing.
+ * Expiration times are stored in binary form so that a check does not need
+ * to allocate or parse anything beyond building the lookup key. */
 struct sss_nc_ctx {
-    struct tdb_context *tdb;
+    struct sss_nc_entry *table;
+    uint32_t size;
+    uint32_t used;
+    uint32_t deleted;
 };
 
 typedef int (*ncache_set_byname_fn_t)(struct sss_nc_ctx *, bool,
@@ -45,16 +85,6 @@ static int sss_ncache_set_ent(struct sss_nc_ctx *ctx, bool permanent,
                               struct sss_domain_info *dom, const char *name,
                               ncache_set_byname_fn_t setter);
 
-static int string_to_tdb_data(char *str, TDB_DATA *ret)
-{
-    if (!str || !ret) return EINVAL;
-
-    ret->dptr = (uint8_t *)str;
-    ret->dsize = strlen(str)+1;
-
-    return EOK;
-}
-
 int sss_ncache_init(TALLOC_CTX *memctx, struct sss_nc_ctx **_ctx)
 {
     struct sss_nc_ctx *ctx;
@@ -62,163 +92,262 @@ int sss_ncache_init(TALLOC_CTX *memctx, struct sss_nc_ctx **_ctx)
     ctx = talloc_zero(memctx, struct sss_nc_ctx);
     if (!ctx) return ENOMEM;
 
-    errno = 0;
-    /* open a memory only tdb with default hash size */
-    ctx->tdb = tdb_open("memcache", 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0);
-    if (!ctx->tdb) return errno;
+    ctx->size = NC_TABLE_INIT_SIZE;
+    ctx->table = talloc_zero_array(ctx, struct sss_nc_entry, ctx->size);
+    if (!ctx->table) {
+        talloc_free(ctx);
+        return ENOMEM;
+    }
 
     *_ctx = ctx;
     return EOK;
 };
 
-static int sss_ncache_check_str(struct sss_nc_ctx *ctx, char *str, int ttl)
+static void sss_ncache_key_init(struct sss_nc_key *key, enum sss_nc_type type,
+                                const char *domain, const char *name,
+                                uint32_t id)
 {
-    TDB_DATA key;
-    TDB_DATA data;
-    unsigned long long int timestamp;
-    bool expired = false;
-    char *ep;
-    int ret;
+    uint32_t hash;
 
-    DEBUG(8, ("Checking negative cache for [%s]\n", str));
+    key->type = type;
+    key->domain = domain;
+    key->name = name;
+    key->id = id;
+
+    hash = murmurhash3((const char *)&key->type, sizeof(key->type), 0);
+    if (name) {
+        hash = murmurhash3(domain, strlen(domain), hash);
+        hash = murmurhash3(name, strlen(name), hash);
+    } else {
+        hash = murmurhash3((const char *)&id, sizeof(id), hash);
+    }
+    key->hash = hash;
+}
 
-    data.dptr = NULL;
+static bool sss_ncache_key_match(struct sss_nc_entry *e,
+                                 struct sss_nc_key *key)
+{
+    if (e->hash != key->hash || e->type != key->type) {
+        return false;
+    }
 
-    ret = string_to_tdb_data(str, &key);
-    if (ret != EOK) goto done;
+    if (key->name == NULL) {
+        return e->name == NULL && e->id == key->id;
+    }
 
-    data = tdb_fetch(ctx->tdb, key);
+    return e->name != NULL &&
+           strcmp(e->name, key->name) == 0 &&
+           strcmp(e->domain, key->domain) == 0;
+}
 
-    if (!data.dptr) {
-        ret = ENOENT;
-        goto done;
+/* Returns the slot holding the key, or if the key is not in the table the
+ * slot where it should be inserted */
+static struct sss_nc_entry *sss_ncache_find_slot(struct sss_nc_ctx *ctx,
+                                                 struct sss_nc_key *key)
+{
+    struct sss_nc_entry *free_slot = NULL;
+    struct sss_nc_entry *e;
+    uint32_t mask = ctx->size - 1;
+    uint32_t idx;
+    uint32_t i;
+
+    idx = key->hash & mask;
+    for (i = 0; i < ctx->size; i++) {
+        e = &ctx->table[(idx + i) & mask];
+
+        switch (e->state) {
+        case NC_SLOT_EMPTY:
+            return free_slot ? free_slot : e;
+        case NC_SLOT_DELETED:
+            if (!free_slot) free_slot = e;
+            break;
+        case NC_SLOT_USED:
+            if (sss_ncache_key_match(e, key)) {
+                return e;
+            }
+            break;
+        }
     }
 
-    if (ttl == -1) {
-        /* a negative ttl means: never expires */
-        ret = EEXIST;
-        goto done;
+    /* the table is never allowed to be full, so we must have seen
+     * at least a deleted slot */
+    return free_slot;
+}
+
+static void sss_ncache_remove_entry(struct sss_nc_ctx *ctx,
+                                    struct sss_nc_entry *e)
+{
+    talloc_zfree(e->domain);
+    e->name = NULL;
+    e->state = NC_SLOT_DELETED;
+    ctx->used--;
+    ctx->deleted++;
+}
+
+/* Move all live entries into a new table of the given size, this also
+ * drops all the deleted slots */
+static int sss_ncache_rehash(struct sss_nc_ctx *ctx, uint32_t size)
+{
+    struct sss_nc_entry *table;
+    struct sss_nc_entry *e;
+    uint32_t mask = size - 1;
+    uint32_t idx;
+    uint32_t i;
+
+    table = talloc_zero_array(ctx, struct sss_nc_entry, size);
+    if (!table) return ENOMEM;
+
+    for (i = 0; i < ctx->size; i++) {
+        if (ctx->table[i].state != NC_SLOT_USED) continue;
+
+        idx = ctx->table[i].hash & mask;
+        for (e = &table[idx]; e->state != NC_SLOT_EMPTY;
+             e = &table[++idx & mask]) ;
+        *e = ctx->table[i];
     }
 
-    errno = 0;
-    timestamp = strtoull((const char *)data.dptr, &ep, 10);
-    if (errno != 0 || *ep != '\0') {
-        /* Malformed entry, remove it and return no entry */
-        expired = true;
-        goto done;
+    talloc_free(ctx->table);
+    ctx->table = table;
+    ctx->size = size;
+    ctx->deleted = 0;
+
+    return EOK;
+}
+
+static int sss_ncache_check_key(struct sss_nc_ctx *ctx,
+                                struct sss_nc_key *key, int ttl)
+{
+    struct sss_nc_entry *e;
+
+    if (key->name) {
+        DEBUG(8, ("Checking negative cache for [%s/%s/%s]\n",
+                  nc_type_prefix[key->type], key->domain, key->name));
+    } else {
+        DEBUG(8, ("Checking negative cache for [%s/%u]\n",
+                  nc_type_prefix[key->type], key->id));
     }
 
-    if (timestamp == 0) {
-        /* a 0 timestamp means this is a permanent entry */
-        ret = EEXIST;
-        goto done;
+    e = sss_ncache_find_slot(ctx, key);
+    if (e == NULL || e->state != NC_SLOT_USED) {
+        return ENOENT;
     }
 
-    if (timestamp + ttl > time(NULL)) {
-        /* still valid */
-        ret = EEXIST;
-        goto done;
+    if (ttl == -1) {
+        /* a negative ttl means: never expires */
+        return EEXIST;
     }
 
-    expired = true;
+    if (e->timestamp == 0) {
+        /* a 0 timestamp means this is a permanent entry */
+        return EEXIST;
+    }
 
-done:
-    if (expired) {
-        /* expired, remove and return no entry */
-        tdb_delete(ctx->tdb, key);
-        ret = ENOENT;
+    if (e->timestamp + ttl > time(NULL)) {
+        /* still valid */
+        return EEXIST;
     }
 
-    free(data.dptr);
-    return ret;
+    /* expired, remove and return no entry */
+    sss_ncache_remove_entry(ctx, e);
+    return ENOENT;
 }
 
-static int sss_ncache_set_str(struct sss_nc_ctx *ctx,
-                              char *str, bool permanent)
+static int sss_ncache_set_key(struct sss_nc_ctx *ctx,
+                              struct sss_nc_key *key, bool permanent)
 {
-    TDB_DATA key;
-    TDB_DATA data;
-    char *timest;
+    struct sss_nc_entry *e;
+    size_t dlen;
+    size_t nlen;
     int ret;
 
-    ret = string_to_tdb_data(str, &key);
-    if (ret != EOK) return ret;
-
-    if (permanent) {
-        timest = talloc_strdup(ctx, "0");
+    if (key->name) {
+        DEBUG(6, ("Adding [%s/%s/%s] to negative cache%s\n",
+                  nc_type_prefix[key->type], key->domain, key->name,
+                  permanent?" permanently":""));
     } else {
-        timest = talloc_asprintf(ctx, "%llu",
-                                 (unsigned long long int)time(NULL));
+        DEBUG(6, ("Adding [%s/%u] to negative cache%s\n",
+                  nc_type_prefix[key->type], key->id,
+                  permanent?" permanently":""));
     }
-    if (!timest) return ENOMEM;
 
-    ret = string_to_tdb_data(timest, &data);
-    if (ret != EOK) goto done;
+    /* keep the load factor, deleted slots included, under 1/2 */
+    if ((ctx->used + ctx->deleted + 1) * 2 > ctx->size) {
+        ret = sss_ncache_rehash(ctx, (ctx->used + 1) * 4 > ctx->size ?
+                                     ctx->size * 2 : ctx->size);
+        if (ret != EOK) {
+            DEBUG(1, ("Negative cache failed to grow the table\n"));
+            return ret;
+        }
+    }
 
-    DEBUG(6, ("Adding [%s] to negative cache%s\n",
-              str, permanent?" permanently":""));
+    e = sss_ncache_find_slot(ctx, key);
+    if (e->state != NC_SLOT_USED) {
+        if (key->name) {
+            dlen = strlen(key->domain) + 1;
+            nlen = strlen(key->name) + 1;
+            e->domain = talloc_size(ctx, dlen + nlen);
+            if (!e->domain) return ENOMEM;
+            memcpy(e->domain, key->domain, dlen);
+            e->name = e->domain + dlen;
+            memcpy(e->name, key->name, nlen);
+        } else {
+            e->domain = NULL;
+            e->name = NULL;
+        }
 
-    ret = tdb_store(ctx->tdb, key, data, TDB_REPLACE);
-    if (ret != 0) {
-        DEBUG(1, ("Negative cache failed to set entry: [%s]\n",
-                  tdb_errorstr(ctx->tdb)));
-        ret = EFAULT;
+        if (e->state == NC_SLOT_DELETED) ctx->deleted--;
+        e->state = NC_SLOT_USED;
+        e->type = key->type;
+        e->hash = key->hash;
+        e->id = key->id;
+        ctx->used++;
     }
 
-done:
-    talloc_free(timest);
-    return ret;
+    e->timestamp = permanent ? 0 : time(NULL);
+
+    return EOK;
 }
 
-static int sss_ncache_check_user_int(struct sss_nc_ctx *ctx, int ttl,
-                                     const char *domain, const char *name)
+static int sss_ncache_check_name(struct sss_nc_ctx *ctx, int ttl,
+                                 enum sss_nc_type type,
+                                 const char *domain, const char *name)
 {
-    char *str;
-    int ret;
+    struct sss_nc_key key;
 
     if (!name || !*name) return EINVAL;
 
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_USER_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_check_str(ctx, str, ttl);
-
-    talloc_free(str);
-    return ret;
+    sss_ncache_key_init(&key, type, domain, name, 0);
+    return sss_ncache_check_key(ctx, &key, ttl);
 }
 
-static int sss_ncache_check_group_int(struct sss_nc_ctx *ctx, int ttl,
-                                      const char *domain, const char *name)
+static int sss_ncache_set_name(struct sss_nc_ctx *ctx, bool permanent,
+                               enum sss_nc_type type,
+                               const char *domain, const char *name)
 {
-    char *str;
-    int ret;
+    struct sss_nc_key key;
 
     if (!name || !*name) return EINVAL;
 
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_GROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
+    sss_ncache_key_init(&key, type, domain, name, 0);
+    return sss_ncache_set_key(ctx, &key, permanent);
+}
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
+static int sss_ncache_check_user_int(struct sss_nc_ctx *ctx, int ttl,
+                                     const char *domain, const char *name)
+{
+    return sss_ncache_check_name(ctx, ttl, NC_USER, domain, name);
+}
 
-    talloc_free(str);
-    return ret;
+static int sss_ncache_check_group_int(struct sss_nc_ctx *ctx, int ttl,
+                                      const char *domain, const char *name)
+{
+    return sss_ncache_check_name(ctx, ttl, NC_GROUP, domain, name);
 }
 
 static int sss_ncache_check_netgr_int(struct sss_nc_ctx *ctx, int ttl,
                                       const char *domain, const char *name)
 {
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_NETGROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_check_str(ctx, str, ttl);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_check_name(ctx, ttl, NC_NETGROUP, domain, name);
 }
 
 static int sss_ncache_check_service_int(struct sss_nc_ctx *ctx,
@@ -226,23 +355,8 @@ static int sss_ncache_check_service_int(struct sss_nc_ctx *ctx,
                                         const char *domain,
                                         const char *name)
 {
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s",
-                          NC_SERVICE_PREFIX,
-                          domain,
-                          name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_check_str(ctx, str, ttl);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_check_name(ctx, ttl, NC_SERVICE, domain, name);
 }
-
 typedef int (*ncache_check_byname_fn_t)(struct sss_nc_ctx *, int,
                                         const char *, const char *);
 
@@ -289,18 +403,7 @@ int sss_ncache_check_netgr(struct sss_nc_ctx *ctx, int ttl,
 static int sss_ncache_set_service_int(struct sss_nc_ctx *ctx, bool permanent,
                                       const char *domain, const char *name)
 {
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_SERVICE_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_name(ctx, permanent, NC_SERVICE, domain, name);
 }
 
 int sss_ncache_set_service_name(struct sss_nc_ctx *ctx, bool permanent,
@@ -375,81 +478,36 @@ int sss_ncache_check_service_port(struct sss_nc_ctx *ctx, int ttl,
 
 int sss_ncache_check_uid(struct sss_nc_ctx *ctx, int ttl, uid_t uid)
 {
-    char *str;
-    int ret;
+    struct sss_nc_key key;
 
-    str = talloc_asprintf(ctx, "%s/%u", NC_UID_PREFIX, uid);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_check_str(ctx, str, ttl);
-
-    talloc_free(str);
-    return ret;
+    sss_ncache_key_init(&key, NC_UID, NULL, NULL, uid);
+    return sss_ncache_check_key(ctx, &key, ttl);
 }
 
 int sss_ncache_check_gid(struct sss_nc_ctx *ctx, int ttl, gid_t gid)
 {
-    char *str;
-    int ret;
-
-    str = talloc_asprintf(ctx, "%s/%u", NC_GID_PREFIX, gid);
-    if (!str) return ENOMEM;
+    struct sss_nc_key key;
 
-    ret = sss_ncache_check_str(ctx, str, ttl);
-
-    talloc_free(str);
-    return ret;
+    sss_ncache_key_init(&key, NC_GID, NULL, NULL, gid);
+    return sss_ncache_check_key(ctx, &key, ttl);
 }
 
 static int sss_ncache_set_user_int(struct sss_nc_ctx *ctx, bool permanent,
                                    const char *domain, const char *name)
 {
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_USER_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_name(ctx, permanent, NC_USER, domain, name);
 }
 
 static int sss_ncache_set_group_int(struct sss_nc_ctx *ctx, bool permanent,
                                     const char *domain, const char *name)
 {
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_GROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_name(ctx, permanent, NC_GROUP, domain, name);
 }
 
 static int sss_ncache_set_netgr_int(struct sss_nc_ctx *ctx, bool permanent,
                                     const char *domain, const char *name)
 {
-    char *str;
-    int ret;
-
-    if (!name || !*name) return EINVAL;
-
-    str = talloc_asprintf(ctx, "%s/%s/%s", NC_NETGROUP_PREFIX, domain, name);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    return sss_ncache_set_name(ctx, permanent, NC_NETGROUP, domain, name);
 }
 
 static int sss_ncache_set_ent(struct sss_nc_ctx *ctx, bool permanent,
@@ -492,75 +550,34 @@ int sss_ncache_set_netgr(struct sss_nc_ctx *ctx, bool permanent,
 
 int sss_ncache_set_uid(struct sss_nc_ctx *ctx, bool permanent, uid_t uid)
 {
-    char *str;
-    int ret;
-
-    str = talloc_asprintf(ctx, "%s/%u", NC_UID_PREFIX, uid);
-    if (!str) return ENOMEM;
+    struct sss_nc_key key;
 
-    ret = sss_ncache_set_str(ctx, str, permanent);
-
-    talloc_free(str);
-    return ret;
+    sss_ncache_key_init(&key, NC_UID, NULL, NULL, uid);
+    return sss_ncache_set_key(ctx, &key, permanent);
 }
 
 int sss_ncache_set_gid(struct sss_nc_ctx *ctx, bool permanent, gid_t gid)
 {
-    char *str;
-    int ret;
-
-    str = talloc_asprintf(ctx, "%s/%u", NC_GID_PREFIX, gid);
-    if (!str) return ENOMEM;
-
-    ret = sss_ncache_set_str(ctx, str, permanent);
+    struct sss_nc_key key;
 
-    talloc_free(str);
-    return ret;
-}
-
-static int delete_permanent(struct tdb_context *tdb,
-                            TDB_DATA key, TDB_DATA data, void *state)
-{
-    unsigned long long int timestamp;
-    bool remove_key = false;
-    char *ep;
-
-    if (strncmp((char *)key.dptr,
-                NC_ENTRY_PREFIX, sizeof(NC_ENTRY_PREFIX)) != 0) {
-        /* not interested in this key */
-        return 0;
-    }
-
-    errno = 0;
-    timestamp = strtoull((const char *)data.dptr, &ep, 10);
-    if (errno != 0 || *ep != '\0') {
-        /* Malformed entry, remove it */
-        remove_key = true;
-        goto done;
-    }
-
-    if (timestamp == 0) {
-        /* a 0 timestamp means this is a permanent entry */
-        remove_key = true;
-    }
-
-done:
-    if (remove_key) {
-        return tdb_delete(tdb, key);
-    }
-
-    return 0;
+    sss_ncache_key_init(&key, NC_GID, NULL, NULL, gid);
+    return sss_ncache_set_key(ctx, &key, permanent);
 }
 
 int sss_ncache_reset_permament(struct sss_nc_ctx *ctx)
 {
-    int ret;
+    uint32_t i;
 
-    ret = tdb_traverse(ctx->tdb, delete_permanent, NULL);
-    if (ret < 0)
-        return EIO;
+    for (i = 0; i < ctx->size; i++) {
+        if (ctx->table[i].state == NC_SLOT_USED &&
+            ctx->table[i].timestamp == 0) {
+            /* a 0 timestamp means this is a permanent entry */
+            sss_ncache_remove_entry(ctx, &ctx->table[i]);
+        }
+    }
 
-    return EOK;
+    /* purge all the deleted slots at once */
+    return sss_ncache_rehash(ctx, ctx->size);
 }
 
 errno_t sss_ncache_prepopulate(struct sss_nc_ctx *ncache,
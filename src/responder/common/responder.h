@@ -33,6 +33,7 @@
 #include "dhash.h"
 #include "sbus/sssd_dbus.h"
 #include "sss_client/sss_cli.h"
+#include "responder/common/responder_cache.h"
 
 extern hash_table_t *dp_requests;
 
@@ -48,6 +49,14 @@ struct cli_request {
 
     /* reply data */
     struct sss_packet *out;
+
+    /* pipelined request context, NULL if the request is executed
+     * directly on the connection */
+    struct cli_ctx *pipe_ctx;
+
+    /* replies waiting to be sent on the connection */
+    struct cli_request *prev;
+    struct cli_request *next;
 };
 
 struct cli_protocol_version {
@@ -95,6 +104,9 @@ struct resp_ctx {
 
     hash_table_t *dp_request_table;
 
+    /* recent sysdb lookup results */
+    struct sss_rc_ctx *result_cache;
+
     struct timeval get_domains_last_call;
 
     size_t allowed_uids_count;
@@ -135,8 +147,24 @@ struct cli_ctx {
     char *automntmap_name;
 
     struct tevent_timer *idle;
+
+    /* connection a pipelined request belongs to, NULL on the
+     * connection context itself */
+    struct cli_ctx *conn;
+
+    /* queue of requests whose reply is ready to be sent */
+    struct cli_request *replies;
+    /* true while a non pipelined request is being processed */
+    bool busy;
+    /* number of pipelined requests being processed */
+    int pipe_inflight;
+    bool closing;
 };
 
+/* Maximum number of pipelined requests processed at the same time on a
+ * single client connection */
+#define SSS_CLI_MAX_PIPELINED_REQS 32
+
 struct sss_cmd_table {
     enum sss_cli_command cmd;
     int (*fn)(struct cli_ctx *cctx);
@@ -178,6 +206,7 @@ int sss_cmd_send_empty(struct cli_ctx *cctx, TALLOC_CTX *freectx);
 int sss_cmd_send_error(struct cli_ctx *cctx, int err);
 void sss_cmd_done(struct cli_ctx *cctx, void *freectx);
 int sss_cmd_get_version(struct cli_ctx *cctx);
+bool sss_cmd_can_pipeline(enum sss_cli_command cmd);
 int sss_cmd_execute(struct cli_ctx *cctx,
                     enum sss_cli_command cmd,
                     struct sss_cmd_table *sss_cmds);
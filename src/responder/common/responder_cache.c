@@ -0,0 +1,220 @@
+/*
+   SSSD
+
+   Responders - short lived cache of sysdb lookup results
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include "util/util.h"
+#include "db/sysdb.h"
+#include "responder/common/responder_table.h"
+#include "responder/common/responder_cache.h"
+
+#define RC_TABLE_INIT_SIZE 64
+/* bounds the memory used when many different names are looked up */
+#define RC_MAX_ENTRIES 10000
+
+/* only used for debug messages and keys */
+static const char *rc_type_prefix[] = {
+    "PWNAM", "PWUID", "GRNAM", "GRGID", "INITGR"
+};
+
+struct sss_rc_entry {
+    struct sss_rtable_entry base;
+    struct ldb_result *res;
+};
+
+struct sss_rc_ctx {
+    struct sss_rtable *table;
+    int timeout;
+};
+
+errno_t sss_rc_init(TALLOC_CTX *mem_ctx, int timeout,
+                    struct sss_rc_ctx **_rc)
+{
+    struct sss_rc_ctx *rc;
+    errno_t ret;
+
+    rc = talloc_zero(mem_ctx, struct sss_rc_ctx);
+    if (!rc) return ENOMEM;
+
+    rc->timeout = timeout < 0 ? 0 : timeout;
+
+    ret = sss_rtable_init(rc, "Result cache", RC_TABLE_INIT_SIZE,
+                          RC_MAX_ENTRIES, rc->timeout, NULL, &rc->table);
+    if (ret != EOK) {
+        talloc_free(rc);
+        return ret;
+    }
+
+    *_rc = rc;
+    return EOK;
+}
+
+static char *sss_rc_key(TALLOC_CTX *mem_ctx, enum sss_rc_type type,
+                        struct sss_domain_info *dom,
+                        const char *name, uint32_t id)
+{
+    if (name) {
+        return talloc_asprintf(mem_ctx, "%s/%s/%s",
+                               rc_type_prefix[type], dom->name, name);
+    }
+    return talloc_asprintf(mem_ctx, "%s/%s/%u",
+                           rc_type_prefix[type], dom->name, (unsigned int)id);
+}
+
+/* Results are copied in and out of the cache, the callers own what they
+ * get and are free to steal or modify it */
+static struct ldb_result *sss_rc_copy_result(TALLOC_CTX *mem_ctx,
+                                             struct ldb_result *res)
+{
+    struct ldb_result *copy;
+    unsigned int i;
+
+    copy = talloc_zero(mem_ctx, struct ldb_result);
+    if (!copy) return NULL;
+
+    copy->msgs = talloc_array(copy, struct ldb_message *, res->count);
+    if (!copy->msgs) {
+        talloc_free(copy);
+        return NULL;
+    }
+
+    for (i = 0; i < res->count; i++) {
+        copy->msgs[i] = ldb_msg_copy(copy->msgs, res->msgs[i]);
+        if (!copy->msgs[i]) {
+            talloc_free(copy);
+            return NULL;
+        }
+    }
+    copy->count = res->count;
+
+    return copy;
+}
+
+errno_t sss_rc_lookup(struct sss_rc_ctx *rc, TALLOC_CTX *mem_ctx,
+                      enum sss_rc_type type, struct sss_domain_info *dom,
+                      const char *name, uint32_t id,
+                      struct ldb_result **_res)
+{
+    struct sss_rc_entry *entry;
+    struct ldb_result *res;
+    char *keystr;
+
+    if (rc == NULL || rc->timeout == 0) return ENOENT;
+
+    keystr = sss_rc_key(NULL, type, dom, name, id);
+    if (!keystr) return ENOMEM;
+
+    entry = (struct sss_rc_entry *)sss_rtable_lookup(rc->table, keystr);
+    talloc_free(keystr);
+    if (!entry) return ENOENT;
+
+    res = sss_rc_copy_result(mem_ctx, entry->res);
+    if (!res) return ENOMEM;
+
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("Result for [%s] found in the result cache\n",
+                                  entry->base.key.str));
+
+    *_res = res;
+    return EOK;
+}
+
+errno_t sss_rc_store(struct sss_rc_ctx *rc,
+                     enum sss_rc_type type, struct sss_domain_info *dom,
+                     const char *name, uint32_t id,
+                     struct ldb_result *res)
+{
+    struct sss_rc_entry *entry;
+    char *keystr;
+    errno_t ret;
+
+    if (rc == NULL || rc->timeout == 0) return EOK;
+    if (res == NULL || res->count == 0) return EOK;
+
+    keystr = sss_rc_key(NULL, type, dom, name, id);
+    if (!keystr) return ENOMEM;
+
+    entry = talloc_zero(rc->table, struct sss_rc_entry);
+    if (!entry) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    entry->res = sss_rc_copy_result(entry, res);
+    if (!entry->res) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_rtable_add(rc->table, &entry->base, keystr,
+                         time(NULL) + rc->timeout);
+
+done:
+    if (ret != EOK) {
+        talloc_free(entry);
+    }
+    talloc_free(keystr);
+    return ret;
+}
+
+void sss_rc_invalidate(struct sss_rc_ctx *rc,
+                       enum sss_rc_type type, struct sss_domain_info *dom,
+                       const char *name, uint32_t id)
+{
+    char *keystr;
+
+    if (rc == NULL) return;
+
+    keystr = sss_rc_key(NULL, type, dom, name, id);
+    if (!keystr) return;
+
+    talloc_free(sss_rtable_find(rc->table, keystr));
+    talloc_free(keystr);
+}
+
+void sss_rc_clear(struct sss_rc_ctx *rc)
+{
+    if (rc == NULL) return;
+
+    sss_rtable_clear(rc->table);
+}
+
+void sss_rc_get_stats(struct sss_rc_ctx *rc, struct sss_rc_stats *stats)
+{
+    struct sss_rtable_stats st;
+
+    if (rc == NULL) {
+        memset(stats, 0, sizeof(struct sss_rc_stats));
+        return;
+    }
+
+    sss_rtable_get_stats(rc->table, &st);
+
+    stats->hits = st.hits;
+    stats->misses = st.misses;
+    stats->stores = st.stores;
+    stats->expired = st.expired;
+    stats->evicted = st.evicted;
+    stats->entries = st.entries;
+}
+
+void sss_rc_log_stats(struct sss_rc_ctx *rc)
+{
+    if (rc == NULL || rc->timeout == 0) return;
+
+    sss_rtable_log_stats(rc->table);
+}
@@ -0,0 +1,83 @@
+/*
+   SSSD
+
+   Responders - short lived cache of sysdb lookup results
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RESPONDER_CACHE_H_
+#define _RESPONDER_CACHE_H_
+
+/* Identical lookups arriving within a few seconds of each other, as during
+ * a login storm, are answered from the result of the first sysdb search
+ * instead of searching again. Results are still checked for expiration by
+ * the caller, this cache only saves the search itself. The least recently
+ * used results make room when the cache is full. A NULL cache or a timeout
+ * of 0 disables it.
+ *
+ * Callers only look results up on the first pass of a request. A search made
+ * after the data provider returned always goes to sysdb, so that the entry
+ * the provider just wrote is seen, and its result replaces the cached one.
+ * Entries the data provider updates behind the responder's back must be
+ * dropped with sss_rc_invalidate() or sss_rc_clear(). */
+
+struct sss_rc_ctx;
+
+enum sss_rc_type {
+    SSS_RC_PWNAM = 0,
+    SSS_RC_PWUID,
+    SSS_RC_GRNAM,
+    SSS_RC_GRGID,
+    SSS_RC_INITGR,
+};
+
+struct sss_rc_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t expired;       /* entries dropped because they were too old */
+    uint64_t evicted;       /* entries dropped to make room */
+    uint32_t entries;
+};
+
+errno_t sss_rc_init(TALLOC_CTX *mem_ctx, int timeout,
+                    struct sss_rc_ctx **_rc);
+
+/* On a hit *_res is a copy of the cached result allocated on mem_ctx.
+ * Returns ENOENT if the lookup is not cached. */
+errno_t sss_rc_lookup(struct sss_rc_ctx *rc, TALLOC_CTX *mem_ctx,
+                      enum sss_rc_type type, struct sss_domain_info *dom,
+                      const char *name, uint32_t id,
+                      struct ldb_result **_res);
+
+/* Only results with at least one entry are stored. The cache keeps its own
+ * copy, res stays with the caller. */
+errno_t sss_rc_store(struct sss_rc_ctx *rc,
+                     enum sss_rc_type type, struct sss_domain_info *dom,
+                     const char *name, uint32_t id,
+                     struct ldb_result *res);
+
+/* Drops the cached result of a single lookup, if any */
+void sss_rc_invalidate(struct sss_rc_ctx *rc,
+                       enum sss_rc_type type, struct sss_domain_info *dom,
+                       const char *name, uint32_t id);
+
+void sss_rc_clear(struct sss_rc_ctx *rc);
+
+void sss_rc_get_stats(struct sss_rc_ctx *rc, struct sss_rc_stats *stats);
+
+void sss_rc_log_stats(struct sss_rc_ctx *rc);
+
+#endif /* _RESPONDER_CACHE_H_ */
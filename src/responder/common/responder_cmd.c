@@ -81,9 +81,15 @@ int sss_cmd_send_empty(struct cli_ctx *cctx, TALLOC_CTX *freectx)
 
 void sss_cmd_done(struct cli_ctx *cctx, void *freectx)
 {
-    /* now that the packet is in place, unlock queue
-     * making the event writable */
-    TEVENT_FD_WRITEABLE(cctx->cfde);
+    struct cli_ctx *conn = cctx->conn ? cctx->conn : cctx;
+
+    /* echo the request ID so that the client can match the reply */
+    sss_packet_set_id(cctx->creq->out, sss_packet_get_id(cctx->creq->in));
+
+    /* now that the packet is in place, queue it on the connection
+     * and unlock queue making the event writable */
+    DLIST_ADD_END(conn->replies, cctx->creq, struct cli_request *);
+    TEVENT_FD_WRITEABLE(conn->cfde);
 
     /* free all request related data through the talloc hierarchy */
     talloc_free(freectx);
@@ -155,6 +161,29 @@ int sss_cmd_execute(struct cli_ctx *cctx,
 
     return EINVAL;
 }
+
+/* Only self-contained lookups can be processed in parallel on the same
+ * connection, commands that keep state in the client context (like
+ * enumerations or the protocol version) must be serialized. */
+bool sss_cmd_can_pipeline(enum sss_cli_command cmd)
+{
+    switch (cmd) {
+    case SSS_NSS_GETPWNAM:
+    case SSS_NSS_GETPWUID:
+    case SSS_NSS_GETPWUID_BULK:
+    case SSS_NSS_GETGRNAM:
+    case SSS_NSS_GETGRGID:
+    case SSS_NSS_INITGR:
+    case SSS_NSS_GETSERVBYNAME:
+    case SSS_NSS_GETSERVBYPORT:
+    case SSS_SSH_GET_USER_PUBKEYS:
+    case SSS_SSH_GET_HOST_PUBKEYS:
+        return true;
+    default:
+        return false;
+    }
+}
+
 struct setent_req_list {
     struct setent_req_list *prev;
     struct setent_req_list *next;
@@ -40,6 +40,7 @@
 #include "sbus/sssd_dbus.h"
 #include "responder/common/responder.h"
 #include "responder/common/responder_packet.h"
+#include "responder/common/responder_private.h"
 #include "providers/data_provider.h"
 #include "monitor/monitor_interfaces.h"
 #include "sbus/sbus_client.h"
@@ -90,6 +91,9 @@ static int client_destructor(struct cli_ctx *ctx)
 {
     errno_t ret;
 
+    /* pipelined requests are freed with the connection */
+    ctx->closing = true;
+
     if ((ctx->cfd > 0) && close(ctx->cfd) < 0) {
         ret = errno;
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -239,11 +243,36 @@ done:
 }
 
 
+static void idle_handler(struct tevent_context *ev,
+                         struct tevent_timer *te,
+                         struct timeval current_time,
+                         void *data);
+
+static void client_update_readable(struct cli_ctx *cctx)
+{
+    if (cctx->busy || cctx->closing ||
+        cctx->pipe_inflight >= SSS_CLI_MAX_PIPELINED_REQS) {
+        TEVENT_FD_NOT_READABLE(cctx->cfde);
+    } else {
+        TEVENT_FD_READABLE(cctx->cfde);
+    }
+}
+
 static void client_send(struct cli_ctx *cctx)
 {
+    struct cli_request *req;
+    struct cli_ctx *pctx;
     int ret;
 
-    ret = sss_packet_send(cctx->creq->out, cctx->cfd);
+    /* replies are sent one at a time in the order they are ready,
+     * a partially sent reply always stays at the head of the queue */
+    req = cctx->replies;
+    if (req == NULL) {
+        TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
+        return;
+    }
+
+    ret = sss_packet_send(req->out, cctx->cfd);
     if (ret == EAGAIN) {
         /* not all data was sent, loop again */
         return;
@@ -255,10 +284,22 @@ static void client_send(struct cli_ctx *cctx)
     }
 
     /* ok all sent */
-    TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
-    TEVENT_FD_READABLE(cctx->cfde);
-    talloc_free(cctx->creq);
-    cctx->creq = NULL;
+    DLIST_REMOVE(cctx->replies, req);
+    if (req->pipe_ctx) {
+        pctx = req->pipe_ctx;
+        pctx->conn = NULL;
+        talloc_free(pctx);
+        cctx->pipe_inflight--;
+    } else {
+        talloc_free(cctx->creq);
+        cctx->creq = NULL;
+        cctx->busy = false;
+    }
+
+    if (cctx->replies == NULL) {
+        TEVENT_FD_NOT_WRITEABLE(cctx->cfde);
+    }
+    client_update_readable(cctx);
     return;
 }
 
@@ -270,6 +311,79 @@ static int client_cmd_execute(struct cli_ctx *cctx, struct sss_cmd_table *sss_cm
     return sss_cmd_execute(cctx, cmd, sss_cmds);
 }
 
+static int pipe_ctx_destructor(struct cli_ctx *pctx)
+{
+    struct cli_ctx *conn = pctx->conn;
+
+    if (conn == NULL || conn->closing) {
+        return 0;
+    }
+
+    /* The request was aborted without sending a reply, the client would
+     * wait for it forever. Terminate the connection as it would happen
+     * for a non pipelined request, but not from within this destructor,
+     * the connection is still referenced by the caller. */
+    DEBUG(SSSDBG_OP_FAILURE,
+          ("Pipelined request aborted, terminating client [%p][%d]\n",
+           conn, conn->cfd));
+
+    DLIST_REMOVE(conn->replies, pctx->creq);
+    conn->pipe_inflight--;
+    conn->closing = true;
+    TEVENT_FD_NOT_READABLE(conn->cfde);
+    TEVENT_FD_NOT_WRITEABLE(conn->cfde);
+
+    talloc_zfree(conn->idle);
+    conn->idle = tevent_add_timer(conn->ev, conn, tevent_timeval_zero(),
+                                  idle_handler, conn);
+    if (!conn->idle) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("Could not schedule client termination\n"));
+    }
+
+    return 0;
+}
+
+/* Execute the request in its own context so that the connection can keep
+ * receiving new requests while this one is being processed. */
+static int client_pipeline_execute(struct cli_ctx *cctx)
+{
+    struct cli_ctx *pctx;
+
+    pctx = talloc_zero(cctx, struct cli_ctx);
+    if (!pctx) {
+        return ENOMEM;
+    }
+
+    pctx->ev = cctx->ev;
+    pctx->rctx = cctx->rctx;
+    pctx->cfd = cctx->cfd;
+    pctx->addr = cctx->addr;
+    pctx->cli_protocol_version = cctx->cli_protocol_version;
+    pctx->priv = cctx->priv;
+    pctx->client_euid = cctx->client_euid;
+    pctx->client_egid = cctx->client_egid;
+    pctx->client_pid = cctx->client_pid;
+    pctx->conn = cctx;
+
+    pctx->creq = talloc_steal(pctx, cctx->creq);
+    pctx->creq->pipe_ctx = pctx;
+    cctx->creq = NULL;
+
+    cctx->pipe_inflight++;
+    talloc_set_destructor(pctx, pipe_ctx_destructor);
+
+    /* keep reading unless too many requests are in flight */
+    client_update_readable(cctx);
+
+    DEBUG(SSSDBG_TRACE_ALL,
+          ("Pipelined request [%u] on client [%p][%d], %d in flight\n",
+           sss_packet_get_id(pctx->creq->in), cctx, cctx->cfd,
+           cctx->pipe_inflight));
+
+    return client_cmd_execute(pctx, cctx->rctx->sss_cmds);
+}
+
 static void client_recv(struct cli_ctx *cctx)
 {
     int ret;
@@ -296,10 +410,18 @@ static void client_recv(struct cli_ctx *cctx)
     ret = sss_packet_recv(cctx->creq->in, cctx->cfd);
     switch (ret) {
     case EOK:
-        /* do not read anymore */
-        TEVENT_FD_NOT_READABLE(cctx->cfde);
-        /* execute command */
-        ret = client_cmd_execute(cctx, cctx->rctx->sss_cmds);
+        if (sss_packet_get_id(cctx->creq->in) != 0 &&
+            sss_cmd_can_pipeline(sss_packet_get_cmd(cctx->creq->in))) {
+            /* the client tagged the request, it can handle replies
+             * out of order */
+            ret = client_pipeline_execute(cctx);
+        } else {
+            /* do not read anymore */
+            cctx->busy = true;
+            TEVENT_FD_NOT_READABLE(cctx->cfde);
+            /* execute command */
+            ret = client_cmd_execute(cctx, cctx->rctx->sss_cmds);
+        }
         if (ret != EOK) {
             DEBUG(0, ("Failed to execute request, aborting client!\n"));
             talloc_free(cctx);
@@ -363,11 +485,6 @@ struct accept_fd_ctx {
     bool is_private;
 };
 
-static void idle_handler(struct tevent_context *ev,
-                         struct tevent_timer *te,
-                         struct timeval current_time,
-                         void *data);
-
 static void accept_fd_handler(struct tevent_context *ev,
                               struct tevent_fd *fde,
                               uint16_t flags, void *ptr)
@@ -568,7 +685,7 @@ static int sss_dp_init(struct resp_ctx *rctx,
 }
 
 /* create a unix socket and listen to it */
-static int set_unix_socket(struct resp_ctx *rctx)
+int set_unix_socket(struct resp_ctx *rctx)
 {
     struct sockaddr_un addr;
     errno_t ret;
@@ -734,6 +851,8 @@ static int sss_responder_ctx_destructor(void *ptr)
     DEBUG(SSSDBG_TRACE_FUNC, ("Responder is being shut down\n"));
     rctx->shutting_down = true;
 
+    sss_rc_log_stats(rctx->result_cache);
+
     return 0;
 }
 
@@ -753,6 +872,7 @@ int sss_process_init(TALLOC_CTX *mem_ctx,
 {
     struct resp_ctx *rctx;
     struct sss_domain_info *dom;
+    int result_cache_timeout;
     int ret;
 
     rctx = talloc_zero(mem_ctx, struct resp_ctx);
@@ -786,6 +906,23 @@ int sss_process_init(TALLOC_CTX *mem_ctx,
         rctx->client_idle_timeout = 10;
     }
 
+    ret = confdb_get_int(rctx->cdb, rctx->confdb_service_path,
+                         CONFDB_RESPONDER_RESULT_CACHE_TIMEOUT,
+                         CONFDB_RESPONDER_RESULT_CACHE_DEFAULT_TIMEOUT,
+                         &result_cache_timeout);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Cannot get the result cache timeout [%d]: %s\n",
+               ret, strerror(ret)));
+        goto fail;
+    }
+
+    ret = sss_rc_init(rctx, result_cache_timeout, &rctx->result_cache);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, ("fatal error initializing result cache\n"));
+        goto fail;
+    }
+
     ret = confdb_get_int(rctx->cdb, rctx->confdb_service_path,
                          CONFDB_RESPONDER_GET_DOMAINS_TIMEOUT,
                          GET_DOMAINS_DEFAULT_TIMEOUT, &rctx->domains_timeout);
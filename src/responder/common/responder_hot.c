@@ -0,0 +1,308 @@
+/*
+   SSSD
+
+   Responders - refresh-ahead of frequently used cache entries
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "providers/data_provider.h"
+#include "responder/common/responder.h"
+#include "responder/common/responder_table.h"
+#include "responder/common/responder_hot.h"
+
+#define HOT_TABLE_INIT_SIZE 256
+/* bounds the memory used when many different names are looked up, the
+ * coldest entries make room for new ones */
+#define HOT_MAX_ENTRIES 10000
+
+static const char *hot_type_prefix[] = { "USER", "GROUP", "NETGR" };
+
+static const uint32_t hot_be_type[] = {
+    BE_REQ_USER, BE_REQ_GROUP, BE_REQ_NETGROUP
+};
+
+struct sss_hot_entry {
+    struct sss_rtable_entry base;
+    struct sss_hot_ctx *hot;
+    enum sss_hot_type type;
+    /* subdomains may go away, so only the name is kept */
+    char *domain;
+    char *name;
+    uint32_t hits;
+};
+
+struct sss_hot_ctx {
+    struct resp_ctx *rctx;
+    struct sss_rtable *table;
+    uint32_t interval;
+    uint32_t min_hits;
+};
+
+static void sss_hot_timer(struct tevent_context *ev,
+                          struct tevent_timer *te,
+                          struct timeval tv, void *pvt);
+
+/* Entries requested often enough are kept, but cool down so that they do not
+ * stay forever once they are no longer used */
+static bool sss_hot_evict(struct sss_rtable_entry *base)
+{
+    struct sss_hot_entry *entry = (struct sss_hot_entry *)base;
+
+    if (entry->hits < entry->hot->min_hits) {
+        return true;
+    }
+
+    entry->hits /= 2;
+    return false;
+}
+
+static errno_t sss_hot_schedule(struct sss_hot_ctx *hot)
+{
+    struct tevent_timer *te;
+
+    te = tevent_add_timer(hot->rctx->ev, hot,
+                          tevent_timeval_current_ofs(hot->interval, 0),
+                          sss_hot_timer, hot);
+    if (te == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Unable to schedule refresh-ahead\n"));
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+errno_t sss_hot_init(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
+                     int interval, int min_hits,
+                     struct sss_hot_ctx **_hot)
+{
+    struct sss_hot_ctx *hot;
+    errno_t ret;
+
+    if (interval <= 0) {
+        *_hot = NULL;
+        return EOK;
+    }
+
+    hot = talloc_zero(mem_ctx, struct sss_hot_ctx);
+    if (!hot) return ENOMEM;
+
+    hot->rctx = rctx;
+    hot->interval = interval;
+    hot->min_hits = min_hits < 1 ? 1 : min_hits;
+
+    ret = sss_rtable_init(hot, "Refresh-ahead", HOT_TABLE_INIT_SIZE,
+                          HOT_MAX_ENTRIES, 0, sss_hot_evict, &hot->table);
+    if (ret != EOK) {
+        talloc_free(hot);
+        return ret;
+    }
+
+    ret = sss_hot_schedule(hot);
+    if (ret != EOK) {
+        talloc_free(hot);
+        return ret;
+    }
+
+    *_hot = hot;
+    return EOK;
+}
+
+void sss_hot_record(struct sss_hot_ctx *hot, enum sss_hot_type type,
+                    struct sss_domain_info *dom, const char *name)
+{
+    struct sss_hot_entry *entry = NULL;
+    char *keystr;
+    errno_t ret;
+
+    if (hot == NULL || name == NULL) return;
+
+    keystr = talloc_asprintf(hot, "%s/%s/%s",
+                             hot_type_prefix[type], dom->name, name);
+    if (!keystr) return;
+
+    entry = (struct sss_hot_entry *)sss_rtable_lookup(hot->table, keystr);
+    if (entry) {
+        entry->hits++;
+        talloc_free(keystr);
+        return;
+    }
+
+    entry = talloc_zero(hot->table, struct sss_hot_entry);
+    if (!entry) goto done;
+
+    entry->hot = hot;
+    entry->type = type;
+    entry->hits = 1;
+    entry->domain = talloc_strdup(entry, dom->name);
+    entry->name = talloc_strdup(entry, name);
+    if (!entry->domain || !entry->name) {
+        talloc_free(entry);
+        goto done;
+    }
+
+    ret = sss_rtable_add(hot->table, &entry->base, keystr, 0);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Unable to track [%s]\n", keystr));
+        talloc_free(entry);
+    }
+
+done:
+    talloc_free(keystr);
+}
+
+static void sss_hot_reply(DBusPendingCall *pending, void *ptr)
+{
+    DBusMessage *reply;
+
+    /* the back end answers before it refreshes, nothing to do here */
+    reply = dbus_pending_call_steal_reply(pending);
+    if (reply) {
+        dbus_message_unref(reply);
+    }
+    dbus_pending_call_unref(pending);
+}
+
+static errno_t sss_hot_send(struct sss_hot_ctx *hot,
+                            struct sss_domain_info *dom,
+                            enum sss_hot_type type,
+                            const char **names, uint32_t num_names)
+{
+    struct be_conn *be_conn;
+    DBusMessage *msg;
+    DBusMessageIter iter;
+    dbus_bool_t dbret;
+    uint32_t be_type = hot_be_type[type];
+    /* refresh whatever would expire before the next round */
+    uint32_t window = 2 * hot->interval;
+    uint32_t i;
+    errno_t ret;
+
+    ret = sss_dp_get_domain_conn(hot->rctx, dom->conn_name, &be_conn);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("The Data Provider connection for %s is not available\n",
+               dom->name));
+        return ret;
+    }
+
+    msg = dbus_message_new_method_call(NULL,
+                                       DP_PATH,
+                                       DP_INTERFACE,
+                                       DP_METHOD_REFRESHHOT);
+    if (msg == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Out of memory?!\n"));
+        return ENOMEM;
+    }
+
+    dbus_message_iter_init_append(msg, &iter);
+
+    dbret = dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &be_type);
+    if (!dbret) goto fail;
+    dbret = dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &window);
+    if (!dbret) goto fail;
+    /* the back end serves the subdomains of its domain as well */
+    dbret = dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING,
+                                           &dom->name);
+    if (!dbret) goto fail;
+    dbret = dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+                                           &num_names);
+    if (!dbret) goto fail;
+
+    for (i = 0; i < num_names; i++) {
+        dbret = dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING,
+                                               &names[i]);
+        if (!dbret) goto fail;
+    }
+
+    ret = sbus_conn_send(be_conn->conn, msg, SSS_CLI_SOCKET_TIMEOUT / 2,
+                         sss_hot_reply, NULL, NULL);
+    dbus_message_unref(msg);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("D-BUS send failed.\n"));
+        return ret;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Asked the back end of %s to refresh %u %s entries\n",
+           dom->name, num_names, hot_type_prefix[type]));
+
+    return EOK;
+
+fail:
+    DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to build message\n"));
+    dbus_message_unref(msg);
+    return ENOMEM;
+}
+
+static void sss_hot_flush(struct sss_hot_ctx *hot)
+{
+    struct sss_domain_info *dom;
+    struct sss_rtable_stats stats;
+    struct sss_rtable_entry *base;
+    struct sss_rtable_entry *next;
+    struct sss_hot_entry *entry;
+    const char **names;
+    uint32_t num_names;
+    int type;
+
+    sss_rtable_get_stats(hot->table, &stats);
+    if (stats.entries == 0) return;
+
+    names = talloc_array(hot, const char *, stats.entries);
+    if (!names) goto done;
+
+    for (dom = hot->rctx->domains; dom; dom = get_next_domain(dom, true)) {
+        for (type = SSS_HOT_USER; type <= SSS_HOT_NETGR; type++) {
+            num_names = 0;
+            for (base = sss_rtable_first(hot->table); base; base = base->next) {
+                entry = (struct sss_hot_entry *)base;
+                if (entry->type != type
+                        || entry->hits < hot->min_hits
+                        || strcmp(entry->domain, dom->name) != 0) {
+                    continue;
+                }
+                names[num_names++] = entry->name;
+            }
+
+            if (num_names > 0) {
+                sss_hot_send(hot, dom, type, names, num_names);
+            }
+        }
+    }
+
+done:
+    /* let entries that are no longer requested cool down */
+    for (base = sss_rtable_first(hot->table); base; base = next) {
+        next = base->next;
+        entry = (struct sss_hot_entry *)base;
+        entry->hits /= 2;
+        if (entry->hits == 0) {
+            talloc_free(entry);
+        }
+    }
+
+    talloc_free(names);
+}
+
+static void sss_hot_timer(struct tevent_context *ev,
+                          struct tevent_timer *te,
+                          struct timeval tv, void *pvt)
+{
+    struct sss_hot_ctx *hot = talloc_get_type(pvt, struct sss_hot_ctx);
+
+    sss_hot_flush(hot);
+    sss_hot_schedule(hot);
+}
@@ -0,0 +1,46 @@
+/*
+   SSSD
+
+   Responders - refresh-ahead of frequently used cache entries
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RESPONDER_HOT_H_
+#define _RESPONDER_HOT_H_
+
+/* The responder counts how often each cached entry is requested. Every
+ * interval the entries requested at least min_hits times are sent to their
+ * back end, which refreshes those that would expire before the next round
+ * in a few batched searches. Counts are halved after each round so that
+ * entries which are no longer used drop out. A NULL context or an interval
+ * of 0 disables the tracking. */
+
+struct sss_hot_ctx;
+
+enum sss_hot_type {
+    SSS_HOT_USER = 0,
+    SSS_HOT_GROUP,
+    SSS_HOT_NETGR,
+};
+
+errno_t sss_hot_init(TALLOC_CTX *mem_ctx, struct resp_ctx *rctx,
+                     int interval, int min_hits,
+                     struct sss_hot_ctx **_hot);
+
+/* name is the name of the entry as stored in the cache */
+void sss_hot_record(struct sss_hot_ctx *hot, enum sss_hot_type type,
+                    struct sss_domain_info *dom, const char *name);
+
+#endif /* _RESPONDER_HOT_H_ */
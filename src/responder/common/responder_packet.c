@@ -264,3 +264,15 @@ void sss_packet_set_error(struct sss_packet *packet, int error)
 {
     *(packet->status) = error;
 }
+
+/* In requests the request ID is carried in the third header word, which
+ * is the status word of replies, replies carry it in the fourth one. */
+uint32_t sss_packet_get_id(struct sss_packet *packet)
+{
+    return *(packet->status);
+}
+
+void sss_packet_set_id(struct sss_packet *packet, uint32_t id)
+{
+    *(packet->reserved) = id;
+}
@@ -0,0 +1,30 @@
+/*
+   SSSD
+
+   Private Responder Common Header
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SSS_RESPONDER_PRIVATE_H__
+#define __SSS_RESPONDER_PRIVATE_H__
+
+/* Only for use by responder_common.c and its unit tests, responders are
+ * set up through sss_process_init() */
+
+/* creates the listening sockets rctx->sock_name and rctx->priv_sock_name
+ * and accepts client connections on them */
+int set_unix_socket(struct resp_ctx *rctx);
+
+#endif /* __SSS_RESPONDER_PRIVATE_H__ */
@@ -0,0 +1,269 @@
+/*
+   SSSD
+
+   Responders - bounded tables of cached entries
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <time.h>
+#include "util/util.h"
+#include "util/dlinklist.h"
+#include "responder/common/responder_table.h"
+
+/* entries the evict function may keep before the oldest one goes anyway */
+#define RTABLE_EVICT_TRIES 8
+
+struct sss_rtable {
+    const char *name;
+    hash_table_t *table;
+    uint32_t max_entries;
+    time_t sweep_interval;
+    time_t next_sweep;
+    sss_rtable_evict_fn evict_fn;
+
+    /* most recently used first */
+    struct sss_rtable_entry *head;
+    struct sss_rtable_entry *tail;
+
+    struct sss_rtable_stats stats;
+};
+
+errno_t sss_rtable_init(TALLOC_CTX *mem_ctx, const char *name,
+                        unsigned long init_size, uint32_t max_entries,
+                        time_t sweep_interval, sss_rtable_evict_fn evict_fn,
+                        struct sss_rtable **_table)
+{
+    struct sss_rtable *table;
+    errno_t ret;
+
+    table = talloc_zero(mem_ctx, struct sss_rtable);
+    if (!table) return ENOMEM;
+
+    table->name = talloc_strdup(table, name);
+    if (!table->name) {
+        talloc_free(table);
+        return ENOMEM;
+    }
+    table->max_entries = max_entries;
+    table->sweep_interval = sweep_interval;
+    table->evict_fn = evict_fn;
+
+    ret = sss_hash_create(table, init_size, &table->table);
+    if (ret != EOK) {
+        talloc_free(table);
+        return ret;
+    }
+
+    *_table = table;
+    return EOK;
+}
+
+static void sss_rtable_unlink(struct sss_rtable *table,
+                              struct sss_rtable_entry *entry)
+{
+    if (table->tail == entry) {
+        table->tail = entry->prev;
+    }
+    DLIST_REMOVE(table->head, entry);
+}
+
+static void sss_rtable_link(struct sss_rtable *table,
+                            struct sss_rtable_entry *entry)
+{
+    DLIST_ADD(table->head, entry);
+    if (table->tail == NULL) {
+        table->tail = entry;
+    }
+}
+
+static int sss_rtable_entry_destructor(void *ptr)
+{
+    struct sss_rtable_entry *entry = (struct sss_rtable_entry *)ptr;
+    struct sss_rtable *table = entry->table;
+
+    hash_delete(table->table, &entry->key);
+    sss_rtable_unlink(table, entry);
+    table->stats.entries--;
+    return 0;
+}
+
+struct sss_rtable_entry *sss_rtable_find(struct sss_rtable *table,
+                                         const char *keystr)
+{
+    hash_key_t key;
+    hash_value_t value;
+    int hret;
+
+    key.type = HASH_KEY_STRING;
+    key.str = discard_const(keystr);
+
+    hret = hash_lookup(table->table, &key, &value);
+    if (hret != HASH_SUCCESS) {
+        return NULL;
+    }
+
+    return (struct sss_rtable_entry *)value.ptr;
+}
+
+struct sss_rtable_entry *sss_rtable_lookup(struct sss_rtable *table,
+                                           const char *key)
+{
+    struct sss_rtable_entry *entry;
+
+    entry = sss_rtable_find(table, key);
+
+    if (entry && entry->expire != 0 && entry->expire <= time(NULL)) {
+        table->stats.expired++;
+        talloc_free(entry);
+        entry = NULL;
+    }
+
+    if (!entry) {
+        table->stats.misses++;
+        return NULL;
+    }
+
+    table->stats.hits++;
+    sss_rtable_unlink(table, entry);
+    sss_rtable_link(table, entry);
+
+    return entry;
+}
+
+/* Frees the least recently used entry the evict function agrees to */
+static void sss_rtable_evict(struct sss_rtable *table)
+{
+    struct sss_rtable_entry *entry;
+    int tries;
+
+    for (tries = 0; tries < RTABLE_EVICT_TRIES; tries++) {
+        entry = table->tail;
+        if (table->evict_fn == NULL || table->evict_fn(entry)) {
+            break;
+        }
+
+        sss_rtable_unlink(table, entry);
+        sss_rtable_link(table, entry);
+    }
+
+    entry = table->tail;
+    DEBUG(SSSDBG_TRACE_INTERNAL, ("%s is full, evicting [%s]\n",
+                                  table->name, entry->key.str));
+    table->stats.evicted++;
+    talloc_free(entry);
+}
+
+errno_t sss_rtable_add(struct sss_rtable *table,
+                       struct sss_rtable_entry *entry,
+                       const char *key, time_t expire)
+{
+    struct sss_rtable_entry *old;
+    hash_value_t value;
+    time_t now;
+    int hret;
+
+    now = time(NULL);
+    if (table->sweep_interval != 0 && now >= table->next_sweep) {
+        sss_rtable_sweep(table, now);
+    }
+
+    /* replace the entry stored under the same key */
+    old = sss_rtable_find(table, key);
+    talloc_free(old);
+
+    if (table->max_entries != 0 && table->stats.entries >= table->max_entries) {
+        sss_rtable_evict(table);
+    }
+
+    entry->table = table;
+    entry->expire = expire;
+    entry->key.type = HASH_KEY_STRING;
+    entry->key.str = talloc_strdup(entry, key);
+    if (!entry->key.str) {
+        return ENOMEM;
+    }
+
+    value.type = HASH_VALUE_PTR;
+    value.ptr = entry;
+
+    hret = hash_enter(table->table, &entry->key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Unable to store [%s] in %s: %s\n",
+                                     key, table->name,
+                                     hash_error_string(hret)));
+        return EIO;
+    }
+
+    sss_rtable_link(table, entry);
+    talloc_set_destructor((void *)entry, sss_rtable_entry_destructor);
+    table->stats.entries++;
+    table->stats.stores++;
+
+    return EOK;
+}
+
+struct sss_rtable_entry *sss_rtable_first(struct sss_rtable *table)
+{
+    return table->head;
+}
+
+/* Drops all entries that are too old to be used, so that entries which are
+ * never looked up again do not pile up */
+void sss_rtable_sweep(struct sss_rtable *table, time_t now)
+{
+    struct sss_rtable_entry *entry;
+    struct sss_rtable_entry *next;
+
+    table->next_sweep = now + table->sweep_interval;
+
+    for (entry = table->head; entry != NULL; entry = next) {
+        next = entry->next;
+        if (entry->expire != 0 && entry->expire <= now) {
+            table->stats.expired++;
+            talloc_free(entry);
+        }
+    }
+}
+
+void sss_rtable_clear(struct sss_rtable *table)
+{
+    while (table->head != NULL) {
+        talloc_free(table->head);
+    }
+}
+
+void sss_rtable_get_stats(struct sss_rtable *table,
+                          struct sss_rtable_stats *stats)
+{
+    *stats = table->stats;
+}
+
+void sss_rtable_log_stats(struct sss_rtable *table)
+{
+    struct sss_rtable_stats *st = &table->stats;
+    uint64_t lookups = st->hits + st->misses;
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          ("%s: %llu hits, %llu misses (%u%% hit rate), %llu stores, "
+           "%llu expired, %llu evicted, %u entries\n",
+           table->name,
+           (unsigned long long)st->hits,
+           (unsigned long long)st->misses,
+           lookups ? (unsigned int)(st->hits * 100 / lookups) : 0,
+           (unsigned long long)st->stores,
+           (unsigned long long)st->expired,
+           (unsigned long long)st->evicted,
+           (unsigned int)st->entries));
+}
@@ -0,0 +1,94 @@
+/*
+   SSSD
+
+   Responders - bounded tables of cached entries
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RESPONDER_TABLE_H_
+#define _RESPONDER_TABLE_H_
+
+#include "util/util.h"
+
+/* Hash table of talloc allocated entries keyed by a string, used by the
+ * short lived caches of the responders.
+ *
+ * Entries embed struct sss_rtable_entry as their first member and leave the
+ * table when they are freed. A lookup moves the entry to the front of the
+ * table. When the table is full, the entry at the back, the least recently
+ * used one, makes room for a new entry. Entries with a non zero expiration
+ * time are dropped when they are looked up after it, and by a sweep done
+ * while storing at most once per sweep interval. */
+
+struct sss_rtable;
+
+struct sss_rtable_entry {
+    struct sss_rtable_entry *prev;
+    struct sss_rtable_entry *next;
+    struct sss_rtable *table;
+    hash_key_t key;
+    time_t expire;              /* 0 if the entry does not expire */
+};
+
+struct sss_rtable_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t expired;           /* entries dropped because they were too old */
+    uint64_t evicted;           /* entries dropped to make room */
+    uint32_t entries;
+};
+
+/* Asked before the least recently used entry is evicted. Returning false
+ * keeps the entry, it is moved to the front and the next one is asked. */
+typedef bool (*sss_rtable_evict_fn)(struct sss_rtable_entry *entry);
+
+/* name is only used in debug messages. A sweep_interval of 0 disables the
+ * sweep. */
+errno_t sss_rtable_init(TALLOC_CTX *mem_ctx, const char *name,
+                        unsigned long init_size, uint32_t max_entries,
+                        time_t sweep_interval, sss_rtable_evict_fn evict_fn,
+                        struct sss_rtable **_table);
+
+/* Returns the entry stored under key, or NULL. Expired entries are freed. */
+struct sss_rtable_entry *sss_rtable_lookup(struct sss_rtable *table,
+                                           const char *key);
+
+/* Like sss_rtable_lookup() but neither counted nor checked for expiration,
+ * for callers that only want to drop the entry */
+struct sss_rtable_entry *sss_rtable_find(struct sss_rtable *table,
+                                         const char *key);
+
+/* entry is a new talloc object starting with struct sss_rtable_entry and
+ * allocated on the table. An entry stored under the same key is replaced.
+ * On failure entry is left to the caller. */
+errno_t sss_rtable_add(struct sss_rtable *table,
+                       struct sss_rtable_entry *entry,
+                       const char *key, time_t expire);
+
+/* Entries from the most to the least recently used. An entry may be freed
+ * while iterating once the next one was read. */
+struct sss_rtable_entry *sss_rtable_first(struct sss_rtable *table);
+
+void sss_rtable_sweep(struct sss_rtable *table, time_t now);
+
+void sss_rtable_clear(struct sss_rtable *table);
+
+void sss_rtable_get_stats(struct sss_rtable *table,
+                          struct sss_rtable_stats *stats);
+
+void sss_rtable_log_stats(struct sss_rtable *table);
+
+#endif /* _RESPONDER_TABLE_H_ */
@@ -36,6 +36,7 @@
 #include "responder/nss/nsssrv_private.h"
 #include "responder/nss/nsssrv_mmap_cache.h"
 #include "responder/common/negcache.h"
+#include "responder/common/responder_hot.h"
 #include "db/sysdb.h"
 #include "confdb/confdb.h"
 #include "dbus/dbus.h"
@@ -55,12 +56,15 @@
 
 static int nss_clear_memcache(DBusMessage *message,
                               struct sbus_connection *conn);
+static int nss_memcache_stats(DBusMessage *message,
+                              struct sbus_connection *conn);
 
 struct sbus_method monitor_nss_methods[] = {
     { MON_CLI_METHOD_PING, monitor_common_pong },
     { MON_CLI_METHOD_RES_INIT, monitor_common_res_init },
     { MON_CLI_METHOD_ROTATE, responder_logrotate },
     { MON_CLI_METHOD_CLEAR_MEMCACHE, nss_clear_memcache},
+    { MON_CLI_METHOD_MEMCACHE_STATS, nss_memcache_stats},
     { NULL, NULL }
 };
 
@@ -109,6 +113,15 @@ static int nss_clear_memcache(DBusMessage *message,
 
     /* TODO: read cache sizes from configuration */
     DEBUG(SSSDBG_TRACE_FUNC, ("Clearing memory caches.\n"));
+    sss_mmap_cache_log_stats(nctx->pwd_mc_ctx);
+    sss_mmap_cache_log_stats(nctx->grp_mc_ctx);
+    sss_mmap_cache_log_stats(nctx->initgr_mc_ctx);
+    sss_mmap_cache_log_stats(nctx->neg_mc_ctx);
+    sss_rc_log_stats(rctx->result_cache);
+
+    /* results of recent lookups may refer to entries that were expired */
+    sss_rc_clear(rctx->result_cache);
+
     ret = sss_mmap_cache_reinit(nctx, SSS_MC_CACHE_ELEMENTS,
                                 (time_t) memcache_timeout,
                                 &nctx->pwd_mc_ctx);
@@ -127,10 +140,100 @@ static int nss_clear_memcache(DBusMessage *message,
         return ret;
     }
 
+    ret = sss_mmap_cache_reinit(nctx, SSS_MC_CACHE_ELEMENTS,
+                                (time_t) memcache_timeout,
+                                &nctx->initgr_mc_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("initgroups mmap cache invalidation failed\n"));
+        return ret;
+    }
+
+    ret = sss_mmap_cache_reinit(nctx, SSS_MC_CACHE_ELEMENTS,
+                                (time_t) nctx->neg_timeout,
+                                &nctx->neg_mc_ctx);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_CRIT_FAILURE,
+              ("negative mmap cache invalidation failed\n"));
+        return ret;
+    }
+
 done:
     return monitor_common_pong(message, conn);
 }
 
+/* Takes the name of a memory cache (passwd, group, initgroups or negative)
+ * and replies with its statistics, see struct sss_mc_stats */
+static int nss_memcache_stats(DBusMessage *message,
+                              struct sbus_connection *conn)
+{
+    struct resp_ctx *rctx = talloc_get_type(sbus_conn_get_private_data(conn),
+                                            struct resp_ctx);
+    struct nss_ctx *nctx = talloc_get_type(rctx->pvt_ctx, struct nss_ctx);
+    struct sss_mc_ctx *mcc;
+    struct sss_mc_stats st;
+    dbus_uint64_t evictions;
+    DBusError dbus_error;
+    dbus_bool_t dbret;
+    DBusMessage *reply;
+    char *name;
+
+    dbus_error_init(&dbus_error);
+
+    dbret = dbus_message_get_args(message, &dbus_error,
+                                  DBUS_TYPE_STRING, &name,
+                                  DBUS_TYPE_INVALID);
+    if (!dbret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed, to parse message!\n"));
+        if (dbus_error_is_set(&dbus_error)) {
+            dbus_error_free(&dbus_error);
+        }
+        return EIO;
+    }
+
+    if (strcmp(name, "passwd") == 0) {
+        mcc = nctx->pwd_mc_ctx;
+    } else if (strcmp(name, "group") == 0) {
+        mcc = nctx->grp_mc_ctx;
+    } else if (strcmp(name, "initgroups") == 0) {
+        mcc = nctx->initgr_mc_ctx;
+    } else if (strcmp(name, "negative") == 0) {
+        mcc = nctx->neg_mc_ctx;
+    } else {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unknown memory cache [%s]\n", name));
+        return EINVAL;
+    }
+
+    /* all zero if the cache is disabled */
+    sss_mmap_cache_get_stats(mcc, &st);
+    evictions = st.evictions;
+
+    reply = dbus_message_new_method_return(message);
+    if (!reply) return ENOMEM;
+
+    dbret = dbus_message_append_args(reply,
+                                     DBUS_TYPE_UINT32, &st.generation,
+                                     DBUS_TYPE_UINT32, &st.total_slots,
+                                     DBUS_TYPE_UINT32, &st.used_slots,
+                                     DBUS_TYPE_UINT32, &st.records,
+                                     DBUS_TYPE_UINT64, &evictions,
+                                     DBUS_TYPE_UINT32, &st.buckets,
+                                     DBUS_TYPE_UINT32, &st.used_buckets,
+                                     DBUS_TYPE_UINT32, &st.chained_recs,
+                                     DBUS_TYPE_UINT32, &st.max_chain,
+                                     DBUS_TYPE_INVALID);
+    if (!dbret) {
+        dbus_message_unref(reply);
+        return EIO;
+    }
+
+    /* send reply back */
+    sbus_conn_send_reply(conn, reply);
+    dbus_message_unref(reply);
+
+    return EOK;
+}
+
 static errno_t nss_get_etc_shells(TALLOC_CTX *mem_ctx, char ***_shells)
 {
     int i = 0;
@@ -291,6 +394,7 @@ static int nss_update_memcache(DBusMessage *message,
 
     nss_update_pw_memcache(nctx);
     nss_update_gr_memcache(nctx);
+    sss_rc_clear(rctx->result_cache);
 
     return EOK;
 }
@@ -400,6 +504,8 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
     struct be_conn *iter;
     struct nss_ctx *nctx;
     int memcache_timeout;
+    int hot_interval;
+    int hot_min_hits;
     int ret, max_retries;
     int hret;
     int fd_limit;
@@ -442,6 +548,22 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = confdb_get_int(cdb, CONFDB_NSS_CONF_ENTRY,
+                         CONFDB_NSS_REFRESH_AHEAD_INTERVAL, 0,
+                         &hot_interval);
+    if (ret != EOK) goto fail;
+
+    ret = confdb_get_int(cdb, CONFDB_NSS_CONF_ENTRY,
+                         CONFDB_NSS_REFRESH_AHEAD_MIN_HITS, 5,
+                         &hot_min_hits);
+    if (ret != EOK) goto fail;
+
+    ret = sss_hot_init(nctx, rctx, hot_interval, hot_min_hits, &nctx->hot);
+    if (ret != EOK) {
+        DEBUG(0, ("fatal error initializing refresh-ahead\n"));
+        goto fail;
+    }
+
     /* Enable automatic reconnection to the Data Provider */
     ret = confdb_get_int(nctx->rctx->cdb,
                          CONFDB_NSS_CONF_ENTRY,
@@ -500,6 +622,21 @@ int nss_process_init(TALLOC_CTX *mem_ctx,
         DEBUG(SSSDBG_CRIT_FAILURE, ("group mmap cache is DISABLED\n"));
     }
 
+    ret = sss_mmap_cache_init(nctx, "initgroups", SSS_MC_INITGROUPS,
+                              SSS_MC_CACHE_ELEMENTS, (time_t)memcache_timeout,
+                              &nctx->initgr_mc_ctx);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("initgroups mmap cache is DISABLED\n"));
+    }
+
+    /* negative entries are only valid as long as the negative cache ones */
+    ret = sss_mmap_cache_init(nctx, "negative", SSS_MC_NEGATIVE,
+                              SSS_MC_CACHE_ELEMENTS, (time_t)nctx->neg_timeout,
+                              &nctx->neg_mc_ctx);
+    if (ret) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("negative mmap cache is DISABLED\n"));
+    }
+
     /* Set up file descriptor limits */
     ret = confdb_get_int(nctx->rctx->cdb,
                          CONFDB_NSS_CONF_ENTRY,
@@ -37,6 +37,7 @@
 
 struct getent_ctx;
 struct sss_mc_ctx;
+struct sss_hot_ctx;
 
 struct nss_ctx {
     struct resp_ctx *rctx;
@@ -45,6 +46,7 @@ struct nss_ctx {
     struct sss_nc_ctx *ncache;
 
     int cache_refresh_percent;
+    struct sss_hot_ctx *hot;
 
     int enum_cache_timeout;
 
@@ -68,6 +70,8 @@ struct nss_ctx {
 
     struct sss_mc_ctx *pwd_mc_ctx;
     struct sss_mc_ctx *grp_mc_ctx;
+    struct sss_mc_ctx *initgr_mc_ctx;
+    struct sss_mc_ctx *neg_mc_ctx;
 };
 
 struct nss_packet;
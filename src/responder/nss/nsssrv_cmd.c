@@ -27,6 +27,7 @@
 #include "responder/nss/nsssrv_services.h"
 #include "responder/nss/nsssrv_mmap_cache.h"
 #include "responder/common/negcache.h"
+#include "responder/common/responder_hot.h"
 #include "confdb/confdb.h"
 #include "db/sysdb.h"
 #include <time.h>
@@ -277,12 +278,13 @@ static const char *get_shell_override(TALLOC_CTX *mem_ctx,
     return talloc_strdup(mem_ctx, NOLOGIN_SHELL);
 }
 
-static int fill_pwent(struct sss_packet *packet,
-                      struct sss_domain_info *dom,
-                      struct nss_ctx *nctx,
-                      bool filter_users, bool pw_mmap_cache,
-                      struct ldb_message **msgs,
-                      int *count)
+static int fill_pwent_common(struct sss_packet *packet,
+                             struct sss_domain_info *dom,
+                             struct nss_ctx *nctx,
+                             bool filter_users, bool pw_mmap_cache,
+                             bool append,
+                             struct ldb_message **msgs,
+                             int *count)
 {
     struct ldb_message *msg;
     uint8_t *body;
@@ -316,6 +318,17 @@ static int fill_pwent(struct sss_packet *packet,
     rp = 2*sizeof(uint32_t);
 
     num = 0;
+
+    if (append) {
+        /* add to the entries already in the packet, if any */
+        sss_packet_get_body(packet, &body, &blen);
+        if (blen >= rp) {
+            num = ((uint32_t *)body)[0];
+            rp = blen;
+            packet_initialized = true;
+        }
+    }
+
     for (i = 0; i < *count; i++) {
         talloc_zfree(tmp_ctx);
         tmp_ctx = talloc_new(NULL);
@@ -445,6 +458,13 @@ static int fill_pwent(struct sss_packet *packet,
                           name.str, domain));
             }
         }
+
+        if (pw_mmap_cache && nctx->neg_mc_ctx) {
+            /* the user exists, clients must not find it negatively cached */
+            (void)sss_mmap_cache_neg_pw_invalidate(nctx->neg_mc_ctx,
+                                                   &fullname);
+            (void)sss_mmap_cache_neg_uid_invalidate(nctx->neg_mc_ctx, uid);
+        }
     }
     talloc_zfree(tmp_ctx);
 
@@ -462,16 +482,75 @@ done:
     return EOK;
 }
 
+static int fill_pwent(struct sss_packet *packet,
+                      struct sss_domain_info *dom,
+                      struct nss_ctx *nctx,
+                      bool filter_users, bool pw_mmap_cache,
+                      struct ldb_message **msgs,
+                      int *count)
+{
+    return fill_pwent_common(packet, dom, nctx, filter_users, pw_mmap_cache,
+                             false, msgs, count);
+}
+
+/* The user was not found in any domain, export the negative result so that
+ * clients can answer the same lookup without contacting us until the
+ * negative cache timeout expires */
+static void nss_neg_mc_store(struct nss_cmd_ctx *cmdctx)
+{
+    struct cli_ctx *cctx = cmdctx->cctx;
+    struct sized_string name;
+    struct nss_ctx *nctx;
+    uint8_t *body;
+    size_t blen;
+    int ret;
+
+    nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+    if (nctx->neg_mc_ctx == NULL) {
+        return;
+    }
+
+    switch (sss_packet_get_cmd(cctx->creq->in)) {
+    case SSS_NSS_GETPWNAM:
+        /* clients look up the name exactly as they sent it to us */
+        sss_packet_get_body(cctx->creq->in, &body, &blen);
+        to_sized_string(&name, (const char *)body);
+        ret = sss_mmap_cache_neg_pw_store(&nctx->neg_mc_ctx, &name);
+        break;
+    case SSS_NSS_GETPWUID:
+        ret = sss_mmap_cache_neg_uid_store(&nctx->neg_mc_ctx, cmdctx->id);
+        break;
+    default:
+        return;
+    }
+
+    if (ret != EOK && ret != ENOMEM) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Failed to store negative entry in mmap cache!\n"));
+    }
+}
+
 static int nss_cmd_getpw_send_reply(struct nss_dom_ctx *dctx, bool filter)
 {
     struct nss_cmd_ctx *cmdctx = dctx->cmdctx;
     struct cli_ctx *cctx = cmdctx->cctx;
+    struct sized_string rawname;
     struct nss_ctx *nctx;
+    uint8_t *body;
+    size_t blen;
     int ret;
     int i;
 
     nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
 
+    if (nctx->neg_mc_ctx &&
+        sss_packet_get_cmd(cctx->creq->in) == SSS_NSS_GETPWNAM) {
+        /* the requested name may differ from the one we return */
+        sss_packet_get_body(cctx->creq->in, &body, &blen);
+        to_sized_string(&rawname, (const char *)body);
+        (void)sss_mmap_cache_neg_pw_invalidate(nctx->neg_mc_ctx, &rawname);
+    }
+
     ret = sss_packet_new(cctx->creq, 0,
                          sss_packet_get_cmd(cctx->creq->in),
                          &cctx->creq->out);
@@ -494,6 +573,35 @@ static int nss_cmd_getpw_send_reply(struct nss_dom_ctx *dctx, bool filter)
 
 static void nsssrv_dp_send_acct_req_done(struct tevent_req *req);
 
+/* Counts the request so that frequently used entries are refreshed before
+ * they expire. Initgroups results are refreshed by regular lookups only. */
+static void nss_record_hot(struct nss_ctx *nctx,
+                           struct sss_domain_info *dom,
+                           struct ldb_message *msg,
+                           int req_type)
+{
+    const char *name;
+
+    if (nctx->hot == NULL) return;
+
+    name = ldb_msg_find_attr_as_string(msg, SYSDB_NAME, NULL);
+    if (name == NULL) return;
+
+    switch (req_type) {
+    case SSS_DP_USER:
+        sss_hot_record(nctx->hot, SSS_HOT_USER, dom, name);
+        break;
+    case SSS_DP_GROUP:
+        sss_hot_record(nctx->hot, SSS_HOT_GROUP, dom, name);
+        break;
+    case SSS_DP_NETGR:
+        sss_hot_record(nctx->hot, SSS_HOT_NETGR, dom, name);
+        break;
+    default:
+        break;
+    }
+}
+
 /* FIXME: do not check res->count, but get in a msgs and check in parent */
 /* FIXME: do not sss_cmd_done, but return error and let parent do it */
 errno_t check_cache(struct nss_dom_ctx *dctx,
@@ -529,6 +637,8 @@ errno_t check_cache(struct nss_dom_ctx *dctx,
 
     /* if we have any reply let's check cache validity */
     if (res->count > 0) {
+        nss_record_hot(nctx, dctx->domain, res->msgs[0], req_type);
+
         if (req_type == SSS_DP_INITGROUPS) {
             cacheExpire = ldb_msg_find_attr_as_uint64(res->msgs[0],
                                                       SYSDB_INITGR_EXPIRE, 1);
@@ -753,6 +863,7 @@ static int nss_cmd_getpwnam_search(struct nss_dom_ctx *dctx)
             /* There are no further domains or this was a
              * fully-qualified user request.
              */
+            nss_neg_mc_store(cmdctx);
             return ENOENT;
         }
 
@@ -764,10 +875,20 @@ static int nss_cmd_getpwnam_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
-        ret = sysdb_getpwnam(cmdctx, sysdb, dom, name, &dctx->res);
+        ret = ENOENT;
+        if (dctx->check_provider) {
+            ret = sss_rc_lookup(cctx->rctx->result_cache, cmdctx,
+                                SSS_RC_PWNAM, dom, name, 0, &dctx->res);
+        }
         if (ret != EOK) {
-            DEBUG(1, ("Failed to make request to our cache!\n"));
-            return EIO;
+            ret = sysdb_getpwnam(cmdctx, sysdb, dom, name, &dctx->res);
+            if (ret != EOK) {
+                DEBUG(1, ("Failed to make request to our cache!\n"));
+                return EIO;
+            }
+
+            sss_rc_store(cctx->rctx->result_cache, SSS_RC_PWNAM, dom,
+                         name, 0, dctx->res);
         }
 
         if (dctx->res->count > 1) {
@@ -798,6 +919,7 @@ static int nss_cmd_getpwnam_search(struct nss_dom_ctx *dctx)
                       ("Deleting user from memcache failed.\n"));
             }
 
+            nss_neg_mc_store(cmdctx);
             return ENOENT;
         }
 
@@ -824,6 +946,7 @@ static int nss_cmd_getpwnam_search(struct nss_dom_ctx *dctx)
 
     DEBUG(SSSDBG_MINOR_FAILURE,
           ("No matching domain found for [%s], fail!\n", cmdctx->name));
+    nss_neg_mc_store(cmdctx);
     return ENOENT;
 }
 
@@ -1078,10 +1201,20 @@ static int nss_cmd_getpwuid_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
-        ret = sysdb_getpwuid(cmdctx, sysdb, dom, cmdctx->id, &dctx->res);
+        ret = ENOENT;
+        if (dctx->check_provider) {
+            ret = sss_rc_lookup(cctx->rctx->result_cache, cmdctx,
+                                SSS_RC_PWUID, dom, NULL, cmdctx->id, &dctx->res);
+        }
         if (ret != EOK) {
-            DEBUG(1, ("Failed to make request to our cache!\n"));
-            return EIO;
+            ret = sysdb_getpwuid(cmdctx, sysdb, dom, cmdctx->id, &dctx->res);
+            if (ret != EOK) {
+                DEBUG(1, ("Failed to make request to our cache!\n"));
+                return EIO;
+            }
+
+            sss_rc_store(cctx->rctx->result_cache, SSS_RC_PWUID, dom,
+                         NULL, cmdctx->id, dctx->res);
         }
 
         if (dctx->res->count > 1) {
@@ -1104,6 +1237,7 @@ static int nss_cmd_getpwuid_search(struct nss_dom_ctx *dctx)
                 return ret;
             }
 
+            nss_neg_mc_store(cmdctx);
             return ENOENT;
         }
 
@@ -1129,6 +1263,7 @@ static int nss_cmd_getpwuid_search(struct nss_dom_ctx *dctx)
     }
 
     DEBUG(2, ("No matching domain found for [%d], fail!\n", cmdctx->id));
+    nss_neg_mc_store(cmdctx);
     return ENOENT;
 }
 
@@ -1216,6 +1351,7 @@ static int nss_cmd_getpwuid(struct cli_ctx *cctx)
         DEBUG(SSSDBG_TRACE_FUNC,
               ("Uid [%lu] does not exist! (negative cache)\n",
                (unsigned long)cmdctx->id));
+        nss_neg_mc_store(cmdctx);
         ret = ENOENT;
         goto done;
     }
@@ -1271,6 +1407,516 @@ done:
     nss_cmd_done(cmdctx, ret);
 }
 
+/* Bulk uid lookups
+ *
+ * Resolves a vector of uids with one sysdb search per domain. Ids that are
+ * missing or expired in a domain are requested from the data provider all at
+ * once and the domain is searched again when every request has returned.
+ * Entries are returned in the same format as getpwent, uids that do not
+ * exist are simply left out of the reply.
+ */
+
+struct nss_bulk_ctx {
+    struct nss_cmd_ctx *cmdctx;
+    struct sss_domain_info *domain;
+    bool check_provider;
+
+    /* ids not resolved yet */
+    uint32_t *ids;
+    size_t num_ids;
+
+    /* entries found, one result per domain */
+    struct dom_ctx *doms;
+    int num_doms;
+
+    /* outstanding data provider requests */
+    int dp_pending;
+};
+
+static int nss_bulk_id_cmp(const void *a, const void *b)
+{
+    uint32_t id1 = *(const uint32_t *)a;
+    uint32_t id2 = *(const uint32_t *)b;
+
+    return (id1 > id2) - (id1 < id2);
+}
+
+static bool nss_bulk_id_in_domain(struct sss_domain_info *dom, uint32_t id)
+{
+    if ((dom->id_min && (id < dom->id_min)) ||
+        (dom->id_max && (id > dom->id_max))) {
+        return false;
+    }
+    return true;
+}
+
+/* several cached entries may share an id, request each id only once */
+static void nss_bulk_add_dp_id(uint32_t *dp_ids, size_t *_num_dp_ids,
+                               size_t max_dp_ids, uint32_t id)
+{
+    size_t i;
+
+    for (i = 0; i < *_num_dp_ids; i++) {
+        if (dp_ids[i] == id) {
+            return;
+        }
+    }
+
+    if (*_num_dp_ids < max_dp_ids) {
+        dp_ids[(*_num_dp_ids)++] = id;
+    }
+}
+
+static errno_t nss_bulk_search_domain(TALLOC_CTX *mem_ctx,
+                                      struct sss_domain_info *dom,
+                                      uint32_t *ids, size_t num_ids,
+                                      size_t *_count,
+                                      struct ldb_message ***_msgs)
+{
+    static const char *attrs[] = SYSDB_PW_ATTRS;
+    char *filter;
+    size_t i;
+    errno_t ret;
+
+    if (dom->sysdb == NULL) {
+        DEBUG(SSSDBG_FATAL_FAILURE,
+              ("Fatal: Sysdb CTX not found for this domain!\n"));
+        return EIO;
+    }
+
+    filter = talloc_strdup(mem_ctx, "(|");
+    for (i = 0; filter && i < num_ids; i++) {
+        filter = talloc_asprintf_append(filter, "(%s=%u)",
+                                        SYSDB_UIDNUM, ids[i]);
+    }
+    if (filter) {
+        filter = talloc_strdup_append(filter, ")");
+    }
+    if (!filter) {
+        return ENOMEM;
+    }
+
+    ret = sysdb_search_users(mem_ctx, dom->sysdb, dom, filter, attrs,
+                             _count, _msgs);
+    talloc_free(filter);
+    if (ret == ENOENT) {
+        *_count = 0;
+        *_msgs = NULL;
+        ret = EOK;
+    }
+
+    return ret;
+}
+
+static void nss_bulk_dp_done(struct tevent_req *req);
+
+/* search the ids still unresolved in the current and following domains
+ * Returns:
+ *   EAGAIN, if some ids are being fetched from the backend
+ *   EOK, when all domains have been searched
+ *   anything else on a fatal error
+ */
+static int nss_bulk_search(struct nss_bulk_ctx *bctx)
+{
+    struct nss_cmd_ctx *cmdctx = bctx->cmdctx;
+    struct cli_ctx *cctx = cmdctx->cctx;
+    struct sss_domain_info *dom = bctx->domain;
+    struct ldb_message **msgs;
+    struct ldb_result *res;
+    struct tevent_req *req;
+    struct nss_ctx *nctx;
+    uint32_t *dom_ids;
+    uint32_t *dp_ids;
+    size_t num_dom_ids;
+    size_t num_dp_ids;
+    size_t count;
+    size_t i, j, k;
+    uint64_t expire;
+    uint32_t uid;
+    bool found;
+    int ret;
+
+    nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+
+    dom_ids = talloc_array(bctx, uint32_t, bctx->num_ids);
+    dp_ids = talloc_array(bctx, uint32_t, bctx->num_ids);
+    if (!dom_ids || !dp_ids) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    while (dom && bctx->num_ids) {
+
+        num_dom_ids = 0;
+        for (i = 0; i < bctx->num_ids; i++) {
+            if (nss_bulk_id_in_domain(dom, bctx->ids[i])) {
+                dom_ids[num_dom_ids++] = bctx->ids[i];
+            }
+        }
+
+        if (dom != bctx->domain) {
+            /* make sure we reset the check_provider flag when we check
+             * a new domain */
+            bctx->check_provider = NEED_CHECK_PROVIDER(dom->provider);
+        }
+        bctx->domain = dom;
+
+        if (num_dom_ids == 0) {
+            dom = get_next_domain(dom, true);
+            continue;
+        }
+
+        DEBUG(SSSDBG_TRACE_FUNC, ("Requesting info for %zu uids in [%s]\n",
+                                  num_dom_ids, dom->name));
+
+        ret = nss_bulk_search_domain(bctx, dom, dom_ids, num_dom_ids,
+                                     &count, &msgs);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  ("Failed to make request to our cache!\n"));
+            ret = EIO;
+            goto done;
+        }
+
+        num_dp_ids = 0;
+        if (bctx->check_provider) {
+            /* ids missing from the cache */
+            for (i = 0; i < num_dom_ids; i++) {
+                found = false;
+                for (j = 0; j < count && !found; j++) {
+                    uid = ldb_msg_find_attr_as_uint64(msgs[j],
+                                                      SYSDB_UIDNUM, 0);
+                    found = (uid == dom_ids[i]);
+                }
+                if (!found) {
+                    nss_bulk_add_dp_id(dp_ids, &num_dp_ids, bctx->num_ids,
+                                       dom_ids[i]);
+                }
+            }
+
+            /* and ids that need to be refreshed */
+            for (j = 0; j < count; j++) {
+                uid = ldb_msg_find_attr_as_uint64(msgs[j], SYSDB_UIDNUM, 0);
+                expire = ldb_msg_find_attr_as_uint64(msgs[j],
+                                                     SYSDB_CACHE_EXPIRE, 0);
+                ret = sss_cmd_check_cache(msgs[j],
+                                          nctx->cache_refresh_percent,
+                                          expire);
+                if (ret == EAGAIN) {
+                    /* midpoint refresh, return the cached entry and
+                     * update it out of band */
+                    req = sss_dp_get_account_send(cctx, cctx->rctx, dom, true,
+                                                  SSS_DP_USER, NULL, uid,
+                                                  NULL);
+                    talloc_zfree(req);
+                } else if (ret != EOK) {
+                    nss_bulk_add_dp_id(dp_ids, &num_dp_ids, bctx->num_ids,
+                                       uid);
+                }
+            }
+        }
+
+        if (num_dp_ids > 0) {
+            /* dont loop forever :-) */
+            bctx->check_provider = false;
+
+            /* the backend protocol carries a single id per request, issue
+             * all of them together and search this domain again once */
+            for (i = 0; i < num_dp_ids; i++) {
+                req = sss_dp_get_account_send(cctx, cctx->rctx, dom, true,
+                                              SSS_DP_USER, NULL, dp_ids[i],
+                                              NULL);
+                if (!req) {
+                    DEBUG(SSSDBG_CRIT_FAILURE,
+                          ("Out of memory sending data provider request\n"));
+                    /* the requests already sent will bring us back */
+                    break;
+                }
+                tevent_req_set_callback(req, nss_bulk_dp_done, bctx);
+                bctx->dp_pending++;
+            }
+
+            talloc_free(msgs);
+            if (bctx->dp_pending > 0) {
+                ret = EAGAIN;
+                goto done;
+            }
+            ret = ENOMEM;
+            goto done;
+        }
+
+        if (count > 0) {
+            res = talloc_zero(bctx, struct ldb_result);
+            if (!res) {
+                ret = ENOMEM;
+                goto done;
+            }
+            res->count = count;
+            res->msgs = talloc_steal(res, msgs);
+
+            bctx->doms = talloc_realloc(bctx, bctx->doms, struct dom_ctx,
+                                        bctx->num_doms + 1);
+            if (!bctx->doms) {
+                ret = ENOMEM;
+                goto done;
+            }
+            bctx->doms[bctx->num_doms].domain = dom;
+            bctx->doms[bctx->num_doms].res = res;
+            bctx->num_doms++;
+
+            /* remove the ids we found */
+            for (i = 0, j = 0; i < bctx->num_ids; i++) {
+                found = false;
+                for (k = 0; k < res->count && !found; k++) {
+                    uid = ldb_msg_find_attr_as_uint64(res->msgs[k],
+                                                      SYSDB_UIDNUM, 0);
+                    found = (uid == bctx->ids[i]);
+                }
+                if (!found) {
+                    bctx->ids[j++] = bctx->ids[i];
+                }
+            }
+            bctx->num_ids = j;
+        }
+
+        dom = get_next_domain(dom, true);
+    }
+
+    /* whatever is left does not exist in any domain */
+    for (i = 0; i < bctx->num_ids; i++) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("No results for uid [%u]\n", bctx->ids[i]));
+
+        ret = sss_ncache_set_uid(nctx->ncache, false, bctx->ids[i]);
+        if (ret != EOK) {
+            goto done;
+        }
+
+        if (nctx->neg_mc_ctx) {
+            ret = sss_mmap_cache_neg_uid_store(&nctx->neg_mc_ctx,
+                                               bctx->ids[i]);
+            if (ret != EOK && ret != ENOMEM) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      ("Failed to store negative entry in mmap cache!\n"));
+            }
+        }
+    }
+    bctx->num_ids = 0;
+
+    ret = EOK;
+
+done:
+    talloc_free(dom_ids);
+    talloc_free(dp_ids);
+    return ret;
+}
+
+static int nss_bulk_send_reply(struct nss_bulk_ctx *bctx)
+{
+    struct nss_cmd_ctx *cmdctx = bctx->cmdctx;
+    struct cli_ctx *cctx = cmdctx->cctx;
+    struct nss_ctx *nctx;
+    bool found = false;
+    int ret;
+    int i, n;
+
+    nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+
+    ret = sss_packet_new(cctx->creq, 0,
+                         sss_packet_get_cmd(cctx->creq->in),
+                         &cctx->creq->out);
+    if (ret != EOK) {
+        return EFAULT;
+    }
+
+    for (i = 0; i < bctx->num_doms; i++) {
+        n = bctx->doms[i].res->count;
+        ret = fill_pwent_common(cctx->creq->out, bctx->doms[i].domain,
+                                nctx, true, true, true,
+                                bctx->doms[i].res->msgs, &n);
+        if (ret == EOK) {
+            found = true;
+        } else if (ret != ENOENT) {
+            return ret;
+        }
+    }
+
+    if (!found) {
+        return ENOENT;
+    }
+
+    sss_packet_set_error(cctx->creq->out, EOK);
+    sss_cmd_done(cctx, cmdctx);
+    return EOK;
+}
+
+static void nss_bulk_dp_done(struct tevent_req *req)
+{
+    struct nss_bulk_ctx *bctx = tevent_req_callback_data(req,
+                                                         struct nss_bulk_ctx);
+    struct nss_cmd_ctx *cmdctx = bctx->cmdctx;
+    dbus_uint16_t err_maj;
+    dbus_uint32_t err_min;
+    char *err_msg;
+    int ret;
+
+    ret = sss_dp_get_account_recv(bctx, req, &err_maj, &err_min, &err_msg);
+    talloc_zfree(req);
+    if (ret != EOK || err_maj) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unable to get information from Data Provider\n"
+               "Error: %u, %u, %s\n"
+               "Will try to return what we have in cache\n",
+               (unsigned int)err_maj, (unsigned int)err_min,
+               ret == EOK && err_msg ? err_msg : "-"));
+    }
+
+    bctx->dp_pending--;
+    if (bctx->dp_pending > 0) {
+        /* wait for the other requests of the batch */
+        return;
+    }
+
+    /* ok the backend returned, search to see if we have updated results */
+    ret = nss_bulk_search(bctx);
+    if (ret == EOK) {
+        ret = nss_bulk_send_reply(bctx);
+    }
+
+    ret = nss_cmd_done(cmdctx, ret);
+    if (ret) {
+        NSS_CMD_FATAL_ERROR(cmdctx->cctx);
+    }
+}
+
+static void nss_cmd_getpwuid_bulk_cb(struct tevent_req *req);
+static int nss_cmd_getpwuid_bulk(struct cli_ctx *cctx)
+{
+    struct nss_cmd_ctx *cmdctx;
+    struct nss_bulk_ctx *bctx;
+    struct nss_ctx *nctx;
+    struct tevent_req *req;
+    uint8_t *body;
+    size_t blen;
+    uint32_t num;
+    uint32_t id;
+    size_t rp;
+    size_t i;
+    int ret;
+
+    nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+
+    cmdctx = talloc_zero(cctx, struct nss_cmd_ctx);
+    if (!cmdctx) {
+        return ENOMEM;
+    }
+    cmdctx->cctx = cctx;
+    cmdctx->check_next = true;
+
+    bctx = talloc_zero(cmdctx, struct nss_bulk_ctx);
+    if (!bctx) {
+        ret = ENOMEM;
+        goto done;
+    }
+    bctx->cmdctx = cmdctx;
+
+    /* get the uids to query */
+    sss_packet_get_body(cctx->creq->in, &body, &blen);
+
+    if (blen < sizeof(uint32_t)) {
+        ret = EINVAL;
+        goto done;
+    }
+    rp = 0;
+    SAFEALIGN_COPY_UINT32(&num, body, &rp);
+    if (num == 0 || num > SSS_NSS_BULK_MAX_IDS ||
+        blen != (num + 1) * sizeof(uint32_t)) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Invalid bulk request for %u ids\n", num));
+        ret = EINVAL;
+        goto done;
+    }
+
+    bctx->ids = talloc_array(bctx, uint32_t, num);
+    if (!bctx->ids) {
+        ret = ENOMEM;
+        goto done;
+    }
+    for (i = 0; i < num; i++) {
+        SAFEALIGN_COPY_UINT32(&bctx->ids[i], body + rp, &rp);
+    }
+
+    /* drop duplicates and ids we already know do not exist */
+    qsort(bctx->ids, num, sizeof(uint32_t), nss_bulk_id_cmp);
+    for (i = 0; i < num; i++) {
+        id = bctx->ids[i];
+        if (bctx->num_ids > 0 && bctx->ids[bctx->num_ids - 1] == id) {
+            continue;
+        }
+
+        ret = sss_ncache_check_uid(nctx->ncache, nctx->neg_timeout, id);
+        if (ret == EEXIST) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  ("Uid [%lu] does not exist! (negative cache)\n",
+                   (unsigned long)id));
+            continue;
+        }
+
+        bctx->ids[bctx->num_ids++] = id;
+    }
+
+    if (bctx->num_ids == 0) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    /* uid searches are always multidomain */
+    bctx->domain = cctx->rctx->domains;
+    bctx->check_provider = NEED_CHECK_PROVIDER(bctx->domain->provider);
+
+    if (cctx->rctx->get_domains_last_call.tv_sec == 0) {
+        req = sss_dp_get_domains_send(cctx->rctx, cctx->rctx, false, NULL);
+        if (req == NULL) {
+            ret = ENOMEM;
+        } else {
+            tevent_req_set_callback(req, nss_cmd_getpwuid_bulk_cb, bctx);
+            ret = EAGAIN;
+        }
+        goto done;
+    }
+
+    ret = nss_bulk_search(bctx);
+    if (ret == EOK) {
+        /* we have results to return */
+        ret = nss_bulk_send_reply(bctx);
+    }
+
+done:
+    return nss_cmd_done(cmdctx, ret);
+}
+
+static void nss_cmd_getpwuid_bulk_cb(struct tevent_req *req)
+{
+    struct nss_bulk_ctx *bctx = tevent_req_callback_data(req,
+                                                         struct nss_bulk_ctx);
+    struct nss_cmd_ctx *cmdctx = bctx->cmdctx;
+    errno_t ret;
+
+    ret = sss_dp_get_domains_recv(req);
+    talloc_free(req);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    ret = nss_bulk_search(bctx);
+    if (ret == EOK) {
+        /* we have results to return */
+        ret = nss_bulk_send_reply(bctx);
+    }
+
+done:
+    nss_cmd_done(cmdctx, ret);
+}
+
 /* to keep it simple at this stage we are retrieving the
  * full enumeration again for each request for each process
  * and we also block on setpwent() for the full time needed
@@ -1455,7 +2101,7 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
     struct getent_ctx *pctx = step_ctx->getent_ctx;
     struct nss_ctx *nctx = step_ctx->nctx;
     struct sysdb_ctx *sysdb;
-    struct ldb_result *res;
+    struct sysdb_enum_cursor *cursor;
     struct timeval tv;
     struct tevent_timer *te;
     struct tevent_req *dpreq;
@@ -1517,7 +2163,7 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
             }
         }
 
-        ret = sysdb_enumpwent(dctx, sysdb, dom, &res);
+        ret = sysdb_enumpwent_cursor(dctx, sysdb, dom, &cursor);
         if (ret != EOK) {
             DEBUG(1, ("Enum from cache failed, skipping domain [%s]\n",
                       dom->name));
@@ -1525,8 +2171,9 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
             continue;
         }
 
-        if (res->count == 0) {
+        if (sysdb_enum_cursor_count(cursor) == 0) {
             DEBUG(4, ("Domain [%s] has no users, skipping.\n", dom->name));
+            talloc_zfree(cursor);
             dom = get_next_domain(dom, false);
             continue;
         }
@@ -1540,7 +2187,9 @@ static errno_t nss_cmd_setpwent_step(struct setent_step_ctx *step_ctx)
         }
 
         nctx->pctx->doms[pctx->num].domain = dctx->domain;
-        nctx->pctx->doms[pctx->num].res = talloc_steal(pctx->doms, res);
+        nctx->pctx->doms[pctx->num].res = NULL;
+        nctx->pctx->doms[pctx->num].cursor = talloc_steal(pctx->doms,
+                                                             cursor);
 
         nctx->pctx->num++;
 
@@ -1716,8 +2365,9 @@ static int nss_cmd_retpwent(struct cli_ctx *cctx, int num)
 {
     struct nss_ctx *nctx;
     struct getent_ctx *pctx;
-    struct ldb_message **msgs = NULL;
+    struct ldb_result *page = NULL;
     struct dom_ctx *pdom = NULL;
+    int count;
     int n = 0;
     int ret = ENOENT;
 
@@ -1731,11 +2381,13 @@ static int nss_cmd_retpwent(struct cli_ctx *cctx, int num)
 
         pdom = &pctx->doms[cctx->pwent_dom_idx];
 
-        n = pdom->res->count - cctx->pwent_cur;
+        count = sysdb_enum_cursor_count(pdom->cursor);
+        n = count - cctx->pwent_cur;
         if (n <= 0 && (cctx->pwent_dom_idx+1 < pctx->num)) {
             cctx->pwent_dom_idx++;
             pdom = &pctx->doms[cctx->pwent_dom_idx];
-            n = pdom->res->count;
+            count = sysdb_enum_cursor_count(pdom->cursor);
+            n = count;
             cctx->pwent_cur = 0;
         }
 
@@ -1743,22 +2395,34 @@ static int nss_cmd_retpwent(struct cli_ctx *cctx, int num)
 
         if (n < 0) {
             DEBUG(SSSDBG_CRIT_FAILURE, ("BUG: Negative difference"
-                  "[%d - %d = %d]\n", pdom->res->count, cctx->pwent_cur, n));
+                  "[%d - %d = %d]\n", count, cctx->pwent_cur, n));
             DEBUG(SSSDBG_CRIT_FAILURE, ("Domain: %d (total %d)\n",
                                         cctx->pwent_dom_idx, pctx->num));
             break;
         }
 
         if (n > num) n = num;
+        if (n > NSS_ENUM_PAGE_SIZE) n = NSS_ENUM_PAGE_SIZE;
 
-        msgs = &(pdom->res->msgs[cctx->pwent_cur]);
-
-        ret = fill_pwent(cctx->creq->out, pdom->domain, nctx,
-                         true, false, msgs, &n);
+        talloc_zfree(page);
+        ret = sysdb_enum_cursor_fetch(cctx, pdom->cursor,
+                                      cctx->pwent_cur, n, &page);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Failed to read enumeration page "
+                  "from domain [%s]\n", pdom->domain->name));
+            break;
+        }
 
+        /* users removed since setpwent are just not in the page */
         cctx->pwent_cur += n;
+        n = page->count;
+
+        ret = fill_pwent(cctx->creq->out, pdom->domain, nctx,
+                         true, false, page->msgs, &n);
     }
 
+    talloc_free(page);
+
 none:
     if (ret == ENOENT) {
         ret = sss_cmd_empty_packet(cctx->creq->out);
@@ -2342,10 +3006,20 @@ static int nss_cmd_getgrnam_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
-        ret = sysdb_getgrnam(cmdctx, sysdb, dom, name, &dctx->res);
+        ret = ENOENT;
+        if (dctx->check_provider) {
+            ret = sss_rc_lookup(cctx->rctx->result_cache, cmdctx,
+                                SSS_RC_GRNAM, dom, name, 0, &dctx->res);
+        }
         if (ret != EOK) {
-            DEBUG(1, ("Failed to make request to our cache!\n"));
-            return EIO;
+            ret = sysdb_getgrnam(cmdctx, sysdb, dom, name, &dctx->res);
+            if (ret != EOK) {
+                DEBUG(1, ("Failed to make request to our cache!\n"));
+                return EIO;
+            }
+
+            sss_rc_store(cctx->rctx->result_cache, SSS_RC_GRNAM, dom,
+                         name, 0, dctx->res);
         }
 
         if (dctx->res->count > 1) {
@@ -2656,10 +3330,20 @@ static int nss_cmd_getgrgid_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
-        ret = sysdb_getgrgid(cmdctx, sysdb, dom, cmdctx->id, &dctx->res);
+        ret = ENOENT;
+        if (dctx->check_provider) {
+            ret = sss_rc_lookup(cctx->rctx->result_cache, cmdctx,
+                                SSS_RC_GRGID, dom, NULL, cmdctx->id, &dctx->res);
+        }
         if (ret != EOK) {
-            DEBUG(1, ("Failed to make request to our cache!\n"));
-            return EIO;
+            ret = sysdb_getgrgid(cmdctx, sysdb, dom, cmdctx->id, &dctx->res);
+            if (ret != EOK) {
+                DEBUG(1, ("Failed to make request to our cache!\n"));
+                return EIO;
+            }
+
+            sss_rc_store(cctx->rctx->result_cache, SSS_RC_GRGID, dom,
+                         NULL, cmdctx->id, dctx->res);
         }
 
         if (dctx->res->count > 1) {
@@ -3026,7 +3710,7 @@ static errno_t nss_cmd_setgrent_step(struct setent_step_ctx *step_ctx)
     struct getent_ctx *gctx = step_ctx->getent_ctx;
     struct nss_ctx *nctx = step_ctx->nctx;
     struct sysdb_ctx *sysdb;
-    struct ldb_result *res;
+    struct sysdb_enum_cursor *cursor;
     struct timeval tv;
     struct tevent_timer *te;
     struct tevent_req *dpreq;
@@ -3088,7 +3772,7 @@ static errno_t nss_cmd_setgrent_step(struct setent_step_ctx *step_ctx)
             }
         }
 
-        ret = sysdb_enumgrent(dctx, sysdb, dom, &res);
+        ret = sysdb_enumgrent_cursor(dctx, sysdb, dom, &cursor);
         if (ret != EOK) {
             DEBUG(1, ("Enum from cache failed, skipping domain [%s]\n",
                       dom->name));
@@ -3096,8 +3780,9 @@ static errno_t nss_cmd_setgrent_step(struct setent_step_ctx *step_ctx)
             continue;
         }
 
-        if (res->count == 0) {
+        if (sysdb_enum_cursor_count(cursor) == 0) {
             DEBUG(4, ("Domain [%s] has no groups, skipping.\n", dom->name));
+            talloc_zfree(cursor);
             dom = get_next_domain(dom, false);
             continue;
         }
@@ -3111,7 +3796,9 @@ static errno_t nss_cmd_setgrent_step(struct setent_step_ctx *step_ctx)
         }
 
         nctx->gctx->doms[gctx->num].domain = dctx->domain;
-        nctx->gctx->doms[gctx->num].res = talloc_steal(gctx->doms, res);
+        nctx->gctx->doms[gctx->num].res = NULL;
+        nctx->gctx->doms[gctx->num].cursor = talloc_steal(gctx->doms,
+                                                             cursor);
 
         nctx->gctx->num++;
 
@@ -3217,7 +3904,7 @@ static int nss_cmd_retgrent(struct cli_ctx *cctx, int num)
 {
     struct nss_ctx *nctx;
     struct getent_ctx *gctx;
-    struct ldb_message **msgs = NULL;
+    struct ldb_result *page = NULL;
     struct dom_ctx *gdom = NULL;
     int n = 0;
     int ret = ENOENT;
@@ -3232,27 +3919,39 @@ static int nss_cmd_retgrent(struct cli_ctx *cctx, int num)
 
         gdom = &gctx->doms[cctx->grent_dom_idx];
 
-        n = gdom->res->count - cctx->grent_cur;
+        n = sysdb_enum_cursor_count(gdom->cursor) - cctx->grent_cur;
         if (n <= 0 && (cctx->grent_dom_idx+1 < gctx->num)) {
             cctx->grent_dom_idx++;
             gdom = &gctx->doms[cctx->grent_dom_idx];
-            n = gdom->res->count;
+            n = sysdb_enum_cursor_count(gdom->cursor);
             cctx->grent_cur = 0;
         }
 
-        if (!n) break;
+        if (n <= 0) break;
 
         if (n > num) n = num;
+        if (n > NSS_ENUM_PAGE_SIZE) n = NSS_ENUM_PAGE_SIZE;
+
+        talloc_zfree(page);
+        ret = sysdb_enum_cursor_fetch(cctx, gdom->cursor,
+                                      cctx->grent_cur, n, &page);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("Failed to read enumeration page "
+                  "from domain [%s]\n", gdom->domain->name));
+            break;
+        }
 
-        msgs = &(gdom->res->msgs[cctx->grent_cur]);
+        /* groups removed since setgrent are just not in the page */
+        cctx->grent_cur += n;
+        n = page->count;
 
         ret = fill_grent(cctx->creq->out,
                          gdom->domain,
-                         nctx, true, false, msgs, &n);
-
-        cctx->grent_cur += n;
+                         nctx, true, false, page->msgs, &n);
     }
 
+    talloc_free(page);
+
 none:
     if (ret == ENOENT) {
         ret = sss_cmd_empty_packet(cctx->creq->out);
@@ -3389,6 +4088,72 @@ done:
     return EOK;
 }
 
+/* Builds the key under which the initgroups result of the user in the
+ * first message of res is stored in the memory cache. It is the same name
+ * the passwd memory cache uses, so that the client looks up both with the
+ * name it was given. */
+static char *nss_initgr_mc_name(TALLOC_CTX *mem_ctx,
+                                struct sss_domain_info *dom,
+                                struct ldb_result *res)
+{
+    const char *orig_name;
+    char *name;
+
+    orig_name = ldb_msg_find_attr_as_string(res->msgs[0], SYSDB_NAME, NULL);
+    if (orig_name == NULL) {
+        return NULL;
+    }
+
+    name = sss_get_cased_name(mem_ctx, orig_name, dom->case_sensitive);
+    if (name == NULL) {
+        return NULL;
+    }
+
+    if (!IS_SUBDOMAIN(dom) && dom->fqnames) {
+        name = talloc_asprintf(mem_ctx, dom->names->fq_fmt, name, dom->name);
+    }
+
+    return name;
+}
+
+static void nss_initgr_mc_store(struct nss_ctx *nctx,
+                                struct sss_domain_info *dom,
+                                struct ldb_result *res,
+                                uint32_t num_groups, uint32_t *gids)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sized_string key;
+    char *name;
+    int ret;
+
+    if (nctx->initgr_mc_ctx == NULL) {
+        return;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return;
+    }
+
+    name = nss_initgr_mc_name(tmp_ctx, dom, res);
+    if (name == NULL) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Failed to build initgroups memory cache key\n"));
+        goto done;
+    }
+    to_sized_string(&key, name);
+
+    ret = sss_mmap_cache_initgr_store(&nctx->initgr_mc_ctx, &key,
+                                      num_groups, gids);
+    if (ret != EOK && ret != ENOMEM) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Failed to store initgroups of %s in mmap cache!\n", name));
+    }
+
+done:
+    talloc_free(tmp_ctx);
+}
+
 void nss_update_initgr_memcache(struct nss_ctx *nctx,
                                 const char *name, const char *domain,
                                 int gnum, uint32_t *groups)
@@ -3398,6 +4163,10 @@ void nss_update_initgr_memcache(struct nss_ctx *nctx,
     struct ldb_result *res;
     struct sized_string delete_name;
     bool changed = false;
+    bool user_gone = false;
+    char *mc_name;
+    uint32_t *cur_gids;
+    uint32_t num_cur;
     uint32_t id;
     uint32_t gids[gnum];
     int ret;
@@ -3415,9 +4184,12 @@ void nss_update_initgr_memcache(struct nss_ctx *nctx,
         return;
     }
 
+    /* the provider has just refreshed the memberships */
+    sss_rc_invalidate(nctx->rctx->result_cache, SSS_RC_INITGR, dom, name, 0);
+
     tmp_ctx = talloc_new(NULL);
 
-    ret = sysdb_initgroups(tmp_ctx, dom->sysdb, dom, name, &res);
+    ret = sysdb_initgroups_gids(tmp_ctx, dom->sysdb, dom, name, &res);
     if (ret != EOK && ret != ENOENT) {
         DEBUG(SSSDBG_CRIT_FAILURE,
               ("Failed to make request to our cache! [%d][%s]\n",
@@ -3430,7 +4202,7 @@ void nss_update_initgr_memcache(struct nss_ctx *nctx,
     memcpy(gids, groups, gnum * sizeof(uint32_t));
 
     if (ret == ENOENT || res->count == 0) {
-        /* The user is gone. Invalidate the mc record */
+        /* The user is gone. Invalidate the mc records */
         to_sized_string(&delete_name, name);
         ret = sss_mmap_cache_pw_invalidate(nctx->pwd_mc_ctx, &delete_name);
         if (ret != EOK && ret != ENOENT) {
@@ -3439,8 +4211,25 @@ void nss_update_initgr_memcache(struct nss_ctx *nctx,
                   ret, strerror(ret)));
         }
 
+        if (!IS_SUBDOMAIN(dom) && dom->fqnames) {
+            mc_name = talloc_asprintf(tmp_ctx, dom->names->fq_fmt,
+                                      name, dom->name);
+            if (mc_name == NULL) {
+                goto done;
+            }
+            to_sized_string(&delete_name, mc_name);
+        }
+        ret = sss_mmap_cache_initgr_invalidate(nctx->initgr_mc_ctx,
+                                               &delete_name);
+        if (ret != EOK && ret != ENOENT) {
+            DEBUG(SSSDBG_CRIT_FAILURE,
+                  ("Internal failure in memory cache code: %d [%s]\n",
+                  ret, strerror(ret)));
+        }
+
         /* Also invalidate his groups */
         changed = true;
+        user_gone = true;
     } else {
         /* we skip the first entry, it's the user itself */
         for (i = 0; i < res->count; i++) {
@@ -3476,6 +4265,9 @@ void nss_update_initgr_memcache(struct nss_ctx *nctx,
     }
 
     if (changed) {
+        /* the user and the member lists of any group may be stale */
+        sss_rc_clear(nctx->rctx->result_cache);
+
         for (i = 0; i < gnum; i++) {
             id = groups[i];
 
@@ -3488,13 +4280,37 @@ void nss_update_initgr_memcache(struct nss_ctx *nctx,
         }
     }
 
+    if (!user_gone) {
+        /* refresh the initgroups record with the current memberships */
+        cur_gids = talloc_array(tmp_ctx, uint32_t, res->count);
+        if (cur_gids == NULL) {
+            goto done;
+        }
+
+        num_cur = 0;
+        for (i = 1; i < res->count; i++) {
+            id = ldb_msg_find_attr_as_uint(res->msgs[i], SYSDB_GIDNUM, 0);
+            if (id == 0) {
+                /* probably non-posix group, skip */
+                continue;
+            }
+            cur_gids[num_cur] = id;
+            num_cur++;
+        }
+
+        nss_initgr_mc_store(nctx, dom, res, num_cur, cur_gids);
+    }
+
 done:
     talloc_free(tmp_ctx);
 }
 
 /* FIXME: what about mpg, should we return the user's GID ? */
 /* FIXME: should we filter out GIDs ? */
-static int fill_initgr(struct sss_packet *packet, struct ldb_result *res)
+static int fill_initgr(struct sss_packet *packet,
+                       struct sss_domain_info *dom,
+                       struct nss_ctx *nctx,
+                       struct ldb_result *res)
 {
     uint8_t *body;
     size_t blen;
@@ -3537,6 +4353,8 @@ static int fill_initgr(struct sss_packet *packet, struct ldb_result *res)
     ((uint32_t *)body)[0] = num-skipped; /* num results */
     ((uint32_t *)body)[1] = 0; /* reserved */
 
+    nss_initgr_mc_store(nctx, dom, res, bindex, &((uint32_t *)body)[2]);
+
     return EOK;
 }
 
@@ -3544,8 +4362,11 @@ static int nss_cmd_initgr_send_reply(struct nss_dom_ctx *dctx)
 {
     struct nss_cmd_ctx *cmdctx = dctx->cmdctx;
     struct cli_ctx *cctx = cmdctx->cctx;
+    struct nss_ctx *nctx;
     int ret;
 
+    nctx = talloc_get_type(cctx->rctx->pvt_ctx, struct nss_ctx);
+
     ret = sss_packet_new(cctx->creq, 0,
                          sss_packet_get_cmd(cctx->creq->in),
                          &cctx->creq->out);
@@ -3553,7 +4374,7 @@ static int nss_cmd_initgr_send_reply(struct nss_dom_ctx *dctx)
         return EFAULT;
     }
 
-    ret = fill_initgr(cctx->creq->out, dctx->res);
+    ret = fill_initgr(cctx->creq->out, dctx->domain, nctx, dctx->res);
     if (ret) {
         return ret;
     }
@@ -3628,11 +4449,22 @@ static int nss_cmd_initgroups_search(struct nss_dom_ctx *dctx)
             return EIO;
         }
 
-        ret = sysdb_initgroups(cmdctx, sysdb, dom, name, &dctx->res);
+        ret = ENOENT;
+        if (dctx->check_provider) {
+            ret = sss_rc_lookup(cctx->rctx->result_cache, cmdctx,
+                                SSS_RC_INITGR, dom, name, 0, &dctx->res);
+        }
         if (ret != EOK) {
-            DEBUG(1, ("Failed to make request to our cache! [%d][%s]\n",
-                      ret, strerror(ret)));
-            return EIO;
+            ret = sysdb_initgroups_gids(cmdctx, sysdb, dom, name,
+                                        &dctx->res);
+            if (ret != EOK) {
+                DEBUG(1, ("Failed to make request to our cache! [%d][%s]\n",
+                          ret, strerror(ret)));
+                return EIO;
+            }
+
+            sss_rc_store(cctx->rctx->result_cache, SSS_RC_INITGR, dom,
+                         name, 0, dctx->res);
         }
 
         if (dctx->res->count == 0 && !dctx->check_provider) {
@@ -3889,6 +4721,7 @@ static struct sss_cmd_table nss_cmds[] = {
     {SSS_GET_VERSION, sss_cmd_get_version},
     {SSS_NSS_GETPWNAM, nss_cmd_getpwnam},
     {SSS_NSS_GETPWUID, nss_cmd_getpwuid},
+    {SSS_NSS_GETPWUID_BULK, nss_cmd_getpwuid_bulk},
     {SSS_NSS_SETPWENT, nss_cmd_setpwent},
     {SSS_NSS_GETPWENT, nss_cmd_getpwent},
     {SSS_NSS_ENDPWENT, nss_cmd_endpwent},
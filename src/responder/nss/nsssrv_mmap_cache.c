@@ -31,6 +31,13 @@
 #define SSS_AVG_PASSWD_PAYLOAD (MC_SLOT_SIZE * 4)
 /* short group name and no gids (private user group */
 #define SSS_AVG_GROUP_PAYLOAD (MC_SLOT_SIZE * 3)
+/* short user name and a handful of groups */
+#define SSS_AVG_INITGROUP_PAYLOAD (MC_SLOT_SIZE * 3)
+/* just the key string */
+#define SSS_AVG_NEGATIVE_PAYLOAD (MC_SLOT_SIZE * 2)
+
+/* grow the cache when more than this percentage of slots is in use */
+#define SSS_MC_GROW_FILL_PERCENT 90
 
 #define MC_NEXT_BARRIER(val) ((((val) + 1) & 0x00ffffff) | 0xf0000000)
 
@@ -70,8 +77,18 @@ struct sss_mc_ctx {
 
     uint8_t *data_table;    /* data table address (in mmap) */
     uint32_t dt_size;       /* size of data table */
+
+    size_t max_elems;       /* number of elements the cache can grow to */
+    uint32_t generation;    /* number of times the cache has been grown */
+
+    /* statistics */
+    uint32_t used_slots;    /* data table slots in use */
+    uint32_t records;       /* valid records */
+    uint64_t evictions;     /* valid records dropped to make room */
 };
 
+static errno_t sss_mc_grow(struct sss_mc_ctx **_mcc);
+
 #define MC_FIND_BIT(base, num) \
     uint32_t n = (num); \
     uint8_t *b = (base) + n / 8; \
@@ -99,6 +116,18 @@ static uint32_t sss_mc_hash(struct sss_mc_ctx *mcc,
     return murmurhash3(key, len, mcc->seed) % MC_HT_ELEMS(mcc->ht_size);
 }
 
+static void sss_mc_set_next_slot_with_hash(struct sss_mc_rec *rec,
+                                           uint32_t hash, uint32_t slot)
+{
+    /* changing a single uint32_t is atomic, so there is no
+     * need to use barriers in this case */
+    if (rec->hash1 == hash) {
+        rec->next1 = slot;
+    } else if (rec->hash2 == hash) {
+        rec->next2 = slot;
+    }
+}
+
 static void sss_mc_add_rec_to_chain(struct sss_mc_ctx *mcc,
                                     struct sss_mc_rec *rec,
                                     uint32_t hash)
@@ -125,13 +154,12 @@ static void sss_mc_add_rec_to_chain(struct sss_mc_ctx *mcc,
             /* rec already stored in hash chain */
             return;
         }
-        slot = cur->next;
+        slot = sss_mc_next_slot_with_hash(cur, hash);
     } while (slot != MC_INVALID_VAL);
     /* end of chain, append our record here */
 
-    /* changing a single uint32_t is atomic, so there is no
-     * need to use barriers in this case */
-    cur->next = MC_PTR_TO_SLOT(mcc->data_table, rec);
+    sss_mc_set_next_slot_with_hash(cur, hash,
+                                   MC_PTR_TO_SLOT(mcc->data_table, rec));
 }
 
 static void sss_mc_rm_rec_from_chain(struct sss_mc_ctx *mcc,
@@ -149,21 +177,25 @@ static void sss_mc_rm_rec_from_chain(struct sss_mc_ctx *mcc,
     }
 
     slot = mcc->hash_table[hash];
+    if (slot == MC_INVALID_VAL) {
+        /* empty chain */
+        return;
+    }
     cur = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
     if (cur == rec) {
-        mcc->hash_table[hash] = rec->next;
+        mcc->hash_table[hash] = sss_mc_next_slot_with_hash(rec, hash);
     } else {
-        slot = cur->next;
+        slot = sss_mc_next_slot_with_hash(cur, hash);
         while (slot != MC_INVALID_VAL) {
             prev = cur;
             cur = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
             if (cur == rec) {
-                /* changing a single uint32_t is atomic, so there is no
-                 * need to use barriers in this case */
-                prev->next = cur->next;
+                sss_mc_set_next_slot_with_hash(
+                                    prev, hash,
+                                    sss_mc_next_slot_with_hash(cur, hash));
                 slot = MC_INVALID_VAL;
             } else {
-                slot = cur->next;
+                slot = sss_mc_next_slot_with_hash(cur, hash);
             }
         }
     }
@@ -180,6 +212,7 @@ static void sss_mc_free_slots(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
     for (i = 0; i < num; i++) {
         MC_CLEAR_BIT(mcc->free_table, slot + i);
     }
+    mcc->used_slots -= num;
 }
 
 static void sss_mc_invalidate_rec(struct sss_mc_ctx *mcc,
@@ -193,11 +226,14 @@ static void sss_mc_invalidate_rec(struct sss_mc_ctx *mcc,
     /* Remove from hash chains */
     /* hash chain 1 */
     sss_mc_rm_rec_from_chain(mcc, rec, rec->hash1);
-    /* hash chain 2 */
-    sss_mc_rm_rec_from_chain(mcc, rec, rec->hash2);
+    /* hash chain 2, unless both hashes share the same chain */
+    if (rec->hash2 != rec->hash1) {
+        sss_mc_rm_rec_from_chain(mcc, rec, rec->hash2);
+    }
 
     /* Clear from free_table */
     sss_mc_free_slots(mcc, rec);
+    mcc->records--;
 
     /* Invalidate record fields */
     MC_RAISE_INVALID_BARRIER(rec);
@@ -205,7 +241,8 @@ static void sss_mc_invalidate_rec(struct sss_mc_ctx *mcc,
                                         - sizeof(struct sss_mc_rec)));
     rec->len = MC_INVALID_VAL32;
     rec->expire = MC_INVALID_VAL64;
-    rec->next = MC_INVALID_VAL32;
+    rec->next1 = MC_INVALID_VAL32;
+    rec->next2 = MC_INVALID_VAL32;
     rec->hash1 = MC_INVALID_VAL32;
     rec->hash2 = MC_INVALID_VAL32;
     MC_LOWER_BARRIER(rec);
@@ -234,7 +271,7 @@ static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
         return false;
     }
 
-    /* rec->next can be invalid if there are no next records */
+    /* rec->next1/2 can be invalid if there are no next records */
 
     if (rec->hash1 == MC_INVALID_VAL32) {
         return false;
@@ -243,7 +280,7 @@ static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
         slot = mcc->hash_table[rec->hash1];
         while (slot != MC_INVALID_VAL32 && self != rec) {
             self = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
-            slot = self->next;
+            slot = sss_mc_next_slot_with_hash(self, rec->hash1);
         }
         if (self != rec) {
             return false;
@@ -254,7 +291,7 @@ static bool sss_mc_is_valid_rec(struct sss_mc_ctx *mcc, struct sss_mc_rec *rec)
         slot = mcc->hash_table[rec->hash2];
         while (slot != MC_INVALID_VAL32 && self != rec) {
             self = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
-            slot = self->next;
+            slot = sss_mc_next_slot_with_hash(self, rec->hash2);
         }
         if (self != rec) {
             return false;
@@ -348,6 +385,13 @@ static errno_t sss_mc_find_free_slots(struct sss_mc_ctx *mcc,
 
             /* finally invalidate record completely */
             sss_mc_invalidate_rec(mcc, rec);
+
+            if (mcc->evictions++ == 0) {
+                DEBUG(SSSDBG_MINOR_FAILURE,
+                      ("mmap cache %s is full, evicting records\n",
+                       mcc->name));
+                sss_mmap_cache_log_stats(mcc);
+            }
         }
     }
 
@@ -377,11 +421,11 @@ static struct sss_mc_rec *sss_mc_find_record(struct sss_mc_ctx *mcc,
         name_ptr = *((rel_ptr_t *)rec->data);
 
         t_key = (char *)rec->data + name_ptr;
-        if (strcmp(key->str, t_key) == 0) {
+        if (hash == rec->hash1 && strcmp(key->str, t_key) == 0) {
             break;
         }
 
-        slot = rec->next;
+        slot = sss_mc_next_slot_with_hash(rec, hash);
     }
 
     if (slot == MC_INVALID_VAL) {
@@ -421,6 +465,20 @@ static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
         sss_mc_invalidate_rec(mcc, old_rec);
     }
 
+    /* rather than evicting valid records move to a bigger cache */
+    if ((uint64_t)(mcc->used_slots + num_slots) * 100 >
+            (uint64_t)mcc->ft_size * 8 * SSS_MC_GROW_FILL_PERCENT &&
+        mcc->ft_size * 8 * 2 <= mcc->max_elems) {
+        ret = sss_mc_grow(_mcc);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  ("Failed to grow mmap cache %s, old records will be "
+                   "evicted\n", mcc->name));
+            /* keep using the current cache */
+        }
+        mcc = *_mcc;
+    }
+
     /* we are going to use more space, find enough free slots */
     ret = sss_mc_find_free_slots(mcc, num_slots, &base_slot);
     if (ret != EOK) {
@@ -437,13 +495,16 @@ static errno_t sss_mc_get_record(struct sss_mc_ctx **_mcc,
     /* mark as not valid yet */
     MC_RAISE_INVALID_BARRIER(rec);
     rec->len = rec_len;
-    rec->next = MC_INVALID_VAL;
+    rec->next1 = MC_INVALID_VAL;
+    rec->next2 = MC_INVALID_VAL;
     MC_LOWER_BARRIER(rec);
 
     /* and now mark slots as used */
     for (i = 0; i < num_slots; i++) {
         MC_SET_BIT(mcc->free_table, base_slot + i);
     }
+    mcc->used_slots += num_slots;
+    mcc->records++;
 
     *_rec = rec;
     return EOK;
@@ -458,7 +519,12 @@ static inline void sss_mmap_set_rec_header(struct sss_mc_ctx *mcc,
     rec->len = len;
     rec->expire = time(NULL) + ttl;
     rec->hash1 = sss_mc_hash(mcc, key1, key1_len);
-    rec->hash2 = sss_mc_hash(mcc, key2, key2_len);
+    if (key2 != NULL) {
+        rec->hash2 = sss_mc_hash(mcc, key2, key2_len);
+    } else {
+        /* records with a single key (initgroups) have no second chain */
+        rec->hash2 = MC_INVALID_VAL32;
+    }
 }
 
 static inline void sss_mmap_chain_in_rec(struct sss_mc_ctx *mcc,
@@ -466,8 +532,10 @@ static inline void sss_mmap_chain_in_rec(struct sss_mc_ctx *mcc,
 {
     /* name first */
     sss_mc_add_rec_to_chain(mcc, rec, rec->hash1);
-    /* then uid/gid */
-    sss_mc_add_rec_to_chain(mcc, rec, rec->hash2);
+    /* then uid/gid, unless it falls in the same chain */
+    if (rec->hash2 != rec->hash1) {
+        sss_mc_add_rec_to_chain(mcc, rec, rec->hash2);
+    }
 }
 
 /***************************************************************************
@@ -541,6 +609,9 @@ errno_t sss_mmap_cache_pw_store(struct sss_mc_ctx **_mcc,
         return ret;
     }
 
+    /* the cache may have been moved to a bigger file */
+    mcc = *_mcc;
+
     data = (struct sss_mc_pwd_data *)rec->data;
     pos = 0;
 
@@ -611,11 +682,11 @@ errno_t sss_mmap_cache_pw_invalidate_uid(struct sss_mc_ctx *mcc, uid_t uid)
         rec = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
         data = (struct sss_mc_pwd_data *)(&rec->data);
 
-        if (uid == data->uid) {
+        if (hash == rec->hash2 && uid == data->uid) {
             break;
         }
 
-        slot = rec->next;
+        slot = sss_mc_next_slot_with_hash(rec, hash);
     }
 
     if (slot == MC_INVALID_VAL) {
@@ -676,6 +747,9 @@ int sss_mmap_cache_gr_store(struct sss_mc_ctx **_mcc,
         return ret;
     }
 
+    /* the cache may have been moved to a bigger file */
+    mcc = *_mcc;
+
     data = (struct sss_mc_grp_data *)rec->data;
     pos = 0;
 
@@ -742,11 +816,11 @@ errno_t sss_mmap_cache_gr_invalidate_gid(struct sss_mc_ctx *mcc, gid_t gid)
         rec = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
         data = (struct sss_mc_grp_data *)(&rec->data);
 
-        if (gid == data->gid) {
+        if (hash == rec->hash2 && gid == data->gid) {
             break;
         }
 
-        slot = rec->next;
+        slot = sss_mc_next_slot_with_hash(rec, hash);
     }
 
     if (slot == MC_INVALID_VAL) {
@@ -763,6 +837,204 @@ done:
     return ret;
 }
 
+/***************************************************************************
+ * initgroups map
+ ***************************************************************************/
+
+errno_t sss_mmap_cache_initgr_store(struct sss_mc_ctx **_mcc,
+                                    struct sized_string *name,
+                                    uint32_t num_groups, uint32_t *gids)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_initgr_data *data;
+    size_t gids_len;
+    size_t data_len;
+    size_t rec_len;
+    int ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    gids_len = num_groups * sizeof(uint32_t);
+    data_len = gids_len + name->len;
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_initgr_data) +
+              data_len;
+    if (rec_len > mcc->dt_size) {
+        return ENOMEM;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, name, &rec);
+    if (ret != EOK) {
+        return ret;
+    }
+
+    /* the cache may have been moved to a bigger file */
+    mcc = *_mcc;
+
+    data = (struct sss_mc_initgr_data *)rec->data;
+
+    MC_RAISE_BARRIER(rec);
+
+    /* header, initgroups records are only looked up by name */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            name->str, name->len, NULL, 0);
+
+    /* initgroups struct */
+    data->name = MC_PTR_DIFF((uint8_t *)data->gids + gids_len, data);
+    data->num_groups = num_groups;
+    data->data_len = data_len;
+    memcpy(data->gids, gids, gids_len);
+    memcpy((uint8_t *)data->gids + gids_len, name->str, name->len);
+
+    MC_LOWER_BARRIER(rec);
+
+    /* finally chain the rec in the hash table */
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    return EOK;
+}
+
+errno_t sss_mmap_cache_initgr_invalidate(struct sss_mc_ctx *mcc,
+                                         struct sized_string *name)
+{
+    return sss_mmap_cache_invalidate(mcc, name);
+}
+
+
+/***************************************************************************
+ * negative map
+ ***************************************************************************/
+
+static char *sss_mmap_cache_neg_key(TALLOC_CTX *mem_ctx,
+                                    const char *prefix,
+                                    struct sized_string *name,
+                                    uid_t uid)
+{
+    if (name) {
+        return talloc_asprintf(mem_ctx, "%s%s", prefix, name->str);
+    }
+
+    return talloc_asprintf(mem_ctx, "%s%ld", prefix, (long)uid);
+}
+
+static errno_t sss_mmap_cache_neg_store(struct sss_mc_ctx **_mcc,
+                                        const char *prefix,
+                                        struct sized_string *name,
+                                        uid_t uid)
+{
+    struct sss_mc_ctx *mcc = *_mcc;
+    struct sss_mc_rec *rec;
+    struct sss_mc_neg_data *data;
+    struct sized_string key;
+    char *keystr;
+    size_t rec_len;
+    int ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    keystr = sss_mmap_cache_neg_key(NULL, prefix, name, uid);
+    if (!keystr) {
+        return ENOMEM;
+    }
+    to_sized_string(&key, keystr);
+
+    rec_len = sizeof(struct sss_mc_rec) +
+              sizeof(struct sss_mc_neg_data) +
+              key.len;
+    if (rec_len > mcc->dt_size) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = sss_mc_get_record(_mcc, rec_len, &key, &rec);
+    if (ret != EOK) {
+        goto done;
+    }
+
+    /* the cache may have been moved to a bigger file */
+    mcc = *_mcc;
+
+    data = (struct sss_mc_neg_data *)rec->data;
+
+    MC_RAISE_BARRIER(rec);
+
+    /* header, negative records have a single key */
+    sss_mmap_set_rec_header(mcc, rec, rec_len, mcc->valid_time_slot,
+                            key.str, key.len, NULL, 0);
+
+    /* negative struct */
+    data->name = MC_PTR_DIFF(data->strs, data);
+    data->strs_len = key.len;
+    memcpy(data->strs, key.str, key.len);
+
+    MC_LOWER_BARRIER(rec);
+
+    /* finally chain the rec in the hash table */
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    ret = EOK;
+
+done:
+    talloc_free(keystr);
+    return ret;
+}
+
+static errno_t sss_mmap_cache_neg_invalidate(struct sss_mc_ctx *mcc,
+                                             const char *prefix,
+                                             struct sized_string *name,
+                                             uid_t uid)
+{
+    struct sized_string key;
+    char *keystr;
+    errno_t ret;
+
+    if (mcc == NULL) {
+        /* cache not initialized ? */
+        return EINVAL;
+    }
+
+    keystr = sss_mmap_cache_neg_key(NULL, prefix, name, uid);
+    if (!keystr) {
+        return ENOMEM;
+    }
+    to_sized_string(&key, keystr);
+
+    ret = sss_mmap_cache_invalidate(mcc, &key);
+
+    talloc_free(keystr);
+    return ret;
+}
+
+errno_t sss_mmap_cache_neg_pw_store(struct sss_mc_ctx **_mcc,
+                                    struct sized_string *name)
+{
+    return sss_mmap_cache_neg_store(_mcc, SSS_MC_NEG_PWNAM_PREFIX, name, 0);
+}
+
+errno_t sss_mmap_cache_neg_uid_store(struct sss_mc_ctx **_mcc, uid_t uid)
+{
+    return sss_mmap_cache_neg_store(_mcc, SSS_MC_NEG_PWUID_PREFIX, NULL, uid);
+}
+
+errno_t sss_mmap_cache_neg_pw_invalidate(struct sss_mc_ctx *mcc,
+                                         struct sized_string *name)
+{
+    return sss_mmap_cache_neg_invalidate(mcc, SSS_MC_NEG_PWNAM_PREFIX,
+                                         name, 0);
+}
+
+errno_t sss_mmap_cache_neg_uid_invalidate(struct sss_mc_ctx *mcc, uid_t uid)
+{
+    return sss_mmap_cache_neg_invalidate(mcc, SSS_MC_NEG_PWUID_PREFIX,
+                                         NULL, uid);
+}
 
 /***************************************************************************
  * initialization
@@ -933,9 +1205,10 @@ static int mc_ctx_destructor(struct sss_mc_ctx *mc_ctx)
     return 0;
 }
 
-errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
-                            enum sss_mc_type type, size_t n_elem,
-                            time_t timeout, struct sss_mc_ctx **mcc)
+static errno_t sss_mc_init_file(TALLOC_CTX *mem_ctx, const char *name,
+                                const char *file, enum sss_mc_type type,
+                                size_t n_elem, size_t max_elems,
+                                time_t timeout, struct sss_mc_ctx **mcc)
 {
     struct sss_mc_ctx *mc_ctx = NULL;
     unsigned int rseed;
@@ -949,6 +1222,12 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
     case SSS_MC_GROUP:
         payload = SSS_AVG_GROUP_PAYLOAD;
         break;
+    case SSS_MC_INITGROUPS:
+        payload = SSS_AVG_INITGROUP_PAYLOAD;
+        break;
+    case SSS_MC_NEGATIVE:
+        payload = SSS_AVG_NEGATIVE_PAYLOAD;
+        break;
     default:
         return EINVAL;
     }
@@ -970,8 +1249,7 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
 
     mc_ctx->valid_time_slot = timeout;
 
-    mc_ctx->file = talloc_asprintf(mc_ctx, "%s/%s",
-                                   SSS_NSS_MCACHE_DIR, name);
+    mc_ctx->file = talloc_strdup(mc_ctx, file);
     if (!mc_ctx->file) {
         ret = ENOMEM;
         goto done;
@@ -981,6 +1259,7 @@ errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
      * so we increase by the necessary amount if they are not a multiple */
     /* We can use MC_ALIGN64 for this */
     n_elem = MC_ALIGN64(n_elem);
+    mc_ctx->max_elems = max_elems > n_elem ? max_elems : n_elem;
 
     /* hash table is double the size because it will store both forward and
      * reverse keys (name/uid, name/gid, ..) */
@@ -1058,13 +1337,264 @@ done:
     return ret;
 }
 
+errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
+                            enum sss_mc_type type, size_t n_elem,
+                            time_t timeout, struct sss_mc_ctx **mcc)
+{
+    char *file;
+    errno_t ret;
+
+    file = talloc_asprintf(mem_ctx, "%s/%s", SSS_NSS_MCACHE_DIR, name);
+    if (!file) {
+        return ENOMEM;
+    }
+
+    ret = sss_mc_init_file(mem_ctx, name, file, type, n_elem,
+                           n_elem * SSS_MC_CACHE_MAX_GROWTH, timeout, mcc);
+
+    talloc_free(file);
+    return ret;
+}
+
+/* Copy a valid record into a (bigger) cache, hashes depend on the size of
+ * the hash table and on the seed so they must be computed again.
+ * The new cache is empty, records are simply placed one after the other
+ * starting at *_base_slot, which is moved past the copied record. */
+static errno_t sss_mc_copy_rec(struct sss_mc_ctx *mcc,
+                               struct sss_mc_rec *old_rec,
+                               uint32_t *_base_slot)
+{
+    struct sss_mc_rec *rec;
+    uint32_t base_slot = *_base_slot;
+    uint32_t num_slots;
+    char idstr[11];
+    char *name;
+    uint32_t i;
+    int len;
+
+    num_slots = MC_SIZE_TO_SLOTS(old_rec->len);
+    if ((uint64_t)base_slot + num_slots > (uint64_t)mcc->ft_size * 8) {
+        /* can't happen, the new cache is bigger than the old one */
+        return EFAULT;
+    }
+
+    rec = MC_SLOT_TO_PTR(mcc->data_table, base_slot, struct sss_mc_rec);
+    memcpy(rec, old_rec, old_rec->len);
+    rec->next1 = MC_INVALID_VAL;
+    rec->next2 = MC_INVALID_VAL;
+
+    name = (char *)rec->data + *((rel_ptr_t *)rec->data);
+    rec->hash1 = sss_mc_hash(mcc, name, strlen(name) + 1);
+
+    switch (mcc->type) {
+    case SSS_MC_PASSWD:
+        len = snprintf(idstr, 11, "%ld",
+                       (long)((struct sss_mc_pwd_data *)rec->data)->uid);
+        break;
+    case SSS_MC_GROUP:
+        len = snprintf(idstr, 11, "%ld",
+                       (long)((struct sss_mc_grp_data *)rec->data)->gid);
+        break;
+    default:
+        len = -1;
+        break;
+    }
+    if (len > 10) {
+        return EINVAL;
+    } else if (len > 0) {
+        rec->hash2 = sss_mc_hash(mcc, idstr, len + 1);
+    } else {
+        rec->hash2 = MC_INVALID_VAL32;
+    }
+
+    for (i = 0; i < num_slots; i++) {
+        MC_SET_BIT(mcc->free_table, base_slot + i);
+    }
+    mcc->used_slots += num_slots;
+    mcc->records++;
+
+    sss_mmap_chain_in_rec(mcc, rec);
+
+    *_base_slot = base_slot + num_slots;
+    return EOK;
+}
+
+/*
+ * Move all the valid records to a new cache file twice as big. The new file
+ * is fully populated before it replaces the old one, the old one is then
+ * marked as recycled so that clients reopen the cache.
+ */
+static errno_t sss_mc_grow(struct sss_mc_ctx **_mcc)
+{
+    struct sss_mc_ctx *old_mcc = *_mcc;
+    struct sss_mc_ctx *mcc = NULL;
+    struct sss_mc_rec *rec;
+    uint32_t tot_slots;
+    uint32_t base_slot;
+    uint32_t slot;
+    time_t now;
+    char *file;
+    char *tmp_file;
+    bool used;
+    errno_t ret;
+
+    tmp_file = talloc_asprintf(old_mcc, "%s.new", old_mcc->file);
+    if (!tmp_file) {
+        return ENOMEM;
+    }
+
+    ret = sss_mc_init_file(talloc_parent(old_mcc), old_mcc->name, tmp_file,
+                           old_mcc->type, old_mcc->ft_size * 8 * 2,
+                           old_mcc->max_elems, old_mcc->valid_time_slot,
+                           &mcc);
+    if (ret != EOK) {
+        goto done;
+    }
+    mcc->generation = old_mcc->generation + 1;
+    mcc->evictions = old_mcc->evictions;
+
+    now = time(NULL);
+    base_slot = 0;
+    tot_slots = old_mcc->ft_size * 8;
+    for (slot = 0; slot < tot_slots; slot++) {
+        MC_PROBE_BIT(old_mcc->free_table, slot, used);
+        if (!used) continue;
+
+        rec = MC_SLOT_TO_PTR(old_mcc->data_table, slot, struct sss_mc_rec);
+        if (!sss_mc_is_valid_rec(old_mcc, rec)) {
+            /* not the start of a record or a damaged one */
+            continue;
+        }
+
+        if (rec->expire >= now) {
+            ret = sss_mc_copy_rec(mcc, rec, &base_slot);
+            if (ret != EOK) {
+                goto done;
+            }
+        }
+
+        /* skip the rest of the record */
+        slot += MC_SIZE_TO_SLOTS(rec->len) - 1;
+    }
+    /* new records go after the copied ones */
+    mcc->next_slot = base_slot;
+
+    /* atomically replace the old file, clients that open the cache from now
+     * on will find the new one */
+    file = talloc_strdup(mcc, old_mcc->file);
+    if (!file) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    ret = rename(tmp_file, file);
+    if (ret == -1) {
+        ret = errno;
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to rename %s to %s: %d(%s)\n",
+                                    tmp_file, file, ret, strerror(ret)));
+        goto done;
+    }
+    talloc_free(mcc->file);
+    mcc->file = file;
+
+    /* and tell clients still using the old file to switch */
+    sss_mc_header_update(old_mcc, SSS_MC_HEADER_RECYCLED);
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          ("mmap cache %s grown to %zu elements\n",
+           mcc->name, (size_t)mcc->ft_size * 8));
+    sss_mmap_cache_log_stats(mcc);
+
+    talloc_free(old_mcc);
+    *_mcc = mcc;
+    mcc = NULL;
+    ret = EOK;
+
+done:
+    if (mcc) {
+        /* failed, remove the partial new file */
+        unlink(tmp_file);
+        talloc_free(mcc);
+    }
+    talloc_free(tmp_file);
+    return ret;
+}
+
+void sss_mmap_cache_get_stats(struct sss_mc_ctx *mcc,
+                              struct sss_mc_stats *stats)
+{
+    struct sss_mc_rec *rec;
+    uint32_t nbuckets;
+    uint32_t chain;
+    uint32_t slot;
+    uint32_t i;
+
+    memset(stats, 0, sizeof(struct sss_mc_stats));
+    if (mcc == NULL) {
+        return;
+    }
+
+    stats->generation = mcc->generation;
+    stats->total_slots = mcc->ft_size * 8;
+    stats->used_slots = mcc->used_slots;
+    stats->records = mcc->records;
+    stats->evictions = mcc->evictions;
+
+    nbuckets = MC_HT_ELEMS(mcc->ht_size);
+    stats->buckets = nbuckets;
+    for (i = 0; i < nbuckets; i++) {
+        chain = 0;
+        slot = mcc->hash_table[i];
+        /* chains can't be longer than the number of slots, this protects
+         * against loops in a damaged cache */
+        while (slot != MC_INVALID_VAL && slot < stats->total_slots &&
+               chain < stats->total_slots) {
+            rec = MC_SLOT_TO_PTR(mcc->data_table, slot, struct sss_mc_rec);
+            chain++;
+            slot = sss_mc_next_slot_with_hash(rec, i);
+        }
+        if (chain == 0) continue;
+
+        stats->used_buckets++;
+        stats->chained_recs += chain;
+        if (chain > stats->max_chain) {
+            stats->max_chain = chain;
+        }
+    }
+}
+
+void sss_mmap_cache_log_stats(struct sss_mc_ctx *mcc)
+{
+    struct sss_mc_stats st;
+
+    if (mcc == NULL) {
+        return;
+    }
+
+    sss_mmap_cache_get_stats(mcc, &st);
+
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          ("mmap cache %s: generation %u, %u records, %u/%u slots used "
+           "(%u%%), %llu evictions, %u/%u hash buckets used, "
+           "average chain %.2f, longest chain %u\n",
+           mcc->name, st.generation, st.records,
+           st.used_slots, st.total_slots,
+           st.total_slots ? (st.used_slots * 100 / st.total_slots) : 0,
+           (unsigned long long)st.evictions,
+           st.used_buckets, st.buckets,
+           st.used_buckets ? (double)st.chained_recs / st.used_buckets : 0.0,
+           st.max_chain));
+}
+
 errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
                               time_t timeout, struct sss_mc_ctx **mc_ctx)
 {
     errno_t ret;
     TALLOC_CTX* tmp_ctx = NULL;
     char *name;
+    char *file;
     enum sss_mc_type type;
+    size_t max_elems;
 
     if (mc_ctx == NULL || (*mc_ctx) == NULL) {
         DEBUG(SSSDBG_CRIT_FAILURE,
@@ -1085,10 +1615,21 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
         goto done;
     }
 
+    file = talloc_strdup(tmp_ctx, (*mc_ctx)->file);
+    if (file == NULL) {
+        DEBUG(SSSDBG_CRIT_FAILURE, ("Out of memory.\n"));
+        ret = ENOMEM;
+        goto done;
+    }
+
     type = (*mc_ctx)->type;
 
     if (n_elem == (size_t)-1) {
+        /* keep the current size, including any growth */
         n_elem = (*mc_ctx)->ft_size * 8;
+        max_elems = (*mc_ctx)->max_elems;
+    } else {
+        max_elems = n_elem * SSS_MC_CACHE_MAX_GROWTH;
     }
 
     if (timeout == (time_t)-1) {
@@ -1100,7 +1641,8 @@ errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
     /* make sure we do not leave a potentially freed pointer around */
     *mc_ctx = NULL;
 
-    ret = sss_mmap_cache_init(mem_ctx, name, type, n_elem, timeout, mc_ctx);
+    ret = sss_mc_init_file(mem_ctx, name, file, type, n_elem, max_elems,
+                           timeout, mc_ctx);
     if (ret != EOK) {
         DEBUG(SSSDBG_CRIT_FAILURE, ("Failed to re-initialize mmap cache.\n"));
         goto done;
@@ -23,13 +23,29 @@
 #define _NSSSRV_MMAP_CACHE_H_
 
 #define SSS_MC_CACHE_ELEMENTS 50000
+/* caches can grow up to this many times their initial size */
+#define SSS_MC_CACHE_MAX_GROWTH 16
 
 struct sss_mc_ctx;
 
+struct sss_mc_stats {
+    uint32_t generation;    /* times the cache has been grown */
+    uint32_t total_slots;   /* data table slots */
+    uint32_t used_slots;    /* data table slots in use */
+    uint32_t records;       /* valid records */
+    uint64_t evictions;     /* valid records dropped to make room */
+    uint32_t buckets;       /* hash table buckets */
+    uint32_t used_buckets;  /* hash table buckets with at least a record */
+    uint32_t chained_recs;  /* sum of the lengths of all chains */
+    uint32_t max_chain;     /* length of the longest chain */
+};
+
 enum sss_mc_type {
     SSS_MC_NONE = 0,
     SSS_MC_PASSWD,
     SSS_MC_GROUP,
+    SSS_MC_INITGROUPS,
+    SSS_MC_NEGATIVE,
 };
 
 errno_t sss_mmap_cache_init(TALLOC_CTX *mem_ctx, const char *name,
@@ -60,6 +76,28 @@ errno_t sss_mmap_cache_gr_invalidate(struct sss_mc_ctx *mcc,
 
 errno_t sss_mmap_cache_gr_invalidate_gid(struct sss_mc_ctx *mcc, gid_t gid);
 
+errno_t sss_mmap_cache_initgr_store(struct sss_mc_ctx **_mcc,
+                                    struct sized_string *name,
+                                    uint32_t num_groups, uint32_t *gids);
+
+errno_t sss_mmap_cache_initgr_invalidate(struct sss_mc_ctx *mcc,
+                                         struct sized_string *name);
+
+errno_t sss_mmap_cache_neg_pw_store(struct sss_mc_ctx **_mcc,
+                                    struct sized_string *name);
+
+errno_t sss_mmap_cache_neg_uid_store(struct sss_mc_ctx **_mcc, uid_t uid);
+
+errno_t sss_mmap_cache_neg_pw_invalidate(struct sss_mc_ctx *mcc,
+                                         struct sized_string *name);
+
+errno_t sss_mmap_cache_neg_uid_invalidate(struct sss_mc_ctx *mcc, uid_t uid);
+
+void sss_mmap_cache_get_stats(struct sss_mc_ctx *mcc,
+                              struct sss_mc_stats *stats);
+
+void sss_mmap_cache_log_stats(struct sss_mc_ctx *mcc);
+
 errno_t sss_mmap_cache_reinit(TALLOC_CTX *mem_ctx, size_t n_elem,
                               time_t timeout, struct sss_mc_ctx **mc_ctx);
 
@@ -40,9 +40,14 @@ struct nss_cmd_ctx {
     int saved_cur;
 };
 
+/* max entries read from the cache for a single getpwent/getgrent reply */
+#define NSS_ENUM_PAGE_SIZE 256
+
 struct dom_ctx {
     struct sss_domain_info *domain;
     struct ldb_result *res;
+    /* passwd and group enumerations are read a page at a time */
+    struct sysdb_enum_cursor *cursor;
 };
 
 struct getent_ctx {
@@ -194,6 +194,12 @@ int pac_process_init(TALLOC_CTX *mem_ctx,
         goto fail;
     }
 
+    ret = pac_digest_cache_init(pac_ctx, &pac_ctx->digests);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_FATAL_FAILURE, ("pac_digest_cache_init failed.\n"));
+        goto fail;
+    }
+
     /* Set up file descriptor limits */
     ret = confdb_get_int(pac_ctx->rctx->cdb,
                          CONFDB_PAC_CONF_ENTRY,
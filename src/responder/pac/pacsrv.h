@@ -44,14 +44,27 @@
 
 #define PAC_PACKET_MAX_RECV_SIZE 1024
 
+#define PAC_DIGEST_LENGTH 20
+
 struct getent_ctx;
 struct dom_sid;
+struct pac_digest_cache;
 
 struct pac_ctx {
     struct resp_ctx *rctx;
     struct sss_idmap_ctx *idmap_ctx;
     struct dom_sid *my_dom_sid;
     struct local_mapping_ranges *range_map;
+    struct pac_digest_cache *digests;
+};
+
+struct pac_digest_stats {
+    uint64_t requests;
+    uint64_t unchanged;
+    /* user entries written to the cache */
+    uint64_t writes;
+    /* writes the unchanged PACs needed when they were first processed */
+    uint64_t avoided_writes;
 };
 
 struct range {
@@ -130,4 +143,27 @@ struct sss_domain_info *find_domain_by_id(struct sss_domain_info *domains,
                                           const char *id_str);
 
 bool new_and_cached_user_differs(struct passwd *pwd, struct ldb_message *msg);
+
+/* The digest of the last PAC of each user is kept until the user entry
+ * would expire. The user entry is not written again for a PAC with the
+ * same digest, the group memberships are still compared with the PAC. */
+errno_t get_pac_digest(struct PAC_LOGON_INFO *logon_info, uint8_t *digest);
+
+errno_t pac_digest_cache_init(TALLOC_CTX *mem_ctx,
+                              struct pac_digest_cache **_cache);
+
+/* Returns EOK if the user entry is cached and the PAC did not change */
+errno_t pac_digest_lookup(struct pac_digest_cache *cache,
+                          struct sss_domain_info *dom,
+                          const char *name,
+                          const uint8_t *digest);
+
+errno_t pac_digest_store(struct pac_digest_cache *cache,
+                         struct sss_domain_info *dom,
+                         const char *name,
+                         const uint8_t *digest,
+                         uid_t uid,
+                         size_t writes);
+
+void pac_digest_log_stats(struct pac_digest_cache *cache);
 #endif /* __PACSRV_H__ */
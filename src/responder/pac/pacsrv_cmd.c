@@ -70,6 +70,13 @@ struct pac_req_ctx {
 
     size_t del_grp_count;
     struct grp_info **del_grp_list;
+
+    uint8_t digest[PAC_DIGEST_LENGTH];
+    /* the user entry was written for a PAC with the same digest */
+    bool unchanged;
+    uid_t uid;
+    /* user entries written while processing the PAC */
+    size_t writes;
 };
 
 static errno_t pac_add_user_next(struct pac_req_ctx *pr_ctx);
@@ -212,12 +219,30 @@ static errno_t pac_add_user_next(struct pac_req_ctx *pr_ctx)
         goto done;
     }
 
-    ret = save_pac_user(pr_ctx);
+    ret = get_pac_digest(pr_ctx->logon_info, pr_ctx->digest);
     if (ret != EOK) {
-        DEBUG(SSSDBG_OP_FAILURE, ("save_pac_user failed.\n"));
+        DEBUG(SSSDBG_OP_FAILURE, ("get_pac_digest failed.\n"));
         goto done;
     }
 
+    ret = pac_digest_lookup(pr_ctx->pac_ctx->digests, pr_ctx->dom,
+                            pr_ctx->fq_name, pr_ctx->digest);
+    if (ret == EOK) {
+        /* the user entry is up to date, the memberships might have been
+         * changed by other lookups and are compared with the PAC below */
+        pr_ctx->unchanged = true;
+    } else {
+        if (ret != ENOENT) {
+            DEBUG(SSSDBG_MINOR_FAILURE, ("pac_digest_lookup failed.\n"));
+        }
+
+        ret = save_pac_user(pr_ctx);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_OP_FAILURE, ("save_pac_user failed.\n"));
+            goto done;
+        }
+    }
+
     ret = pac_user_get_grp_info(pr_ctx, pr_ctx, &pr_ctx->current_grp_count,
                                 &pr_ctx->current_grp_list);
     if (ret != EOK) {
@@ -357,7 +382,8 @@ static errno_t save_pac_user(struct pac_req_ctx *pr_ctx)
 {
     struct sysdb_ctx *sysdb;
     int ret;
-    const char *attrs[] = {SYSDB_NAME, SYSDB_UIDNUM, SYSDB_GIDNUM, NULL};
+    const char *attrs[] = {SYSDB_NAME, SYSDB_UIDNUM, SYSDB_GIDNUM,
+                           SYSDB_GECOS, SYSDB_HOMEDIR, SYSDB_SHELL, NULL};
     struct ldb_message *msg;
     struct passwd *pwd = NULL;
     TALLOC_CTX *tmp_ctx = NULL;
@@ -384,6 +410,8 @@ static errno_t save_pac_user(struct pac_req_ctx *pr_ctx)
         goto done;
     }
 
+    pr_ctx->uid = pwd->pw_uid;
+
     ret = sysdb_search_user_by_uid(tmp_ctx, sysdb, pr_ctx->dom,
                                    pwd->pw_uid, attrs, &msg);
     if (ret == EOK) {
@@ -393,6 +421,7 @@ static errno_t save_pac_user(struct pac_req_ctx *pr_ctx)
                 DEBUG(SSSDBG_OP_FAILURE, ("sysdb_delete_user failed.\n"));
                 goto done;
             }
+            pr_ctx->writes++;
         } else {
             goto done;
         }
@@ -411,6 +440,7 @@ static errno_t save_pac_user(struct pac_req_ctx *pr_ctx)
                                   ret, strerror(ret)));
         goto done;
     }
+    pr_ctx->writes++;
 
     ret = EOK;
 
@@ -761,6 +791,18 @@ static void pac_save_memberships_done(struct tevent_req *req)
     ret = pac_save_memberships_recv(req);
     talloc_zfree(req);
 
+    if (ret == EOK && !pr_ctx->unchanged) {
+        /* the digest keeps the expiration time of the user entry */
+        ret = pac_digest_store(pr_ctx->pac_ctx->digests, pr_ctx->dom,
+                               pr_ctx->fq_name, pr_ctx->digest,
+                               pr_ctx->uid, pr_ctx->writes);
+        if (ret != EOK) {
+            /* the cache was updated, the next PAC is processed again */
+            DEBUG(SSSDBG_MINOR_FAILURE, ("pac_digest_store failed.\n"));
+            ret = EOK;
+        }
+    }
+
     talloc_free(pr_ctx);
     pac_cmd_done(cctx, ret);
 }
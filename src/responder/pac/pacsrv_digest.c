@@ -0,0 +1,312 @@
+/*
+   SSSD
+
+   PAC Responder - digests of processed PACs
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/util.h"
+#include "util/crypto/sss_crypto.h"
+#include "responder/common/responder_table.h"
+#include "responder/pac/pacsrv.h"
+
+#define PAC_DIGEST_TABLE_INIT_SIZE 64
+/* bounds the memory used when many different users log in, the least
+ * recently used digests make room for new ones */
+#define PAC_DIGEST_MAX_ENTRIES 10000
+/* how often digests of users who did not log in again are dropped */
+#define PAC_DIGEST_SWEEP_INTERVAL 60
+#define PAC_DIGEST_LOG_INTERVAL 1000
+
+struct pac_digest_entry {
+    struct sss_rtable_entry base;
+    uint8_t digest[PAC_DIGEST_LENGTH];
+    uid_t uid;
+    size_t writes;
+};
+
+struct pac_digest_cache {
+    struct sss_rtable *table;
+    struct pac_digest_stats stats;
+};
+
+static errno_t pac_digest_add(TALLOC_CTX *mem_ctx, uint8_t **_buf,
+                              size_t *_len, const void *data, size_t size)
+{
+    uint8_t *buf;
+
+    buf = talloc_realloc(mem_ctx, *_buf, uint8_t, *_len + size);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+
+    memcpy(buf + *_len, data, size);
+    *_buf = buf;
+    *_len += size;
+
+    return EOK;
+}
+
+static errno_t pac_digest_add_string(TALLOC_CTX *mem_ctx, uint8_t **_buf,
+                                     size_t *_len, const char *str)
+{
+    if (str == NULL) {
+        str = "";
+    }
+
+    /* with the terminating NUL so that neighbours can not be mixed up */
+    return pac_digest_add(mem_ctx, _buf, _len, str, strlen(str) + 1);
+}
+
+static errno_t pac_digest_add_uint32(TALLOC_CTX *mem_ctx, uint8_t **_buf,
+                                     size_t *_len, uint32_t value)
+{
+    return pac_digest_add(mem_ctx, _buf, _len, &value, sizeof(uint32_t));
+}
+
+static errno_t pac_digest_add_sid(TALLOC_CTX *mem_ctx, uint8_t **_buf,
+                                  size_t *_len, struct dom_sid *sid)
+{
+    uint8_t num_auths;
+    errno_t ret;
+
+    if (sid == NULL) {
+        return pac_digest_add_uint32(mem_ctx, _buf, _len, 0);
+    }
+
+    num_auths = sid->num_auths < 0 ? 0 : sid->num_auths;
+    if (num_auths > 15) {
+        return EINVAL;
+    }
+
+    ret = pac_digest_add(mem_ctx, _buf, _len,
+                         &sid->sid_rev_num, sizeof(uint8_t));
+    if (ret != EOK) return ret;
+
+    ret = pac_digest_add(mem_ctx, _buf, _len, &num_auths, sizeof(uint8_t));
+    if (ret != EOK) return ret;
+
+    ret = pac_digest_add(mem_ctx, _buf, _len, sid->id_auth,
+                         sizeof(sid->id_auth));
+    if (ret != EOK) return ret;
+
+    return pac_digest_add(mem_ctx, _buf, _len, sid->sub_auths,
+                          num_auths * sizeof(uint32_t));
+}
+
+/**
+ * Digest of the parts of the PAC logon data that end up in the cache.
+ * Logon times, counters and the signatures change with every ticket and
+ * are left out.
+ */
+errno_t get_pac_digest(struct PAC_LOGON_INFO *logon_info, uint8_t *digest)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct netr_SamBaseInfo *base;
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    uint32_t c;
+    errno_t ret;
+
+    if (logon_info == NULL || digest == NULL) {
+        return EINVAL;
+    }
+
+    tmp_ctx = talloc_new(NULL);
+    if (tmp_ctx == NULL) {
+        return ENOMEM;
+    }
+
+    base = &logon_info->info3.base;
+
+    ret = pac_digest_add_string(tmp_ctx, &buf, &len,
+                                base->account_name.string);
+    if (ret != EOK) goto done;
+
+    ret = pac_digest_add_string(tmp_ctx, &buf, &len,
+                                base->full_name.string);
+    if (ret != EOK) goto done;
+
+    ret = pac_digest_add_string(tmp_ctx, &buf, &len,
+                                base->logon_domain.string);
+    if (ret != EOK) goto done;
+
+    ret = pac_digest_add_sid(tmp_ctx, &buf, &len, base->domain_sid);
+    if (ret != EOK) goto done;
+
+    ret = pac_digest_add_uint32(tmp_ctx, &buf, &len, base->rid);
+    if (ret != EOK) goto done;
+
+    ret = pac_digest_add_uint32(tmp_ctx, &buf, &len, base->primary_gid);
+    if (ret != EOK) goto done;
+
+    ret = pac_digest_add_uint32(tmp_ctx, &buf, &len, base->groups.count);
+    if (ret != EOK) goto done;
+
+    for (c = 0; c < base->groups.count; c++) {
+        ret = pac_digest_add_uint32(tmp_ctx, &buf, &len,
+                                    base->groups.rids[c].rid);
+        if (ret != EOK) goto done;
+    }
+
+    ret = pac_digest_add_uint32(tmp_ctx, &buf, &len,
+                                logon_info->info3.sidcount);
+    if (ret != EOK) goto done;
+
+    for (c = 0; c < logon_info->info3.sidcount; c++) {
+        ret = pac_digest_add_sid(tmp_ctx, &buf, &len,
+                                 logon_info->info3.sids[c].sid);
+        if (ret != EOK) goto done;
+    }
+
+    ret = sss_sha1(buf, len, digest);
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int pac_digest_cache_destructor(struct pac_digest_cache *cache)
+{
+    pac_digest_log_stats(cache);
+    return 0;
+}
+
+errno_t pac_digest_cache_init(TALLOC_CTX *mem_ctx,
+                              struct pac_digest_cache **_cache)
+{
+    struct pac_digest_cache *cache;
+    errno_t ret;
+
+    cache = talloc_zero(mem_ctx, struct pac_digest_cache);
+    if (!cache) return ENOMEM;
+
+    ret = sss_rtable_init(cache, "PAC digests", PAC_DIGEST_TABLE_INIT_SIZE,
+                          PAC_DIGEST_MAX_ENTRIES, PAC_DIGEST_SWEEP_INTERVAL,
+                          NULL, &cache->table);
+    if (ret != EOK) {
+        talloc_free(cache);
+        return ret;
+    }
+
+    talloc_set_destructor(cache, pac_digest_cache_destructor);
+
+    *_cache = cache;
+    return EOK;
+}
+
+errno_t pac_digest_lookup(struct pac_digest_cache *cache,
+                          struct sss_domain_info *dom,
+                          const char *name,
+                          const uint8_t *digest)
+{
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct pac_digest_entry *entry;
+    struct ldb_message *msg;
+    errno_t ret;
+
+    if (cache == NULL) return ENOENT;
+
+    cache->stats.requests++;
+    if (cache->stats.requests % PAC_DIGEST_LOG_INTERVAL == 0) {
+        pac_digest_log_stats(cache);
+    }
+
+    /* digests older than the user entry are not returned */
+    entry = (struct pac_digest_entry *)sss_rtable_lookup(cache->table, name);
+    if (entry == NULL) {
+        return ENOENT;
+    }
+
+    if (memcmp(entry->digest, digest, PAC_DIGEST_LENGTH) != 0) {
+        DEBUG(SSSDBG_TRACE_FUNC, ("The PAC of [%s] changed\n", name));
+        goto drop;
+    }
+
+    /* the user might have been removed from the cache in the meantime */
+    ret = sysdb_search_user_by_uid(entry, dom->sysdb, dom, entry->uid,
+                                   attrs, &msg);
+    if (ret == ENOENT) {
+        goto drop;
+    } else if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("sysdb_search_user_by_uid failed.\n"));
+        return ret;
+    }
+    talloc_free(msg);
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("The PAC of [%s] did not change, "
+                              "skipping the update of the user\n", name));
+    cache->stats.unchanged++;
+    cache->stats.avoided_writes += entry->writes;
+
+    return EOK;
+
+drop:
+    talloc_free(entry);
+    return ENOENT;
+}
+
+errno_t pac_digest_store(struct pac_digest_cache *cache,
+                         struct sss_domain_info *dom,
+                         const char *name,
+                         const uint8_t *digest,
+                         uid_t uid,
+                         size_t writes)
+{
+    struct pac_digest_entry *entry;
+    time_t expire;
+    errno_t ret;
+
+    if (cache == NULL) return EOK;
+
+    cache->stats.writes += writes;
+
+    entry = talloc_zero(cache->table, struct pac_digest_entry);
+    if (entry == NULL) {
+        return ENOMEM;
+    }
+    entry->uid = uid;
+    /* writes are counted from the first time the PAC was processed */
+    entry->writes = writes;
+    memcpy(entry->digest, digest, PAC_DIGEST_LENGTH);
+
+    /* process the PAC again once the user entry would have expired */
+    expire = dom->user_timeout ? time(NULL) + dom->user_timeout : 0;
+
+    /* replaces the digest of an older PAC */
+    ret = sss_rtable_add(cache->table, &entry->base, name, expire);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE, ("Unable to remember the PAC of [%s]\n",
+                                     name));
+        talloc_free(entry);
+        return ret;
+    }
+
+    return EOK;
+}
+
+void pac_digest_log_stats(struct pac_digest_cache *cache)
+{
+    if (cache == NULL) return;
+
+    sss_rtable_log_stats(cache->table);
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          ("PAC digests: %llu requests, %llu unchanged, %llu user writes, "
+           "%llu writes avoided\n",
+           (unsigned long long)cache->stats.requests,
+           (unsigned long long)cache->stats.unchanged,
+           (unsigned long long)cache->stats.writes,
+           (unsigned long long)cache->stats.avoided_writes));
+}
@@ -949,10 +949,20 @@ static int pam_check_user_search(struct pam_auth_req *preq)
             return EFAULT;
         }
 
-        ret = sysdb_getpwnam(preq, sysdb, dom, name, &preq->res);
+        ret = ENOENT;
+        if (preq->check_provider) {
+            ret = sss_rc_lookup(preq->cctx->rctx->result_cache, preq,
+                                SSS_RC_PWNAM, dom, name, 0, &preq->res);
+        }
         if (ret != EOK) {
-            DEBUG(1, ("Failed to make request to our cache!\n"));
-            return EIO;
+            ret = sysdb_getpwnam(preq, sysdb, dom, name, &preq->res);
+            if (ret != EOK) {
+                DEBUG(1, ("Failed to make request to our cache!\n"));
+                return EIO;
+            }
+
+            sss_rc_store(preq->cctx->rctx->result_cache, SSS_RC_PWNAM, dom,
+                         name, 0, preq->res);
         }
 
         if (preq->res->count > 1) {
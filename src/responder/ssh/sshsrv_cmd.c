@@ -351,7 +351,8 @@ ssh_host_pubkeys_search_next(struct ssh_cmd_ctx *cmd_ctx)
 {
     errno_t ret;
     struct sysdb_ctx *sysdb;
-    const char *attrs[] = { SYSDB_NAME, SYSDB_SSH_PUBKEY, NULL };
+    const char *attrs[] = { SYSDB_NAME, SYSDB_NAME_ALIAS,
+                            SYSDB_SSH_PUBKEY, NULL };
 
     DEBUG(SSSDBG_TRACE_FUNC,
           ("Requesting SSH host public keys for [%s@%s]\n",
@@ -411,264 +412,24 @@ ssh_host_pubkeys_search_dp_callback(uint16_t err_maj,
     ssh_cmd_done(cmd_ctx, ret);
 }
 
-static char *
-ssh_host_pubkeys_format_known_host_plain(TALLOC_CTX *mem_ctx,
-                                         struct sss_ssh_ent *ent)
-{
-    TALLOC_CTX *tmp_ctx;
-    errno_t ret;
-    char *name, *pubkey;
-    char *result = NULL;
-    size_t i;
-
-    tmp_ctx = talloc_new(NULL);
-    if (!tmp_ctx) {
-        return NULL;
-    }
-
-    name = talloc_strdup(tmp_ctx, ent->name);
-    if (!name) {
-        goto done;
-    }
-
-    for (i = 0; i < ent->num_aliases; i++) {
-        name = talloc_asprintf_append(name, ",%s", ent->aliases[i]);
-        if (!name) {
-            goto done;
-        }
-    }
-
-    result = talloc_strdup(tmp_ctx, "");
-    if (!result) {
-        goto done;
-    }
-
-    for (i = 0; i < ent->num_pubkeys; i++) {
-        ret = sss_ssh_format_pubkey(tmp_ctx, &ent->pubkeys[i], &pubkey);
-        if (ret != EOK) {
-            result = NULL;
-            goto done;
-        }
-
-        result = talloc_asprintf_append(result, "%s %s\n", name, pubkey);
-        if (!result) {
-            goto done;
-        }
-
-        talloc_free(pubkey);
-    }
-
-    talloc_steal(mem_ctx, result);
-
-done:
-    talloc_free(tmp_ctx);
-
-    return result;
-}
-
-static char *
-ssh_host_pubkeys_format_known_host_hashed(TALLOC_CTX *mem_ctx,
-                                          struct sss_ssh_ent *ent)
-{
-    TALLOC_CTX *tmp_ctx;
-    errno_t ret;
-    char *name, *pubkey, *saltstr, *hashstr, *result;
-    unsigned char salt[SSS_SHA1_LENGTH], hash[SSS_SHA1_LENGTH];
-    size_t i, j, k;
-
-    tmp_ctx = talloc_new(NULL);
-    if (!tmp_ctx) {
-        return NULL;
-    }
-
-    result = talloc_strdup(tmp_ctx, "");
-    if (!result) {
-        goto done;
-    }
-
-    for (i = 0; i < ent->num_pubkeys; i++) {
-        ret = sss_ssh_format_pubkey(tmp_ctx, &ent->pubkeys[i], &pubkey);
-        if (ret != EOK) {
-            result = NULL;
-            goto done;
-        }
-
-        for (j = 0; j <= ent->num_aliases; j++) {
-            name = (j == 0 ? ent->name : ent->aliases[j-1]);
-
-            for (k = 0; k < SSS_SHA1_LENGTH; k++) {
-                salt[k] = rand();
-            }
-
-            ret = sss_hmac_sha1(salt, SSS_SHA1_LENGTH,
-                                (unsigned char *)name, strlen(name),
-                                hash);
-            if (ret != EOK) {
-                DEBUG(SSSDBG_OP_FAILURE,
-                      ("sss_hmac_sha1() failed (%d): %s\n",
-                       ret, strerror(ret)));
-                result = NULL;
-                goto done;
-            }
-
-            saltstr = sss_base64_encode(tmp_ctx, salt, SSS_SHA1_LENGTH);
-            if (!saltstr) {
-                result = NULL;
-                goto done;
-            }
-
-            hashstr = sss_base64_encode(tmp_ctx, hash, SSS_SHA1_LENGTH);
-            if (!hashstr) {
-                result = NULL;
-                goto done;
-            }
-
-            result = talloc_asprintf_append(result, "|1|%s|%s %s\n",
-                                            saltstr, hashstr, pubkey);
-            if (!result) {
-                goto done;
-            }
-
-            talloc_free(saltstr);
-            talloc_free(hashstr);
-        }
-
-        talloc_free(pubkey);
-    }
-
-    talloc_steal(mem_ctx, result);
-
-done:
-    talloc_free(tmp_ctx);
-
-    return result;
-}
-
 static errno_t
 ssh_host_pubkeys_update_known_hosts(struct ssh_cmd_ctx *cmd_ctx)
 {
-    TALLOC_CTX *tmp_ctx;
     errno_t ret;
-    const char *attrs[] = {
-        SYSDB_NAME,
-        SYSDB_NAME_ALIAS,
-        SYSDB_SSH_PUBKEY,
-        NULL
-    };
     struct cli_ctx *cctx = cmd_ctx->cctx;
-    struct sss_domain_info *dom = cctx->rctx->domains;
     struct ssh_ctx *ssh_ctx = (struct ssh_ctx *)cctx->rctx->pvt_ctx;
-    struct sysdb_ctx *sysdb;
     time_t now = time(NULL);
-    struct ldb_message **hosts;
-    size_t num_hosts, i;
-    struct sss_ssh_ent *ent;
-    int fd = -1;
-    char *filename = NULL;
-    char *entstr;
-    ssize_t wret;
-    mode_t old_mask;
-
-    tmp_ctx = talloc_new(NULL);
-    if (!tmp_ctx) {
-        return ENOMEM;
-    }
 
     ret = sysdb_update_ssh_known_host_expire(cmd_ctx->domain->sysdb,
                                              cmd_ctx->domain,
                                              cmd_ctx->name, now,
                                              ssh_ctx->known_hosts_timeout);
     if (ret != EOK) {
-        goto done;
-    }
-
-    /* write known_hosts file */
-    filename = talloc_strdup(tmp_ctx, SSS_SSH_KNOWN_HOSTS_TEMP_TMPL);
-    if (!filename) {
-        ret = ENOMEM;
-        goto done;
-    }
-
-    old_mask = umask(0133);
-    fd = mkstemp(filename);
-    umask(old_mask);
-    if (fd == -1) {
-        filename = NULL;
-        ret = errno;
-        goto done;
-    }
-
-    for (; dom; dom = get_next_domain(dom, false)) {
-        sysdb = dom->sysdb;
-        if (sysdb == NULL) {
-            DEBUG(SSSDBG_FATAL_FAILURE,
-                  ("Fatal: Sysdb CTX not found for this domain!\n"));
-            ret = EFAULT;
-            goto done;
-        }
-
-        ret = sysdb_get_ssh_known_hosts(tmp_ctx, sysdb, dom, now, attrs,
-                                        &hosts, &num_hosts);
-        if (ret != EOK) {
-            if (ret != ENOENT) {
-                DEBUG(SSSDBG_OP_FAILURE,
-                      ("Host search failed for domain [%s]\n", dom->name));
-            }
-            continue;
-        }
-
-        for (i = 0; i < num_hosts; i++) {
-            ret = sss_ssh_make_ent(tmp_ctx, hosts[i], &ent);
-            if (ret != EOK) {
-                DEBUG(SSSDBG_OP_FAILURE,
-                      ("Failed to get SSH host public keys\n"));
-                continue;
-            }
-
-            if (ssh_ctx->hash_known_hosts) {
-                entstr = ssh_host_pubkeys_format_known_host_hashed(ent, ent);
-            } else {
-                entstr = ssh_host_pubkeys_format_known_host_plain(ent, ent);
-            }
-            if (!entstr) {
-                DEBUG(SSSDBG_OP_FAILURE,
-                      ("Failed to format known_hosts data for [%s]\n",
-                       ent->name));
-                continue;
-            }
-
-            wret = sss_atomic_write_s(fd, entstr, strlen(entstr));
-            if (wret == -1) {
-                ret = errno;
-                goto done;
-            }
-
-            talloc_free(ent);
-        }
-
-        talloc_free(hosts);
-    }
-
-    ret = fchmod(fd, 0644);
-    if (ret == -1) {
-        ret = errno;
-        goto done;
-    }
-
-    ret = rename(filename, SSS_SSH_KNOWN_HOSTS_PATH);
-    if (ret == -1) {
-        ret = errno;
-        goto done;
+        return ret;
     }
 
-    ret = EOK;
-
-done:
-    if (fd != -1) close(fd);
-    if (ret != EOK && filename) unlink(filename);
-    talloc_free(tmp_ctx);
-
-    return ret;
+    return ssh_known_hosts_update(ssh_ctx, cmd_ctx->domain, cmd_ctx->result,
+                                  now);
 }
 
 static errno_t
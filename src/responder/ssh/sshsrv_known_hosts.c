@@ -0,0 +1,573 @@
+/*
+    SSSD
+
+    SSH responder - the known_hosts file
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <talloc.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "util/util.h"
+#include "util/crypto/sss_crypto.h"
+#include "util/sss_ssh.h"
+#include "db/sysdb.h"
+#include "db/sysdb_ssh.h"
+#include "responder/ssh/sshsrv_private.h"
+
+static char *
+ssh_host_pubkeys_format_known_host_plain(TALLOC_CTX *mem_ctx,
+                                         struct sss_ssh_ent *ent)
+{
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    char *name, *pubkey;
+    char *result = NULL;
+    size_t i;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return NULL;
+    }
+
+    name = talloc_strdup(tmp_ctx, ent->name);
+    if (!name) {
+        goto done;
+    }
+
+    for (i = 0; i < ent->num_aliases; i++) {
+        name = talloc_asprintf_append(name, ",%s", ent->aliases[i]);
+        if (!name) {
+            goto done;
+        }
+    }
+
+    result = talloc_strdup(tmp_ctx, "");
+    if (!result) {
+        goto done;
+    }
+
+    for (i = 0; i < ent->num_pubkeys; i++) {
+        ret = sss_ssh_format_pubkey(tmp_ctx, &ent->pubkeys[i], &pubkey);
+        if (ret != EOK) {
+            result = NULL;
+            goto done;
+        }
+
+        result = talloc_asprintf_append(result, "%s %s\n", name, pubkey);
+        if (!result) {
+            goto done;
+        }
+
+        talloc_free(pubkey);
+    }
+
+    talloc_steal(mem_ctx, result);
+
+done:
+    talloc_free(tmp_ctx);
+
+    return result;
+}
+
+static char *
+ssh_host_pubkeys_format_known_host_hashed(TALLOC_CTX *mem_ctx,
+                                          struct sss_ssh_ent *ent)
+{
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    char *name, *pubkey, *saltstr, *hashstr, *result;
+    unsigned char salt[SSS_SHA1_LENGTH], hash[SSS_SHA1_LENGTH];
+    size_t i, j, k;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return NULL;
+    }
+
+    result = talloc_strdup(tmp_ctx, "");
+    if (!result) {
+        goto done;
+    }
+
+    for (i = 0; i < ent->num_pubkeys; i++) {
+        ret = sss_ssh_format_pubkey(tmp_ctx, &ent->pubkeys[i], &pubkey);
+        if (ret != EOK) {
+            result = NULL;
+            goto done;
+        }
+
+        for (j = 0; j <= ent->num_aliases; j++) {
+            name = (j == 0 ? ent->name : ent->aliases[j-1]);
+
+            for (k = 0; k < SSS_SHA1_LENGTH; k++) {
+                salt[k] = rand();
+            }
+
+            ret = sss_hmac_sha1(salt, SSS_SHA1_LENGTH,
+                                (unsigned char *)name, strlen(name),
+                                hash);
+            if (ret != EOK) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      ("sss_hmac_sha1() failed (%d): %s\n",
+                       ret, strerror(ret)));
+                result = NULL;
+                goto done;
+            }
+
+            saltstr = sss_base64_encode(tmp_ctx, salt, SSS_SHA1_LENGTH);
+            if (!saltstr) {
+                result = NULL;
+                goto done;
+            }
+
+            hashstr = sss_base64_encode(tmp_ctx, hash, SSS_SHA1_LENGTH);
+            if (!hashstr) {
+                result = NULL;
+                goto done;
+            }
+
+            result = talloc_asprintf_append(result, "|1|%s|%s %s\n",
+                                            saltstr, hashstr, pubkey);
+            if (!result) {
+                goto done;
+            }
+
+            talloc_free(saltstr);
+            talloc_free(hashstr);
+        }
+
+        talloc_free(pubkey);
+    }
+
+    talloc_steal(mem_ctx, result);
+
+done:
+    talloc_free(tmp_ctx);
+
+    return result;
+}
+
+/* The entries of the known_hosts file are kept in memory, keyed by domain
+ * and host name. The file is appended to when a host is added and only
+ * rewritten when the keys of a host change or entries expire, so looking
+ * up a known host does not touch the file at all.
+ */
+struct ssh_known_host {
+    /* the entry is allocated on the table it is stored in, so a table that
+     * is thrown away takes its entries with it */
+    hash_table_t *table;
+    hash_key_t key;
+    /* plain entry, tells whether the keys of the host changed */
+    char *plain;
+    /* entry as written to the file */
+    char *text;
+    time_t expire;
+};
+
+static int ssh_known_host_destructor(struct ssh_known_host *host)
+{
+    hash_delete(host->table, &host->key);
+    return 0;
+}
+
+errno_t
+ssh_known_hosts_set(struct ssh_ctx *ssh_ctx,
+                    struct sss_domain_info *dom,
+                    struct ldb_message *msg,
+                    time_t expire,
+                    struct ssh_known_host **_host,
+                    enum ssh_known_hosts_change *_change)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ssh_known_host *host = NULL;
+    struct ssh_known_host *old = NULL;
+    struct sss_ssh_ent *ent;
+    hash_key_t key;
+    hash_value_t value;
+    char *plain;
+    int hret;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    ret = sss_ssh_make_ent(tmp_ctx, msg, &ent);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Failed to get SSH host public keys\n"));
+        goto done;
+    }
+
+    key.type = HASH_KEY_STRING;
+    key.str = talloc_asprintf(tmp_ctx, "%s/%s", dom->name, ent->name);
+    if (!key.str) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    plain = ssh_host_pubkeys_format_known_host_plain(tmp_ctx, ent);
+    if (!plain) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Failed to format known_hosts data for [%s]\n", ent->name));
+        ret = ENOMEM;
+        goto done;
+    }
+
+    hret = hash_lookup(ssh_ctx->known_hosts, &key, &value);
+    if (hret == HASH_SUCCESS) {
+        old = talloc_get_type(value.ptr, struct ssh_known_host);
+        if (strcmp(old->plain, plain) == 0) {
+            old->expire = expire;
+            host = old;
+            *_change = SSH_KNOWN_HOSTS_UNCHANGED;
+            goto expire;
+        }
+    }
+
+    host = talloc_zero(ssh_ctx->known_hosts, struct ssh_known_host);
+    if (!host) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    host->table = ssh_ctx->known_hosts;
+    host->expire = expire;
+    host->key.type = HASH_KEY_STRING;
+    host->key.str = talloc_steal(host, key.str);
+    host->plain = talloc_steal(host, plain);
+
+    if (ssh_ctx->hash_known_hosts) {
+        /* hashed only once, the salt stays the same on later rewrites */
+        host->text = ssh_host_pubkeys_format_known_host_hashed(host, ent);
+        if (!host->text) {
+            DEBUG(SSSDBG_OP_FAILURE,
+                  ("Failed to format known_hosts data for [%s]\n",
+                   ent->name));
+            ret = ENOMEM;
+            goto done;
+        }
+    } else {
+        host->text = host->plain;
+    }
+
+    if (old) {
+        talloc_free(old);
+        *_change = SSH_KNOWN_HOSTS_MODIFIED;
+    } else {
+        *_change = SSH_KNOWN_HOSTS_ADDED;
+    }
+
+    value.type = HASH_VALUE_PTR;
+    value.ptr = host;
+
+    hret = hash_enter(ssh_ctx->known_hosts, &host->key, &value);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unable to add [%s] to known_hosts: %s\n",
+                                  host->key.str, hash_error_string(hret)));
+        ret = EIO;
+        goto done;
+    }
+    talloc_set_destructor(host, ssh_known_host_destructor);
+
+expire:
+    if (ssh_ctx->known_hosts_next_expire == 0
+            || expire < ssh_ctx->known_hosts_next_expire) {
+        ssh_ctx->known_hosts_next_expire = expire;
+    }
+
+    *_host = host;
+    ret = EOK;
+
+done:
+    if (ret != EOK && host != old) {
+        talloc_free(host);
+    }
+    talloc_free(tmp_ctx);
+
+    return ret;
+}
+
+bool
+ssh_known_hosts_expire(struct ssh_ctx *ssh_ctx, time_t now)
+{
+    struct ssh_known_host *host;
+    hash_value_t *values;
+    unsigned long count;
+    unsigned long i;
+    time_t next = 0;
+    bool removed = false;
+    int hret;
+
+    if (ssh_ctx->known_hosts_next_expire == 0
+            || ssh_ctx->known_hosts_next_expire >= now) {
+        return false;
+    }
+
+    hret = hash_values(ssh_ctx->known_hosts, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        DEBUG(SSSDBG_OP_FAILURE, ("Unable to list known_hosts entries\n"));
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        host = talloc_get_type(values[i].ptr, struct ssh_known_host);
+        if (host->expire < now) {
+            talloc_free(host);
+            removed = true;
+        } else if (next == 0 || host->expire < next) {
+            next = host->expire;
+        }
+    }
+
+    ssh_ctx->known_hosts_next_expire = next;
+    talloc_free(values);
+
+    return removed;
+}
+
+errno_t
+ssh_known_hosts_write(struct ssh_ctx *ssh_ctx)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct ssh_known_host *host;
+    hash_value_t *values = NULL;
+    unsigned long count;
+    unsigned long i;
+    int fd = -1;
+    char *filename = NULL;
+    ssize_t wret;
+    mode_t old_mask;
+    int hret;
+    errno_t ret;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    hret = hash_values(ssh_ctx->known_hosts, &count, &values);
+    if (hret != HASH_SUCCESS) {
+        values = NULL;
+        ret = ENOMEM;
+        goto done;
+    }
+
+    filename = talloc_strdup(tmp_ctx, SSS_SSH_KNOWN_HOSTS_TEMP_TMPL);
+    if (!filename) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    old_mask = umask(0133);
+    fd = mkstemp(filename);
+    umask(old_mask);
+    if (fd == -1) {
+        filename = NULL;
+        ret = errno;
+        goto done;
+    }
+
+    for (i = 0; i < count; i++) {
+        host = talloc_get_type(values[i].ptr, struct ssh_known_host);
+
+        wret = sss_atomic_write_s(fd, host->text, strlen(host->text));
+        if (wret == -1) {
+            ret = errno;
+            goto done;
+        }
+    }
+
+    ret = fchmod(fd, 0644);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    ret = rename(filename, SSS_SSH_KNOWN_HOSTS_PATH);
+    if (ret == -1) {
+        ret = errno;
+        goto done;
+    }
+
+    DEBUG(SSSDBG_TRACE_FUNC,
+          ("Wrote %lu entries to the known_hosts file\n", count));
+
+    ret = EOK;
+
+done:
+    if (fd != -1) close(fd);
+    if (ret != EOK && filename) unlink(filename);
+    talloc_free(values);
+    talloc_free(tmp_ctx);
+
+    return ret;
+}
+
+errno_t
+ssh_known_hosts_append(struct ssh_known_host *host)
+{
+    int fd;
+    ssize_t wret;
+    errno_t ret;
+
+    fd = open(SSS_SSH_KNOWN_HOSTS_PATH, O_WRONLY | O_APPEND);
+    if (fd == -1) {
+        return errno;
+    }
+
+    wret = sss_atomic_write_s(fd, host->text, strlen(host->text));
+    if (wret == -1) {
+        ret = errno;
+    } else {
+        ret = EOK;
+    }
+
+    close(fd);
+    return ret;
+}
+
+errno_t
+ssh_known_hosts_load(struct ssh_ctx *ssh_ctx, time_t now)
+{
+    TALLOC_CTX *tmp_ctx;
+    errno_t ret;
+    const char *attrs[] = {
+        SYSDB_NAME,
+        SYSDB_NAME_ALIAS,
+        SYSDB_SSH_PUBKEY,
+        SYSDB_SSH_KNOWN_HOSTS_EXPIRE,
+        NULL
+    };
+    struct sss_domain_info *dom = ssh_ctx->rctx->domains;
+    struct sysdb_ctx *sysdb;
+    struct ldb_message **hosts;
+    struct ssh_known_host *host;
+    enum ssh_known_hosts_change change;
+    size_t num_hosts, i;
+    time_t expire;
+
+    tmp_ctx = talloc_new(NULL);
+    if (!tmp_ctx) {
+        return ENOMEM;
+    }
+
+    ret = sss_hash_create(ssh_ctx, 0, &ssh_ctx->known_hosts);
+    if (ret != EOK) {
+        goto done;
+    }
+    ssh_ctx->known_hosts_next_expire = 0;
+
+    for (; dom; dom = get_next_domain(dom, false)) {
+        sysdb = dom->sysdb;
+        if (sysdb == NULL) {
+            DEBUG(SSSDBG_FATAL_FAILURE,
+                  ("Fatal: Sysdb CTX not found for this domain!\n"));
+            ret = EFAULT;
+            goto done;
+        }
+
+        ret = sysdb_get_ssh_known_hosts(tmp_ctx, sysdb, dom, now, attrs,
+                                        &hosts, &num_hosts);
+        if (ret != EOK) {
+            if (ret != ENOENT) {
+                DEBUG(SSSDBG_OP_FAILURE,
+                      ("Host search failed for domain [%s]\n", dom->name));
+            }
+            continue;
+        }
+
+        for (i = 0; i < num_hosts; i++) {
+            expire = ldb_msg_find_attr_as_uint64(hosts[i],
+                                                 SYSDB_SSH_KNOWN_HOSTS_EXPIRE,
+                                                 0);
+
+            ret = ssh_known_hosts_set(ssh_ctx, dom, hosts[i], expire,
+                                      &host, &change);
+            if (ret == ENOMEM) {
+                goto done;
+            }
+        }
+
+        talloc_free(hosts);
+    }
+
+    ret = EOK;
+
+done:
+    if (ret != EOK) {
+        /* start over with the next lookup, this frees the entries loaded
+         * so far too */
+        talloc_zfree(ssh_ctx->known_hosts);
+    }
+    talloc_free(tmp_ctx);
+
+    return ret;
+}
+
+errno_t
+ssh_known_hosts_update(struct ssh_ctx *ssh_ctx,
+                       struct sss_domain_info *dom,
+                       struct ldb_message *msg,
+                       time_t now)
+{
+    errno_t ret;
+    struct ssh_known_host *host = NULL;
+    enum ssh_known_hosts_change change = SSH_KNOWN_HOSTS_MODIFIED;
+    bool rewrite;
+
+    if (ssh_ctx->known_hosts == NULL) {
+        /* first lookup, the cache already contains this host */
+        ret = ssh_known_hosts_load(ssh_ctx, now);
+        if (ret != EOK) {
+            return ret;
+        }
+    } else {
+        ret = ssh_known_hosts_set(ssh_ctx, dom, msg,
+                                  now + ssh_ctx->known_hosts_timeout,
+                                  &host, &change);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    rewrite = (change == SSH_KNOWN_HOSTS_MODIFIED);
+    if (ssh_known_hosts_expire(ssh_ctx, now)) {
+        rewrite = true;
+    }
+
+    if (!rewrite && change == SSH_KNOWN_HOSTS_ADDED) {
+        ret = ssh_known_hosts_append(host);
+        if (ret != EOK) {
+            DEBUG(SSSDBG_TRACE_FUNC,
+                  ("Cannot append to the known_hosts file [%d]: %s\n",
+                   ret, strerror(ret)));
+            rewrite = true;
+        }
+    }
+
+    if (rewrite) {
+        ret = ssh_known_hosts_write(ssh_ctx);
+        if (ret != EOK) {
+            return ret;
+        }
+    }
+
+    return EOK;
+}
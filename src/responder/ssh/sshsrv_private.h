@@ -23,14 +23,22 @@
 
 #include "responder/common/responder.h"
 
-#define SSS_SSH_KNOWN_HOSTS_PATH PUBCONF_PATH"/known_hosts"
-#define SSS_SSH_KNOWN_HOSTS_TEMP_TMPL PUBCONF_PATH"/.known_hosts.XXXXXX"
+#ifndef SSS_SSH_KNOWN_HOSTS_DIR
+#define SSS_SSH_KNOWN_HOSTS_DIR PUBCONF_PATH
+#endif
+
+#define SSS_SSH_KNOWN_HOSTS_PATH SSS_SSH_KNOWN_HOSTS_DIR"/known_hosts"
+#define SSS_SSH_KNOWN_HOSTS_TEMP_TMPL SSS_SSH_KNOWN_HOSTS_DIR"/.known_hosts.XXXXXX"
 
 struct ssh_ctx {
     struct resp_ctx *rctx;
 
     bool hash_known_hosts;
     int known_hosts_timeout;
+
+    /* entries of the known_hosts file, see sshsrv_known_hosts.c */
+    hash_table_t *known_hosts;
+    time_t known_hosts_next_expire;
 };
 
 struct ssh_cmd_ctx {
@@ -62,4 +70,45 @@ sss_dp_get_ssh_host_recv(TALLOC_CTX *mem_ctx,
                          dbus_uint32_t *dp_ret,
                          char **err_msg);
 
+/* known_hosts file */
+struct ssh_known_host;
+
+enum ssh_known_hosts_change {
+    SSH_KNOWN_HOSTS_UNCHANGED,
+    SSH_KNOWN_HOSTS_ADDED,
+    SSH_KNOWN_HOSTS_MODIFIED
+};
+
+/* Adds the host in msg to the entries, or updates its expiration time if
+ * its keys did not change */
+errno_t
+ssh_known_hosts_set(struct ssh_ctx *ssh_ctx,
+                    struct sss_domain_info *dom,
+                    struct ldb_message *msg,
+                    time_t expire,
+                    struct ssh_known_host **_host,
+                    enum ssh_known_hosts_change *_change);
+
+/* Returns true if any entry was removed */
+bool
+ssh_known_hosts_expire(struct ssh_ctx *ssh_ctx, time_t now);
+
+/* Rewrites the whole file */
+errno_t
+ssh_known_hosts_write(struct ssh_ctx *ssh_ctx);
+
+errno_t
+ssh_known_hosts_append(struct ssh_known_host *host);
+
+/* Loads the entries of all hosts that did not expire from the cache */
+errno_t
+ssh_known_hosts_load(struct ssh_ctx *ssh_ctx, time_t now);
+
+/* Brings the file up to date after the host in msg was looked up */
+errno_t
+ssh_known_hosts_update(struct ssh_ctx *ssh_ctx,
+                       struct sss_domain_info *dom,
+                       struct ldb_message *msg,
+                       time_t now);
+
 #endif /* _SSHSRV_PRIVATE_H_ */
@@ -0,0 +1,390 @@
+/*
+    SSSD
+
+    Sudo responder - cache of sorted rule sets
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <string.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "db/sysdb_sudo.h"
+#include "responder/common/responder_table.h"
+#include "responder/sudo/sudosrv_private.h"
+
+#define SUDO_CACHE_TABLE_INIT_SIZE 64
+/* how often rule sets nobody asked for again are dropped */
+#define SUDO_CACHE_SWEEP_INTERVAL 60
+
+struct sudosrv_cache_entry {
+    struct sss_rtable_entry base;
+    char *domain;
+    /* a copy owned by the entry, callers never share it */
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+};
+
+/* last change of the rules of a domain, as seen by this cache */
+struct sudosrv_cache_dom {
+    struct sudosrv_cache_dom *next;
+    char *name;
+    time_t last_change;
+};
+
+struct sudosrv_cache {
+    struct sss_rtable *table;
+    struct sudosrv_cache_dom *domains;
+    uint64_t invalidated;
+};
+
+static int sudosrv_cache_destructor(struct sudosrv_cache *cache)
+{
+    sudosrv_cache_log_stats(cache);
+    return 0;
+}
+
+errno_t sudosrv_cache_init(TALLOC_CTX *mem_ctx,
+                           struct sudosrv_cache **_cache)
+{
+    struct sudosrv_cache *cache;
+    errno_t ret;
+
+    cache = talloc_zero(mem_ctx, struct sudosrv_cache);
+    if (!cache) return ENOMEM;
+
+    ret = sss_rtable_init(cache, "Sudo rule cache", SUDO_CACHE_TABLE_INIT_SIZE,
+                          SUDO_CACHE_MAX_ENTRIES, SUDO_CACHE_SWEEP_INTERVAL,
+                          NULL, &cache->table);
+    if (ret != EOK) {
+        talloc_free(cache);
+        return ret;
+    }
+
+    talloc_set_destructor(cache, sudosrv_cache_destructor);
+
+    *_cache = cache;
+    return EOK;
+}
+
+/* Defaults do not depend on the user, one entry per domain is enough */
+static char *sudosrv_cache_key(TALLOC_CTX *mem_ctx,
+                               struct sss_domain_info *domain,
+                               enum sss_sudo_type type,
+                               const char *username,
+                               uid_t uid,
+                               char **groupnames)
+{
+    char *key;
+    int i;
+
+    if (type == SSS_SUDO_DEFAULTS) {
+        return talloc_asprintf(mem_ctx, "DFL/%s", domain->name);
+    }
+
+    key = talloc_asprintf(mem_ctx, "USER/%s/%s/%llu", domain->name,
+                          username, (unsigned long long)uid);
+    if (key == NULL) return NULL;
+
+    for (i = 0; groupnames != NULL && groupnames[i] != NULL; i++) {
+        key = talloc_asprintf_append_buffer(key, "/%s", groupnames[i]);
+        if (key == NULL) return NULL;
+    }
+
+    return key;
+}
+
+static struct sysdb_attrs **
+sudosrv_cache_copy_rules(TALLOC_CTX *mem_ctx,
+                         struct sysdb_attrs **rules,
+                         uint32_t num_rules)
+{
+    struct sysdb_attrs **copy;
+    uint32_t i;
+    int j;
+    errno_t ret;
+
+    copy = talloc_array(mem_ctx, struct sysdb_attrs *, num_rules);
+    if (copy == NULL) return NULL;
+
+    for (i = 0; i < num_rules; i++) {
+        copy[i] = sysdb_new_attrs(copy);
+        if (copy[i] == NULL) goto fail;
+
+        for (j = 0; j < rules[i]->num; j++) {
+            ret = sysdb_attrs_copy_values(rules[i], copy[i],
+                                          rules[i]->a[j].name);
+            if (ret != EOK) goto fail;
+        }
+    }
+
+    return copy;
+
+fail:
+    talloc_free(copy);
+    return NULL;
+}
+
+static void sudosrv_cache_drop_domain(struct sudosrv_cache *cache,
+                                      const char *domain)
+{
+    struct sss_rtable_entry *base;
+    struct sss_rtable_entry *next;
+    struct sudosrv_cache_entry *entry;
+
+    for (base = sss_rtable_first(cache->table); base != NULL; base = next) {
+        next = base->next;
+        entry = (struct sudosrv_cache_entry *)base;
+        if (strcmp(entry->domain, domain) == 0) {
+            cache->invalidated++;
+            talloc_free(entry);
+        }
+    }
+}
+
+static struct sudosrv_cache_dom *
+sudosrv_cache_find_dom(struct sudosrv_cache *cache, const char *name)
+{
+    struct sudosrv_cache_dom *dom;
+
+    for (dom = cache->domains; dom != NULL; dom = dom->next) {
+        if (strcmp(dom->name, name) == 0) break;
+    }
+
+    return dom;
+}
+
+/* Reads when the provider last changed the rules of the domain and drops
+ * all entries of the domain if that happened since they were stored */
+static errno_t sudosrv_cache_check_domain(struct sudosrv_cache *cache,
+                                          struct sss_domain_info *domain,
+                                          time_t *_last_change)
+{
+    struct sudosrv_cache_dom *dom;
+    time_t last_change;
+    errno_t ret;
+
+    ret = sysdb_sudo_get_last_change(domain->sysdb, domain, &last_change);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_OP_FAILURE,
+              ("Unable to get the last change of sudo rules [%d]: %s\n",
+               ret, strerror(ret)));
+        return ret;
+    }
+
+    dom = sudosrv_cache_find_dom(cache, domain->name);
+    if (dom == NULL) {
+        dom = talloc_zero(cache, struct sudosrv_cache_dom);
+        if (dom == NULL) return ENOMEM;
+
+        dom->name = talloc_strdup(dom, domain->name);
+        if (dom->name == NULL) {
+            talloc_free(dom);
+            return ENOMEM;
+        }
+        dom->last_change = last_change;
+        dom->next = cache->domains;
+        cache->domains = dom;
+    } else if (dom->last_change != last_change) {
+        DEBUG(SSSDBG_TRACE_FUNC,
+              ("Sudo rules of [%s] changed, dropping cached rule sets\n",
+               domain->name));
+        sudosrv_cache_drop_domain(cache, domain->name);
+        dom->last_change = last_change;
+        sudosrv_cache_log_stats(cache);
+    }
+
+    *_last_change = last_change;
+    return EOK;
+}
+
+errno_t sudosrv_cache_lookup(struct sudosrv_cache *cache,
+                             TALLOC_CTX *mem_ctx,
+                             struct sss_domain_info *domain,
+                             enum sss_sudo_type type,
+                             const char *username,
+                             uid_t uid,
+                             char **groupnames,
+                             struct sysdb_attrs ***_rules,
+                             uint32_t *_num_rules)
+{
+    struct sudosrv_cache_entry *entry;
+    time_t last_change;
+    char *keystr;
+    errno_t ret;
+
+    if (cache == NULL) return ENOENT;
+
+    ret = sudosrv_cache_check_domain(cache, domain, &last_change);
+    if (ret != EOK) return ret;
+
+    keystr = sudosrv_cache_key(NULL, domain, type, username, uid,
+                               groupnames);
+    if (keystr == NULL) return ENOMEM;
+
+    /* entries whose rules have to be refreshed are not returned */
+    entry = (struct sudosrv_cache_entry *)sss_rtable_lookup(cache->table,
+                                                             keystr);
+    talloc_free(keystr);
+    if (entry == NULL) return ENOENT;
+
+    DEBUG(SSSDBG_TRACE_FUNC, ("Returning %u cached rules for [%s]\n",
+                              entry->num_rules, entry->base.key.str));
+
+    if (entry->num_rules > 0) {
+        /* the entry may go away while the caller still uses the rules */
+        *_rules = sudosrv_cache_copy_rules(mem_ctx, entry->rules,
+                                           entry->num_rules);
+        if (*_rules == NULL) return ENOMEM;
+    } else {
+        *_rules = NULL;
+    }
+    *_num_rules = entry->num_rules;
+
+    return EOK;
+}
+
+void sudosrv_cache_take_expire(struct sysdb_attrs **rules,
+                               uint32_t num_rules,
+                               time_t *_expire)
+{
+    struct ldb_message_element *el;
+    time_t expire;
+    uint32_t i;
+    int j;
+
+    for (i = 0; i < num_rules; i++) {
+        for (j = 0; j < rules[i]->num; j++) {
+            el = &rules[i]->a[j];
+            if (strcasecmp(el->name, SYSDB_CACHE_EXPIRE) != 0) continue;
+
+            if (el->num_values > 0) {
+                expire = strtoll((const char *)el->values[0].data, NULL, 10);
+                if (expire < *_expire) {
+                    *_expire = expire;
+                }
+            }
+
+            rules[i]->num--;
+            if (j != rules[i]->num) {
+                rules[i]->a[j] = rules[i]->a[rules[i]->num];
+            }
+            break;
+        }
+    }
+}
+
+errno_t sudosrv_cache_get_last_change(struct sudosrv_cache *cache,
+                                      struct sss_domain_info *domain,
+                                      time_t *_last_change)
+{
+    if (cache == NULL) {
+        *_last_change = 0;
+        return EOK;
+    }
+
+    return sudosrv_cache_check_domain(cache, domain, _last_change);
+}
+
+errno_t sudosrv_cache_store(struct sudosrv_cache *cache,
+                            struct sss_domain_info *domain,
+                            enum sss_sudo_type type,
+                            const char *username,
+                            uid_t uid,
+                            char **groupnames,
+                            time_t last_change,
+                            time_t expire,
+                            struct sysdb_attrs **rules,
+                            uint32_t num_rules)
+{
+    struct sudosrv_cache_dom *dom;
+    struct sudosrv_cache_entry *entry;
+    char *keystr;
+    errno_t ret;
+
+    if (cache == NULL || expire <= time(NULL)) return EOK;
+
+    /* the rules were read before the last change seen by a lookup */
+    dom = sudosrv_cache_find_dom(cache, domain->name);
+    if (dom == NULL || dom->last_change != last_change) return EOK;
+
+    keystr = sudosrv_cache_key(NULL, domain, type, username, uid,
+                               groupnames);
+    if (keystr == NULL) return ENOMEM;
+
+    entry = talloc_zero(cache->table, struct sudosrv_cache_entry);
+    if (entry == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+    entry->num_rules = num_rules;
+    entry->domain = talloc_strdup(entry, domain->name);
+    if (entry->domain == NULL) {
+        ret = ENOMEM;
+        goto done;
+    }
+
+    if (num_rules > 0) {
+        entry->rules = sudosrv_cache_copy_rules(entry, rules, num_rules);
+        if (entry->rules == NULL) {
+            ret = ENOMEM;
+            goto done;
+        }
+    }
+
+    /* replaces any older rule set, the least recently used set makes room
+     * when the cache is full */
+    ret = sss_rtable_add(cache->table, &entry->base, keystr, expire);
+
+done:
+    if (ret != EOK) {
+        talloc_free(entry);
+    }
+    talloc_free(keystr);
+    return ret;
+}
+
+void sudosrv_cache_get_stats(struct sudosrv_cache *cache,
+                             struct sudosrv_cache_stats *stats)
+{
+    struct sss_rtable_stats st;
+
+    if (cache == NULL) {
+        memset(stats, 0, sizeof(struct sudosrv_cache_stats));
+        return;
+    }
+
+    sss_rtable_get_stats(cache->table, &st);
+
+    stats->hits = st.hits;
+    stats->misses = st.misses;
+    stats->stores = st.stores;
+    stats->expired = st.expired;
+    stats->evicted = st.evicted;
+    stats->invalidated = cache->invalidated;
+    stats->entries = st.entries;
+}
+
+void sudosrv_cache_log_stats(struct sudosrv_cache *cache)
+{
+    if (cache == NULL) return;
+
+    sss_rtable_log_stats(cache->table);
+    DEBUG(SSSDBG_CONF_SETTINGS,
+          ("Sudo rule cache: %llu invalidated\n",
+           (unsigned long long)cache->invalidated));
+}
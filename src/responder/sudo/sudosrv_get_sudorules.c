@@ -364,6 +364,21 @@ errno_t sudosrv_get_rules(struct sudo_cmd_ctx *cmd_ctx)
         goto done;
     }
 
+    /* none of the rules has expired or changed since they were sorted */
+    ret = sudosrv_cache_lookup(cmd_ctx->sudo_ctx->cache, cmd_ctx,
+                               cmd_ctx->domain, cmd_ctx->type,
+                               cmd_ctx->orig_username, cmd_ctx->uid,
+                               groupnames, &cmd_ctx->rules,
+                               &cmd_ctx->num_rules);
+    if (ret == EOK) {
+        cmd_ctx->expired_rules_num = 0;
+        goto done;
+    } else if (ret != ENOENT) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unable to look up cached rules [%d]: %s\n",
+               ret, strerror(ret)));
+    }
+
     flags =   SYSDB_SUDO_FILTER_INCLUDE_ALL
             | SYSDB_SUDO_FILTER_INCLUDE_DFL
             | SYSDB_SUDO_FILTER_ONLY_EXPIRED
@@ -531,6 +546,8 @@ static errno_t sudosrv_get_sudorules_from_cache(TALLOC_CTX *mem_ctx,
     unsigned int flags = SYSDB_SUDO_FILTER_NONE;
     struct sysdb_attrs **rules = NULL;
     uint32_t num_rules = 0;
+    time_t last_change;
+    time_t expire;
     const char *attrs[] = { SYSDB_OBJECTCLASS,
                             SYSDB_SUDO_CACHE_AT_CN,
                             SYSDB_SUDO_CACHE_AT_USER,
@@ -542,6 +559,7 @@ static errno_t sudosrv_get_sudorules_from_cache(TALLOC_CTX *mem_ctx,
                             SYSDB_SUDO_CACHE_AT_NOTBEFORE,
                             SYSDB_SUDO_CACHE_AT_NOTAFTER,
                             SYSDB_SUDO_CACHE_AT_ORDER,
+                            SYSDB_CACHE_EXPIRE,
                             NULL };
 
     if (cmd_ctx->domain == NULL) {
@@ -555,6 +573,12 @@ static errno_t sudosrv_get_sudorules_from_cache(TALLOC_CTX *mem_ctx,
         return ENOMEM;
     }
 
+    ret = sudosrv_cache_get_last_change(cmd_ctx->sudo_ctx->cache,
+                                        cmd_ctx->domain, &last_change);
+    if (ret != EOK) {
+        goto done;
+    }
+
     switch (cmd_ctx->type) {
     case SSS_SUDO_USER:
         debug_name = cmd_ctx->cased_username;
@@ -589,6 +613,19 @@ static errno_t sudosrv_get_sudorules_from_cache(TALLOC_CTX *mem_ctx,
     DEBUG(SSSDBG_TRACE_FUNC, ("Returning %d rules for [%s@%s]\n",
                               num_rules, debug_name, cmd_ctx->domain->name));
 
+    /* an empty set has nothing that expires, use the sudo cache timeout */
+    expire = time(NULL) + cmd_ctx->domain->sudo_timeout;
+    sudosrv_cache_take_expire(rules, num_rules, &expire);
+
+    ret = sudosrv_cache_store(cmd_ctx->sudo_ctx->cache, cmd_ctx->domain,
+                              cmd_ctx->type, cmd_ctx->orig_username,
+                              cmd_ctx->uid, groupnames, last_change, expire,
+                              rules, num_rules);
+    if (ret != EOK) {
+        DEBUG(SSSDBG_MINOR_FAILURE,
+              ("Unable to cache rules [%d]: %s\n", ret, strerror(ret)));
+    }
+
     if (_rules != NULL) {
         *_rules = talloc_steal(mem_ctx, rules);
     }
@@ -40,6 +40,8 @@ enum sss_sudo_type {
     SSS_SUDO_USER
 };
 
+struct sudosrv_cache;
+
 struct sudo_ctx {
     struct resp_ctx *rctx;
 
@@ -47,6 +49,9 @@ struct sudo_ctx {
      * options
      */
     bool timed;
+
+    /* sorted rule sets of recent requests */
+    struct sudosrv_cache *cache;
 };
 
 struct sudo_cmd_ctx {
@@ -106,6 +111,68 @@ errno_t sudosrv_build_response(TALLOC_CTX *mem_ctx,
                                uint8_t **_response_body,
                                size_t *_response_len);
 
+/* The responder keeps the sorted rule set it returned for each user (and
+ * the default options of each domain) until the first of the rules expires.
+ * The provider stamps the rules container whenever it changes the cached
+ * rules; all rule sets of a domain are dropped once its stamp moves. */
+
+struct sudosrv_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t expired;
+    uint64_t evicted;
+    uint64_t invalidated;
+    uint32_t entries;
+};
+
+/* bounds the memory used when many different users run sudo, the least
+ * recently used rule sets make room for new ones */
+#define SUDO_CACHE_MAX_ENTRIES 10000
+
+errno_t sudosrv_cache_init(TALLOC_CTX *mem_ctx,
+                           struct sudosrv_cache **_cache);
+
+/* Returns ENOENT if there is no valid rule set for the user, on a hit
+ * *_rules is a copy allocated on mem_ctx */
+errno_t sudosrv_cache_lookup(struct sudosrv_cache *cache,
+                             TALLOC_CTX *mem_ctx,
+                             struct sss_domain_info *domain,
+                             enum sss_sudo_type type,
+                             const char *username,
+                             uid_t uid,
+                             char **groupnames,
+                             struct sysdb_attrs ***_rules,
+                             uint32_t *_num_rules);
+
+/* Must be read before the rules are searched and passed to store */
+errno_t sudosrv_cache_get_last_change(struct sudosrv_cache *cache,
+                                      struct sss_domain_info *domain,
+                                      time_t *_last_change);
+
+/* Lowers *_expire to the earliest expiration of the rules. The attribute
+ * is removed from the rules so that it is not sent to sudo. */
+void sudosrv_cache_take_expire(struct sysdb_attrs **rules,
+                               uint32_t num_rules,
+                               time_t *_expire);
+
+/* The cache keeps its own copy of the rules */
+errno_t sudosrv_cache_store(struct sudosrv_cache *cache,
+                            struct sss_domain_info *domain,
+                            enum sss_sudo_type type,
+                            const char *username,
+                            uid_t uid,
+                            char **groupnames,
+                            time_t last_change,
+                            time_t expire,
+                            struct sysdb_attrs **rules,
+                            uint32_t num_rules);
+
+void sudosrv_cache_get_stats(struct sudosrv_cache *cache,
+                             struct sudosrv_cache_stats *stats);
+
+void sudosrv_cache_log_stats(struct sudosrv_cache *cache);
+
 struct tevent_req *
 sss_dp_get_sudoers_send(TALLOC_CTX *mem_ctx,
                         struct resp_ctx *rctx,
@@ -63,9 +63,89 @@
 
 /* common functions */
 
-int sss_cli_sd = -1; /* the sss client socket descriptor */
-struct stat sss_cli_sb; /* the sss client stat buffer */
+struct sss_cli_conn {
+    int sd;                 /* the sss client socket descriptor */
+    struct stat sb;         /* the sss client stat buffer */
+    pid_t pid;              /* the process that opened the socket */
+    uint32_t last_id;       /* ID of the last pipelined request */
+};
+
+#if HAVE_PTHREAD_EXT
+/* In lock-free mode every thread talks to the responders over its own
+ * connection, so that lookups that miss the memory cache can run
+ * concurrently. Enumerations keep their state in the responder, per
+ * connection, so they are still serialized over one shared connection
+ * (see sss_nss_enum_lock()). */
+static struct sss_cli_conn sss_cli_shared_conn = { -1, { 0 }, 0 };
+static __thread struct sss_cli_conn sss_cli_thread_conn = { -1, { 0 }, 0 };
+static __thread bool sss_cli_use_shared_conn;
+
+static pthread_key_t sss_cli_conn_key;
+static pthread_once_t sss_cli_conn_key_once = PTHREAD_ONCE_INIT;
+
+static void sss_cli_close_thread_conn(void *conn);
+
+static void sss_cli_conn_key_init(void)
+{
+    pthread_key_create(&sss_cli_conn_key, sss_cli_close_thread_conn);
+}
+
+static struct sss_cli_conn *sss_cli_get_conn(void)
+{
+    if (sss_cli_use_shared_conn) {
+        return &sss_cli_shared_conn;
+    }
+
+    return &sss_cli_thread_conn;
+}
+
+#define sss_cli_sd (sss_cli_get_conn()->sd)
+#define sss_cli_sb (sss_cli_get_conn()->sb)
+#define sss_cli_pid (sss_cli_get_conn()->pid)
+#define sss_cli_last_id (sss_cli_get_conn()->last_id)
+#else
+static struct sss_cli_conn sss_cli_conn = { -1, { 0 }, 0 };
+
+#define sss_cli_sd (sss_cli_conn.sd)
+#define sss_cli_sb (sss_cli_conn.sb)
+#define sss_cli_pid (sss_cli_conn.pid)
+#define sss_cli_last_id (sss_cli_conn.last_id)
+#endif
+
+#if HAVE_PTHREAD_EXT
+/* closes the connection currently in use by the calling thread, the
+ * shared enumeration connection is only in use while holding the
+ * enumeration lock so no other thread can be reading from it */
+static void sss_cli_close_socket(void)
+{
+    if (sss_cli_sd != -1) {
+        close(sss_cli_sd);
+        sss_cli_sd = -1;
+    }
+}
+
+/* called by pthread on thread exit for threads that opened a connection */
+static void sss_cli_close_thread_conn(void *conn)
+{
+    struct sss_cli_conn *c = (struct sss_cli_conn *)conn;
+
+    if (c->sd != -1) {
+        close(c->sd);
+        c->sd = -1;
+    }
+}
 
+#if HAVE_FUNCTION_ATTRIBUTE_DESTRUCTOR
+/* the library is being unloaded, close the connection of the unloading
+ * thread and the shared enumeration connection */
+__attribute__((destructor))
+static void sss_cli_close_all_sockets(void)
+{
+    sss_cli_close_thread_conn(&sss_cli_thread_conn);
+    sss_cli_close_thread_conn(&sss_cli_shared_conn);
+}
+#endif
+#else
 #if HAVE_FUNCTION_ATTRIBUTE_DESTRUCTOR
 __attribute__((destructor))
 #endif
@@ -76,17 +156,19 @@ static void sss_cli_close_socket(void)
         sss_cli_sd = -1;
     }
 }
+#endif
 
 /* Requests:
  *
  * byte 0-3: 32bit unsigned with length (the complete packet length: 0 to X)
  * byte 4-7: 32bit unsigned with command code
- * byte 8-11: 32bit unsigned (reserved)
+ * byte 8-11: 32bit unsigned with the request ID (0 if not pipelined)
  * byte 12-15: 32bit unsigned (reserved)
  * byte 16-X: (optional) request structure associated to the command code used
  */
 static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
                                         struct sss_cli_req_data *rd,
+                                        uint32_t id,
                                         int *errnop)
 {
     uint32_t header[4];
@@ -94,7 +176,7 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
 
     header[0] = SSS_NSS_HEADER_SIZE + (rd?rd->len:0);
     header[1] = cmd;
-    header[2] = 0;
+    header[2] = id;
     header[3] = 0;
 
     datasent = 0;
@@ -183,11 +265,12 @@ static enum sss_status sss_cli_send_req(enum sss_cli_command cmd,
  * byte 0-3: 32bit unsigned with length (the complete packet length: 0 to X)
  * byte 4-7: 32bit unsigned with command code
  * byte 8-11: 32bit unsigned with the request status (server errno)
- * byte 12-15: 32bit unsigned (reserved)
+ * byte 12-15: 32bit unsigned with the ID of the request being answered
  * byte 16-X: (optional) reply structure associated to the command code used
  */
 
 static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
+                                        uint32_t *_id,
                                         uint8_t **_buf, int *_len,
                                         int *errnop)
 {
@@ -329,6 +412,9 @@ static enum sss_status sss_cli_recv_rep(enum sss_cli_command cmd,
         sss_cli_close_socket();
     }
 
+    if (_id) {
+        *_id = header[3];
+    }
     *_len = len;
     *_buf = buf;
 
@@ -352,13 +438,13 @@ static enum sss_status sss_cli_make_request_nochecks(
     int len = 0;
 
     /* send data */
-    ret = sss_cli_send_req(cmd, rd, errnop);
+    ret = sss_cli_send_req(cmd, rd, 0, errnop);
     if (ret != SSS_STATUS_SUCCESS) {
         return ret;
     }
 
     /* data sent, now get reply */
-    ret = sss_cli_recv_rep(cmd, &buf, &len, errnop);
+    ret = sss_cli_recv_rep(cmd, NULL, &buf, &len, errnop);
     if (ret != SSS_STATUS_SUCCESS) {
         return ret;
     }
@@ -380,6 +466,102 @@ static enum sss_status sss_cli_make_request_nochecks(
     return SSS_STATUS_SUCCESS;
 }
 
+/* Send several requests of the same kind on the connection without waiting
+ * for the replies in between, so that the responder can process them in
+ * parallel. Every request is tagged with its own ID and the replies, which
+ * may arrive in any order, are matched to the requests by ID. Responders
+ * that do not know about request IDs answer with ID 0, one request at a
+ * time, so their replies are matched in order.
+ * repbuf[i] and replen[i] receive the reply to rd[i]. */
+static enum sss_status sss_cli_make_requests_nochecks(
+                                       enum sss_cli_command cmd,
+                                       struct sss_cli_req_data *rd,
+                                       size_t num,
+                                       uint8_t **repbuf, size_t *replen,
+                                       int *errnop)
+{
+    enum sss_status ret;
+    uint32_t first_id;
+    uint32_t id;
+    uint8_t *buf;
+    bool *done;
+    size_t sent;
+    size_t received;
+    size_t i;
+    int len;
+
+    done = calloc(num, sizeof(bool));
+    if (!done) {
+        *errnop = ENOMEM;
+        return SSS_STATUS_UNAVAIL;
+    }
+
+    for (i = 0; i < num; i++) {
+        repbuf[i] = NULL;
+        replen[i] = 0;
+    }
+
+    /* IDs of the requests in flight must be unique and never 0 */
+    first_id = sss_cli_last_id + 1;
+    if (first_id == 0 || first_id + num - 1 < first_id) {
+        first_id = 1;
+    }
+    sss_cli_last_id = first_id + num - 1;
+
+    sent = 0;
+    received = 0;
+    while (received < num) {
+        /* the responder stops reading when too many requests are in
+         * flight, keep enough replies flowing so that it never blocks */
+        while (sent < num && sent - received < SSS_CLI_PIPELINE_DEPTH) {
+            ret = sss_cli_send_req(cmd, &rd[sent], first_id + sent, errnop);
+            if (ret != SSS_STATUS_SUCCESS) {
+                goto failed;
+            }
+            sent++;
+        }
+
+        buf = NULL;
+        len = 0;
+        ret = sss_cli_recv_rep(cmd, &id, &buf, &len, errnop);
+        if (ret != SSS_STATUS_SUCCESS) {
+            goto failed;
+        }
+
+        if (id == 0) {
+            /* answered in order */
+            i = received;
+        } else {
+            i = id - first_id;
+        }
+        if (i >= sent || done[i]) {
+            /* not a reply to any of the requests in flight */
+            free(buf);
+            sss_cli_close_socket();
+            *errnop = EBADMSG;
+            ret = SSS_STATUS_UNAVAIL;
+            goto failed;
+        }
+
+        done[i] = true;
+        repbuf[i] = buf;
+        replen[i] = len;
+        received++;
+    }
+
+    free(done);
+    return SSS_STATUS_SUCCESS;
+
+failed:
+    for (i = 0; i < num; i++) {
+        free(repbuf[i]);
+        repbuf[i] = NULL;
+        replen[i] = 0;
+    }
+    free(done);
+    return ret;
+}
+
 /* GET_VERSION Reply:
  * 0-3: 32bit unsigned version number
  */
@@ -626,12 +808,11 @@ static int sss_cli_open_socket(int *errnop, const char *socket_name)
 
 static enum sss_status sss_cli_check_socket(int *errnop, const char *socket_name)
 {
-    static pid_t mypid;
     struct stat mysb;
     int mysd;
     int ret;
 
-    if (getpid() != mypid) {
+    if (getpid() != sss_cli_pid) {
         ret = fstat(sss_cli_sd, &mysb);
         if (ret == 0) {
             if (S_ISSOCK(mysb.st_mode) &&
@@ -641,7 +822,7 @@ static enum sss_status sss_cli_check_socket(int *errnop, const char *socket_name
             }
         }
         sss_cli_sd = -1;
-        mypid = getpid();
+        sss_cli_pid = getpid();
     }
 
     /* check if the socket has been closed on the other side */
@@ -697,6 +878,14 @@ static enum sss_status sss_cli_check_socket(int *errnop, const char *socket_name
 
     sss_cli_sd = mysd;
 
+#if HAVE_PTHREAD_EXT
+    if (!sss_cli_use_shared_conn) {
+        /* make sure the connection is closed when the thread exits */
+        pthread_once(&sss_cli_conn_key_once, sss_cli_conn_key_init);
+        pthread_setspecific(sss_cli_conn_key, &sss_cli_thread_conn);
+    }
+#endif
+
     if (sss_cli_check_version(socket_name)) {
         return SSS_STATUS_SUCCESS;
     }
@@ -706,15 +895,38 @@ static enum sss_status sss_cli_check_socket(int *errnop, const char *socket_name
     return SSS_STATUS_UNAVAIL;
 }
 
-/* this function will check command codes match and returned length is ok */
-/* repbuf and replen report only the data section not the header */
-enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
-                      struct sss_cli_req_data *rd,
-                      uint8_t **repbuf, size_t *replen,
-                      int *errnop)
+/* The connection is kept open between calls, the responder may have closed
+ * it in the meantime (idle timeout, restart) without sss_cli_check_socket()
+ * noticing yet. NSS requests are lookups that can safely be repeated, so
+ * a request that fails this way is sent again once on a new connection. */
+static bool sss_cli_conn_lost(bool reused, int errnop)
+{
+    if (!reused || sss_cli_sd != -1) {
+        return false;
+    }
+
+    switch (errnop) {
+    case 0:         /* EOF */
+    case EPIPE:
+    case ECONNRESET:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* sends num requests, pipelined if num > 1 */
+static enum nss_status sss_nss_make_request_int(enum sss_cli_command cmd,
+                                                struct sss_cli_req_data *rd,
+                                                size_t num,
+                                                uint8_t **repbuf,
+                                                size_t *replen,
+                                                int *errnop)
 {
     enum sss_status ret;
     char *envval;
+    bool reused;
+    int retry;
 
     /* avoid looping in the nss daemon */
     envval = getenv("_SSS_LOOPS");
@@ -722,12 +934,26 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
         return NSS_STATUS_NOTFOUND;
     }
 
-    ret = sss_cli_check_socket(errnop, SSS_NSS_SOCKET_NAME);
-    if (ret != SSS_STATUS_SUCCESS) {
-        return NSS_STATUS_UNAVAIL;
+    for (retry = 0; retry < 2; retry++) {
+        reused = (sss_cli_sd != -1);
+
+        ret = sss_cli_check_socket(errnop, SSS_NSS_SOCKET_NAME);
+        if (ret != SSS_STATUS_SUCCESS) {
+            return NSS_STATUS_UNAVAIL;
+        }
+
+        if (num == 1) {
+            ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen,
+                                                errnop);
+        } else {
+            ret = sss_cli_make_requests_nochecks(cmd, rd, num,
+                                                 repbuf, replen, errnop);
+        }
+        if (ret != SSS_STATUS_UNAVAIL || !sss_cli_conn_lost(reused, *errnop)) {
+            break;
+        }
     }
 
-    ret = sss_cli_make_request_nochecks(cmd, rd, repbuf, replen, errnop);
     switch (ret) {
     case SSS_STATUS_TRYAGAIN:
         return NSS_STATUS_TRYAGAIN;
@@ -739,6 +965,27 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
     }
 }
 
+/* this function will check command codes match and returned length is ok */
+/* repbuf and replen report only the data section not the header */
+enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
+                      struct sss_cli_req_data *rd,
+                      uint8_t **repbuf, size_t *replen,
+                      int *errnop)
+{
+    return sss_nss_make_request_int(cmd, rd, 1, repbuf, replen, errnop);
+}
+
+/* pipelined version of sss_nss_make_request(), see
+ * sss_cli_make_requests_nochecks() */
+enum nss_status sss_nss_make_requests(enum sss_cli_command cmd,
+                                      struct sss_cli_req_data *rd,
+                                      size_t num,
+                                      uint8_t **repbuf, size_t *replen,
+                                      int *errnop)
+{
+    return sss_nss_make_request_int(cmd, rd, num, repbuf, replen, errnop);
+}
+
 int sss_pac_make_request(enum sss_cli_command cmd,
                          struct sss_cli_req_data *rd,
                          uint8_t **repbuf, size_t *replen,
@@ -1006,12 +1253,17 @@ struct sss_mutex {
 };
 
 static void sss_nss_mt_init(void);
+static void sss_nss_enum_mt_init(void);
 static void sss_pam_mt_init(void);
 
 static struct sss_mutex sss_nss_mtx = { .mtx  = PTHREAD_MUTEX_INITIALIZER,
                                         .once = PTHREAD_ONCE_INIT,
                                         .init = sss_nss_mt_init };
 
+static struct sss_mutex sss_nss_enum_mtx = { .mtx  = PTHREAD_MUTEX_INITIALIZER,
+                                             .once = PTHREAD_ONCE_INIT,
+                                             .init = sss_nss_enum_mt_init };
+
 static struct sss_mutex sss_pam_mtx = { .mtx  = PTHREAD_MUTEX_INITIALIZER,
                                         .once = PTHREAD_ONCE_INIT,
                                         .init = sss_pam_mt_init };
@@ -1077,6 +1329,11 @@ static void sss_nss_mt_init(void)
 {
     sss_mt_init(&sss_nss_mtx);
 }
+#if HAVE_PTHREAD_EXT
+/* every thread has its own connection, nothing to serialize */
+void sss_nss_lock(void) { return; }
+void sss_nss_unlock(void) { return; }
+#else
 void sss_nss_lock(void)
 {
     sss_mt_lock(&sss_nss_mtx);
@@ -1085,6 +1342,36 @@ void sss_nss_unlock(void)
 {
     sss_mt_unlock(&sss_nss_mtx);
 }
+#endif
+
+/* NSS enumeration mutex wrappers */
+static void sss_nss_enum_mt_init(void)
+{
+    sss_mt_init(&sss_nss_enum_mtx);
+}
+#if HAVE_PTHREAD_EXT
+void sss_nss_enum_lock(void)
+{
+    /* switch first, so that a dead owner's connection is the one that
+     * gets closed by sss_mt_lock() */
+    sss_cli_use_shared_conn = true;
+    sss_mt_lock(&sss_nss_enum_mtx);
+}
+void sss_nss_enum_unlock(void)
+{
+    sss_cli_use_shared_conn = false;
+    sss_mt_unlock(&sss_nss_enum_mtx);
+}
+#else
+void sss_nss_enum_lock(void)
+{
+    sss_nss_lock();
+}
+void sss_nss_enum_unlock(void)
+{
+    sss_nss_unlock();
+}
+#endif
 
 /* NSS mutex wrappers */
 static void sss_pam_mt_init(void)
@@ -1105,6 +1392,8 @@ void sss_pam_unlock(void)
 /* sorry no mutexes available */
 void sss_nss_lock(void) { return; }
 void sss_nss_unlock(void) { return; }
+void sss_nss_enum_lock(void) { return; }
+void sss_nss_enum_unlock(void) { return; }
 void sss_pam_lock(void) { return; }
 void sss_pam_unlock(void) { return; }
 #endif
@@ -19,6 +19,8 @@
 
 /* GROUP database NSS interface */
 
+#include "config.h"
+
 #include <nss.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -52,7 +54,14 @@ enum sss_nss_gr_type {
     GETGR_GID
 };
 
-static struct sss_nss_getgr_data {
+/* the reply kept for a retry with a larger buffer belongs to the thread
+ * that made the request when threads do not share the connection */
+#if HAVE_PTHREAD_EXT
+static __thread
+#else
+static
+#endif
+struct sss_nss_getgr_data {
     enum sss_nss_gr_type type;
     union {
         char *grname;
@@ -285,8 +294,39 @@ enum nss_status _nss_sss_initgroups_dyn(const char *user, gid_t group,
     uint32_t *rbuf;
     uint32_t num_ret;
     long int l, max_ret;
+    size_t user_len;
+    int ret;
+
+    ret = sss_strnlen(user, SSS_NAME_MAX, &user_len);
+    if (ret != 0) {
+        *errnop = EINVAL;
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    ret = sss_nss_mc_initgroups_dyn(user, user_len, group, start, size,
+                                    groups, limit);
+    switch (ret) {
+    case 0:
+        *errnop = 0;
+        return NSS_STATUS_SUCCESS;
+    case ENODATA:
+        /* same as an empty reply from the responder */
+        *errnop = 0;
+        return NSS_STATUS_NOTFOUND;
+    case ENOMEM:
+        *errnop = ENOMEM;
+        return NSS_STATUS_TRYAGAIN;
+    case ENOENT:
+        /* fall through, we need to actively ask the parent
+         * if no entry is found */
+        break;
+    default:
+        /* if using the mmaped cache failed,
+         * fall back to socket based comms */
+        break;
+    }
 
-    rd.len = strlen(user) +1;
+    rd.len = user_len + 1;
     rd.data = user;
 
     sss_nss_lock();
@@ -529,7 +569,7 @@ enum nss_status _nss_sss_setgrent(void)
     enum nss_status nret;
     int errnop;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     sss_nss_getgrent_data_clean();
@@ -540,7 +580,7 @@ enum nss_status _nss_sss_setgrent(void)
         errno = errnop;
     }
 
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
 
@@ -617,9 +657,9 @@ enum nss_status _nss_sss_getgrent_r(struct group *result,
 {
     enum nss_status nret;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
     nret = internal_getgrent_r(result, buffer, buflen, errnop);
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
 
     return nret;
 }
@@ -629,7 +669,7 @@ enum nss_status _nss_sss_endgrent(void)
     enum nss_status nret;
     int errnop;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     sss_nss_getgrent_data_clean();
@@ -640,6 +680,6 @@ enum nss_status _nss_sss_endgrent(void)
         errno = errnop;
     }
 
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
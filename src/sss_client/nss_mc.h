@@ -75,4 +75,13 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
                             struct group *result,
                             char *buffer, size_t buflen);
 
+/* initgroups db */
+errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
+                                  gid_t group, long int *start, long int *size,
+                                  gid_t **groups, long int limit);
+
+/* negative entries */
+errno_t sss_nss_mc_neg_getpwnam(const char *name, size_t name_len);
+errno_t sss_nss_mc_neg_getpwuid(uid_t uid);
+
 #endif /* _NSS_MC_H_ */
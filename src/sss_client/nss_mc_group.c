@@ -125,7 +125,7 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
         /* check record matches what we are searching for */
         if (hash != rec->hash1) {
             /* if name hash does not match we can skip this immediately */
-            slot = rec->next;
+            slot = sss_mc_next_slot_with_hash(rec, hash);
             continue;
         }
 
@@ -135,7 +135,7 @@ errno_t sss_nss_mc_getgrnam(const char *name, size_t name_len,
             break;
         }
 
-        slot = rec->next;
+        slot = sss_mc_next_slot_with_hash(rec, hash);
     }
 
     if (slot == MC_INVALID_VAL) {
@@ -189,7 +189,7 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
         /* check record matches what we are searching for */
         if (hash != rec->hash2) {
             /* if uid hash does not match we can skip this immediately */
-            slot = rec->next;
+            slot = sss_mc_next_slot_with_hash(rec, hash);
             continue;
         }
 
@@ -198,7 +198,7 @@ errno_t sss_nss_mc_getgrgid(gid_t gid,
             break;
         }
 
-        slot = rec->next;
+        slot = sss_mc_next_slot_with_hash(rec, hash);
     }
 
     if (slot == MC_INVALID_VAL) {
@@ -0,0 +1,150 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) Simo Sorce 2011
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* INITGROUPS database NSS interface using mmap cache */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "nss_mc.h"
+
+struct sss_cli_mc_ctx initgr_mc_ctx = { false, -1, 0, NULL, 0, NULL, 0, NULL, 0 };
+
+static errno_t sss_nss_mc_parse_result(struct sss_mc_rec *rec,
+                                       long int *start, long int *size,
+                                       gid_t **groups, long int limit)
+{
+    struct sss_mc_initgr_data *data;
+    time_t expire;
+    long int i;
+    uint32_t gids_count;
+    long int max_ret;
+
+    /* additional checks before filling result*/
+    expire = rec->expire;
+    if (expire < time(NULL)) {
+        /* entry is now invalid */
+        return EINVAL;
+    }
+
+    data = (struct sss_mc_initgr_data *)rec->data;
+    gids_count = data->num_groups;
+    if (gids_count * sizeof(uint32_t) > data->data_len) {
+        return EINVAL;
+    }
+    if (gids_count == 0) {
+        /* the user is known but is not a member of any group, the socket
+         * based lookup reports this as not found as well */
+        return ENODATA;
+    }
+    max_ret = gids_count;
+
+    /* check we have enough space in the buffer */
+    if ((*size - *start) < gids_count) {
+        long int newsize;
+        gid_t *newgroups;
+
+        newsize = *size + gids_count;
+        if ((limit > 0) && (newsize > limit)) {
+            newsize = limit;
+            max_ret = newsize - *start;
+        }
+
+        newgroups = (gid_t *)realloc((*groups), newsize * sizeof(**groups));
+        if (!newgroups) {
+            return ENOMEM;
+        }
+        *groups = newgroups;
+        *size = newsize;
+    }
+
+    for (i = 0; i < max_ret; i++) {
+        (*groups)[*start] = data->gids[i];
+        *start += 1;
+    }
+
+    return 0;
+}
+
+errno_t sss_nss_mc_initgroups_dyn(const char *name, size_t name_len,
+                                  gid_t group, long int *start, long int *size,
+                                  gid_t **groups, long int limit)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_initgr_data *data;
+    char *rec_name;
+    uint32_t hash;
+    uint32_t slot;
+    int ret;
+
+    ret = sss_nss_mc_get_ctx("initgroups", &initgr_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&initgr_mc_ctx, name, name_len + 1);
+    slot = initgr_mc_ctx.hash_table[hash];
+    if (slot > MC_SIZE_TO_SLOTS(initgr_mc_ctx.dt_size)) {
+        return ENOENT;
+    }
+
+    while (slot != MC_INVALID_VAL) {
+
+        free(rec);
+        ret = sss_nss_mc_get_record(&initgr_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != rec->hash1) {
+            /* if name hash does not match we can skip this immediately */
+            slot = sss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        data = (struct sss_mc_initgr_data *)rec->data;
+        if (data->name >= sizeof(struct sss_mc_initgr_data) + data->data_len) {
+            /* corrupted record, do not read past its end */
+            ret = EINVAL;
+            goto done;
+        }
+        rec_name = (char *)data + data->name;
+        if (strcmp(name, rec_name) == 0) {
+            break;
+        }
+
+        slot = sss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (slot == MC_INVALID_VAL) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = sss_nss_mc_parse_result(rec, start, size, groups, limit);
+
+done:
+    free(rec);
+    return ret;
+}
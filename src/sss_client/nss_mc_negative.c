@@ -0,0 +1,128 @@
+/*
+ * System Security Services Daemon. NSS client interface
+ *
+ * Copyright (C) Simo Sorce 2011
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Negative entries NSS interface using mmap cache */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "nss_mc.h"
+
+struct sss_cli_mc_ctx neg_mc_ctx = { false, -1, 0, NULL, 0, NULL, 0, NULL, 0 };
+
+/* Returns 0 if the responder recorded that the lookup identified by key has
+ * no result and that record has not expired yet, ENOENT if the client has
+ * to ask the responder */
+static errno_t sss_nss_mc_neg_check(const char *key, size_t key_len)
+{
+    struct sss_mc_rec *rec = NULL;
+    struct sss_mc_neg_data *data;
+    char *rec_key;
+    uint32_t hash;
+    uint32_t slot;
+    int ret;
+
+    ret = sss_nss_mc_get_ctx("negative", &neg_mc_ctx);
+    if (ret) {
+        return ret;
+    }
+
+    /* hashes are calculated including the NULL terminator */
+    hash = sss_nss_mc_hash(&neg_mc_ctx, key, key_len + 1);
+    slot = neg_mc_ctx.hash_table[hash];
+    if (slot > MC_SIZE_TO_SLOTS(neg_mc_ctx.dt_size)) {
+        return ENOENT;
+    }
+
+    while (slot != MC_INVALID_VAL) {
+
+        ret = sss_nss_mc_get_record(&neg_mc_ctx, slot, &rec);
+        if (ret) {
+            goto done;
+        }
+
+        /* check record matches what we are searching for */
+        if (hash != rec->hash1) {
+            /* if key hash does not match we can skip this immediately */
+            slot = sss_mc_next_slot_with_hash(rec, hash);
+            continue;
+        }
+
+        data = (struct sss_mc_neg_data *)rec->data;
+        rec_key = (char *)data + data->name;
+        if (strcmp(key, rec_key) == 0) {
+            break;
+        }
+
+        slot = sss_mc_next_slot_with_hash(rec, hash);
+    }
+
+    if (slot == MC_INVALID_VAL) {
+        ret = ENOENT;
+        goto done;
+    }
+
+    if ((time_t)rec->expire < time(NULL)) {
+        /* entry is now invalid */
+        ret = ENOENT;
+        goto done;
+    }
+
+    ret = 0;
+
+done:
+    free(rec);
+    return ret;
+}
+
+errno_t sss_nss_mc_neg_getpwnam(const char *name, size_t name_len)
+{
+    char *key;
+    int len;
+    int ret;
+
+    len = asprintf(&key, "%s%.*s", SSS_MC_NEG_PWNAM_PREFIX,
+                   (int)name_len, name);
+    if (len == -1) {
+        return ENOMEM;
+    }
+
+    ret = sss_nss_mc_neg_check(key, len);
+    free(key);
+    return ret;
+}
+
+errno_t sss_nss_mc_neg_getpwuid(uid_t uid)
+{
+    char key[sizeof(SSS_MC_NEG_PWUID_PREFIX) + 11];
+    int len;
+
+    len = snprintf(key, sizeof(key), "%s%ld",
+                   SSS_MC_NEG_PWUID_PREFIX, (long)uid);
+    if (len >= sizeof(key)) {
+        return EINVAL;
+    }
+
+    return sss_nss_mc_neg_check(key, len);
+}
@@ -126,7 +126,7 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
         /* check record matches what we are searching for */
         if (hash != rec->hash1) {
             /* if name hash does not match we can skip this immediately */
-            slot = rec->next;
+            slot = sss_mc_next_slot_with_hash(rec, hash);
             continue;
         }
 
@@ -136,7 +136,7 @@ errno_t sss_nss_mc_getpwnam(const char *name, size_t name_len,
             break;
         }
 
-        slot = rec->next;
+        slot = sss_mc_next_slot_with_hash(rec, hash);
     }
 
     if (slot == MC_INVALID_VAL) {
@@ -190,7 +190,7 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
         /* check record matches what we are searching for */
         if (hash != rec->hash2) {
             /* if uid hash does not match we can skip this immediately */
-            slot = rec->next;
+            slot = sss_mc_next_slot_with_hash(rec, hash);
             continue;
         }
 
@@ -199,7 +199,7 @@ errno_t sss_nss_mc_getpwuid(uid_t uid,
             break;
         }
 
-        slot = rec->next;
+        slot = sss_mc_next_slot_with_hash(rec, hash);
     }
 
     if (slot == MC_INVALID_VAL) {
@@ -169,7 +169,7 @@ enum nss_status _nss_sss_setnetgrent(const char *netgroup,
 
     if (!netgroup) return NSS_STATUS_NOTFOUND;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     CLEAR_NETGRENT_DATA(result);
@@ -209,7 +209,7 @@ enum nss_status _nss_sss_setnetgrent(const char *netgroup,
     nret = NSS_STATUS_SUCCESS;
 
 out:
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
 
@@ -287,9 +287,9 @@ enum nss_status _nss_sss_getnetgrent_r(struct __netgrent *result,
 {
     enum nss_status nret;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
     nret = internal_getnetgrent_r(result, buffer, buflen, errnop);
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
 
     return nret;
 }
@@ -299,7 +299,7 @@ enum nss_status _nss_sss_endnetgrent(struct __netgrent *result)
     enum nss_status nret;
     int errnop;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     CLEAR_NETGRENT_DATA(result);
@@ -310,6 +310,6 @@ enum nss_status _nss_sss_endnetgrent(struct __netgrent *result)
         errno = errnop;
     }
 
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
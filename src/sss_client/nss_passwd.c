@@ -53,6 +53,14 @@ static void sss_nss_getpwent_data_clean(void) {
  *
  * 0-3: 32bit number with uid
  *
+ * GETPWUID_BULK Request:
+ *
+ * 0-3: 32bit unsigned number of uids (max SSS_NSS_BULK_MAX_IDS)
+ * For each uid:
+ *  0-3: 32bit number with uid
+ *
+ * Replies (GETPWUID_BULK returns only the uids that exist, in any order):
+ *
  * Replies:
  *
  * 0-3: 32bit unsigned number of results
@@ -163,6 +171,11 @@ enum nss_status _nss_sss_getpwnam_r(const char *name, struct passwd *result,
         *errnop = ERANGE;
         return NSS_STATUS_TRYAGAIN;
     case ENOENT:
+        /* the responder may already know there is no such user */
+        if (sss_nss_mc_neg_getpwnam(name, name_len) == 0) {
+            *errnop = 0;
+            return NSS_STATUS_NOTFOUND;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -241,6 +254,11 @@ enum nss_status _nss_sss_getpwuid_r(uid_t uid, struct passwd *result,
         *errnop = ERANGE;
         return NSS_STATUS_TRYAGAIN;
     case ENOENT:
+        /* the responder may already know there is no such user */
+        if (sss_nss_mc_neg_getpwuid(uid) == 0) {
+            *errnop = 0;
+            return NSS_STATUS_NOTFOUND;
+        }
         /* fall through, we need to actively ask the parent
          * if no entry is found */
         break;
@@ -297,12 +315,259 @@ out:
     return nret;
 }
 
+/* strings of an entry are stored one after the other, shell is the last */
+static size_t sss_nss_pw_buffer_used(struct passwd *pw, char *buffer)
+{
+    return pw->pw_shell + strlen(pw->pw_shell) + 1 - buffer;
+}
+
+/* builds a GETPWUID_BULK request for the uids uids[idx[0..num-1]] */
+static int sss_nss_getpwuid_bulk_req(const uid_t *uids,
+                                     size_t *idx, size_t num,
+                                     struct sss_cli_req_data *rd)
+{
+    uint32_t *reqbuf;
+    size_t i;
+
+    reqbuf = malloc((num + 1) * sizeof(uint32_t));
+    if (!reqbuf) {
+        return ENOMEM;
+    }
+    reqbuf[0] = num;
+    for (i = 0; i < num; i++) {
+        reqbuf[i + 1] = uids[idx[i]];
+    }
+
+    rd->len = (num + 1) * sizeof(uint32_t);
+    rd->data = reqbuf;
+
+    return 0;
+}
+
+static enum nss_status sss_nss_getpwuid_bulk_readrep(const uid_t *uids,
+                                                     size_t *idx, size_t num,
+                                                     uint8_t *repbuf,
+                                                     size_t replen,
+                                                     struct passwd *results,
+                                                     int *found,
+                                                     char *buffer,
+                                                     size_t buflen,
+                                                     size_t *_used,
+                                                     int *errnop)
+{
+    struct sss_nss_pw_rep pwrep;
+    struct passwd pwd;
+    uint8_t *p;
+    size_t len, rlen;
+    size_t used = *_used;
+    uint32_t count;
+    uint32_t n;
+    size_t i;
+    bool match;
+    int ret;
+
+    if (replen < 2 * sizeof(uint32_t)) {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    SAFEALIGN_COPY_UINT32(&count, repbuf, NULL);
+    if (count == 0) {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    p = repbuf + 8;
+    len = replen - 8;
+    for (n = 0; n < count; n++) {
+        pwrep.result = &pwd;
+        pwrep.buffer = buffer + used;
+        pwrep.buflen = buflen - used;
+
+        rlen = len;
+        ret = sss_nss_getpw_readrep(&pwrep, p, &len);
+        if (ret) {
+            *errnop = ret;
+            return NSS_STATUS_TRYAGAIN;
+        }
+        p += rlen - len;
+        used += sss_nss_pw_buffer_used(&pwd, pwrep.buffer);
+
+        /* the same uid may have been requested more than once */
+        match = false;
+        for (i = 0; i < num; i++) {
+            if (uids[idx[i]] == pwd.pw_uid && !found[idx[i]]) {
+                results[idx[i]] = pwd;
+                found[idx[i]] = 1;
+                match = true;
+            }
+        }
+        if (!match) {
+            /* not something we asked for, reuse its space */
+            used = pwrep.buffer - buffer;
+        }
+    }
+
+    *_used = used;
+    return NSS_STATUS_SUCCESS;
+}
+
+/* Resolve many uids at once, sending the ones not found in the memory cache
+ * to the responder in batches of up to SSS_NSS_BULK_MAX_IDS. The batches
+ * are pipelined on the connection so the responder resolves them in
+ * parallel.
+ * results[i] is set and found[i] is set to 1 for each uids[i] that exists,
+ * the strings of all the entries are stored in buffer. */
+enum nss_status _nss_sss_getpwuid_bulk_r(const uid_t *uids, size_t num,
+                                         struct passwd *results, int *found,
+                                         char *buffer, size_t buflen,
+                                         int *errnop)
+{
+    struct sss_cli_req_data *rd = NULL;
+    uint8_t **repbuf = NULL;
+    size_t *replen = NULL;
+    enum nss_status nret;
+    enum nss_status rret;
+    size_t *idx = NULL;
+    size_t num_idx = 0;
+    size_t num_req = 0;
+    size_t used = 0;
+    size_t i, r, n;
+    bool any = false;
+    int ret;
+
+    if (!buffer || !buflen) {
+        *errnop = ERANGE;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    if (num == 0) {
+        *errnop = 0;
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    idx = malloc(num * sizeof(size_t));
+    if (!idx) {
+        *errnop = ENOMEM;
+        return NSS_STATUS_TRYAGAIN;
+    }
+
+    for (i = 0; i < num; i++) {
+        found[i] = 0;
+
+        ret = sss_nss_mc_getpwuid(uids[i], &results[i],
+                                  buffer + used, buflen - used);
+        switch (ret) {
+        case 0:
+            found[i] = 1;
+            used += sss_nss_pw_buffer_used(&results[i], buffer + used);
+            any = true;
+            continue;
+        case ERANGE:
+            free(idx);
+            *errnop = ERANGE;
+            return NSS_STATUS_TRYAGAIN;
+        case ENOENT:
+            if (sss_nss_mc_neg_getpwuid(uids[i]) == 0) {
+                /* known not to exist */
+                continue;
+            }
+            break;
+        default:
+            break;
+        }
+
+        idx[num_idx++] = i;
+    }
+
+    nret = NSS_STATUS_SUCCESS;
+    if (num_idx == 0) {
+        goto done;
+    }
+
+    num_req = (num_idx + SSS_NSS_BULK_MAX_IDS - 1) / SSS_NSS_BULK_MAX_IDS;
+    rd = calloc(num_req, sizeof(struct sss_cli_req_data));
+    repbuf = calloc(num_req, sizeof(uint8_t *));
+    replen = calloc(num_req, sizeof(size_t));
+    if (!rd || !repbuf || !replen) {
+        *errnop = ENOMEM;
+        nret = NSS_STATUS_TRYAGAIN;
+        goto done;
+    }
+
+    for (r = 0; r < num_req; r++) {
+        i = r * SSS_NSS_BULK_MAX_IDS;
+        n = num_idx - i;
+        if (n > SSS_NSS_BULK_MAX_IDS) {
+            n = SSS_NSS_BULK_MAX_IDS;
+        }
+
+        ret = sss_nss_getpwuid_bulk_req(uids, &idx[i], n, &rd[r]);
+        if (ret) {
+            *errnop = ret;
+            nret = NSS_STATUS_TRYAGAIN;
+            goto done;
+        }
+    }
+
+    sss_nss_lock();
+    nret = sss_nss_make_requests(SSS_NSS_GETPWUID_BULK, rd, num_req,
+                                 repbuf, replen, errnop);
+    sss_nss_unlock();
+    if (nret == NSS_STATUS_NOTFOUND) {
+        /* only the entries from the memory cache */
+        nret = NSS_STATUS_SUCCESS;
+        goto done;
+    } else if (nret != NSS_STATUS_SUCCESS) {
+        goto done;
+    }
+
+    for (r = 0; r < num_req; r++) {
+        i = r * SSS_NSS_BULK_MAX_IDS;
+        n = num_idx - i;
+        if (n > SSS_NSS_BULK_MAX_IDS) {
+            n = SSS_NSS_BULK_MAX_IDS;
+        }
+
+        rret = sss_nss_getpwuid_bulk_readrep(uids, &idx[i], n,
+                                             repbuf[r], replen[r],
+                                             results, found,
+                                             buffer, buflen, &used, errnop);
+        if (rret == NSS_STATUS_SUCCESS) {
+            any = true;
+        } else if (rret != NSS_STATUS_NOTFOUND) {
+            nret = rret;
+            goto done;
+        }
+    }
+
+done:
+    for (r = 0; r < num_req; r++) {
+        if (rd) free((void *)rd[r].data);
+        if (repbuf) free(repbuf[r]);
+    }
+    free(rd);
+    free(repbuf);
+    free(replen);
+    free(idx);
+
+    if (nret != NSS_STATUS_SUCCESS) {
+        return nret;
+    }
+
+    if (!any) {
+        *errnop = 0;
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    *errnop = 0;
+    return NSS_STATUS_SUCCESS;
+}
+
 enum nss_status _nss_sss_setpwent(void)
 {
     enum nss_status nret;
     int errnop;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     sss_nss_getpwent_data_clean();
@@ -313,7 +578,7 @@ enum nss_status _nss_sss_setpwent(void)
         errno = errnop;
     }
 
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
 
@@ -389,9 +654,9 @@ enum nss_status _nss_sss_getpwent_r(struct passwd *result,
 {
     enum nss_status nret;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
     nret = internal_getpwent_r(result, buffer, buflen, errnop);
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
 
     return nret;
 }
@@ -401,7 +666,7 @@ enum nss_status _nss_sss_endpwent(void)
     enum nss_status nret;
     int errnop;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     sss_nss_getpwent_data_clean();
@@ -412,6 +677,6 @@ enum nss_status _nss_sss_endpwent(void)
         errno = errnop;
     }
 
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
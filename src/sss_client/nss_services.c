@@ -359,7 +359,7 @@ _nss_sss_setservent(void)
 {
     enum nss_status nret;
     int errnop;
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     sss_nss_getservent_data_clean();
@@ -370,7 +370,7 @@ _nss_sss_setservent(void)
         errno = errnop;
     }
 
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
 
@@ -385,9 +385,9 @@ _nss_sss_getservent_r(struct servent *result,
 {
     enum nss_status nret;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
     nret = internal_getservent_r(result, buffer, buflen, errnop);
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
 
     return nret;
 }
@@ -468,7 +468,7 @@ _nss_sss_endservent(void)
     enum nss_status nret;
     int errnop;
 
-    sss_nss_lock();
+    sss_nss_enum_lock();
 
     /* make sure we do not have leftovers, and release memory */
     sss_nss_getservent_data_clean();
@@ -479,6 +479,6 @@ _nss_sss_endservent(void)
         errno = errnop;
     }
 
-    sss_nss_unlock();
+    sss_nss_enum_unlock();
     return nret;
 }
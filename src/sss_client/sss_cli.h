@@ -55,6 +55,9 @@ typedef int errno_t;
 #define SSS_NAME_MAX 256
 #endif
 
+/* maximum number of ids in a single SSS_NSS_GETPWUID_BULK request */
+#define SSS_NSS_BULK_MAX_IDS 256
+
 /**
  * @defgroup sss_cli_command SSS client commands
  * @{
@@ -76,6 +79,8 @@ enum sss_cli_command {
     SSS_NSS_SETPWENT       = 0x0013,
     SSS_NSS_GETPWENT       = 0x0014,
     SSS_NSS_ENDPWENT       = 0x0015,
+    SSS_NSS_GETPWUID_BULK  = 0x0016, /**< resolve up to
+                                      * SSS_NSS_BULK_MAX_IDS uids at once */
 
 /* group */
 
@@ -295,7 +300,19 @@ enum pam_item_type {
 };
 
 #define SSS_NSS_MAX_ENTRIES 256
+/* The packet header is made of four 32bit words:
+ * 0: total packet length
+ * 1: command
+ * 2: in replies the status, in requests an optional request ID
+ * 3: in replies the ID of the request being answered
+ *
+ * Requests carrying a non zero ID may be processed in parallel by the
+ * responder and their replies may come back in any order, the client must
+ * match them by ID. Requests with ID 0 are processed one at a time. */
 #define SSS_NSS_HEADER_SIZE (sizeof(uint32_t) * 4)
+/* maximum number of pipelined requests a client keeps in flight, must not
+ * exceed what the responder processes in parallel on a connection */
+#define SSS_CLI_PIPELINE_DEPTH 16
 struct sss_cli_req_data {
     size_t len;
     const void *data;
@@ -480,6 +497,17 @@ enum nss_status sss_nss_make_request(enum sss_cli_command cmd,
                                      uint8_t **repbuf, size_t *replen,
                                      int *errnop);
 
+enum nss_status sss_nss_make_requests(enum sss_cli_command cmd,
+                                      struct sss_cli_req_data *rd,
+                                      size_t num,
+                                      uint8_t **repbuf, size_t *replen,
+                                      int *errnop);
+
+enum nss_status _nss_sss_getpwuid_bulk_r(const uid_t *uids, size_t num,
+                                         struct passwd *results, int *found,
+                                         char *buffer, size_t buflen,
+                                         int *errnop);
+
 int sss_pam_make_request(enum sss_cli_command cmd,
                          struct sss_cli_req_data *rd,
                          uint8_t **repbuf, size_t *replen,
@@ -570,6 +598,8 @@ errno_t sss_strnlen(const char *str, size_t maxlen, size_t *len);
 
 void sss_nss_lock(void);
 void sss_nss_unlock(void);
+void sss_nss_enum_lock(void);
+void sss_nss_enum_unlock(void);
 void sss_pam_lock(void);
 void sss_pam_unlock(void);
 
@@ -0,0 +1,263 @@
+/*
+    SSSD
+
+    Back end request scheduler -- Tests
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <popt.h>
+#include <check.h>
+
+#include "confdb/confdb.h"
+#include "providers/dp_backend.h"
+#include "tests/common.h"
+
+#define TESTS_PATH "tests_be_sched"
+#define TEST_CONF_FILE "tests_conf.ldb"
+#define TEST_CONF_PATH "config/domain/SCHED"
+
+#define MAX_SLOTS 4
+
+struct sched_test_ctx {
+    struct tevent_context *ev;
+    struct be_ctx *be_ctx;
+
+    /* slots in the order they were started */
+    int started;
+    enum be_req_class order[MAX_SLOTS];
+};
+
+struct sched_test_slot {
+    struct sched_test_ctx *tctx;
+    enum be_req_class req_class;
+    struct tevent_req *req;
+    bool done;
+    int error;
+};
+
+struct sched_test_ctx *test_ctx = NULL;
+
+static void sched_test_slot_done(struct tevent_req *req)
+{
+    struct sched_test_slot *slot =
+                        tevent_req_callback_data(req, struct sched_test_slot);
+    struct sched_test_ctx *tctx = slot->tctx;
+
+    /* the request is kept, it holds the slot until it is freed */
+    slot->error = be_sched_slot_recv(req);
+    slot->done = true;
+
+    fail_if(tctx->started >= MAX_SLOTS, "Too many slots started");
+    tctx->order[tctx->started++] = slot->req_class;
+}
+
+static struct sched_test_slot *sched_test_queue(enum be_req_class req_class)
+{
+    struct sched_test_slot *slot;
+
+    slot = talloc_zero(test_ctx, struct sched_test_slot);
+    fail_if(slot == NULL, "Out of memory");
+    slot->tctx = test_ctx;
+    slot->req_class = req_class;
+
+    slot->req = be_sched_slot_send(slot, test_ctx->be_ctx, req_class);
+    fail_if(slot->req == NULL, "be_sched_slot_send failed");
+    tevent_req_set_callback(slot->req, sched_test_slot_done, slot);
+
+    return slot;
+}
+
+static void sched_test_wait(struct sched_test_slot *slot)
+{
+    while (!slot->done) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    fail_unless(slot->error == EOK, "Slot failed [%d]", slot->error);
+}
+
+void setup_sched(void)
+{
+    struct be_ctx *be_ctx;
+    const char *val[2];
+    char *conf_db;
+    errno_t ret;
+
+    val[1] = NULL;
+
+    fail_unless(test_ctx == NULL, "Scheduler context already initialized.");
+    test_ctx = talloc_zero(NULL, struct sched_test_ctx);
+    fail_unless(test_ctx != NULL, "Cannot create scheduler test context.");
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    fail_unless(test_ctx->ev != NULL, "Cannot create tevent context.");
+
+    ret = mkdir(TESTS_PATH, 0775);
+    fail_if(ret == -1 && errno != EEXIST,
+            "Could not create %s directory", TESTS_PATH);
+
+    be_ctx = talloc_zero(test_ctx, struct be_ctx);
+    fail_unless(be_ctx != NULL, "Cannot create back end context.");
+    be_ctx->ev = test_ctx->ev;
+    be_ctx->conf_path = TEST_CONF_PATH;
+
+    conf_db = talloc_asprintf(test_ctx, "%s/%s", TESTS_PATH, TEST_CONF_FILE);
+    fail_if(conf_db == NULL, "Out of memory, aborting!");
+
+    ret = confdb_init(be_ctx, &be_ctx->cdb, conf_db);
+    fail_if(ret != EOK, "Could not initialize connection to the confdb");
+
+    /* one background request at a time, no limit for the other classes */
+    val[0] = "1";
+    ret = confdb_add_param(be_ctx->cdb, true, TEST_CONF_PATH,
+                           CONFDB_DOMAIN_MAX_BACKGROUND_REQUESTS, val);
+    fail_if(ret != EOK, "Could not set background limit");
+
+    ret = be_sched_init(be_ctx);
+    fail_if(ret != EOK, "be_sched_init failed [%d]", ret);
+
+    test_ctx->be_ctx = be_ctx;
+}
+
+void teardown_sched(void)
+{
+    int ret;
+
+    fail_unless(test_ctx != NULL, "Scheduler context already freed.");
+    ret = talloc_free(test_ctx);
+    test_ctx = NULL;
+    fail_unless(ret == 0, "Cannot free scheduler context.");
+}
+
+/* A PAM request that arrives together with background work starts first */
+START_TEST(test_auth_before_background)
+{
+    struct sched_test_slot *background;
+    struct sched_test_slot *auth;
+
+    background = sched_test_queue(BE_REQ_CLASS_BACKGROUND);
+    auth = sched_test_queue(BE_REQ_CLASS_AUTH);
+
+    fail_if(background->done || auth->done,
+            "Slots must not start before the next loop iteration");
+
+    sched_test_wait(background);
+    sched_test_wait(auth);
+
+    fail_unless(test_ctx->started == 2, "Expected 2 started slots, got %d",
+                test_ctx->started);
+    fail_unless(test_ctx->order[0] == BE_REQ_CLASS_AUTH,
+                "PAM request was not dispatched first");
+    fail_unless(test_ctx->order[1] == BE_REQ_CLASS_BACKGROUND,
+                "Background work was not dispatched second");
+}
+END_TEST
+
+/* Queued background work waits for the running one, PAM requests do not */
+START_TEST(test_background_limit)
+{
+    struct sched_test_slot *first;
+    struct sched_test_slot *second;
+    struct sched_test_slot *auth;
+    int i;
+
+    first = sched_test_queue(BE_REQ_CLASS_BACKGROUND);
+    sched_test_wait(first);
+
+    second = sched_test_queue(BE_REQ_CLASS_BACKGROUND);
+    auth = sched_test_queue(BE_REQ_CLASS_AUTH);
+
+    sched_test_wait(auth);
+
+    for (i = 0; i < 10; i++) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    fail_if(second->done, "Background limit was not enforced");
+
+    /* freeing the request ends the slot */
+    talloc_zfree(first->req);
+
+    sched_test_wait(second);
+
+    fail_unless(test_ctx->started == 3, "Expected 3 started slots, got %d",
+                test_ctx->started);
+    fail_unless(test_ctx->order[1] == BE_REQ_CLASS_AUTH,
+                "PAM request waited for background work");
+    fail_unless(test_ctx->order[2] == BE_REQ_CLASS_BACKGROUND,
+                "Background work was not dispatched last");
+}
+END_TEST
+
+Suite *be_sched_suite(void)
+{
+    Suite *s = suite_create("be_sched");
+
+    TCase *tc_sched = tcase_create("request classes");
+    tcase_add_checked_fixture(tc_sched, setup_sched, teardown_sched);
+    tcase_add_test(tc_sched, test_auth_before_background);
+    tcase_add_test(tc_sched, test_background_limit);
+    suite_add_tcase(s, tc_sched);
+
+    return s;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int number_failed;
+    int ret;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_MAIN_OPTS
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    tests_set_cwd();
+
+    Suite *s = be_sched_suite();
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_ENV);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    ret = unlink(TESTS_PATH"/"TEST_CONF_FILE);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not delete the test config ldb file (%d) (%s)\n",
+                errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    rmdir(TESTS_PATH);
+
+    return (number_failed==0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
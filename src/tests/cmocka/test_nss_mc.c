@@ -0,0 +1,364 @@
+/*
+    SSSD
+
+    NSS memory cache - tests of the responder and client sides
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <talloc.h>
+
+#include "util/util.h"
+#include "tests/common.h"
+#include "responder/nss/nsssrv_mmap_cache.h"
+#include "sss_client/nss_mc.h"
+
+/* SSS_NSS_MCACHE_DIR is set to a directory relative to TEST_DIR for this
+ * test, so both sides of the cache use files created by the test */
+#define TEST_MC_ELEMS 64
+#define TEST_MC_TIMEOUT 300
+#define TEST_MC_MAX_RECS (TEST_MC_ELEMS * SSS_MC_CACHE_MAX_GROWTH)
+#define TEST_UID_BASE 10000
+
+/* client side state, it lives in nss_mc_passwd.c and nss_mc_initgr.c */
+extern struct sss_cli_mc_ctx pw_mc_ctx;
+extern struct sss_cli_mc_ctx initgr_mc_ctx;
+
+struct nss_mc_test_ctx {
+    struct sss_mc_ctx *mcc;
+};
+
+static void nss_mc_client_reset(struct sss_cli_mc_ctx *ctx)
+{
+    if (ctx->initialized) {
+        munmap(ctx->mmap_base, ctx->mmap_size);
+        close(ctx->fd);
+    }
+    memset(ctx, 0, sizeof(struct sss_cli_mc_ctx));
+    ctx->fd = -1;
+}
+
+void setup_initgr_mc(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx;
+    errno_t ret;
+
+    ret = mkdir(SSS_NSS_MCACHE_DIR, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(NULL, struct nss_mc_test_ctx);
+    assert_non_null(test_ctx);
+
+    ret = sss_mmap_cache_init(test_ctx, "initgroups", SSS_MC_INITGROUPS,
+                              TEST_MC_ELEMS, TEST_MC_TIMEOUT, &test_ctx->mcc);
+    assert_int_equal(ret, EOK);
+
+    nss_mc_client_reset(&initgr_mc_ctx);
+
+    *state = test_ctx;
+}
+
+void teardown_initgr_mc(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+
+    nss_mc_client_reset(&initgr_mc_ctx);
+    talloc_free(test_ctx);
+
+    unlink(SSS_NSS_MCACHE_DIR"/initgroups");
+    rmdir(SSS_NSS_MCACHE_DIR);
+}
+
+void setup_pw_mc(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx;
+    errno_t ret;
+
+    ret = mkdir(SSS_NSS_MCACHE_DIR, 0775);
+    assert_true(ret == 0 || errno == EEXIST);
+
+    test_ctx = talloc_zero(NULL, struct nss_mc_test_ctx);
+    assert_non_null(test_ctx);
+
+    ret = sss_mmap_cache_init(test_ctx, "passwd", SSS_MC_PASSWD,
+                              TEST_MC_ELEMS, TEST_MC_TIMEOUT, &test_ctx->mcc);
+    assert_int_equal(ret, EOK);
+
+    nss_mc_client_reset(&pw_mc_ctx);
+
+    *state = test_ctx;
+}
+
+void teardown_pw_mc(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+
+    nss_mc_client_reset(&pw_mc_ctx);
+    talloc_free(test_ctx);
+
+    unlink(SSS_NSS_MCACHE_DIR"/passwd");
+    rmdir(SSS_NSS_MCACHE_DIR);
+}
+
+static void store_pw(struct nss_mc_test_ctx *test_ctx, uint32_t num)
+{
+    struct sized_string name;
+    struct sized_string pw;
+    struct sized_string gecos;
+    struct sized_string homedir;
+    struct sized_string shell;
+    char namestr[32];
+    char homestr[64];
+    errno_t ret;
+
+    snprintf(namestr, sizeof(namestr), "user%u", num);
+    snprintf(homestr, sizeof(homestr), "/home/user%u", num);
+
+    to_sized_string(&name, namestr);
+    to_sized_string(&pw, "*");
+    to_sized_string(&gecos, "Test User");
+    to_sized_string(&homedir, homestr);
+    to_sized_string(&shell, "/bin/sh");
+
+    ret = sss_mmap_cache_pw_store(&test_ctx->mcc, &name, &pw,
+                                  TEST_UID_BASE + num, TEST_UID_BASE,
+                                  &gecos, &homedir, &shell);
+    assert_int_equal(ret, EOK);
+}
+
+/* Records must survive the cache being moved to bigger files */
+void test_pw_mc_grow(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+    struct sss_mc_stats stats;
+    struct passwd pwd;
+    char buffer[1024];
+    char name[32];
+    uint32_t num;
+    uint32_t i;
+    errno_t ret;
+
+    /* fill the cache until it had to grow twice */
+    memset(&stats, 0, sizeof(stats));
+    for (num = 0; stats.generation < 2; num++) {
+        assert_true(num < TEST_MC_MAX_RECS);
+        store_pw(test_ctx, num);
+        sss_mmap_cache_get_stats(test_ctx->mcc, &stats);
+    }
+
+    assert_int_equal(stats.evictions, 0);
+    assert_int_equal(stats.records, num);
+
+    /* new records still fit after the grown ones */
+    store_pw(test_ctx, num);
+    num++;
+    sss_mmap_cache_get_stats(test_ctx->mcc, &stats);
+    assert_int_equal(stats.evictions, 0);
+    assert_int_equal(stats.records, num);
+
+    /* the client opens the grown file */
+    nss_mc_client_reset(&pw_mc_ctx);
+
+    for (i = 0; i < num; i++) {
+        snprintf(name, sizeof(name), "user%u", i);
+
+        ret = sss_nss_mc_getpwnam(name, strlen(name), &pwd,
+                                  buffer, sizeof(buffer));
+        assert_int_equal(ret, 0);
+        assert_int_equal(pwd.pw_uid, TEST_UID_BASE + i);
+        assert_string_equal(pwd.pw_name, name);
+
+        ret = sss_nss_mc_getpwuid(TEST_UID_BASE + i, &pwd,
+                                  buffer, sizeof(buffer));
+        assert_int_equal(ret, 0);
+        assert_string_equal(pwd.pw_name, name);
+    }
+}
+
+static void store_initgr(struct nss_mc_test_ctx *test_ctx, const char *name,
+                         uint32_t num_groups, uint32_t *gids)
+{
+    struct sized_string key;
+    errno_t ret;
+
+    to_sized_string(&key, name);
+    ret = sss_mmap_cache_initgr_store(&test_ctx->mcc, &key, num_groups, gids);
+    assert_int_equal(ret, EOK);
+}
+
+void test_initgr_mc_groups(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+    uint32_t gids[] = { 1001, 1002, 1003 };
+    long int start = 1;
+    long int size = 1;
+    gid_t *groups;
+    errno_t ret;
+
+    store_initgr(test_ctx, "testuser", 3, gids);
+
+    groups = malloc(sizeof(gid_t));
+    assert_non_null(groups);
+    groups[0] = 1000;
+
+    ret = sss_nss_mc_initgroups_dyn("testuser", strlen("testuser"), 1000,
+                                    &start, &size, &groups, 0);
+    assert_int_equal(ret, 0);
+    assert_int_equal(start, 4);
+    assert_true(size >= 4);
+    assert_int_equal(groups[0], 1000);
+    assert_int_equal(groups[1], 1001);
+    assert_int_equal(groups[2], 1002);
+    assert_int_equal(groups[3], 1003);
+
+    free(groups);
+}
+
+void test_initgr_mc_limit(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+    uint32_t gids[] = { 1001, 1002, 1003 };
+    long int start = 1;
+    long int size = 1;
+    gid_t *groups;
+    errno_t ret;
+
+    store_initgr(test_ctx, "testuser", 3, gids);
+
+    groups = malloc(sizeof(gid_t));
+    assert_non_null(groups);
+    groups[0] = 1000;
+
+    ret = sss_nss_mc_initgroups_dyn("testuser", strlen("testuser"), 1000,
+                                    &start, &size, &groups, 2);
+    assert_int_equal(ret, 0);
+    assert_int_equal(start, 2);
+    assert_int_equal(size, 2);
+    assert_int_equal(groups[1], 1001);
+
+    free(groups);
+}
+
+/* A user without supplementary groups must be reported the same way the
+ * socket based lookup does, i.e. as not found */
+void test_initgr_mc_no_groups(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+    long int start = 1;
+    long int size = 1;
+    gid_t *groups;
+    errno_t ret;
+
+    store_initgr(test_ctx, "nogroups", 0, NULL);
+
+    groups = malloc(sizeof(gid_t));
+    assert_non_null(groups);
+    groups[0] = 1000;
+
+    ret = sss_nss_mc_initgroups_dyn("nogroups", strlen("nogroups"), 1000,
+                                    &start, &size, &groups, 0);
+    assert_int_equal(ret, ENODATA);
+    assert_int_equal(start, 1);
+    assert_int_equal(size, 1);
+
+    free(groups);
+}
+
+void test_initgr_mc_unknown(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+    uint32_t gids[] = { 1001 };
+    long int start = 1;
+    long int size = 1;
+    gid_t *groups;
+    errno_t ret;
+
+    store_initgr(test_ctx, "testuser", 1, gids);
+
+    groups = malloc(sizeof(gid_t));
+    assert_non_null(groups);
+    groups[0] = 1000;
+
+    ret = sss_nss_mc_initgroups_dyn("otheruser", strlen("otheruser"), 1000,
+                                    &start, &size, &groups, 0);
+    assert_int_equal(ret, ENOENT);
+    assert_int_equal(start, 1);
+
+    free(groups);
+}
+
+void test_initgr_mc_invalidate(void **state)
+{
+    struct nss_mc_test_ctx *test_ctx = *state;
+    uint32_t gids[] = { 1001 };
+    struct sized_string key;
+    long int start = 1;
+    long int size = 1;
+    gid_t *groups;
+    errno_t ret;
+
+    store_initgr(test_ctx, "testuser", 1, gids);
+
+    to_sized_string(&key, "testuser");
+    ret = sss_mmap_cache_initgr_invalidate(test_ctx->mcc, &key);
+    assert_int_equal(ret, EOK);
+
+    groups = malloc(sizeof(gid_t));
+    assert_non_null(groups);
+    groups[0] = 1000;
+
+    /* the client falls back to the responder for invalidated records */
+    ret = sss_nss_mc_initgroups_dyn("testuser", strlen("testuser"), 1000,
+                                    &start, &size, &groups, 0);
+    assert_int_not_equal(ret, 0);
+    assert_int_not_equal(ret, ENODATA);
+    assert_int_equal(start, 1);
+
+    free(groups);
+}
+
+int main(void)
+{
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_initgr_mc_groups,
+                                 setup_initgr_mc, teardown_initgr_mc),
+        unit_test_setup_teardown(test_initgr_mc_limit,
+                                 setup_initgr_mc, teardown_initgr_mc),
+        unit_test_setup_teardown(test_initgr_mc_no_groups,
+                                 setup_initgr_mc, teardown_initgr_mc),
+        unit_test_setup_teardown(test_initgr_mc_unknown,
+                                 setup_initgr_mc, teardown_initgr_mc),
+        unit_test_setup_teardown(test_initgr_mc_invalidate,
+                                 setup_initgr_mc, teardown_initgr_mc),
+        unit_test_setup_teardown(test_pw_mc_grow,
+                                 setup_pw_mc, teardown_pw_mc),
+    };
+
+    debug_level = SSSDBG_INVALID;
+    DEBUG_INIT(debug_level);
+
+    tests_set_cwd();
+
+    return run_tests(tests);
+}
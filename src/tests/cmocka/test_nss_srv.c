@@ -28,6 +28,7 @@
 #include "tests/cmocka/common_mock.h"
 #include "tests/cmocka/common_mock_resp.h"
 #include "responder/common/negcache.h"
+#include "responder/common/responder_cache.h"
 #include "responder/nss/nsssrv.h"
 #include "responder/nss/nsssrv_private.h"
 
@@ -88,7 +89,7 @@ void __wrap_sss_packet_get_body(struct sss_packet *packet,
     }
 
     *body = sss_mock_ptr_type(uint8_t *);
-    *blen = strlen((const char *) *body)+1;
+    *blen = sss_mock_type(size_t);
     return;
 }
 
@@ -113,6 +114,9 @@ void __wrap_sss_cmd_done(struct cli_ctx *cctx, void *freectx)
 
     nss_test_ctx->tctx->error = check_cb(body, blen);
     nss_test_ctx->tctx->done = true;
+
+    /* like the real function, release the request data */
+    talloc_free(freectx);
 }
 
 enum sss_cli_command __wrap_sss_packet_get_cmd(struct sss_packet *packet)
@@ -148,6 +152,15 @@ static void mock_input_user(const char *username)
 {
     will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
     will_return(__wrap_sss_packet_get_body, username);
+    will_return(__wrap_sss_packet_get_body, strlen(username) + 1);
+}
+
+/* The bulk requests are binary, the length is passed explicitly */
+static void mock_input_uids(uint8_t *body, size_t blen)
+{
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_WRAPPER);
+    will_return(__wrap_sss_packet_get_body, body);
+    will_return(__wrap_sss_packet_get_body, blen);
 }
 
 static void mock_fill_user(void)
@@ -157,6 +170,19 @@ static void mock_fill_user(void)
     will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
 }
 
+static void mock_fill_bulk(uint32_t num_entries)
+{
+    uint32_t i;
+
+    /* One packet to look for entries added before, one per entry
+     * and one for num entries */
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+    for (i = 0; i < num_entries; i++) {
+        will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+    }
+    will_return(__wrap_sss_packet_get_body, WRAP_CALL_REAL);
+}
+
 static int parse_user_packet(uint8_t *body, size_t blen, struct passwd *pwd)
 {
     size_t rp = 2 * sizeof(uint32_t);
@@ -411,6 +437,549 @@ void test_nss_getpwnam_update(void **state)
     assert_string_equal(shell, "/bin/ksh");
 }
 
+/* Result cache */
+static const char *rc_expected_name;
+static const char *rc_expected_shell;
+
+static int test_nss_getpwnam_rc_check(uint8_t *body, size_t blen)
+{
+    struct passwd pwd;
+    errno_t ret;
+
+    ret = parse_user_packet(body, blen, &pwd);
+    assert_int_equal(ret, EOK);
+
+    assert_string_equal(pwd.pw_name, rc_expected_name);
+    assert_string_equal(pwd.pw_shell, rc_expected_shell);
+    return EOK;
+}
+
+static void rc_enable(int timeout)
+{
+    errno_t ret;
+
+    ret = sss_rc_init(nss_test_ctx->rctx, timeout,
+                      &nss_test_ctx->rctx->result_cache);
+    assert_int_equal(ret, EOK);
+}
+
+/* Any DP request the lookup makes must be mocked by the caller */
+static void rc_getpwnam(const char *name, const char *shell)
+{
+    errno_t ret;
+
+    rc_expected_name = name;
+    rc_expected_shell = shell;
+
+    nss_test_ctx->tctx->done = false;
+
+    mock_input_user(name);
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETPWNAM);
+    mock_fill_user();
+    set_cmd_cb(test_nss_getpwnam_rc_check);
+
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETPWNAM,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+/* An identical lookup is answered from the result of the first one, which
+ * must stay valid after the first request was freed */
+void test_nss_getpwnam_rc_hit(void **state)
+{
+    struct sss_rc_stats stats;
+    errno_t ret;
+
+    ret = sysdb_add_user(nss_test_ctx->tctx->sysdb,
+                         nss_test_ctx->tctx->dom,
+                         "testuser_rc", 601, 602, "test user",
+                         "/home/testuser", "/bin/sh", NULL,
+                         NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    rc_enable(300);
+
+    rc_getpwnam("testuser_rc", "/bin/sh");
+
+    sss_rc_get_stats(nss_test_ctx->rctx->result_cache, &stats);
+    assert_int_equal(stats.misses, 1);
+    assert_int_equal(stats.stores, 1);
+    assert_int_equal(stats.hits, 0);
+
+    rc_getpwnam("testuser_rc", "/bin/sh");
+
+    sss_rc_get_stats(nss_test_ctx->rctx->result_cache, &stats);
+    assert_int_equal(stats.misses, 1);
+    assert_int_equal(stats.stores, 1);
+    assert_int_equal(stats.hits, 1);
+}
+
+/* Once the timeout passed the sysdb is searched again */
+void test_nss_getpwnam_rc_expire(void **state)
+{
+    struct sss_rc_stats stats;
+    errno_t ret;
+
+    ret = sysdb_add_user(nss_test_ctx->tctx->sysdb,
+                         nss_test_ctx->tctx->dom,
+                         "testuser_rc_exp", 611, 612, "test user",
+                         "/home/testuser", "/bin/sh", NULL,
+                         NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    rc_enable(1);
+
+    rc_getpwnam("testuser_rc_exp", "/bin/sh");
+
+    ret = sysdb_store_user(nss_test_ctx->tctx->sysdb,
+                           nss_test_ctx->tctx->dom,
+                           "testuser_rc_exp", NULL, 611, 612, "test user",
+                           "/home/testuser", "/bin/ksh", NULL,
+                           NULL, NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    sleep(1);
+
+    rc_getpwnam("testuser_rc_exp", "/bin/ksh");
+
+    sss_rc_get_stats(nss_test_ctx->rctx->result_cache, &stats);
+    assert_int_equal(stats.hits, 0);
+    assert_int_equal(stats.expired, 1);
+    assert_int_equal(stats.stores, 2);
+}
+
+static int test_nss_getpwnam_rc_update_acct_cb(void *pvt)
+{
+    errno_t ret;
+    struct nss_test_ctx *ctx = talloc_get_type(pvt, struct nss_test_ctx);
+
+    ret = sysdb_store_user(ctx->tctx->sysdb,
+                           ctx->tctx->dom,
+                           "testuser_rc_upd", NULL, 621, 622, "test user",
+                           "/home/testuser", "/bin/ksh", NULL,
+                           NULL, NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    return EOK;
+}
+
+/* The expired result stored before going to the provider is replaced by
+ * the updated one, which later lookups get without asking the provider */
+void test_nss_getpwnam_rc_update(void **state)
+{
+    struct sss_rc_stats stats;
+    errno_t ret;
+
+    ret = sysdb_add_user(nss_test_ctx->tctx->sysdb,
+                         nss_test_ctx->tctx->dom,
+                         "testuser_rc_upd", 621, 622, "test user",
+                         "/home/testuser", "/bin/sh", NULL,
+                         NULL, 1, 1);
+    assert_int_equal(ret, EOK);
+
+    rc_enable(300);
+
+    mock_account_recv(0, 0, NULL, test_nss_getpwnam_rc_update_acct_cb,
+                      nss_test_ctx);
+    rc_getpwnam("testuser_rc_upd", "/bin/ksh");
+
+    sss_rc_get_stats(nss_test_ctx->rctx->result_cache, &stats);
+    assert_int_equal(stats.hits, 0);
+    assert_int_equal(stats.stores, 2);
+
+    /* no DP request is mocked, the lookup must not need one */
+    rc_getpwnam("testuser_rc_upd", "/bin/ksh");
+
+    sss_rc_get_stats(nss_test_ctx->rctx->result_cache, &stats);
+    assert_int_equal(stats.hits, 1);
+    assert_int_equal(stats.stores, 2);
+}
+
+/* A membership change reported by the provider drops the cached results */
+void test_nss_getpwnam_rc_initgr_check(void **state)
+{
+    struct sss_rc_stats stats;
+    uint32_t groups[] = { 633 };
+    errno_t ret;
+
+    ret = sysdb_add_user(nss_test_ctx->tctx->sysdb,
+                         nss_test_ctx->tctx->dom,
+                         "testuser_rc_initgr", 631, 632, "test user",
+                         "/home/testuser", "/bin/sh", NULL,
+                         NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    rc_enable(300);
+
+    rc_getpwnam("testuser_rc_initgr", "/bin/sh");
+
+    ret = sysdb_store_user(nss_test_ctx->tctx->sysdb,
+                           nss_test_ctx->tctx->dom,
+                           "testuser_rc_initgr", NULL, 631, 632, "test user",
+                           "/home/testuser", "/bin/ksh", NULL,
+                           NULL, NULL, 300, 0);
+    assert_int_equal(ret, EOK);
+
+    /* the user was member of a group it is no longer member of */
+    nss_update_initgr_memcache(nss_test_ctx->nctx, "testuser_rc_initgr",
+                               nss_test_ctx->tctx->dom->name, 1, groups);
+
+    sss_rc_get_stats(nss_test_ctx->rctx->result_cache, &stats);
+    assert_int_equal(stats.entries, 0);
+
+    rc_getpwnam("testuser_rc_initgr", "/bin/ksh");
+
+    sss_rc_get_stats(nss_test_ctx->rctx->result_cache, &stats);
+    assert_int_equal(stats.hits, 0);
+    assert_int_equal(stats.stores, 2);
+}
+
+/* Bulk uid lookups */
+#define BULK_MAX_TEST_IDS 8
+
+struct bulk_test_user {
+    const char *name;
+    uid_t uid;
+    gid_t gid;
+};
+
+static struct bulk_test_user bulk_test_users[] = {
+    { "testbulk1", 1001, 2001 },
+    { "testbulk2", 1002, 2002 },
+    { "testbulk3", 1003, 2003 },
+    { "testbulk_search1", 1011, 2011 },
+    { "testbulk_search2", 1012, 2012 },
+    { "testbulk_search3", 1013, 2013 },
+    { "testbulk_dup1", 1031, 2031 },
+    { "testbulk_dup2", 1032, 2032 },
+    { NULL, 0, 0 }
+};
+
+/* the users the check callback expects in the reply */
+static uid_t bulk_expected_uids[BULK_MAX_TEST_IDS];
+static size_t bulk_num_expected;
+
+static uint8_t *bulk_request(TALLOC_CTX *mem_ctx, uint32_t num,
+                             uint32_t *uids, size_t *_blen)
+{
+    uint8_t *body;
+    size_t rp = 0;
+    uint32_t i;
+
+    body = talloc_array(mem_ctx, uint8_t, (num + 1) * sizeof(uint32_t));
+    assert_non_null(body);
+
+    SAFEALIGN_SET_UINT32(body + rp, num, &rp);
+    for (i = 0; i < num; i++) {
+        SAFEALIGN_SET_UINT32(body + rp, uids[i], &rp);
+    }
+
+    *_blen = rp;
+    return body;
+}
+
+static void bulk_add_user(struct nss_test_ctx *ctx, uid_t uid,
+                          uint64_t cache_timeout, time_t now)
+{
+    struct bulk_test_user *u;
+    errno_t ret;
+
+    for (u = bulk_test_users; u->name != NULL; u++) {
+        if (u->uid == uid) break;
+    }
+    assert_non_null(u->name);
+
+    ret = sysdb_add_user(ctx->tctx->sysdb, ctx->tctx->dom,
+                         u->name, u->uid, u->gid, "bulk user",
+                         "/home/bulk", "/bin/sh", NULL,
+                         NULL, cache_timeout, now);
+    assert_int_equal(ret, EOK);
+}
+
+static void bulk_expect(size_t num, uid_t *uids)
+{
+    assert_true(num <= BULK_MAX_TEST_IDS);
+
+    memcpy(bulk_expected_uids, uids, num * sizeof(uid_t));
+    bulk_num_expected = num;
+}
+
+/* Checks the reply is a list of passwd entries in the format the client
+ * library parses, with exactly the expected users in it */
+static int test_nss_getpwuid_bulk_check(uint8_t *body, size_t blen)
+{
+    struct bulk_test_user *u;
+    bool seen[BULK_MAX_TEST_IDS] = { false };
+    uint32_t num;
+    uint32_t reserved;
+    uint32_t uid;
+    uint32_t gid;
+    const char *name;
+    size_t rp = 0;
+    size_t len;
+    size_t i, j;
+
+    assert_true(blen >= 2 * sizeof(uint32_t));
+    SAFEALIGN_COPY_UINT32(&num, body + rp, &rp);
+    SAFEALIGN_COPY_UINT32(&reserved, body + rp, &rp);
+    assert_int_equal(num, bulk_num_expected);
+    assert_int_equal(reserved, 0);
+
+    for (i = 0; i < num; i++) {
+        assert_true(rp + 2 * sizeof(uint32_t) <= blen);
+        SAFEALIGN_COPY_UINT32(&uid, body + rp, &rp);
+        SAFEALIGN_COPY_UINT32(&gid, body + rp, &rp);
+
+        name = (const char *) body + rp;
+
+        /* name, passwd, gecos, dir, shell */
+        for (j = 0; j < 5; j++) {
+            assert_true(rp < blen);
+            len = strnlen((const char *) body + rp, blen - rp);
+            assert_true(rp + len < blen);
+            rp += len + 1;
+        }
+
+        for (j = 0; j < bulk_num_expected; j++) {
+            if (bulk_expected_uids[j] == uid) break;
+        }
+        assert_true(j < bulk_num_expected);
+        assert_false(seen[j]);
+        seen[j] = true;
+
+        for (u = bulk_test_users; u->name != NULL; u++) {
+            if (u->uid == uid) break;
+        }
+        assert_non_null(u->name);
+        assert_int_equal(gid, u->gid);
+        assert_string_equal(name, u->name);
+    }
+
+    /* nothing trails the last entry */
+    assert_int_equal(rp, blen);
+    return EOK;
+}
+
+static void bulk_execute(uint8_t *body, size_t blen)
+{
+    errno_t ret;
+
+    mock_input_uids(body, blen);
+    ret = sss_cmd_execute(nss_test_ctx->cctx, SSS_NSS_GETPWUID_BULK,
+                          nss_test_ctx->nss_cmds);
+    assert_int_equal(ret, EOK);
+}
+
+/* All requested users are cached and valid, the DP is not contacted */
+void test_nss_getpwuid_bulk(void **state)
+{
+    uint32_t uids[] = { 1003, 1001, 1002, 1001 };
+    uid_t expected[] = { 1001, 1002, 1003 };
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    bulk_add_user(nss_test_ctx, 1001, 300, 0);
+    bulk_add_user(nss_test_ctx, 1002, 300, 0);
+    bulk_add_user(nss_test_ctx, 1003, 300, 0);
+
+    /* the duplicate uid is only returned once */
+    body = bulk_request(nss_test_ctx, 4, uids, &blen);
+    bulk_expect(3, expected);
+
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETPWUID_BULK);
+    mock_fill_bulk(3);
+    set_cmd_cb(test_nss_getpwuid_bulk_check);
+
+    bulk_execute(body, blen);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static int test_nss_getpwuid_bulk_search_acct_cb(void *pvt)
+{
+    struct nss_test_ctx *ctx = talloc_get_type(pvt, struct nss_test_ctx);
+
+    bulk_add_user(ctx, 1012, 300, 0);
+    return EOK;
+}
+
+/* One of the users is missing from the cache and one is expired, both are
+ * fetched from the DP and the reply carries all of them */
+void test_nss_getpwuid_bulk_search(void **state)
+{
+    uint32_t uids[] = { 1011, 1012, 1013 };
+    uid_t expected[] = { 1011, 1012, 1013 };
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    bulk_add_user(nss_test_ctx, 1011, 300, 0);
+    /* expired a long time ago */
+    bulk_add_user(nss_test_ctx, 1013, 1, 1);
+
+    body = bulk_request(nss_test_ctx, 3, uids, &blen);
+    bulk_expect(3, expected);
+
+    /* one DP request per uid, the search is repeated once both of them
+     * finished and the missing user was written by then */
+    mock_account_recv(0, 0, NULL, test_nss_getpwuid_bulk_search_acct_cb,
+                      nss_test_ctx);
+    mock_account_recv_simple();
+
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETPWUID_BULK);
+    mock_fill_bulk(3);
+    set_cmd_cb(test_nss_getpwuid_bulk_check);
+
+    bulk_execute(body, blen);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+static int test_nss_getpwuid_bulk_dup_acct_cb(void *pvt)
+{
+    struct nss_test_ctx *ctx = talloc_get_type(pvt, struct nss_test_ctx);
+
+    /* the provider sorted out the conflict */
+    return sysdb_delete_user(ctx->tctx->sysdb, ctx->tctx->dom,
+                             "testbulk_dup2", 0);
+}
+
+/* Two expired cached users share a uid, the uid is requested from the DP
+ * only once */
+void test_nss_getpwuid_bulk_dup(void **state)
+{
+    uint32_t uids[] = { 1031 };
+    uid_t expected[] = { 1031 };
+    struct sysdb_attrs *attrs;
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    bulk_add_user(nss_test_ctx, 1031, 1, 1);
+    bulk_add_user(nss_test_ctx, 1032, 1, 1);
+
+    attrs = sysdb_new_attrs(nss_test_ctx);
+    assert_non_null(attrs);
+    ret = sysdb_attrs_add_uint32(attrs, SYSDB_UIDNUM, 1031);
+    assert_int_equal(ret, EOK);
+    ret = sysdb_set_user_attr(nss_test_ctx->tctx->sysdb,
+                              nss_test_ctx->tctx->dom, "testbulk_dup2",
+                              attrs, SYSDB_MOD_REP);
+    assert_int_equal(ret, EOK);
+
+    body = bulk_request(nss_test_ctx, 1, uids, &blen);
+    bulk_expect(1, expected);
+
+    /* a single DP request */
+    mock_account_recv(0, 0, NULL, test_nss_getpwuid_bulk_dup_acct_cb,
+                      nss_test_ctx);
+
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETPWUID_BULK);
+    mock_fill_bulk(1);
+    set_cmd_cb(test_nss_getpwuid_bulk_check);
+
+    bulk_execute(body, blen);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EOK);
+}
+
+/* Unknown uids yield ENOENT and end up in the negative cache */
+void test_nss_getpwuid_bulk_neg(void **state)
+{
+    uint32_t uids[] = { 1021, 1022 };
+    uint8_t *body;
+    size_t blen;
+    errno_t ret;
+
+    body = bulk_request(nss_test_ctx, 2, uids, &blen);
+
+    /* one DP request per uid */
+    mock_account_recv_simple();
+    mock_account_recv_simple();
+
+    bulk_execute(body, blen);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, ENOENT);
+
+    ret = sss_ncache_check_uid(nss_test_ctx->nctx->ncache,
+                               nss_test_ctx->nctx->neg_timeout, 1021);
+    assert_int_equal(ret, EEXIST);
+    ret = sss_ncache_check_uid(nss_test_ctx->nctx->ncache,
+                               nss_test_ctx->nctx->neg_timeout, 1022);
+    assert_int_equal(ret, EEXIST);
+
+    /* The second search is answered from the negative cache, the DP
+     * is not contacted again */
+    nss_test_ctx->tctx->done = false;
+
+    bulk_execute(body, blen);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, ENOENT);
+}
+
+/* An error reply carries no entries */
+static int test_nss_getpwuid_bulk_inval_check(uint8_t *body, size_t blen)
+{
+    assert_int_equal(blen, 0);
+    return EINVAL;
+}
+
+static void bulk_expect_inval(uint8_t *body, size_t blen)
+{
+    errno_t ret;
+
+    nss_test_ctx->tctx->done = false;
+
+    will_return(__wrap_sss_packet_get_cmd, SSS_NSS_GETPWUID_BULK);
+    set_cmd_cb(test_nss_getpwuid_bulk_inval_check);
+
+    bulk_execute(body, blen);
+
+    ret = test_ev_loop(nss_test_ctx->tctx);
+    assert_int_equal(ret, EINVAL);
+}
+
+/* Malformed requests are refused without touching the cache */
+void test_nss_getpwuid_bulk_inval(void **state)
+{
+    uint32_t uids[SSS_NSS_BULK_MAX_IDS + 1];
+    uint8_t *body;
+    size_t blen;
+    size_t rp;
+    uint32_t i;
+
+    for (i = 0; i < SSS_NSS_BULK_MAX_IDS + 1; i++) {
+        uids[i] = 1001 + i;
+    }
+
+    /* shorter than the count */
+    body = bulk_request(nss_test_ctx, 1, uids, &blen);
+    bulk_expect_inval(body, sizeof(uint32_t) - 1);
+
+    /* no ids */
+    body = bulk_request(nss_test_ctx, 0, uids, &blen);
+    bulk_expect_inval(body, blen);
+
+    /* the count does not match the ids sent */
+    body = bulk_request(nss_test_ctx, 2, uids, &blen);
+    rp = 0;
+    SAFEALIGN_SET_UINT32(body, 3, &rp);
+    bulk_expect_inval(body, blen);
+
+    /* too many ids in a single request */
+    body = bulk_request(nss_test_ctx, SSS_NSS_BULK_MAX_IDS + 1, uids, &blen);
+    bulk_expect_inval(body, blen);
+}
+
 /* Testsuite setup and teardown */
 void nss_test_setup(void **state)
 {
@@ -479,6 +1048,24 @@ int main(int argc, const char *argv[])
                                  nss_test_setup, nss_test_teardown),
         unit_test_setup_teardown(test_nss_getpwnam_update,
                                  nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwnam_rc_hit,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwnam_rc_expire,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwnam_rc_update,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwnam_rc_initgr_check,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwuid_bulk,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwuid_bulk_search,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwuid_bulk_dup,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwuid_bulk_neg,
+                                 nss_test_setup, nss_test_teardown),
+        unit_test_setup_teardown(test_nss_getpwuid_bulk_inval,
+                                 nss_test_setup, nss_test_teardown),
     };
 
     /* Set debug level to invalid value so we can deside if -d 0 was used. */
@@ -0,0 +1,322 @@
+/*
+    SSSD
+
+    SSH responder - tests of the known_hosts file
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "util/crypto/sss_crypto.h"
+#include "db/sysdb_ssh.h"
+#include "responder/ssh/sshsrv_private.h"
+
+#define TESTS_PATH "tests_ssh_known_hosts"
+#define TEST_CONF_DB "test_ssh_known_hosts_conf.ldb"
+#define TEST_SYSDB_FILE "cache_ssh_known_hosts_test.ldb"
+#define TEST_DOM_NAME "ssh_known_hosts_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_TIMEOUT 100
+
+#define TEST_HOST1 "host1.example.com"
+#define TEST_HOST2 "host2.example.com"
+#define TEST_KEY1 "ssh-rsa AAAAB3NzaC1yc2EAAAAkey1"
+#define TEST_KEY2 "ssh-rsa AAAAB3NzaC1yc2EAAAAkey2"
+#define TEST_KEY3 "ssh-rsa AAAAB3NzaC1yc2EAAAAkey3"
+
+struct known_hosts_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct ssh_ctx *ssh_ctx;
+};
+
+struct known_hosts_test_ctx *kh_test_ctx;
+
+void known_hosts_test_setup(void **state)
+{
+    struct sss_test_conf_param params[] = {
+        { "enumerate", "false" },
+        { NULL, NULL },             /* Sentinel */
+    };
+    struct resp_ctx *rctx;
+
+    kh_test_ctx = talloc_zero(NULL, struct known_hosts_test_ctx);
+    assert_non_null(kh_test_ctx);
+
+    kh_test_ctx->tctx = create_dom_test_ctx(kh_test_ctx, TESTS_PATH,
+                                            TEST_CONF_DB, TEST_SYSDB_FILE,
+                                            TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                            params);
+    assert_non_null(kh_test_ctx->tctx);
+
+    rctx = talloc_zero(kh_test_ctx, struct resp_ctx);
+    assert_non_null(rctx);
+    rctx->domains = kh_test_ctx->tctx->dom;
+
+    kh_test_ctx->ssh_ctx = talloc_zero(kh_test_ctx, struct ssh_ctx);
+    assert_non_null(kh_test_ctx->ssh_ctx);
+    kh_test_ctx->ssh_ctx->rctx = rctx;
+    kh_test_ctx->ssh_ctx->known_hosts_timeout = TEST_TIMEOUT;
+}
+
+void known_hosts_test_teardown(void **state)
+{
+    unlink(SSS_SSH_KNOWN_HOSTS_PATH);
+    talloc_free(kh_test_ctx);
+}
+
+/* Stores the host with a single key and marks it as looked up at now */
+static void store_host(const char *name, const char *key, time_t now)
+{
+    struct sss_domain_info *dom = kh_test_ctx->tctx->dom;
+    struct sysdb_attrs *attrs;
+    char *b64;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(NULL);
+    assert_non_null(attrs);
+
+    b64 = sss_base64_encode(attrs, (const unsigned char *)key, strlen(key));
+    assert_non_null(b64);
+
+    ret = sysdb_attrs_add_string(attrs, SYSDB_SSH_PUBKEY, b64);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_store_ssh_host(dom->sysdb, dom, name, NULL, now, attrs);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_update_ssh_known_host_expire(dom->sysdb, dom, name, now,
+                                             TEST_TIMEOUT);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(attrs);
+}
+
+/* Looks the host up the way the responder does */
+static void update_host(const char *name, time_t now)
+{
+    struct sss_domain_info *dom = kh_test_ctx->tctx->dom;
+    const char *attrs[] = { SYSDB_NAME, SYSDB_NAME_ALIAS,
+                            SYSDB_SSH_PUBKEY, NULL };
+    struct ldb_message *msg;
+    errno_t ret;
+
+    ret = sysdb_get_ssh_host(kh_test_ctx, dom->sysdb, dom, name, attrs, &msg);
+    assert_int_equal(ret, EOK);
+
+    ret = ssh_known_hosts_update(kh_test_ctx->ssh_ctx, dom, msg, now);
+    assert_int_equal(ret, EOK);
+
+    talloc_free(msg);
+}
+
+static char *read_known_hosts(ino_t *_ino)
+{
+    struct stat st;
+    char *buf;
+    ssize_t len;
+    int fd;
+    int ret;
+
+    fd = open(SSS_SSH_KNOWN_HOSTS_PATH, O_RDONLY);
+    assert_true(fd != -1);
+
+    ret = fstat(fd, &st);
+    assert_int_equal(ret, 0);
+
+    buf = talloc_zero_array(kh_test_ctx, char, st.st_size + 1);
+    assert_non_null(buf);
+
+    len = sss_atomic_read_s(fd, buf, st.st_size);
+    assert_int_equal(len, st.st_size);
+    close(fd);
+
+    if (_ino) *_ino = st.st_ino;
+    return buf;
+}
+
+void test_ssh_known_hosts_append(void **state)
+{
+    time_t now = time(NULL);
+    char *content;
+    ino_t ino;
+    ino_t ino2;
+
+    store_host(TEST_HOST1, TEST_KEY1, now);
+    update_host(TEST_HOST1, now);
+
+    content = read_known_hosts(&ino);
+    assert_string_equal(content, TEST_HOST1" "TEST_KEY1"\n");
+
+    /* an unchanged host leaves the file alone */
+    update_host(TEST_HOST1, now);
+    content = read_known_hosts(&ino2);
+    assert_string_equal(content, TEST_HOST1" "TEST_KEY1"\n");
+    assert_true(ino == ino2);
+
+    /* a new host is appended to the same file */
+    store_host(TEST_HOST2, TEST_KEY2, now);
+    update_host(TEST_HOST2, now);
+
+    content = read_known_hosts(&ino2);
+    assert_string_equal(content, TEST_HOST1" "TEST_KEY1"\n"
+                                 TEST_HOST2" "TEST_KEY2"\n");
+    assert_true(ino == ino2);
+}
+
+void test_ssh_known_hosts_expire(void **state)
+{
+    time_t now = time(NULL);
+    time_t later = now + TEST_TIMEOUT + 1;
+    char *content;
+    ino_t ino;
+    ino_t ino2;
+
+    store_host(TEST_HOST1, TEST_KEY1, now);
+    update_host(TEST_HOST1, now);
+    content = read_known_hosts(&ino);
+    assert_string_equal(content, TEST_HOST1" "TEST_KEY1"\n");
+
+    /* host1 was not looked up since, it is dropped when host2 is added */
+    store_host(TEST_HOST2, TEST_KEY2, later);
+    update_host(TEST_HOST2, later);
+
+    content = read_known_hosts(&ino2);
+    assert_string_equal(content, TEST_HOST2" "TEST_KEY2"\n");
+    assert_true(ino != ino2);
+}
+
+void test_ssh_known_hosts_rewrite(void **state)
+{
+    time_t now = time(NULL);
+    char *content;
+    ino_t ino;
+    ino_t ino2;
+
+    store_host(TEST_HOST1, TEST_KEY1, now);
+    store_host(TEST_HOST2, TEST_KEY2, now);
+    update_host(TEST_HOST1, now);
+    content = read_known_hosts(&ino);
+
+    /* both hosts were loaded from the cache on the first lookup */
+    assert_non_null(strstr(content, TEST_HOST1" "TEST_KEY1"\n"));
+    assert_non_null(strstr(content, TEST_HOST2" "TEST_KEY2"\n"));
+
+    /* new keys of a host replace the whole file */
+    store_host(TEST_HOST2, TEST_KEY3, now);
+    update_host(TEST_HOST2, now);
+
+    content = read_known_hosts(&ino2);
+    assert_non_null(strstr(content, TEST_HOST1" "TEST_KEY1"\n"));
+    assert_non_null(strstr(content, TEST_HOST2" "TEST_KEY3"\n"));
+    assert_null(strstr(content, TEST_KEY2));
+    assert_true(ino != ino2);
+}
+
+void test_ssh_known_hosts_reload(void **state)
+{
+    const char *stale = "stale.example.com "TEST_KEY3"\n";
+    time_t now = time(NULL);
+    char *content;
+    ssize_t wret;
+    int fd;
+
+    /* left behind by an earlier run of the responder */
+    fd = open(SSS_SSH_KNOWN_HOSTS_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert_true(fd != -1);
+    wret = sss_atomic_write_s(fd, discard_const(stale), strlen(stale));
+    assert_int_equal(wret, strlen(stale));
+    close(fd);
+
+    store_host(TEST_HOST1, TEST_KEY1, now);
+    update_host(TEST_HOST1, now);
+
+    content = read_known_hosts(NULL);
+    assert_string_equal(content, TEST_HOST1" "TEST_KEY1"\n");
+
+    /* later hosts are appended to the rewritten file */
+    store_host(TEST_HOST2, TEST_KEY2, now);
+    update_host(TEST_HOST2, now);
+
+    content = read_known_hosts(NULL);
+    assert_string_equal(content, TEST_HOST1" "TEST_KEY1"\n"
+                                 TEST_HOST2" "TEST_KEY2"\n");
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_ssh_known_hosts_append,
+                                 known_hosts_test_setup,
+                                 known_hosts_test_teardown),
+        unit_test_setup_teardown(test_ssh_known_hosts_expire,
+                                 known_hosts_test_setup,
+                                 known_hosts_test_teardown),
+        unit_test_setup_teardown(test_ssh_known_hosts_rewrite,
+                                 known_hosts_test_setup,
+                                 known_hosts_test_teardown),
+        unit_test_setup_teardown(test_ssh_known_hosts_reload,
+                                 known_hosts_test_setup,
+                                 known_hosts_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = run_tests(tests);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    }
+    return rv;
+}
@@ -0,0 +1,399 @@
+/*
+    SSSD
+
+    Sudo responder - tests of the cache of sorted rule sets
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <talloc.h>
+#include <tevent.h>
+#include <errno.h>
+#include <popt.h>
+#include <unistd.h>
+
+#include "tests/cmocka/common_mock.h"
+#include "db/sysdb_sudo.h"
+#include "responder/sudo/sudosrv_private.h"
+
+#define TESTS_PATH "tests_sudo_cache"
+#define TEST_CONF_DB "test_sudo_cache_conf.ldb"
+#define TEST_SYSDB_FILE "cache_sudo_cache_test.ldb"
+#define TEST_DOM_NAME "sudo_cache_test"
+#define TEST_ID_PROVIDER "ldap"
+
+#define TEST_USER "testuser"
+#define TEST_UID 1234
+
+struct sudo_cache_test_ctx {
+    struct sss_test_ctx *tctx;
+    struct sudosrv_cache *cache;
+    char **groupnames;
+};
+
+struct sudo_cache_test_ctx *sudo_test_ctx;
+
+void sudo_cache_test_setup(void **state)
+{
+    errno_t ret;
+    struct sss_test_conf_param params[] = {
+        { "enumerate", "false" },
+        { NULL, NULL },             /* Sentinel */
+    };
+
+    sudo_test_ctx = talloc_zero(NULL, struct sudo_cache_test_ctx);
+    assert_non_null(sudo_test_ctx);
+
+    sudo_test_ctx->tctx = create_dom_test_ctx(sudo_test_ctx, TESTS_PATH,
+                                              TEST_CONF_DB, TEST_SYSDB_FILE,
+                                              TEST_DOM_NAME, TEST_ID_PROVIDER,
+                                              params);
+    assert_non_null(sudo_test_ctx->tctx);
+
+    ret = sudosrv_cache_init(sudo_test_ctx, &sudo_test_ctx->cache);
+    assert_int_equal(ret, EOK);
+
+    sudo_test_ctx->groupnames = talloc_array(sudo_test_ctx, char *, 3);
+    assert_non_null(sudo_test_ctx->groupnames);
+    sudo_test_ctx->groupnames[0] = talloc_strdup(sudo_test_ctx, "wheel");
+    sudo_test_ctx->groupnames[1] = talloc_strdup(sudo_test_ctx, "admins");
+    sudo_test_ctx->groupnames[2] = NULL;
+}
+
+void sudo_cache_test_teardown(void **state)
+{
+    talloc_free(sudo_test_ctx);
+}
+
+static struct sysdb_attrs *make_rule(TALLOC_CTX *mem_ctx,
+                                     const char *name, time_t expire)
+{
+    struct sysdb_attrs *rule;
+    errno_t ret;
+
+    rule = sysdb_new_attrs(mem_ctx);
+    assert_non_null(rule);
+
+    ret = sysdb_attrs_add_string(rule, SYSDB_NAME, name);
+    assert_int_equal(ret, EOK);
+
+    ret = sysdb_attrs_add_time_t(rule, SYSDB_CACHE_EXPIRE, expire);
+    assert_int_equal(ret, EOK);
+
+    return rule;
+}
+
+/* Stores two rules the way the responder does and returns the expiration
+ * of the stored set */
+static time_t store_rules(const char *username, time_t expire1,
+                          time_t expire2)
+{
+    struct sysdb_attrs **rules;
+    time_t last_change;
+    time_t expire;
+    errno_t ret;
+
+    ret = sudosrv_cache_get_last_change(sudo_test_ctx->cache,
+                                        sudo_test_ctx->tctx->dom,
+                                        &last_change);
+    assert_int_equal(ret, EOK);
+
+    rules = talloc_array(NULL, struct sysdb_attrs *, 2);
+    assert_non_null(rules);
+    rules[0] = make_rule(rules, "rule1", expire1);
+    rules[1] = make_rule(rules, "rule2", expire2);
+
+    expire = time(NULL) + 1000;
+    sudosrv_cache_take_expire(rules, 2, &expire);
+
+    ret = sudosrv_cache_store(sudo_test_ctx->cache, sudo_test_ctx->tctx->dom,
+                              SSS_SUDO_USER, username, TEST_UID,
+                              sudo_test_ctx->groupnames, last_change, expire,
+                              rules, 2);
+    assert_int_equal(ret, EOK);
+
+    /* the cache must not depend on the rules of the caller */
+    talloc_free(rules);
+
+    return expire;
+}
+
+static errno_t lookup_rules(TALLOC_CTX *mem_ctx, const char *username,
+                            struct sysdb_attrs ***_rules,
+                            uint32_t *_num_rules)
+{
+    return sudosrv_cache_lookup(sudo_test_ctx->cache, mem_ctx,
+                                sudo_test_ctx->tctx->dom, SSS_SUDO_USER,
+                                username, TEST_UID,
+                                sudo_test_ctx->groupnames,
+                                _rules, _num_rules);
+}
+
+void test_sudo_cache_hit(void **state)
+{
+    struct sudosrv_cache_stats stats;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    const char *name;
+    TALLOC_CTX *tmp_ctx;
+    time_t now = time(NULL);
+    errno_t ret;
+
+    ret = lookup_rules(sudo_test_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, ENOENT);
+
+    store_rules(TEST_USER, now + 100, now + 200);
+
+    tmp_ctx = talloc_new(NULL);
+    assert_non_null(tmp_ctx);
+
+    ret = lookup_rules(tmp_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_rules, 2);
+    assert_true(talloc_parent(rules) == tmp_ctx);
+
+    ret = sysdb_attrs_get_string(rules[0], SYSDB_NAME, &name);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(name, "rule1");
+    ret = sysdb_attrs_get_string(rules[1], SYSDB_NAME, &name);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(name, "rule2");
+
+    /* the expiration is not sent to sudo */
+    ret = sysdb_attrs_get_string(rules[0], SYSDB_CACHE_EXPIRE, &name);
+    assert_int_equal(ret, ENOENT);
+
+    /* the caller owns what it got, the cached set stays intact */
+    talloc_free(tmp_ctx);
+
+    ret = lookup_rules(sudo_test_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_rules, 2);
+    ret = sysdb_attrs_get_string(rules[1], SYSDB_NAME, &name);
+    assert_int_equal(ret, EOK);
+    assert_string_equal(name, "rule2");
+    talloc_free(rules);
+
+    /* other users have rule sets of their own */
+    ret = lookup_rules(sudo_test_ctx, "otheruser", &rules, &num_rules);
+    assert_int_equal(ret, ENOENT);
+
+    sudosrv_cache_get_stats(sudo_test_ctx->cache, &stats);
+    assert_int_equal(stats.hits, 2);
+    assert_int_equal(stats.misses, 2);
+    assert_int_equal(stats.stores, 1);
+    assert_int_equal(stats.entries, 1);
+}
+
+void test_sudo_cache_invalidate(void **state)
+{
+    struct sudosrv_cache_stats stats;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    time_t now = time(NULL);
+    time_t last_change;
+    errno_t ret;
+
+    store_rules(TEST_USER, now + 100, now + 200);
+
+    ret = sudosrv_cache_get_last_change(sudo_test_ctx->cache,
+                                        sudo_test_ctx->tctx->dom,
+                                        &last_change);
+    assert_int_equal(ret, EOK);
+
+    /* the provider changed the rules, sudoLastChange moves */
+    ret = sysdb_sudo_mark_changed(sudo_test_ctx->tctx->sysdb,
+                                  sudo_test_ctx->tctx->dom);
+    assert_int_equal(ret, EOK);
+
+    ret = lookup_rules(sudo_test_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, ENOENT);
+
+    sudosrv_cache_get_stats(sudo_test_ctx->cache, &stats);
+    assert_int_equal(stats.invalidated, 1);
+    assert_int_equal(stats.entries, 0);
+
+    /* rules read before the change are not cached */
+    rules = talloc_array(sudo_test_ctx, struct sysdb_attrs *, 1);
+    assert_non_null(rules);
+    rules[0] = make_rule(rules, "rule1", now + 100);
+    ret = sudosrv_cache_store(sudo_test_ctx->cache, sudo_test_ctx->tctx->dom,
+                              SSS_SUDO_USER, TEST_USER, TEST_UID,
+                              sudo_test_ctx->groupnames, last_change,
+                              now + 100, rules, 1);
+    assert_int_equal(ret, EOK);
+    talloc_free(rules);
+
+    ret = lookup_rules(sudo_test_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, ENOENT);
+
+    /* a set read after the change is */
+    store_rules(TEST_USER, now + 100, now + 200);
+    ret = lookup_rules(sudo_test_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    talloc_free(rules);
+}
+
+void test_sudo_cache_expire(void **state)
+{
+    struct sudosrv_cache_stats stats;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    time_t now = time(NULL);
+    time_t expire;
+    errno_t ret;
+
+    /* the set expires with its first rule */
+    expire = store_rules(TEST_USER, now + 100, now + 2);
+    assert_int_equal(expire, now + 2);
+
+    ret = lookup_rules(sudo_test_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    talloc_free(rules);
+
+    sleep(3);
+
+    ret = lookup_rules(sudo_test_ctx, TEST_USER, &rules, &num_rules);
+    assert_int_equal(ret, ENOENT);
+
+    sudosrv_cache_get_stats(sudo_test_ctx->cache, &stats);
+    assert_int_equal(stats.expired, 1);
+    assert_int_equal(stats.entries, 0);
+}
+
+void test_sudo_cache_max_entries(void **state)
+{
+    struct sudosrv_cache_stats stats;
+    struct sysdb_attrs **rules;
+    uint32_t num_rules;
+    time_t last_change;
+    char name[32];
+    errno_t ret;
+    int i;
+
+    ret = sudosrv_cache_get_last_change(sudo_test_ctx->cache,
+                                        sudo_test_ctx->tctx->dom,
+                                        &last_change);
+    assert_int_equal(ret, EOK);
+
+    for (i = 0; i < SUDO_CACHE_MAX_ENTRIES; i++) {
+        snprintf(name, sizeof(name), "user%d", i);
+        ret = sudosrv_cache_store(sudo_test_ctx->cache,
+                                  sudo_test_ctx->tctx->dom,
+                                  SSS_SUDO_USER, name, TEST_UID + i,
+                                  NULL, last_change, time(NULL) + 100,
+                                  NULL, 0);
+        assert_int_equal(ret, EOK);
+    }
+
+    /* user0 was used recently, user1 is the least recently used set */
+    ret = sudosrv_cache_lookup(sudo_test_ctx->cache, sudo_test_ctx,
+                               sudo_test_ctx->tctx->dom, SSS_SUDO_USER,
+                               "user0", TEST_UID, NULL,
+                               &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+    assert_int_equal(num_rules, 0);
+
+    /* a new set still fits, it takes the place of user1 */
+    snprintf(name, sizeof(name), "user%d", SUDO_CACHE_MAX_ENTRIES);
+    ret = sudosrv_cache_store(sudo_test_ctx->cache,
+                              sudo_test_ctx->tctx->dom,
+                              SSS_SUDO_USER, name,
+                              TEST_UID + SUDO_CACHE_MAX_ENTRIES,
+                              NULL, last_change, time(NULL) + 100,
+                              NULL, 0);
+    assert_int_equal(ret, EOK);
+
+    sudosrv_cache_get_stats(sudo_test_ctx->cache, &stats);
+    assert_int_equal(stats.entries, SUDO_CACHE_MAX_ENTRIES);
+    assert_int_equal(stats.stores, SUDO_CACHE_MAX_ENTRIES + 1);
+    assert_int_equal(stats.evicted, 1);
+
+    ret = sudosrv_cache_lookup(sudo_test_ctx->cache, sudo_test_ctx,
+                               sudo_test_ctx->tctx->dom, SSS_SUDO_USER,
+                               name, TEST_UID + SUDO_CACHE_MAX_ENTRIES, NULL,
+                               &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+
+    ret = sudosrv_cache_lookup(sudo_test_ctx->cache, sudo_test_ctx,
+                               sudo_test_ctx->tctx->dom, SSS_SUDO_USER,
+                               "user0", TEST_UID, NULL,
+                               &rules, &num_rules);
+    assert_int_equal(ret, EOK);
+
+    ret = sudosrv_cache_lookup(sudo_test_ctx->cache, sudo_test_ctx,
+                               sudo_test_ctx->tctx->dom, SSS_SUDO_USER,
+                               "user1", TEST_UID + 1, NULL,
+                               &rules, &num_rules);
+    assert_int_equal(ret, ENOENT);
+}
+
+int main(int argc, const char *argv[])
+{
+    int rv;
+    int no_cleanup = 0;
+    poptContext pc;
+    int opt;
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_DEBUG_OPTS
+        {"no-cleanup", 'n', POPT_ARG_NONE, &no_cleanup, 0,
+         _("Do not delete the test database after a test run"), NULL },
+        POPT_TABLEEND
+    };
+
+    const UnitTest tests[] = {
+        unit_test_setup_teardown(test_sudo_cache_hit,
+                                 sudo_cache_test_setup,
+                                 sudo_cache_test_teardown),
+        unit_test_setup_teardown(test_sudo_cache_invalidate,
+                                 sudo_cache_test_setup,
+                                 sudo_cache_test_teardown),
+        unit_test_setup_teardown(test_sudo_cache_expire,
+                                 sudo_cache_test_setup,
+                                 sudo_cache_test_teardown),
+        unit_test_setup_teardown(test_sudo_cache_max_entries,
+                                 sudo_cache_test_setup,
+                                 sudo_cache_test_teardown),
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    /* Even though normally the tests should clean up after themselves
+     * they might not after a failed run. Remove the old db to be sure */
+    tests_set_cwd();
+    test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    test_dom_suite_setup(TESTS_PATH);
+
+    rv = run_tests(tests);
+    if (rv == 0 && !no_cleanup) {
+        test_dom_suite_cleanup(TESTS_PATH, TEST_CONF_DB, TEST_SYSDB_FILE);
+    }
+    return rv;
+}
@@ -122,6 +122,31 @@ START_TEST(test_hmac_sha1)
 }
 END_TEST
 
+START_TEST(test_sha1)
+{
+    const char *messages[] = {
+        "",
+        "abc",
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+        NULL };
+    const char *results[] = {
+        "\xda\x39\xa3\xee\x5e\x6b\x4b\x0d\x32\x55\xbf\xef\x95\x60\x18\x90\xaf\xd8\x07\x09",
+        "\xa9\x99\x3e\x36\x47\x06\x81\x6a\xba\x3e\x25\x71\x78\x50\xc2\x6c\x9c\xd0\xd8\x9d",
+        "\x84\x98\x3e\x44\x1c\x3b\xd2\x6e\xba\xae\x4a\xa1\xf9\x51\x29\xe5\xe5\x46\x70\xf1",
+        NULL };
+    unsigned char out[SSS_SHA1_LENGTH];
+    int ret;
+    int i;
+
+    for (i = 0; messages[i]; i++) {
+        ret = sss_sha1((const unsigned char *)messages[i], strlen(messages[i]),
+                       out);
+        fail_if(ret != EOK);
+        fail_if(memcmp(out, results[i], SSS_SHA1_LENGTH) != 0);
+    }
+}
+END_TEST
+
 START_TEST(test_base64_encode)
 {
     const unsigned char obfbuf[] = "test";
@@ -170,6 +195,7 @@ Suite *crypto_suite(void)
 #endif
     tcase_add_test(tc, test_encrypt_decrypt);
     tcase_add_test(tc, test_hmac_sha1);
+    tcase_add_test(tc, test_sha1);
     tcase_add_test(tc, test_base64_encode);
     tcase_add_test(tc, test_base64_decode);
     /* Add all test cases to the test suite */
@@ -0,0 +1,218 @@
+/*
+   SSSD
+
+   HBAC evaluation benchmark
+
+   Builds many rules that each allow one user group and a request that
+   matches the last one, then evaluates the request with hbac_evaluate()
+   and with a compiled rule set and compares the time needed.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <talloc.h>
+#include <popt.h>
+
+#include "providers/ipa/ipa_hbac.h"
+
+#define DEFAULT_RULES  2000
+#define DEFAULT_ROUNDS 200
+
+static double elapsed_sec(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+           (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static struct hbac_rule_element *all_element(TALLOC_CTX *mem_ctx)
+{
+    struct hbac_rule_element *el;
+
+    el = talloc_zero(mem_ctx, struct hbac_rule_element);
+    if (el) el->category = HBAC_CATEGORY_ALL;
+    return el;
+}
+
+static struct hbac_request_element *req_element(TALLOC_CTX *mem_ctx,
+                                                const char *name,
+                                                const char *group)
+{
+    struct hbac_request_element *el;
+
+    el = talloc_zero(mem_ctx, struct hbac_request_element);
+    if (!el) return NULL;
+
+    el->name = name;
+    el->groups = talloc_array(el, const char *, 2);
+    if (!el->groups) return NULL;
+    el->groups[0] = group;
+    el->groups[1] = NULL;
+
+    return el;
+}
+
+/* rule i allows the members of Group<i> everything */
+static struct hbac_rule **bench_rules(TALLOC_CTX *mem_ctx, int num_rules)
+{
+    struct hbac_rule **rules;
+    struct hbac_rule *rule;
+    int i;
+
+    rules = talloc_array(mem_ctx, struct hbac_rule *, num_rules + 1);
+    if (!rules) return NULL;
+
+    for (i = 0; i < num_rules; i++) {
+        rule = talloc_zero(rules, struct hbac_rule);
+        if (!rule) return NULL;
+
+        rule->enabled = true;
+        rule->name = talloc_asprintf(rule, "rule%d", i);
+        rule->users = talloc_zero(rule, struct hbac_rule_element);
+        rule->services = all_element(rule);
+        rule->targethosts = all_element(rule);
+        rule->srchosts = all_element(rule);
+        if (!rule->name || !rule->users || !rule->services ||
+            !rule->targethosts || !rule->srchosts) {
+            return NULL;
+        }
+
+        rule->users->category = HBAC_CATEGORY_NULL;
+        rule->users->groups = talloc_array(rule->users, const char *, 2);
+        if (!rule->users->groups) return NULL;
+        rule->users->groups[0] = talloc_asprintf(rule->users, "Group%d", i);
+        if (!rule->users->groups[0]) return NULL;
+        rule->users->groups[1] = NULL;
+
+        rules[i] = rule;
+    }
+    rules[i] = NULL;
+
+    return rules;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_rules = DEFAULT_RULES;
+    int pc_rounds = DEFAULT_ROUNDS;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+    struct hbac_compiled_rules *compiled;
+    struct hbac_info *info;
+    enum hbac_eval_result result;
+    enum hbac_error_code code;
+    struct timeval start;
+    double linear_sec, compile_sec, compiled_sec;
+    const char *last;
+    TALLOC_CTX *ctx;
+    int i;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "rules", 'n', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_rules, 0, "Number of rules", NULL },
+        { "rounds", 'r', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_rounds, 0, "How often the request is evaluated",
+                    NULL },
+        POPT_TABLEEND
+    };
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                poptBadOption(pc, 0), poptStrerror(opt));
+        poptPrintUsage(pc, stderr, 0);
+        return 1;
+    }
+    poptFreeContext(pc);
+
+    if (pc_rules <= 0 || pc_rounds <= 0) {
+        fprintf(stderr, "invalid number of rules or rounds\n");
+        return 1;
+    }
+
+    ctx = talloc_new(NULL);
+    if (!ctx) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    rules = bench_rules(ctx, pc_rules);
+    eval_req = talloc_zero(ctx, struct hbac_eval_req);
+    last = talloc_asprintf(ctx, "group%d", pc_rules - 1);
+    if (!rules || !eval_req || !last) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    eval_req->user = req_element(eval_req, "testuser", last);
+    eval_req->service = req_element(eval_req, "testservice", "login_services");
+    eval_req->srchost = req_element(eval_req, "client.example.com",
+                                    "site_hosts");
+    if (!eval_req->user || !eval_req->service || !eval_req->srchost) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < pc_rounds; i++) {
+        result = hbac_evaluate(rules, eval_req, &info);
+        hbac_free_info(info);
+        if (result != HBAC_EVAL_ALLOW) {
+            fprintf(stderr, "Linear evaluation returned [%s]\n",
+                    hbac_result_string(result));
+            return 1;
+        }
+    }
+    linear_sec = elapsed_sec(&start);
+
+    gettimeofday(&start, NULL);
+    code = hbac_compile_rules(rules, &compiled);
+    if (code != HBAC_SUCCESS) {
+        fprintf(stderr, "Could not compile rules: %s\n",
+                hbac_error_string(code));
+        return 1;
+    }
+    compile_sec = elapsed_sec(&start);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < pc_rounds; i++) {
+        result = hbac_evaluate_compiled(compiled, eval_req, &info);
+        if (result != HBAC_EVAL_ALLOW ||
+            strcmp(info->rule_name, rules[pc_rules - 1]->name) != 0) {
+            fprintf(stderr, "Compiled evaluation returned [%s]\n",
+                    hbac_result_string(result));
+            return 1;
+        }
+        hbac_free_info(info);
+    }
+    compiled_sec = elapsed_sec(&start);
+
+    printf("%d rules, evaluated %d times\n", pc_rules, pc_rounds);
+    printf("mode        time(s)\n");
+    printf("linear    %9.3f\n", linear_sec);
+    printf("compiled  %9.3f (+%.3f to compile)\n", compiled_sec, compile_sec);
+
+    hbac_free_compiled_rules(compiled);
+    talloc_free(ctx);
+    return 0;
+}
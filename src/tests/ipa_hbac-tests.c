@@ -63,6 +63,8 @@ const uint8_t service_utf8_upcase[] = { 'M', 0xC3, 0x9C, 'N', 'C', 'H', 'E', 'N'
 /* Greek - "AlphaBetaGamma" */
 const uint8_t srchost_utf8_lowcase[] = { 0xCE, 0xB1, 0xCE, 0xB2, 0xCE, 0xB3, 0x0  };
 const uint8_t srchost_utf8_upcase[] = { 0xCE, 0x91, 0xCE, 0x92, 0xCE, 0x93, 0x0 };
+/* Truncated sequence followed by a byte that never occurs in UTF-8 */
+const uint8_t service_invalid_utf8[] = { 's', 0xC3, 0xFF, 'v', 0x0 };
 /* Turkish "capital I" and "dotless i" */
 const uint8_t user_lowcase_tr[] = { 0xC4, 0xB1, 0x0 };
 const uint8_t user_upcase_tr[] = { 0x49, 0x0 };
@@ -809,6 +811,215 @@ START_TEST(ipa_hbac_test_incomplete)
 }
 END_TEST
 
+START_TEST(ipa_hbac_test_compiled)
+{
+    enum hbac_eval_result result;
+    enum hbac_error_code code;
+    TALLOC_CTX *test_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+    struct hbac_compiled_rules *compiled;
+    struct hbac_info *info;
+
+    test_ctx = talloc_new(global_talloc_context);
+
+    /* Create a request */
+    eval_req = talloc_zero(test_ctx, struct hbac_eval_req);
+    fail_if (eval_req == NULL);
+
+    get_test_user(eval_req, &eval_req->user);
+    get_test_service(eval_req, &eval_req->service);
+    get_test_srchost(eval_req, &eval_req->srchost);
+    eval_req->user->name = (const char *) &user_utf8_lowcase;
+
+    /* A disabled rule, a rule for another group and a rule for the user */
+    rules = talloc_array(test_ctx, struct hbac_rule *, 5);
+    fail_if (rules == NULL);
+
+    get_allow_all_rule(rules, &rules[0]);
+    rules[0]->name = talloc_strdup(rules[0], "Disabled");
+    fail_if(rules[0]->name == NULL);
+    rules[0]->enabled = false;
+
+    get_allow_all_rule(rules, &rules[1]);
+    rules[1]->name = talloc_strdup(rules[1], "Allow group");
+    fail_if(rules[1]->name == NULL);
+    rules[1]->users->category = HBAC_CATEGORY_NULL;
+    rules[1]->users->groups = talloc_array(rules[1], const char *, 2);
+    fail_if(rules[1]->users->groups == NULL);
+    rules[1]->users->groups[0] = HBAC_TEST_INVALID_GROUP;
+    rules[1]->users->groups[1] = NULL;
+
+    get_allow_all_rule(rules, &rules[2]);
+    rules[2]->name = talloc_strdup(rules[2], "Allow user");
+    fail_if(rules[2]->name == NULL);
+    rules[2]->users->category = HBAC_CATEGORY_NULL;
+    rules[2]->users->names = talloc_array(rules[2], const char *, 2);
+    fail_if(rules[2]->users->names == NULL);
+    rules[2]->users->names[0] = (const char *) &user_utf8_upcase;
+    rules[2]->users->names[1] = NULL;
+
+    /* Incomplete, but never reached */
+    rules[3] = talloc_zero(rules, struct hbac_rule);
+    fail_if(rules[3] == NULL);
+    rules[3]->name = talloc_strdup(rules[3], "Incomplete");
+    fail_if(rules[3]->name == NULL);
+    rules[3]->enabled = true;
+
+    rules[4] = NULL;
+
+    code = hbac_compile_rules(rules, &compiled);
+    fail_unless(code == HBAC_SUCCESS,
+                "Could not compile rules: [%s]", hbac_error_string(code));
+
+    result = hbac_evaluate_compiled(compiled, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_ALLOW,
+                "Expected [%s], got [%s]; "
+                "Error: [%s]",
+                hbac_result_string(HBAC_EVAL_ALLOW),
+                hbac_result_string(result),
+                info ? hbac_error_string(info->code):"Unknown");
+    fail_unless(strcmp(info->rule_name, "Allow user") == 0,
+                "Expected rule [Allow user], got [%s]", info->rule_name);
+    hbac_free_info(info);
+
+    /* Another user only reaches the incomplete rule */
+    eval_req->user->name = (const char *) &user_utf8_lowcase_neg;
+
+    result = hbac_evaluate_compiled(compiled, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_ERROR,
+                "Expected [%s], got [%s]",
+                hbac_result_string(HBAC_EVAL_ERROR),
+                hbac_result_string(result));
+    fail_unless(info->code == HBAC_ERROR_UNPARSEABLE_RULE);
+    fail_unless(strcmp(info->rule_name, "Incomplete") == 0,
+                "Expected rule [Incomplete], got [%s]", info->rule_name);
+    hbac_free_info(info);
+
+    /* Same results as the linear evaluation */
+    result = hbac_evaluate(rules, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_ERROR);
+    hbac_free_info(info);
+
+    rules[3] = NULL;
+    hbac_free_compiled_rules(compiled);
+
+    code = hbac_compile_rules(rules, &compiled);
+    fail_unless(code == HBAC_SUCCESS);
+
+    result = hbac_evaluate_compiled(compiled, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_DENY,
+                "Expected [%s], got [%s]",
+                hbac_result_string(HBAC_EVAL_DENY),
+                hbac_result_string(result));
+    hbac_free_info(info);
+
+    hbac_free_compiled_rules(compiled);
+    talloc_free(test_ctx);
+}
+END_TEST
+
+/* A rule element that is not valid UTF-8 only fails the evaluation when it
+ * is compared, like in hbac_evaluate() */
+START_TEST(ipa_hbac_test_compiled_invalid_utf8)
+{
+    enum hbac_eval_result result;
+    enum hbac_eval_result linear;
+    enum hbac_error_code code;
+    TALLOC_CTX *test_ctx;
+    struct hbac_rule **rules;
+    struct hbac_eval_req *eval_req;
+    struct hbac_compiled_rules *compiled;
+    struct hbac_info *info;
+
+    test_ctx = talloc_new(global_talloc_context);
+
+    /* Create a request */
+    eval_req = talloc_zero(test_ctx, struct hbac_eval_req);
+    fail_if (eval_req == NULL);
+
+    get_test_user(eval_req, &eval_req->user);
+    get_test_service(eval_req, &eval_req->service);
+    get_test_srchost(eval_req, &eval_req->srchost);
+
+    /* A rule for another user with an invalid service name, followed by a
+     * rule for the user */
+    rules = talloc_array(test_ctx, struct hbac_rule *, 3);
+    fail_if (rules == NULL);
+
+    get_allow_all_rule(rules, &rules[0]);
+    rules[0]->name = talloc_strdup(rules[0], "Invalid service");
+    fail_if(rules[0]->name == NULL);
+    rules[0]->users->category = HBAC_CATEGORY_NULL;
+    rules[0]->users->names = talloc_array(rules[0], const char *, 2);
+    fail_if(rules[0]->users->names == NULL);
+    rules[0]->users->names[0] = HBAC_TEST_INVALID_USER;
+    rules[0]->users->names[1] = NULL;
+    rules[0]->services->category = HBAC_CATEGORY_NULL;
+    rules[0]->services->names = talloc_array(rules[0], const char *, 3);
+    fail_if(rules[0]->services->names == NULL);
+    rules[0]->services->names[0] = (const char *) &service_invalid_utf8;
+    rules[0]->services->names[1] = HBAC_TEST_INVALID_SERVICE;
+    rules[0]->services->names[2] = NULL;
+
+    get_allow_all_rule(rules, &rules[1]);
+    rules[1]->name = talloc_strdup(rules[1], "Allow user");
+    fail_if(rules[1]->name == NULL);
+    rules[1]->users->category = HBAC_CATEGORY_NULL;
+    rules[1]->users->names = talloc_array(rules[1], const char *, 2);
+    fail_if(rules[1]->users->names == NULL);
+    rules[1]->users->names[0] = HBAC_TEST_USER;
+    rules[1]->users->names[1] = NULL;
+
+    rules[2] = NULL;
+
+    code = hbac_compile_rules(rules, &compiled);
+    fail_unless(code == HBAC_SUCCESS,
+                "Could not compile rules: [%s]", hbac_error_string(code));
+
+    /* The user does not match the first rule, its services are never
+     * compared */
+    result = hbac_evaluate_compiled(compiled, eval_req, &info);
+    fail_unless(result == HBAC_EVAL_ALLOW,
+                "Expected [%s], got [%s]; "
+                "Error: [%s]",
+                hbac_result_string(HBAC_EVAL_ALLOW),
+                hbac_result_string(result),
+                info ? hbac_error_string(info->code):"Unknown");
+    fail_unless(strcmp(info->rule_name, "Allow user") == 0,
+                "Expected rule [Allow user], got [%s]", info->rule_name);
+    hbac_free_info(info);
+
+    linear = hbac_evaluate(rules, eval_req, &info);
+    fail_unless(linear == result);
+    hbac_free_info(info);
+
+    /* Now the services of the first rule are compared with the request */
+    rules[0]->users->names[0] = HBAC_TEST_USER;
+    hbac_free_compiled_rules(compiled);
+
+    code = hbac_compile_rules(rules, &compiled);
+    fail_unless(code == HBAC_SUCCESS);
+
+    result = hbac_evaluate_compiled(compiled, eval_req, &info);
+    linear = hbac_evaluate(rules, eval_req, NULL);
+    fail_unless(result == linear,
+                "Expected [%s], got [%s]",
+                hbac_result_string(linear),
+                hbac_result_string(result));
+    if (result != HBAC_EVAL_DENY) {
+        fail_unless(strcmp(info->rule_name, result == HBAC_EVAL_ERROR ?
+                                            "Invalid service" :
+                                            "Allow user") == 0,
+                    "Unexpected rule [%s]", info->rule_name);
+    }
+    hbac_free_info(info);
+
+    hbac_free_compiled_rules(compiled);
+    talloc_free(test_ctx);
+}
+END_TEST
+
 Suite *hbac_test_suite (void)
 {
     Suite *s = suite_create ("HBAC");
@@ -827,6 +1038,8 @@ Suite *hbac_test_suite (void)
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_srchostgroup);
     tcase_add_test(tc_hbac, ipa_hbac_test_allow_utf8);
     tcase_add_test(tc_hbac, ipa_hbac_test_incomplete);
+    tcase_add_test(tc_hbac, ipa_hbac_test_compiled);
+    tcase_add_test(tc_hbac, ipa_hbac_test_compiled_invalid_utf8);
 
     suite_add_tcase(s, tc_hbac);
     return s;
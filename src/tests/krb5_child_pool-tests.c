@@ -0,0 +1,587 @@
+/*
+    SSSD
+
+    Kerberos 5 Backend Module -- Tests of the persistent krb5_child pool
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <popt.h>
+#include <check.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "util/util.h"
+#include "util/child_common.h"
+#include "tests/common.h"
+#include "providers/krb5/krb5_auth.h"
+#include "providers/krb5/krb5_common.h"
+
+/* KRB5_CHILD_DIR is set to this directory for the test, the krb5_child in
+ * there is a link to the test itself */
+#define TESTS_PATH "tests_krb5_child_pool"
+#define TEST_KRB5_CHILD TESTS_PATH"/krb5_child"
+#define TEST_HANG_PID_FILE TESTS_PATH"/hang.pid"
+
+/* the uid of a request selects what the fake krb5_child does */
+#define TEST_UID_ECHO 1000
+#define TEST_UID_SPLIT 1001
+#define TEST_UID_HANG 1002
+
+extern struct dp_option default_krb5_opts[];
+
+/* Stands in for a persistent krb5_child. The reply to a request is the
+ * pid of the worker and the uid of the request. */
+static int fake_krb5_child(void)
+{
+    uint8_t frame[3*sizeof(uint32_t)];
+    uint32_t reply[2];
+    uint32_t frame_len;
+    bool run_as_user;
+    uint8_t *buf;
+    size_t len;
+    uint32_t uid;
+    FILE *f;
+    pid_t pid;
+    size_t i;
+    errno_t ret;
+
+    while (1) {
+        ret = k5c_recv_frame(NULL, STDIN_FILENO, &buf, &len, &run_as_user);
+        if (ret == ENOENT) {
+            return 0;
+        } else if (ret != EOK || len < 2*sizeof(uint32_t)) {
+            return 1;
+        }
+
+        /* the request starts with the command and the uid */
+        memcpy(&uid, buf + sizeof(uint32_t), sizeof(uint32_t));
+        talloc_free(buf);
+
+        reply[0] = getpid();
+        reply[1] = uid;
+
+        switch (uid) {
+        case TEST_UID_HANG:
+            /* like in krb5_child the request is handled by a copy of the
+             * worker, this one never finishes */
+            pid = fork();
+            if (pid == 0) {
+                f = fopen(TEST_HANG_PID_FILE".tmp", "w");
+                if (f != NULL) {
+                    fprintf(f, "%d\n", (int) getpid());
+                    fclose(f);
+                    rename(TEST_HANG_PID_FILE".tmp", TEST_HANG_PID_FILE);
+                }
+                while (1) pause();
+            }
+            waitpid(pid, NULL, 0);
+            return 1;
+        case TEST_UID_SPLIT:
+            /* the reply arrives byte by byte */
+            frame_len = sizeof(reply);
+            memcpy(frame, &frame_len, sizeof(uint32_t));
+            memcpy(frame + sizeof(uint32_t), reply, sizeof(reply));
+            for (i = 0; i < sizeof(frame); i++) {
+                if (sss_atomic_write_s(STDOUT_FILENO, frame + i, 1) != 1) {
+                    return 1;
+                }
+                usleep(10000);
+            }
+            break;
+        default:
+            ret = k5c_send_frame(STDOUT_FILENO, (uint8_t *) reply,
+                                 sizeof(reply));
+            if (ret != EOK) {
+                return 1;
+            }
+        }
+    }
+}
+
+/* The frame codec of krb5_child */
+
+static errno_t recv_frame_from(const void *data, size_t size,
+                               uint8_t **_buf, size_t *_len,
+                               bool *_run_as_user)
+{
+    int pipefd[2];
+    ssize_t written;
+    errno_t ret;
+
+    ret = pipe(pipefd);
+    fail_unless(ret == 0, "pipe failed");
+
+    if (size > 0) {
+        written = sss_atomic_write_s(pipefd[1], discard_const(data), size);
+        fail_unless(written == size, "write failed");
+    }
+    close(pipefd[1]);
+
+    ret = k5c_recv_frame(global_talloc_context, pipefd[0],
+                         _buf, _len, _run_as_user);
+    close(pipefd[0]);
+
+    return ret;
+}
+
+START_TEST(test_recv_frame)
+{
+    uint8_t data[2*sizeof(uint32_t) + 3];
+    uint32_t header[2];
+    bool run_as_user = false;
+    uint8_t *buf = NULL;
+    size_t len = 0;
+    errno_t ret;
+
+    header[0] = sizeof(uint32_t) + 3;
+    header[1] = 1;
+    memcpy(data, header, sizeof(header));
+    memcpy(data + sizeof(header), "abc", 3);
+
+    ret = recv_frame_from(data, sizeof(data), &buf, &len, &run_as_user);
+    fail_unless(ret == EOK, "k5c_recv_frame failed [%d]", ret);
+    fail_unless(len == 3, "Wrong length [%zu]", len);
+    fail_unless(memcmp(buf, "abc", 3) == 0, "Wrong data");
+    fail_unless(run_as_user, "run_as_user not set");
+    talloc_free(buf);
+
+    /* the backend closed the pipe */
+    ret = recv_frame_from(NULL, 0, &buf, &len, &run_as_user);
+    fail_unless(ret == ENOENT, "Expected ENOENT, got [%d]", ret);
+
+    /* the pipe was closed in the middle of a frame */
+    ret = recv_frame_from(data, sizeof(uint32_t), &buf, &len, &run_as_user);
+    fail_unless(ret == EIO, "Expected EIO, got [%d]", ret);
+
+    ret = recv_frame_from(data, sizeof(data) - 1,
+                          &buf, &len, &run_as_user);
+    fail_unless(ret == EIO, "Expected EIO, got [%d]", ret);
+
+    /* the length has to cover the flag */
+    header[0] = sizeof(uint32_t) - 1;
+    ret = recv_frame_from(header, sizeof(header), &buf, &len, &run_as_user);
+    fail_unless(ret == EINVAL, "Expected EINVAL, got [%d]", ret);
+
+    /* and must not be larger than what krb5_child accepts */
+    header[0] = sizeof(uint32_t) + IN_BUF_SIZE + 1;
+    ret = recv_frame_from(header, sizeof(header), &buf, &len, &run_as_user);
+    fail_unless(ret == EINVAL, "Expected EINVAL, got [%d]", ret);
+}
+END_TEST
+
+START_TEST(test_send_frame)
+{
+    uint8_t data[sizeof(uint32_t) + 3];
+    uint32_t frame_len;
+    int pipefd[2];
+    ssize_t len;
+    errno_t ret;
+
+    ret = pipe(pipefd);
+    fail_unless(ret == 0, "pipe failed");
+
+    ret = k5c_send_frame(pipefd[1], (uint8_t *) "abc", 3);
+    fail_unless(ret == EOK, "k5c_send_frame failed [%d]", ret);
+
+    /* an empty reply is just the length */
+    ret = k5c_send_frame(pipefd[1], NULL, 0);
+    fail_unless(ret == EOK, "k5c_send_frame failed [%d]", ret);
+    close(pipefd[1]);
+
+    len = sss_atomic_read_s(pipefd[0], data, sizeof(data));
+    fail_unless(len == sizeof(data), "read failed");
+    memcpy(&frame_len, data, sizeof(uint32_t));
+    fail_unless(frame_len == 3, "Wrong length [%u]", frame_len);
+    fail_unless(memcmp(data + sizeof(uint32_t), "abc", 3) == 0,
+                "Wrong data");
+
+    len = sss_atomic_read_s(pipefd[0], &frame_len, sizeof(uint32_t));
+    fail_unless(len == sizeof(uint32_t), "read failed");
+    fail_unless(frame_len == 0, "Wrong length [%u]", frame_len);
+
+    len = sss_atomic_read_s(pipefd[0], data, sizeof(data));
+    fail_unless(len == 0, "Unexpected data after the frames");
+    close(pipefd[0]);
+}
+END_TEST
+
+/* The pool of persistent krb5_child processes */
+
+struct pool_test_ctx {
+    struct tevent_context *ev;
+    struct krb5_ctx *krb5_ctx;
+};
+
+struct pool_test_req {
+    bool done;
+    int error;
+    uint32_t pid;
+    uint32_t uid;
+};
+
+static struct pool_test_ctx *pool_test_setup(int pool_size, int timeout)
+{
+    struct pool_test_ctx *test_ctx;
+    struct krb5_ctx *krb5_ctx;
+    errno_t ret;
+
+    test_ctx = talloc_zero(global_talloc_context, struct pool_test_ctx);
+    fail_if(test_ctx == NULL, "Out of memory");
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    fail_if(test_ctx->ev == NULL, "tevent_context_init failed");
+
+    krb5_ctx = talloc_zero(test_ctx, struct krb5_ctx);
+    fail_if(krb5_ctx == NULL, "Out of memory");
+    krb5_ctx->child_debug_fd = -1;
+
+    ret = dp_copy_options(krb5_ctx, default_krb5_opts, KRB5_OPTS,
+                          &krb5_ctx->opts);
+    fail_unless(ret == EOK, "dp_copy_options failed [%d]", ret);
+
+    ret = dp_opt_set_string(krb5_ctx->opts, KRB5_KEYTAB, "/dev/null");
+    fail_unless(ret == EOK, "dp_opt_set_string failed [%d]", ret);
+    ret = dp_opt_set_int(krb5_ctx->opts, KRB5_AUTH_TIMEOUT, timeout);
+    fail_unless(ret == EOK, "dp_opt_set_int failed [%d]", ret);
+    ret = dp_opt_set_int(krb5_ctx->opts, KRB5_CHILD_POOL_SIZE, pool_size);
+    fail_unless(ret == EOK, "dp_opt_set_int failed [%d]", ret);
+
+    test_ctx->krb5_ctx = krb5_ctx;
+
+    unlink(TEST_HANG_PID_FILE);
+
+    return test_ctx;
+}
+
+static void pool_test_teardown(struct pool_test_ctx *test_ctx)
+{
+    /* closes the pipes, the workers exit */
+    talloc_free(test_ctx);
+
+    unlink(TEST_HANG_PID_FILE);
+}
+
+static void pool_test_done(struct tevent_req *req)
+{
+    struct pool_test_req *preq = tevent_req_callback_data(req,
+                                                       struct pool_test_req);
+    uint8_t *buf;
+    ssize_t len;
+
+    preq->done = true;
+    preq->error = handle_child_recv(req, preq, &buf, &len);
+    talloc_free(req);
+    if (preq->error != EOK) {
+        return;
+    }
+
+    if (len != 2*sizeof(uint32_t)) {
+        preq->error = EBADMSG;
+        return;
+    }
+    memcpy(&preq->pid, buf, sizeof(uint32_t));
+    memcpy(&preq->uid, buf + sizeof(uint32_t), sizeof(uint32_t));
+}
+
+static struct pool_test_req *pool_test_send(struct pool_test_ctx *test_ctx,
+                                            uid_t uid)
+{
+    struct pool_test_req *preq;
+    struct krb5child_req *kr;
+    struct tevent_req *req;
+
+    preq = talloc_zero(test_ctx, struct pool_test_req);
+    fail_if(preq == NULL, "Out of memory");
+
+    kr = talloc_zero(preq, struct krb5child_req);
+    fail_if(kr == NULL, "Out of memory");
+    kr->pd = talloc_zero(kr, struct pam_data);
+    fail_if(kr->pd == NULL, "Out of memory");
+
+    kr->pd->cmd = SSS_PAM_ACCT_MGMT;
+    kr->pd->user = talloc_strdup(kr->pd, "pool_user");
+    kr->upn = talloc_strdup(kr, "pool_user@POOL.TEST");
+    fail_if(kr->pd->user == NULL || kr->upn == NULL, "Out of memory");
+    kr->uid = uid;
+    kr->gid = uid;
+    kr->krb5_ctx = test_ctx->krb5_ctx;
+
+    req = handle_child_send(preq, test_ctx->ev, kr);
+    fail_if(req == NULL, "handle_child_send failed");
+    tevent_req_set_callback(req, pool_test_done, preq);
+
+    return preq;
+}
+
+static void pool_test_timeout(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt)
+{
+    bool *timed_out = (bool *)pvt;
+
+    *timed_out = true;
+}
+
+static void pool_test_wait(struct pool_test_ctx *test_ctx,
+                           struct pool_test_req *preq)
+{
+    struct tevent_timer *te;
+    bool timed_out = false;
+
+    te = tevent_add_timer(test_ctx->ev, test_ctx,
+                          tevent_timeval_current_ofs(5, 0),
+                          pool_test_timeout, &timed_out);
+    fail_if(te == NULL, "tevent_add_timer failed");
+
+    while (!preq->done && !timed_out) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    talloc_free(te);
+
+    fail_if(timed_out, "Timed out waiting for krb5_child");
+}
+
+/* A killed process might linger as a zombie if nobody reaps it */
+static bool process_gone(pid_t pid)
+{
+    char path[64];
+    char state = 0;
+    FILE *f;
+    int ret;
+
+    ret = kill(pid, 0);
+    if (ret == -1 && errno == ESRCH) {
+        return true;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+    f = fopen(path, "r");
+    if (f == NULL) {
+        return true;
+    }
+    ret = fscanf(f, "%*d %*s %c", &state);
+    fclose(f);
+
+    return ret == 1 && state == 'Z';
+}
+
+static void wait_process_gone(pid_t pid)
+{
+    int i;
+
+    for (i = 0; i < 500 && !process_gone(pid); i++) {
+        usleep(10000);
+    }
+
+    fail_unless(process_gone(pid), "Process [%d] still running", (int) pid);
+}
+
+START_TEST(test_pool_reuse)
+{
+    struct pool_test_ctx *test_ctx;
+    struct pool_test_req *preq[4];
+    int i;
+
+    test_ctx = pool_test_setup(1, 5);
+
+    preq[0] = pool_test_send(test_ctx, TEST_UID_ECHO);
+    pool_test_wait(test_ctx, preq[0]);
+    fail_unless(preq[0]->error == EOK, "Request failed [%d]", preq[0]->error);
+    fail_unless(preq[0]->uid == TEST_UID_ECHO, "Wrong reply");
+
+    /* the same worker serves the next request */
+    preq[1] = pool_test_send(test_ctx, TEST_UID_ECHO);
+    pool_test_wait(test_ctx, preq[1]);
+    fail_unless(preq[1]->error == EOK, "Request failed [%d]", preq[1]->error);
+    fail_unless(preq[1]->pid == preq[0]->pid,
+                "Worker not reused [%u][%u]", preq[0]->pid, preq[1]->pid);
+
+    /* requests arriving while the only worker is busy wait for it */
+    preq[2] = pool_test_send(test_ctx, TEST_UID_ECHO);
+    preq[3] = pool_test_send(test_ctx, TEST_UID_ECHO + 1);
+    pool_test_wait(test_ctx, preq[3]);
+    fail_unless(preq[2]->done, "Requests finished out of order");
+
+    for (i = 2; i < 4; i++) {
+        fail_unless(preq[i]->error == EOK,
+                    "Request failed [%d]", preq[i]->error);
+        fail_unless(preq[i]->pid == preq[0]->pid, "Worker not reused");
+    }
+    fail_unless(preq[2]->uid == TEST_UID_ECHO &&
+                preq[3]->uid == TEST_UID_ECHO + 1,
+                "Replies mixed up [%u][%u]", preq[2]->uid, preq[3]->uid);
+
+    pool_test_teardown(test_ctx);
+}
+END_TEST
+
+/* replies are read in as many pieces as they arrive */
+START_TEST(test_pool_split_reply)
+{
+    struct pool_test_ctx *test_ctx;
+    struct pool_test_req *preq[2];
+
+    test_ctx = pool_test_setup(1, 5);
+
+    preq[0] = pool_test_send(test_ctx, TEST_UID_SPLIT);
+    pool_test_wait(test_ctx, preq[0]);
+    fail_unless(preq[0]->error == EOK, "Request failed [%d]", preq[0]->error);
+    fail_unless(preq[0]->uid == TEST_UID_SPLIT, "Wrong reply");
+
+    preq[1] = pool_test_send(test_ctx, TEST_UID_ECHO);
+    pool_test_wait(test_ctx, preq[1]);
+    fail_unless(preq[1]->error == EOK, "Request failed [%d]", preq[1]->error);
+    fail_unless(preq[1]->pid == preq[0]->pid, "Worker not reused");
+
+    pool_test_teardown(test_ctx);
+}
+END_TEST
+
+/* a worker that times out is killed together with the process handling
+ * the request and replaced by a new one */
+START_TEST(test_pool_timeout)
+{
+    struct pool_test_ctx *test_ctx;
+    struct pool_test_req *preq[3];
+    pid_t hang_pid = 0;
+    FILE *f;
+    int ret;
+
+    test_ctx = pool_test_setup(1, 1);
+
+    preq[0] = pool_test_send(test_ctx, TEST_UID_ECHO);
+    pool_test_wait(test_ctx, preq[0]);
+    fail_unless(preq[0]->error == EOK, "Request failed [%d]", preq[0]->error);
+
+    preq[1] = pool_test_send(test_ctx, TEST_UID_HANG);
+    pool_test_wait(test_ctx, preq[1]);
+    fail_unless(preq[1]->error == ETIMEDOUT,
+                "Expected ETIMEDOUT, got [%d]", preq[1]->error);
+
+    f = fopen(TEST_HANG_PID_FILE, "r");
+    fail_if(f == NULL, "The request was not handled by a copy of the worker");
+    ret = fscanf(f, "%d", &hang_pid);
+    fclose(f);
+    fail_unless(ret == 1 && hang_pid > 0, "Invalid pid file");
+
+    wait_process_gone(preq[0]->pid);
+    wait_process_gone(hang_pid);
+
+    preq[2] = pool_test_send(test_ctx, TEST_UID_ECHO);
+    pool_test_wait(test_ctx, preq[2]);
+    fail_unless(preq[2]->error == EOK, "Request failed [%d]", preq[2]->error);
+    fail_unless(preq[2]->pid != preq[0]->pid, "The worker was reused");
+
+    pool_test_teardown(test_ctx);
+}
+END_TEST
+
+Suite *krb5_child_pool_suite(void)
+{
+    Suite *s = suite_create("krb5_child pool");
+
+    TCase *tc_frame = tcase_create("Frame codec");
+    tcase_add_checked_fixture(tc_frame,
+                              leak_check_setup,
+                              leak_check_teardown);
+    tcase_add_test(tc_frame, test_recv_frame);
+    tcase_add_test(tc_frame, test_send_frame);
+    suite_add_tcase(s, tc_frame);
+
+    TCase *tc_pool = tcase_create("Persistent workers");
+    tcase_add_checked_fixture(tc_pool,
+                              leak_check_setup,
+                              leak_check_teardown);
+    tcase_set_timeout(tc_pool, 30);
+    tcase_add_test(tc_pool, test_pool_reuse);
+    tcase_add_test(tc_pool, test_pool_split_reply);
+    tcase_add_test(tc_pool, test_pool_timeout);
+    suite_add_tcase(s, tc_pool);
+
+    return s;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    int number_failed;
+    poptContext pc;
+    char self[PATH_MAX];
+    ssize_t len;
+    int ret;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        SSSD_MAIN_OPTS
+        POPT_TABLEEND
+    };
+
+    /* started by the pool as krb5_child */
+    if (getenv(SSSD_KRB5_CHILD_PERSISTENT) != NULL) {
+        return fake_krb5_child();
+    }
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while((opt = poptGetNextOpt(pc)) != -1) {
+        switch(opt) {
+        default:
+            fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                    poptBadOption(pc, 0), poptStrerror(opt));
+            poptPrintUsage(pc, stderr, 0);
+            return 1;
+        }
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+    tests_set_cwd();
+
+    len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len == -1) {
+        fprintf(stderr, "Cannot find the test binary\n");
+        return EXIT_FAILURE;
+    }
+    self[len] = '\0';
+
+    ret = mkdir(TESTS_PATH, 0775);
+    if (ret != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s directory\n", TESTS_PATH);
+        return EXIT_FAILURE;
+    }
+    unlink(TEST_KRB5_CHILD);
+    ret = symlink(self, TEST_KRB5_CHILD);
+    if (ret != 0) {
+        fprintf(stderr, "Could not create %s\n", TEST_KRB5_CHILD);
+        return EXIT_FAILURE;
+    }
+
+    Suite *s = krb5_child_pool_suite();
+    SRunner *sr = srunner_create(s);
+
+    /* If CK_VERBOSITY is set, use that, otherwise it defaults to CK_NORMAL */
+    srunner_run_all(sr, CK_ENV);
+    number_failed = srunner_ntests_failed (sr);
+    srunner_free (sr);
+
+    unlink(TEST_KRB5_CHILD);
+    rmdir(TESTS_PATH);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,310 @@
+/*
+   SSSD
+
+   Memory cache hash chain benchmark
+
+   Measures how many records a lookup has to visit in the hash chains of
+   the memory cache at different fill levels, comparing the current layout
+   where every record has a chain pointer per hash with the previous one
+   where both hashes of a record shared a single chain pointer.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <talloc.h>
+#include <popt.h>
+
+#include "util/util.h"
+#include "util/mmap_cache.h"
+
+#define DEFAULT_ELEMENTS 50000
+#define BENCH_SEED 0x5553
+
+/* The responder sizes the hash table for two keys per element */
+#define BENCH_BUCKETS(elems) MC_HT_ELEMS(MC_HT_SIZE((elems) * 2))
+
+static const int fill_levels[] = { 10, 25, 50, 75, 90, 100, 0 };
+
+struct bench_table {
+    uint32_t nbuckets;
+    uint32_t *hash_table;
+    struct sss_mc_rec *recs;    /* one record per slot */
+    uint32_t *ids;
+    char **names;
+    uint32_t num_recs;
+    bool shared_next;           /* single chain pointer, as before */
+};
+
+struct bench_probes {
+    uint64_t lookups;
+    uint64_t probes;
+    uint32_t max;
+};
+
+static uint32_t bench_hash(struct bench_table *t, const char *key)
+{
+    return murmurhash3(key, strlen(key) + 1, BENCH_SEED) % t->nbuckets;
+}
+
+static uint32_t bench_next(struct bench_table *t,
+                           struct sss_mc_rec *rec, uint32_t hash)
+{
+    if (t->shared_next) {
+        return rec->next1;
+    }
+    return sss_mc_next_slot_with_hash(rec, hash);
+}
+
+static void bench_set_next(struct bench_table *t, struct sss_mc_rec *rec,
+                           uint32_t hash, uint32_t slot)
+{
+    if (t->shared_next || rec->hash1 == hash) {
+        rec->next1 = slot;
+    } else {
+        rec->next2 = slot;
+    }
+}
+
+/* same logic as sss_mc_add_rec_to_chain() in the responder */
+static void bench_add_to_chain(struct bench_table *t,
+                               uint32_t slot, uint32_t hash)
+{
+    struct sss_mc_rec *cur;
+    uint32_t cur_slot;
+
+    cur_slot = t->hash_table[hash];
+    if (cur_slot == MC_INVALID_VAL) {
+        t->hash_table[hash] = slot;
+        return;
+    }
+
+    do {
+        cur = &t->recs[cur_slot];
+        if (cur_slot == slot) {
+            return;
+        }
+        cur_slot = bench_next(t, cur, hash);
+    } while (cur_slot != MC_INVALID_VAL);
+
+    bench_set_next(t, cur, hash, slot);
+}
+
+static void bench_store(struct bench_table *t, uint32_t slot)
+{
+    struct sss_mc_rec *rec = &t->recs[slot];
+    char idstr[11];
+
+    snprintf(idstr, 11, "%u", t->ids[slot]);
+
+    rec->next1 = MC_INVALID_VAL;
+    rec->next2 = MC_INVALID_VAL;
+    rec->hash1 = bench_hash(t, t->names[slot]);
+    rec->hash2 = bench_hash(t, idstr);
+
+    bench_add_to_chain(t, slot, rec->hash1);
+    if (t->shared_next || rec->hash2 != rec->hash1) {
+        bench_add_to_chain(t, slot, rec->hash2);
+    }
+}
+
+static void bench_account(struct bench_probes *p, uint32_t probes)
+{
+    p->lookups++;
+    p->probes += probes;
+    if (probes > p->max) {
+        p->max = probes;
+    }
+}
+
+/* Walk the chain as the client does, counting the records it has to copy
+ * out of the cache before finding the one it is looking for */
+static void bench_lookup_name(struct bench_table *t, const char *name,
+                              struct bench_probes *p)
+{
+    struct sss_mc_rec *rec;
+    uint32_t probes = 0;
+    uint32_t hash;
+    uint32_t slot;
+
+    hash = bench_hash(t, name);
+    slot = t->hash_table[hash];
+    while (slot != MC_INVALID_VAL && probes <= t->num_recs) {
+        rec = &t->recs[slot];
+        probes++;
+        if (rec->hash1 == hash && strcmp(t->names[slot], name) == 0) {
+            break;
+        }
+        slot = bench_next(t, rec, hash);
+    }
+
+    bench_account(p, probes);
+}
+
+static void bench_lookup_id(struct bench_table *t, uint32_t id,
+                            struct bench_probes *p)
+{
+    struct sss_mc_rec *rec;
+    uint32_t probes = 0;
+    char idstr[11];
+    uint32_t hash;
+    uint32_t slot;
+
+    snprintf(idstr, 11, "%u", id);
+    hash = bench_hash(t, idstr);
+    slot = t->hash_table[hash];
+    while (slot != MC_INVALID_VAL && probes <= t->num_recs) {
+        rec = &t->recs[slot];
+        probes++;
+        if (rec->hash2 == hash && t->ids[slot] == id) {
+            break;
+        }
+        slot = bench_next(t, rec, hash);
+    }
+
+    bench_account(p, probes);
+}
+
+static double bench_avg(struct bench_probes *p)
+{
+    return p->lookups ? (double)p->probes / p->lookups : 0.0;
+}
+
+static int bench_run(TALLOC_CTX *mem_ctx, uint32_t elems, uint32_t num,
+                     bool shared_next, char **names, uint32_t *ids)
+{
+    struct bench_table *t;
+    struct bench_probes by_name = { 0 };
+    struct bench_probes by_id = { 0 };
+    struct bench_probes miss = { 0 };
+    char *missing;
+    uint32_t i;
+
+    t = talloc_zero(mem_ctx, struct bench_table);
+    if (!t) return ENOMEM;
+
+    t->nbuckets = BENCH_BUCKETS(elems);
+    t->shared_next = shared_next;
+    t->names = names;
+    t->ids = ids;
+    t->num_recs = num;
+    t->hash_table = talloc_array(t, uint32_t, t->nbuckets);
+    t->recs = talloc_zero_array(t, struct sss_mc_rec, num);
+    if (!t->hash_table || !t->recs) {
+        talloc_free(t);
+        return ENOMEM;
+    }
+    memset(t->hash_table, 0xff, t->nbuckets * sizeof(uint32_t));
+
+    for (i = 0; i < num; i++) {
+        bench_store(t, i);
+    }
+
+    for (i = 0; i < num; i++) {
+        bench_lookup_name(t, names[i], &by_name);
+        bench_lookup_id(t, ids[i], &by_id);
+
+        missing = talloc_asprintf(t, "unknown_user%u", i);
+        if (!missing) {
+            talloc_free(t);
+            return ENOMEM;
+        }
+        bench_lookup_name(t, missing, &miss);
+        talloc_free(missing);
+    }
+
+    printf("%-7s %5.1f   %5.1f %5u     %5.1f %5u     %5.1f %5u\n",
+           shared_next ? "shared" : "split",
+           (double)num * 100 / elems,
+           bench_avg(&by_name), by_name.max,
+           bench_avg(&by_id), by_id.max,
+           bench_avg(&miss), miss.max);
+
+    talloc_free(t);
+    return EOK;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_elements = DEFAULT_ELEMENTS;
+    TALLOC_CTX *ctx;
+    char **names;
+    uint32_t *ids;
+    uint32_t num;
+    int ret;
+    int i;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "elements", 'n', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_elements, 0,
+                    "Number of elements the cache is sized for", NULL },
+        POPT_TABLEEND
+    };
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                poptBadOption(pc, 0), poptStrerror(opt));
+        poptPrintUsage(pc, stderr, 0);
+        return 1;
+    }
+    poptFreeContext(pc);
+
+    if (pc_elements <= 0) {
+        fprintf(stderr, "elements must be positive\n");
+        return 1;
+    }
+
+    ctx = talloc_new(NULL);
+    names = talloc_array(ctx, char *, pc_elements);
+    ids = talloc_array(ctx, uint32_t, pc_elements);
+    if (!ctx || !names || !ids) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (i = 0; i < pc_elements; i++) {
+        names[i] = talloc_asprintf(names, "cached_user%d", i);
+        if (!names[i]) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        ids[i] = 10000 + i;
+    }
+
+    printf("%d elements, %u hash buckets, probes per lookup (avg/max)\n",
+           pc_elements, (unsigned int)BENCH_BUCKETS(pc_elements));
+    printf("chains  fill%%  by name       by id         missing\n");
+
+    for (i = 0; fill_levels[i] != 0; i++) {
+        num = (uint64_t)pc_elements * fill_levels[i] / 100;
+
+        ret = bench_run(ctx, pc_elements, num, true, names, ids);
+        if (ret == EOK) {
+            ret = bench_run(ctx, pc_elements, num, false, names, ids);
+        }
+        if (ret != EOK) {
+            fprintf(stderr, "benchmark failed [%d]: %s\n", ret, strerror(ret));
+            return 1;
+        }
+    }
+
+    talloc_free(ctx);
+    return 0;
+}
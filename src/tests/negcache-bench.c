@@ -0,0 +1,282 @@
+/*
+   SSSD
+
+   Negative cache microbenchmark
+
+   Compares the hash table based negative cache with the tdb based
+   implementation it replaced, using the same key format and timestamp
+   encoding the tdb version used.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/time.h>
+#include <talloc.h>
+#include <popt.h>
+#include "tdb.h"
+
+#include "util/util.h"
+#include "responder/common/negcache.h"
+
+#define DEFAULT_ENTRIES 10000
+#define DEFAULT_ROUNDS  10
+#define NEG_TTL         15
+
+static double elapsed_usec(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) * 1000000.0 +
+           (end.tv_usec - start->tv_usec);
+}
+
+/* The tdb based negative cache, as it was before the hash table */
+static int tdb_nc_set(TALLOC_CTX *mem_ctx, struct tdb_context *tdb,
+                      const char *domain, const char *name)
+{
+    TDB_DATA key;
+    TDB_DATA data;
+    char *str;
+    char *timest;
+    int ret;
+
+    str = talloc_asprintf(mem_ctx, "NCE/USER/%s/%s", domain, name);
+    timest = talloc_asprintf(mem_ctx, "%llu",
+                             (unsigned long long int)time(NULL));
+    if (!str || !timest) return ENOMEM;
+
+    key.dptr = (uint8_t *)str;
+    key.dsize = strlen(str) + 1;
+    data.dptr = (uint8_t *)timest;
+    data.dsize = strlen(timest) + 1;
+
+    ret = tdb_store(tdb, key, data, TDB_REPLACE);
+
+    talloc_free(str);
+    talloc_free(timest);
+    return ret == 0 ? EOK : EFAULT;
+}
+
+static int tdb_nc_check(TALLOC_CTX *mem_ctx, struct tdb_context *tdb,
+                        const char *domain, const char *name, int ttl)
+{
+    TDB_DATA key;
+    TDB_DATA data;
+    unsigned long long int timestamp;
+    char *str;
+    char *ep;
+    int ret = ENOENT;
+
+    str = talloc_asprintf(mem_ctx, "NCE/USER/%s/%s", domain, name);
+    if (!str) return ENOMEM;
+
+    key.dptr = (uint8_t *)str;
+    key.dsize = strlen(str) + 1;
+
+    data = tdb_fetch(tdb, key);
+    if (data.dptr) {
+        errno = 0;
+        timestamp = strtoull((const char *)data.dptr, &ep, 10);
+        if (errno == 0 && *ep == '\0' &&
+            (timestamp == 0 || timestamp + ttl > time(NULL))) {
+            ret = EEXIST;
+        }
+    }
+
+    free(data.dptr);
+    talloc_free(str);
+    return ret;
+}
+
+static int bench_tdb(TALLOC_CTX *mem_ctx, const char *domain,
+                     char **names, char **missing, int num, int rounds)
+{
+    struct tdb_context *tdb;
+    struct timeval start;
+    double usec;
+    int ret;
+    int i, r;
+
+    tdb = tdb_open("memcache", 0, TDB_INTERNAL, O_RDWR|O_CREAT, 0);
+    if (!tdb) return EIO;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < num; i++) {
+        ret = tdb_nc_set(mem_ctx, tdb, domain, names[i]);
+        if (ret != EOK) goto done;
+    }
+    usec = elapsed_usec(&start);
+    printf("tdb   set:   %8.1f ns/op\n", usec * 1000 / num);
+
+    gettimeofday(&start, NULL);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < num; i++) {
+            ret = tdb_nc_check(mem_ctx, tdb, domain, names[i], NEG_TTL);
+            if (ret != EEXIST) goto done;
+        }
+    }
+    usec = elapsed_usec(&start);
+    printf("tdb   hit:   %8.1f ns/op\n", usec * 1000 / (num * rounds));
+
+    gettimeofday(&start, NULL);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < num; i++) {
+            ret = tdb_nc_check(mem_ctx, tdb, domain, missing[i], NEG_TTL);
+            if (ret != ENOENT) goto done;
+        }
+    }
+    usec = elapsed_usec(&start);
+    printf("tdb   miss:  %8.1f ns/op\n", usec * 1000 / (num * rounds));
+
+    ret = EOK;
+
+done:
+    tdb_close(tdb);
+    return ret;
+}
+
+static int bench_hash(TALLOC_CTX *mem_ctx, struct sss_domain_info *dom,
+                      char **names, char **missing, int num, int rounds)
+{
+    struct sss_nc_ctx *ncache;
+    struct timeval start;
+    double usec;
+    int ret;
+    int i, r;
+
+    ret = sss_ncache_init(mem_ctx, &ncache);
+    if (ret != EOK) return ret;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < num; i++) {
+        ret = sss_ncache_set_user(ncache, false, dom, names[i]);
+        if (ret != EOK) goto done;
+    }
+    usec = elapsed_usec(&start);
+    printf("hash  set:   %8.1f ns/op\n", usec * 1000 / num);
+
+    gettimeofday(&start, NULL);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < num; i++) {
+            ret = sss_ncache_check_user(ncache, NEG_TTL, dom, names[i]);
+            if (ret != EEXIST) goto done;
+        }
+    }
+    usec = elapsed_usec(&start);
+    printf("hash  hit:   %8.1f ns/op\n", usec * 1000 / (num * rounds));
+
+    gettimeofday(&start, NULL);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < num; i++) {
+            ret = sss_ncache_check_user(ncache, NEG_TTL, dom, missing[i]);
+            if (ret != ENOENT) goto done;
+        }
+    }
+    usec = elapsed_usec(&start);
+    printf("hash  miss:  %8.1f ns/op\n", usec * 1000 / (num * rounds));
+
+    gettimeofday(&start, NULL);
+    ret = sss_ncache_reset_permament(ncache);
+    if (ret != EOK) goto done;
+    usec = elapsed_usec(&start);
+    printf("hash  reset: %8.1f us\n", usec);
+
+    ret = EOK;
+
+done:
+    talloc_free(ncache);
+    return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_entries = DEFAULT_ENTRIES;
+    int pc_rounds = DEFAULT_ROUNDS;
+    TALLOC_CTX *ctx;
+    struct sss_domain_info *dom;
+    char **names;
+    char **missing;
+    int ret;
+    int i;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "entries", 'n', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_entries, 0,
+                    "Number of entries in the negative cache", NULL },
+        { "rounds", 'r', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_rounds, 0,
+                    "How many times each entry is checked", NULL },
+        POPT_TABLEEND
+    };
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                poptBadOption(pc, 0), poptStrerror(opt));
+        poptPrintUsage(pc, stderr, 0);
+        return 1;
+    }
+    poptFreeContext(pc);
+
+    if (pc_entries <= 0 || pc_rounds <= 0) {
+        fprintf(stderr, "entries and rounds must be positive\n");
+        return 1;
+    }
+
+    ctx = talloc_new(NULL);
+    dom = talloc_zero(ctx, struct sss_domain_info);
+    names = talloc_array(ctx, char *, pc_entries);
+    missing = talloc_array(ctx, char *, pc_entries);
+    if (!ctx || !dom || !names || !missing) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    dom->name = talloc_strdup(dom, "LOCAL");
+    dom->case_sensitive = true;
+
+    for (i = 0; i < pc_entries; i++) {
+        names[i] = talloc_asprintf(names, "negative_user%d", i);
+        missing[i] = talloc_asprintf(missing, "unknown_user%d", i);
+        if (!dom->name || !names[i] || !missing[i]) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+
+    printf("%d entries, %d rounds\n", pc_entries, pc_rounds);
+
+    ret = bench_tdb(ctx, dom->name, names, missing, pc_entries, pc_rounds);
+    if (ret != EOK) {
+        fprintf(stderr, "tdb benchmark failed [%d]: %s\n", ret, strerror(ret));
+        return 1;
+    }
+
+    ret = bench_hash(ctx, dom, names, missing, pc_entries, pc_rounds);
+    if (ret != EOK) {
+        fprintf(stderr, "hash benchmark failed [%d]: %s\n", ret, strerror(ret));
+        return 1;
+    }
+
+    talloc_free(ctx);
+    return 0;
+}
@@ -482,6 +482,75 @@ START_TEST(pac_test_get_gids_from_pac)
 }
 END_TEST
 
+START_TEST(pac_test_get_pac_digest)
+{
+    int ret;
+    struct PAC_LOGON_INFO *logon_info;
+    uint8_t digest[PAC_DIGEST_LENGTH];
+    uint8_t new_digest[PAC_DIGEST_LENGTH];
+
+    ret = get_pac_digest(NULL, digest);
+    fail_unless(ret == EINVAL, "Unexpected return value for NULL parameters");
+
+    logon_info = talloc_zero(global_talloc_context, struct PAC_LOGON_INFO);
+    fail_unless(logon_info != NULL, "talloc_zero failed.\n");
+
+    logon_info->info3.base.account_name.string = "user";
+    logon_info->info3.base.logon_domain.string = "REMOTEDOM";
+    logon_info->info3.base.domain_sid = &test_remote_dom_sid;
+    logon_info->info3.base.rid = 1111;
+    logon_info->info3.base.groups.count = 2;
+    logon_info->info3.base.groups.rids = talloc_zero_array(logon_info,
+                                           struct samr_RidWithAttribute,
+                                           logon_info->info3.base.groups.count);
+    fail_unless(logon_info->info3.base.groups.rids != NULL,
+                "talloc_zero_array failed.");
+    logon_info->info3.base.groups.rids[0].rid = 500;
+    logon_info->info3.base.groups.rids[1].rid = 501;
+
+    ret = get_pac_digest(logon_info, digest);
+    fail_unless(ret == EOK, "get_pac_digest failed.");
+
+    /* a new ticket of the same user */
+    logon_info->info3.base.logon_time = 123456789;
+    logon_info->info3.base.logon_count = 42;
+
+    ret = get_pac_digest(logon_info, new_digest);
+    fail_unless(ret == EOK, "get_pac_digest failed.");
+    fail_unless(memcmp(digest, new_digest, PAC_DIGEST_LENGTH) == 0,
+                "Logon time changed the digest.");
+
+    logon_info->info3.base.groups.rids[1].rid = 502;
+
+    ret = get_pac_digest(logon_info, new_digest);
+    fail_unless(ret == EOK, "get_pac_digest failed.");
+    fail_unless(memcmp(digest, new_digest, PAC_DIGEST_LENGTH) != 0,
+                "Different group membership has the same digest.");
+
+    logon_info->info3.base.groups.rids[1].rid = 501;
+    logon_info->info3.sidcount = 1;
+    logon_info->info3.sids = talloc_zero_array(logon_info, struct netr_SidAttr,
+                                               logon_info->info3.sidcount);
+    fail_unless(logon_info->info3.sids != NULL, "talloc_zero_array failed.");
+    logon_info->info3.sids[0].sid = &test_smb_sid;
+
+    ret = get_pac_digest(logon_info, new_digest);
+    fail_unless(ret == EOK, "get_pac_digest failed.");
+    fail_unless(memcmp(digest, new_digest, PAC_DIGEST_LENGTH) != 0,
+                "Additional SID has the same digest.");
+
+    logon_info->info3.sidcount = 0;
+    logon_info->info3.base.full_name.string = "User Name";
+
+    ret = get_pac_digest(logon_info, new_digest);
+    fail_unless(ret == EOK, "get_pac_digest failed.");
+    fail_unless(memcmp(digest, new_digest, PAC_DIGEST_LENGTH) != 0,
+                "Different full name has the same digest.");
+
+    talloc_free(logon_info);
+}
+END_TEST
+
 Suite *idmap_test_suite (void)
 {
     Suite *s = suite_create ("PAC responder");
@@ -500,6 +569,7 @@ Suite *idmap_test_suite (void)
     tcase_add_test(tc_pac, pac_test_get_gids_to_add_and_remove);
     tcase_add_test(tc_pac, pac_test_find_domain_by_id);
     tcase_add_test(tc_pac, pac_test_get_gids_from_pac);
+    tcase_add_test(tc_pac, pac_test_get_pac_digest);
 
     suite_add_tcase(s, tc_pac);
 
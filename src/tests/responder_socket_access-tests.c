@@ -23,9 +23,18 @@
 #include <popt.h>
 #include <check.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 #include "tests/common.h"
 #include "responder/common/responder.h"
+#include "responder/common/responder_packet.h"
+#include "responder/common/responder_private.h"
+
+#define TESTS_PATH "tests_responder"
+#define TEST_SOCKET TESTS_PATH"/test_pipe"
+#define TEST_MAX_REPLIES 4
 
 struct cli_protocol_version *register_cli_protocol_version(void)
 {
@@ -122,6 +131,286 @@ START_TEST(check_allowed_uids_test)
 }
 END_TEST
 
+/* Pipelined requests: the test command answers with the tag found in the
+ * request after the delay found in the request. */
+struct pipe_test_ctx {
+    struct tevent_context *ev;
+    struct resp_ctx *rctx;
+    int fd;
+    struct tevent_fd *fde;
+
+    uint8_t buf[TEST_MAX_REPLIES * 2 * SSS_NSS_HEADER_SIZE];
+    size_t buflen;
+    /* replies as id, tag pairs in the order they were received */
+    uint32_t ids[TEST_MAX_REPLIES];
+    uint32_t tags[TEST_MAX_REPLIES];
+    int num_replies;
+    bool error;
+};
+
+struct pipe_cmd_state {
+    struct cli_ctx *cctx;
+    uint32_t tag;
+};
+
+static void pipe_cmd_reply(struct tevent_context *ev,
+                           struct tevent_timer *te,
+                           struct timeval tv, void *pvt)
+{
+    struct pipe_cmd_state *state = talloc_get_type(pvt,
+                                                   struct pipe_cmd_state);
+    struct cli_ctx *cctx = state->cctx;
+    uint8_t *body;
+    size_t blen;
+    int ret;
+
+    ret = sss_packet_new(cctx->creq, sizeof(uint32_t),
+                         sss_packet_get_cmd(cctx->creq->in),
+                         &cctx->creq->out);
+    if (ret != EOK) {
+        talloc_free(cctx);
+        return;
+    }
+
+    sss_packet_get_body(cctx->creq->out, &body, &blen);
+    memcpy(body, &state->tag, sizeof(uint32_t));
+
+    sss_cmd_done(cctx, state);
+}
+
+static int pipe_cmd(struct cli_ctx *cctx)
+{
+    struct pipe_cmd_state *state;
+    struct tevent_timer *te;
+    uint32_t delay;
+    uint8_t *body;
+    size_t blen;
+
+    sss_packet_get_body(cctx->creq->in, &body, &blen);
+    if (blen != 2 * sizeof(uint32_t)) {
+        return EINVAL;
+    }
+
+    state = talloc_zero(cctx, struct pipe_cmd_state);
+    if (!state) return ENOMEM;
+    state->cctx = cctx;
+
+    memcpy(&delay, body, sizeof(uint32_t));
+    memcpy(&state->tag, body + sizeof(uint32_t), sizeof(uint32_t));
+
+    te = tevent_add_timer(cctx->ev, state,
+                          tevent_timeval_current_ofs(0, delay * 1000),
+                          pipe_cmd_reply, state);
+    if (!te) {
+        talloc_free(state);
+        return ENOMEM;
+    }
+
+    return EOK;
+}
+
+static struct sss_cmd_table pipe_test_cmds[] = {
+    /* can be pipelined */
+    { SSS_NSS_GETPWNAM, pipe_cmd },
+    /* always processed one at a time */
+    { SSS_NSS_SETPWENT, pipe_cmd },
+    { SSS_CLI_NULL, NULL }
+};
+
+static void pipe_test_client_handler(struct tevent_context *ev,
+                                     struct tevent_fd *fde,
+                                     uint16_t flags, void *pvt)
+{
+    struct pipe_test_ctx *test_ctx = talloc_get_type(pvt,
+                                                     struct pipe_test_ctx);
+    uint32_t header[4];
+    ssize_t len;
+
+    len = recv(test_ctx->fd, test_ctx->buf + test_ctx->buflen,
+               sizeof(test_ctx->buf) - test_ctx->buflen, MSG_DONTWAIT);
+    if (len <= 0) {
+        test_ctx->error = true;
+        return;
+    }
+    test_ctx->buflen += len;
+
+    /* every reply is a header and a tag */
+    while (test_ctx->buflen >= SSS_NSS_HEADER_SIZE + sizeof(uint32_t)) {
+        memcpy(header, test_ctx->buf, SSS_NSS_HEADER_SIZE);
+        if (header[0] != SSS_NSS_HEADER_SIZE + sizeof(uint32_t) ||
+            header[2] != 0 ||
+            test_ctx->num_replies == TEST_MAX_REPLIES) {
+            test_ctx->error = true;
+            return;
+        }
+
+        test_ctx->ids[test_ctx->num_replies] = header[3];
+        memcpy(&test_ctx->tags[test_ctx->num_replies],
+               test_ctx->buf + SSS_NSS_HEADER_SIZE, sizeof(uint32_t));
+        test_ctx->num_replies++;
+
+        test_ctx->buflen -= header[0];
+        memmove(test_ctx->buf, test_ctx->buf + header[0], test_ctx->buflen);
+    }
+}
+
+static struct pipe_test_ctx *pipe_test_setup(void)
+{
+    struct pipe_test_ctx *test_ctx;
+    struct sockaddr_un addr;
+    int ret;
+
+    test_ctx = talloc_zero(global_talloc_context, struct pipe_test_ctx);
+    fail_if(test_ctx == NULL, "Out of memory");
+
+    test_ctx->ev = tevent_context_init(test_ctx);
+    fail_if(test_ctx->ev == NULL, "tevent_context_init failed");
+
+    test_ctx->rctx = talloc_zero(test_ctx, struct resp_ctx);
+    fail_if(test_ctx->rctx == NULL, "Out of memory");
+    test_ctx->rctx->ev = test_ctx->ev;
+    test_ctx->rctx->lfd = -1;
+    test_ctx->rctx->priv_lfd = -1;
+    test_ctx->rctx->sock_name = TEST_SOCKET;
+    test_ctx->rctx->client_idle_timeout = 60;
+    test_ctx->rctx->sss_cmds = pipe_test_cmds;
+
+    ret = mkdir(TESTS_PATH, 0775);
+    fail_if(ret != 0 && errno != EEXIST,
+            "Could not create %s directory", TESTS_PATH);
+
+    ret = set_unix_socket(test_ctx->rctx);
+    fail_unless(ret == EOK, "set_unix_socket failed [%d]", ret);
+
+    test_ctx->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    fail_if(test_ctx->fd == -1, "socket failed");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, TEST_SOCKET, sizeof(addr.sun_path) - 1);
+    ret = connect(test_ctx->fd, (struct sockaddr *)&addr, sizeof(addr));
+    fail_unless(ret == 0, "connect failed [%d]", errno);
+
+    test_ctx->fde = tevent_add_fd(test_ctx->ev, test_ctx, test_ctx->fd,
+                                  TEVENT_FD_READ, pipe_test_client_handler,
+                                  test_ctx);
+    fail_if(test_ctx->fde == NULL, "tevent_add_fd failed");
+
+    return test_ctx;
+}
+
+static void pipe_test_teardown(struct pipe_test_ctx *test_ctx)
+{
+    close(test_ctx->fd);
+    close(test_ctx->rctx->lfd);
+    talloc_free(test_ctx);
+
+    unlink(TEST_SOCKET);
+    rmdir(TESTS_PATH);
+}
+
+static void pipe_test_send(struct pipe_test_ctx *test_ctx,
+                           enum sss_cli_command cmd, uint32_t id,
+                           uint32_t delay, uint32_t tag)
+{
+    uint32_t packet[6];
+    ssize_t len;
+
+    packet[0] = sizeof(packet);
+    packet[1] = cmd;
+    packet[2] = id;
+    packet[3] = 0;
+    packet[4] = delay;
+    packet[5] = tag;
+
+    len = send(test_ctx->fd, packet, sizeof(packet), 0);
+    fail_unless(len == sizeof(packet), "send failed [%d]", errno);
+}
+
+static void pipe_test_timeout(struct tevent_context *ev,
+                              struct tevent_timer *te,
+                              struct timeval tv, void *pvt)
+{
+    bool *timed_out = (bool *)pvt;
+
+    *timed_out = true;
+}
+
+static void pipe_test_wait(struct pipe_test_ctx *test_ctx, int num_replies)
+{
+    struct tevent_timer *te;
+    bool timed_out = false;
+
+    te = tevent_add_timer(test_ctx->ev, test_ctx,
+                          tevent_timeval_current_ofs(5, 0),
+                          pipe_test_timeout, &timed_out);
+    fail_if(te == NULL, "tevent_add_timer failed");
+
+    while (test_ctx->num_replies < num_replies &&
+           !test_ctx->error && !timed_out) {
+        tevent_loop_once(test_ctx->ev);
+    }
+    talloc_free(te);
+
+    fail_if(timed_out, "Timed out waiting for replies");
+    fail_if(test_ctx->error, "Invalid reply received");
+}
+
+START_TEST(pipelined_requests_test)
+{
+    struct pipe_test_ctx *test_ctx;
+
+    test_ctx = pipe_test_setup();
+
+    /* the first request is answered after the second one */
+    pipe_test_send(test_ctx, SSS_NSS_GETPWNAM, 1, 200, 0xA);
+    pipe_test_send(test_ctx, SSS_NSS_GETPWNAM, 2, 0, 0xB);
+
+    pipe_test_wait(test_ctx, 2);
+
+    fail_unless(test_ctx->num_replies == 2,
+                "Expected 2 replies, got %d", test_ctx->num_replies);
+    fail_unless(test_ctx->ids[0] == 2 && test_ctx->tags[0] == 0xB,
+                "First reply should answer request 2, got [%u][%x]",
+                test_ctx->ids[0], test_ctx->tags[0]);
+    fail_unless(test_ctx->ids[1] == 1 && test_ctx->tags[1] == 0xA,
+                "Second reply should answer request 1, got [%u][%x]",
+                test_ctx->ids[1], test_ctx->tags[1]);
+
+    pipe_test_teardown(test_ctx);
+}
+END_TEST
+
+START_TEST(serialized_requests_test)
+{
+    struct pipe_test_ctx *test_ctx;
+
+    test_ctx = pipe_test_setup();
+
+    /* untagged requests and commands that can not be pipelined are
+     * answered in order */
+    pipe_test_send(test_ctx, SSS_NSS_GETPWNAM, 0, 200, 0xA);
+    pipe_test_send(test_ctx, SSS_NSS_SETPWENT, 3, 0, 0xB);
+    pipe_test_send(test_ctx, SSS_NSS_GETPWNAM, 0, 0, 0xC);
+
+    pipe_test_wait(test_ctx, 3);
+
+    fail_unless(test_ctx->num_replies == 3,
+                "Expected 3 replies, got %d", test_ctx->num_replies);
+    fail_unless(test_ctx->tags[0] == 0xA && test_ctx->ids[0] == 0,
+                "Wrong first reply [%u][%x]",
+                test_ctx->ids[0], test_ctx->tags[0]);
+    fail_unless(test_ctx->tags[1] == 0xB && test_ctx->ids[1] == 3,
+                "Wrong second reply [%u][%x]",
+                test_ctx->ids[1], test_ctx->tags[1]);
+    fail_unless(test_ctx->tags[2] == 0xC && test_ctx->ids[2] == 0,
+                "Wrong third reply [%u][%x]",
+                test_ctx->ids[2], test_ctx->tags[2]);
+
+    pipe_test_teardown(test_ctx);
+}
+END_TEST
+
 Suite *responder_test_suite(void)
 {
     Suite *s = suite_create ("Responder socket access");
@@ -133,6 +422,16 @@ Suite *responder_test_suite(void)
 
     suite_add_tcase(s, tc_utils);
 
+    TCase *tc_pipe = tcase_create("Pipelined requests");
+
+    tcase_add_checked_fixture(tc_pipe,
+                              leak_check_setup,
+                              leak_check_teardown);
+    tcase_add_test(tc_pipe, pipelined_requests_test);
+    tcase_add_test(tc_pipe, serialized_requests_test);
+
+    suite_add_tcase(s, tc_pipe);
+
     return s;
 }
 
@@ -0,0 +1,403 @@
+/*
+   SSSD
+
+   LDAP entry parsing benchmark
+
+   Turns canned LDAP replies (users with many memberOf values and groups
+   with large member lists) into sysdb attributes, once value by value as
+   sdap_parse_entry() used to and once an attribute at a time through a
+   reused scratch array, and compares the time and allocations needed.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <talloc.h>
+#include <popt.h>
+
+#include "util/util.h"
+#include "db/sysdb.h"
+
+#define DEFAULT_USERS    2000
+#define DEFAULT_GROUPS   200
+#define DEFAULT_MEMBEROF 200
+#define DEFAULT_MEMBERS  5000
+#define DEFAULT_ROUNDS   5
+
+/* one attribute of a canned reply, as ldap_get_values_len() returns it */
+struct canned_attr {
+    const char *name;
+    struct ldb_val *vals;
+    size_t num_vals;
+};
+
+struct canned_entry {
+    struct canned_attr *attrs;
+    size_t num_attrs;
+};
+
+struct canned_reply {
+    struct canned_entry *entries;
+    size_t num_entries;
+    size_t num_vals;
+};
+
+static double elapsed_sec(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+           (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static int canned_attr(TALLOC_CTX *mem_ctx, struct canned_attr *attr,
+                       const char *name, size_t num, const char *fmt,
+                       int base)
+{
+    size_t i;
+    char *str;
+
+    attr->name = name;
+    attr->num_vals = num;
+    attr->vals = talloc_array(mem_ctx, struct ldb_val, num);
+    if (!attr->vals) return ENOMEM;
+
+    for (i = 0; i < num; i++) {
+        str = talloc_asprintf(attr->vals, fmt, (int)(base + i));
+        if (!str) return ENOMEM;
+        attr->vals[i].data = (uint8_t *)str;
+        attr->vals[i].length = strlen(str);
+    }
+
+    return EOK;
+}
+
+/* Users carry a handful of single valued attributes and many memberOf
+ * values, groups a name, a gid and a large member list */
+static int canned_reply(TALLOC_CTX *mem_ctx, int num_users, int num_groups,
+                        int memberof, int members,
+                        struct canned_reply **_reply)
+{
+    struct canned_reply *reply;
+    struct canned_entry *e;
+    size_t n;
+    int i;
+    int ret;
+
+    reply = talloc_zero(mem_ctx, struct canned_reply);
+    if (!reply) return ENOMEM;
+
+    reply->num_entries = num_users + num_groups;
+    reply->entries = talloc_zero_array(reply, struct canned_entry,
+                                       reply->num_entries);
+    if (!reply->entries) return ENOMEM;
+
+    for (i = 0; i < num_users + num_groups; i++) {
+        e = &reply->entries[i];
+        e->num_attrs = 5;
+        e->attrs = talloc_zero_array(reply->entries, struct canned_attr,
+                                     e->num_attrs);
+        if (!e->attrs) return ENOMEM;
+
+        if (i < num_users) {
+            ret = canned_attr(e->attrs, &e->attrs[0], SYSDB_NAME, 1,
+                              "user%d", i);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[1], SYSDB_UIDNUM, 1,
+                              "%d", 10000 + i);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[2], SYSDB_HOMEDIR, 1,
+                              "/home/user%d", i);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[3], SYSDB_ORIG_DN, 1,
+                              "uid=user%d,ou=people,dc=example,dc=com", i);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[4], SYSDB_ORIG_MEMBEROF,
+                              memberof,
+                              "cn=group%d,ou=groups,dc=example,dc=com",
+                              i % num_groups);
+            if (ret) return ret;
+        } else {
+            n = i - num_users;
+            ret = canned_attr(e->attrs, &e->attrs[0], SYSDB_NAME, 1,
+                              "group%d", n);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[1], SYSDB_GIDNUM, 1,
+                              "%d", 200000 + n);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[2], SYSDB_DESCRIPTION, 1,
+                              "Group number %d", n);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[3], SYSDB_ORIG_DN, 1,
+                              "cn=group%d,ou=groups,dc=example,dc=com", n);
+            if (ret) return ret;
+            ret = canned_attr(e->attrs, &e->attrs[4], SYSDB_MEMBER,
+                              members,
+                              "uid=user%d,ou=people,dc=example,dc=com", 0);
+            if (ret) return ret;
+        }
+
+        for (n = 0; n < e->num_attrs; n++) {
+            reply->num_vals += e->attrs[n].num_vals;
+        }
+    }
+
+    *_reply = reply;
+    return EOK;
+}
+
+/* the way sdap_parse_entry() stored values before */
+static int parse_per_value(TALLOC_CTX *mem_ctx, struct canned_entry *e,
+                           struct sysdb_attrs **_attrs)
+{
+    struct sysdb_attrs *attrs;
+    size_t a, i;
+    int ret;
+
+    attrs = sysdb_new_attrs(mem_ctx);
+    if (!attrs) return ENOMEM;
+
+    for (a = 0; a < e->num_attrs; a++) {
+        for (i = 0; i < e->attrs[a].num_vals; i++) {
+            ret = sysdb_attrs_add_val(attrs, e->attrs[a].name,
+                                      &e->attrs[a].vals[i]);
+            if (ret) return ret;
+        }
+    }
+
+    *_attrs = attrs;
+    return EOK;
+}
+
+/* the way sdap_parse_entry() stores values now */
+static int parse_batched(TALLOC_CTX *mem_ctx, struct canned_entry *e,
+                         struct ldb_val **scratch, size_t *scratch_size,
+                         struct sysdb_attrs **_attrs)
+{
+    struct sysdb_attrs *attrs;
+    size_t a, i;
+    int ret;
+
+    attrs = sysdb_new_attrs(mem_ctx);
+    if (!attrs) return ENOMEM;
+
+    for (a = 0; a < e->num_attrs; a++) {
+        if (e->attrs[a].num_vals > *scratch_size) {
+            *scratch_size = e->attrs[a].num_vals;
+            *scratch = talloc_realloc(NULL, *scratch, struct ldb_val,
+                                      *scratch_size);
+            if (!*scratch) return ENOMEM;
+        }
+
+        /* sdap_parse_entry() points into the LDAP library's values here */
+        for (i = 0; i < e->attrs[a].num_vals; i++) {
+            (*scratch)[i] = e->attrs[a].vals[i];
+        }
+
+        ret = sysdb_attrs_add_vals(attrs, e->attrs[a].name,
+                                   *scratch, e->attrs[a].num_vals);
+        if (ret) return ret;
+    }
+
+    *_attrs = attrs;
+    return EOK;
+}
+
+static int compare_attrs(struct sysdb_attrs *x, struct sysdb_attrs *y)
+{
+    int a;
+    unsigned int i;
+
+    if (x->num != y->num) return EINVAL;
+
+    for (a = 0; a < x->num; a++) {
+        if (strcmp(x->a[a].name, y->a[a].name) != 0 ||
+            x->a[a].num_values != y->a[a].num_values) {
+            return EINVAL;
+        }
+        for (i = 0; i < x->a[a].num_values; i++) {
+            if (x->a[a].values[i].length != y->a[a].values[i].length ||
+                memcmp(x->a[a].values[i].data, y->a[a].values[i].data,
+                       x->a[a].values[i].length + 1) != 0) {
+                return EINVAL;
+            }
+        }
+    }
+
+    return EOK;
+}
+
+static int bench_run(struct canned_reply *reply, bool batched, int rounds,
+                     double *_sec, size_t *_blocks, size_t *_bytes,
+                     struct sysdb_attrs ***_keep, TALLOC_CTX *keep_ctx)
+{
+    struct sysdb_attrs **entries;
+    struct ldb_val *scratch = NULL;
+    size_t scratch_size = 0;
+    struct timeval start;
+    TALLOC_CTX *page;
+    size_t i;
+    int r;
+    int ret = EOK;
+
+    *_sec = 0;
+
+    for (r = 0; r < rounds; r++) {
+        page = talloc_new(NULL);
+        if (!page) return ENOMEM;
+
+        entries = talloc_array(page, struct sysdb_attrs *,
+                               reply->num_entries);
+        if (!entries) {
+            talloc_free(page);
+            return ENOMEM;
+        }
+
+        gettimeofday(&start, NULL);
+        for (i = 0; i < reply->num_entries; i++) {
+            if (batched) {
+                ret = parse_batched(entries, &reply->entries[i],
+                                    &scratch, &scratch_size, &entries[i]);
+            } else {
+                ret = parse_per_value(entries, &reply->entries[i],
+                                      &entries[i]);
+            }
+            if (ret) break;
+        }
+        *_sec += elapsed_sec(&start);
+
+        if (ret) {
+            talloc_free(page);
+            break;
+        }
+
+        /* the same reply every round */
+        *_blocks = talloc_total_blocks(entries);
+        *_bytes = talloc_total_size(entries);
+
+        if (r == rounds - 1) {
+            *_keep = talloc_steal(keep_ctx, entries);
+        }
+        talloc_free(page);
+    }
+
+    talloc_free(scratch);
+    return ret;
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_users = DEFAULT_USERS;
+    int pc_groups = DEFAULT_GROUPS;
+    int pc_memberof = DEFAULT_MEMBEROF;
+    int pc_members = DEFAULT_MEMBERS;
+    int pc_rounds = DEFAULT_ROUNDS;
+    struct canned_reply *reply;
+    struct sysdb_attrs **old_entries;
+    struct sysdb_attrs **new_entries;
+    double old_sec, new_sec;
+    size_t old_blocks = 0, new_blocks = 0;
+    size_t old_bytes = 0, new_bytes = 0;
+    TALLOC_CTX *ctx;
+    size_t i;
+    int ret;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "users", 'u', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_users, 0, "Number of user entries", NULL },
+        { "groups", 'g', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_groups, 0, "Number of group entries", NULL },
+        { "memberof", 'o', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_memberof, 0, "memberOf values per user", NULL },
+        { "members", 'm', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_members, 0, "member values per group", NULL },
+        { "rounds", 'r', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_rounds, 0, "How often the reply is parsed", NULL },
+        SSSD_MAIN_OPTS
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                poptBadOption(pc, 0), poptStrerror(opt));
+        poptPrintUsage(pc, stderr, 0);
+        return 1;
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    if (pc_users < 0 || pc_groups <= 0 || pc_memberof < 0 ||
+        pc_members < 0 || pc_rounds <= 0) {
+        fprintf(stderr, "invalid reply size\n");
+        return 1;
+    }
+
+    ctx = talloc_new(NULL);
+    if (!ctx) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    ret = canned_reply(ctx, pc_users, pc_groups, pc_memberof, pc_members,
+                       &reply);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not build the reply [%d]: %s\n",
+                ret, strerror(ret));
+        return 1;
+    }
+
+    printf("%u entries with %u values, parsed %d times\n",
+           (unsigned int)reply->num_entries, (unsigned int)reply->num_vals,
+           pc_rounds);
+
+    ret = bench_run(reply, false, pc_rounds, &old_sec,
+                    &old_blocks, &old_bytes, &old_entries, ctx);
+    if (ret == EOK) {
+        ret = bench_run(reply, true, pc_rounds, &new_sec,
+                        &new_blocks, &new_bytes, &new_entries, ctx);
+    }
+    if (ret != EOK) {
+        fprintf(stderr, "Parsing failed [%d]: %s\n", ret, strerror(ret));
+        return 1;
+    }
+
+    for (i = 0; i < reply->num_entries; i++) {
+        ret = compare_attrs(old_entries[i], new_entries[i]);
+        if (ret != EOK) {
+            fprintf(stderr, "Entry %u differs between the two modes\n",
+                    (unsigned int)i);
+            return 1;
+        }
+    }
+
+    printf("mode        time(s)   allocations        bytes\n");
+    printf("per-value %9.3f %13llu %12llu\n", old_sec,
+           (unsigned long long)old_blocks, (unsigned long long)old_bytes);
+    printf("batched   %9.3f %13llu %12llu\n", new_sec,
+           (unsigned long long)new_blocks, (unsigned long long)new_bytes);
+
+    talloc_free(ctx);
+    return 0;
+}
@@ -28,6 +28,10 @@
 #include <pwd.h>
 #include <grp.h>
 #include <errno.h>
+#include <sys/time.h>
+#if HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "util/util.h"
 #include "tests/common.h"
@@ -37,6 +41,7 @@
 
 #define NAME_SIZE       255
 #define CHUNK           64
+#define BUFSIZE         16384
 
 
 /* How many tests failed */
@@ -51,13 +56,14 @@ int verbose;
  */
 int test_lookup_user(const char *name, int enoent_fail)
 {
+    struct passwd pwd_buf;
     struct passwd *pwd = NULL;
+    char buf[BUFSIZE];
     int ret = 0;
     int error;
 
-    errno = 0;
-    pwd = getpwnam(name);
-    error = errno;
+    /* reentrant version, lookups may run in several threads */
+    error = getpwnam_r(name, &pwd_buf, buf, BUFSIZE, &pwd);
     if (pwd == NULL) {
         if (error == 0 || error == ENOENT) {
             ret = (enoent_fail == 1) ? ENOENT : 0;
@@ -79,13 +85,16 @@ int test_lookup_user(const char *name, int enoent_fail)
  */
 int test_lookup_group(const char *name, int enoent_fail)
 {
+    struct group grp_buf;
     struct group *grp = NULL;
+    char buf[BUFSIZE];
     int ret = 0;
+    int error;
 
-    errno = 0;
-    grp = getgrnam(name);
+    /* reentrant version, lookups may run in several threads */
+    error = getgrnam_r(name, &grp_buf, buf, BUFSIZE, &grp);
     if (grp == NULL) {
-        if (errno == 0 || errno == ENOENT) {
+        if (error == 0 || error == ENOENT) {
             ret = enoent_fail ? ENOENT : 0;
         }
     }
@@ -108,6 +117,104 @@ int run_one_testcase(const char *name, int group, int enoent_fail)
     }
 }
 
+#if HAVE_PTHREAD
+struct thread_data {
+    pthread_t tid;
+    char **names;
+    int num_names;
+    int offset;
+    int step;
+    int repeat;
+    int group;
+    int enoent_fail;
+
+    int lookups;
+    int failures;
+};
+
+/*
+ * Every thread looks up every step-th name starting at offset, repeat times
+ */
+static void *lookup_thread(void *ptr)
+{
+    struct thread_data *td = (struct thread_data *) ptr;
+    int i, r;
+
+    for (r = 0; r < td->repeat; r++) {
+        for (i = td->offset; i < td->num_names; i += td->step) {
+            if (run_one_testcase(td->names[i], td->group, td->enoent_fail)) {
+                td->failures++;
+            }
+            td->lookups++;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Runs the lookups in num_threads threads of one process, so that the
+ * client library is exercised concurrently. Returns the number of failures.
+ */
+static int run_threaded(char **names, int num_threads, int repeat,
+                        int group, int enoent_fail)
+{
+    struct thread_data *threads;
+    struct timeval start, end;
+    double elapsed;
+    int num_names;
+    int lookups = 0;
+    int failures = 0;
+    int ret;
+    int i;
+
+    for (num_names = 0; names[num_names]; num_names++) ;
+
+    threads = talloc_zero_array(NULL, struct thread_data, num_threads);
+    if (threads == NULL) {
+        return ENOMEM;
+    }
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < num_threads; i++) {
+        threads[i].names = names;
+        threads[i].num_names = num_names;
+        threads[i].offset = i;
+        threads[i].step = num_threads;
+        threads[i].repeat = repeat;
+        threads[i].group = group;
+        threads[i].enoent_fail = enoent_fail;
+
+        ret = pthread_create(&threads[i].tid, NULL,
+                             lookup_thread, &threads[i]);
+        if (ret != 0) {
+            fprintf(stderr, "pthread_create failed: %s\n", strerror(ret));
+            num_threads = i;
+            failures++;
+            break;
+        }
+    }
+
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i].tid, NULL);
+        lookups += threads[i].lookups;
+        failures += threads[i].failures;
+    }
+
+    gettimeofday(&end, NULL);
+    elapsed = (end.tv_sec - start.tv_sec) +
+              (end.tv_usec - start.tv_usec) / 1000000.0;
+
+    fprintf(stderr, "%d threads, %d lookups in %.3f seconds (%.0f/s)\n",
+            num_threads, lookups, elapsed,
+            elapsed > 0 ? lookups / elapsed : 0);
+
+    talloc_free(threads);
+    return failures;
+}
+#endif
+
 /*
  * Beware, has side-effects: changes global variable failure_count
  */
@@ -203,6 +310,8 @@ int main(int argc, const char *argv[])
     int pc_enoent_fail=0;
     int pc_groups=0;
     int pc_verbosity = 0;
+    int pc_threads = 0;
+    int pc_repeat = 1;
     char *pc_prefix = NULL;
     TALLOC_CTX *ctx = NULL;
     char **names = NULL;
@@ -226,6 +335,14 @@ int main(int argc, const char *argv[])
         { "enoent-fail", '\0', POPT_ARG_NONE, &pc_enoent_fail, 0,
                     "Fail on not getting the requested NSS data (default: No)",
                     NULL },
+#if HAVE_PTHREAD
+        { "threads", '\0', POPT_ARG_INT, &pc_threads, 0,
+                    "Run the lookups in N threads of a single process "
+                    "instead of one child process per name", "N" },
+        { "repeat", '\0', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_repeat, 0,
+                    "How many times each thread looks up its names", NULL },
+#endif
         { "verbose", 'v', POPT_ARG_NONE, 0, 'v',
                     "Be verbose", NULL },
         POPT_TABLEEND
@@ -272,6 +389,14 @@ int main(int argc, const char *argv[])
         }
     }
 
+#if HAVE_PTHREAD
+    if (pc_threads > 0) {
+        failure_count = run_threaded(names, pc_threads, pc_repeat,
+                                     pc_groups, pc_enoent_fail);
+        return (failure_count==0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+#endif
+
     /* Reap the children in a handler asynchronously so we can
      * somehow protect against too many processes */
     memset(&action, 0, sizeof(action));
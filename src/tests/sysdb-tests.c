@@ -31,6 +31,7 @@
 #include "db/sysdb_private.h"
 #include "db/sysdb_services.h"
 #include "db/sysdb_autofs.h"
+#include "db/sysdb_sudo.h"
 #include "tests/common.h"
 
 #define TESTS_PATH "tests_sysdb"
@@ -51,8 +52,17 @@
 #define MBO_GROUP_BASE 28500
 #define NUM_GHOSTS 10
 
+#define MBO_GRAPH_BASE 28800
+#define NUM_GRAPH_GROUPS 15
+
+#define MBO_BULK_BASE 28900
+#define NUM_BULK_GROUPS 4
+
 #define TEST_AUTOFS_MAP_BASE 29500
 
+#define TEST_SUDO_USER "sudouser"
+#define TEST_SUDO_UID 29600
+
 struct sysdb_test_ctx {
     struct sysdb_ctx *sysdb;
     struct confdb_ctx *confdb;
@@ -1118,6 +1128,93 @@ START_TEST (test_sysdb_enumpwent)
 END_TEST
 
 
+START_TEST (test_sysdb_enumpwent_cursor)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct sysdb_enum_cursor *cursor;
+    struct ldb_result *res;
+    size_t offset;
+    size_t total;
+    int ret;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up the test");
+        return;
+    }
+
+    ret = sysdb_enumpwent_cursor(test_ctx,
+                                 test_ctx->sysdb,
+                                 test_ctx->domain,
+                                 &cursor);
+    fail_unless(ret == EOK,
+                "sysdb_enumpwent_cursor failed (%d: %s)",
+                ret, strerror(ret));
+    fail_if(sysdb_enum_cursor_count(cursor) != 10,
+            "Expected 10 users, got %zu", sysdb_enum_cursor_count(cursor));
+
+    /* read it back in pages that do not divide the total evenly */
+    total = 0;
+    for (offset = 0; ; offset += 3) {
+        ret = sysdb_enum_cursor_fetch(test_ctx, cursor, offset, 3, &res);
+        if (ret == ENOENT) break;
+        fail_unless(ret == EOK,
+                    "sysdb_enum_cursor_fetch failed (%d: %s)",
+                    ret, strerror(ret));
+        fail_if(res->count > 3, "Page too large: %d", res->count);
+        total += res->count;
+        talloc_free(res);
+    }
+
+    fail_if(total != 10, "Expected 10 users, got %zu", total);
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+START_TEST (test_sysdb_enumgrent_cursor)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct sysdb_enum_cursor *cursor;
+    struct ldb_result *res;
+    size_t offset;
+    size_t total;
+    int ret;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up the test");
+        return;
+    }
+
+    ret = sysdb_enumgrent_cursor(test_ctx,
+                                 test_ctx->sysdb,
+                                 test_ctx->domain,
+                                 &cursor);
+    fail_unless(ret == EOK,
+                "sysdb_enumgrent_cursor failed (%d: %s)",
+                ret, strerror(ret));
+
+    total = 0;
+    for (offset = 0; ; offset += 7) {
+        ret = sysdb_enum_cursor_fetch(test_ctx, cursor, offset, 7, &res);
+        if (ret == ENOENT) break;
+        fail_unless(ret == EOK,
+                    "sysdb_enum_cursor_fetch failed (%d: %s)",
+                    ret, strerror(ret));
+        total += res->count;
+        talloc_free(res);
+    }
+
+    /* 10 groups + 10 users (we're MPG) */
+    fail_if(total != 20, "Expected 20 groups, got %zu", total);
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST (test_sysdb_set_user_attr)
 {
     struct sysdb_test_ctx *test_ctx;
@@ -1335,6 +1432,103 @@ START_TEST (test_sysdb_initgroups)
 }
 END_TEST
 
+START_TEST (test_sysdb_initgroups_gids)
+{
+    struct sysdb_test_ctx *test_ctx;
+    int ret;
+    const char *username;
+    const char *groupname;
+    const char *stored;
+    const char *attrs[] = { SYSDB_INITGR_GIDS, NULL };
+    struct sysdb_attrs *attrs_bogus;
+    struct ldb_result *res;
+    gid_t gid;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up the test");
+        return;
+    }
+
+    username = talloc_asprintf(test_ctx, "testuser%d", _i);
+    groupname = talloc_asprintf(test_ctx, "testgroup%d", _i + 1000);
+
+    /* nothing stored yet, the full lookup is used */
+    ret = sysdb_initgroups_gids(test_ctx, test_ctx->sysdb,
+                                test_ctx->domain, username, &res);
+    fail_if(ret != EOK, "sysdb_initgroups_gids failed\n");
+    fail_if(res->count != 2, "expected 2 groups, got %d\n", res->count);
+
+    ret = sysdb_update_initgr_gids(test_ctx->sysdb, test_ctx->domain,
+                                   username);
+    fail_if(ret != EOK, "sysdb_update_initgr_gids failed\n");
+
+    ret = sysdb_get_user_attr(test_ctx, test_ctx->sysdb, test_ctx->domain,
+                              username, attrs, &res);
+    fail_if(ret != EOK || res->count != 1, "Could not read the user\n");
+    stored = ldb_msg_find_attr_as_string(res->msgs[0],
+                                         SYSDB_INITGR_GIDS, NULL);
+    fail_if(stored == NULL, "The gid list was not stored\n");
+
+    /* the stored list is used */
+    ret = sysdb_initgroups_gids(test_ctx, test_ctx->sysdb,
+                                test_ctx->domain, username, &res);
+    fail_if(ret != EOK, "sysdb_initgroups_gids failed\n");
+    fail_if(res->count != 2, "expected 2 groups, got %d\n", res->count);
+    fail_if(ldb_msg_find_attr_as_uint(res->msgs[0], SYSDB_UIDNUM, 0) != _i,
+            "Did not find the expected user\n");
+    gid = ldb_msg_find_attr_as_uint(res->msgs[1], SYSDB_GIDNUM, 0);
+    fail_unless(gid == _i + 1000,
+                "Did not find the expected GID (found %d expected %d)",
+                gid, _i + 1000);
+
+    /* a gid change drops the lists of the members */
+    ret = sysdb_store_group(test_ctx->sysdb, test_ctx->domain, groupname,
+                            _i + 50000, NULL, 0, 0);
+    fail_if(ret != EOK, "Could not change the gid of %s\n", groupname);
+
+    ret = sysdb_get_user_attr(test_ctx, test_ctx->sysdb, test_ctx->domain,
+                              username, attrs, &res);
+    fail_if(ret != EOK || res->count != 1, "Could not read the user\n");
+    fail_if(ldb_msg_find_element(res->msgs[0], SYSDB_INITGR_GIDS) != NULL,
+            "The gid list was not dropped\n");
+
+    ret = sysdb_initgroups_gids(test_ctx, test_ctx->sysdb,
+                                test_ctx->domain, username, &res);
+    fail_if(ret != EOK, "sysdb_initgroups_gids failed\n");
+    gid = ldb_msg_find_attr_as_uint(res->msgs[1], SYSDB_GIDNUM, 0);
+    fail_unless(gid == _i + 50000,
+                "Did not find the expected GID (found %d expected %d)",
+                gid, _i + 50000);
+
+    ret = sysdb_store_group(test_ctx->sysdb, test_ctx->domain, groupname,
+                            _i + 1000, NULL, 0, 0);
+    fail_if(ret != EOK, "Could not restore the gid of %s\n", groupname);
+
+    /* a list that does not match the memberships is ignored */
+    attrs_bogus = sysdb_new_attrs(test_ctx);
+    fail_if(attrs_bogus == NULL, "Out of memory\n");
+    ret = sysdb_attrs_add_string(attrs_bogus, SYSDB_INITGR_GIDS,
+                                 "1;0:00000000:00000000;4242");
+    fail_if(ret != EOK, "Could not build the attributes\n");
+    ret = sysdb_set_user_attr(test_ctx->sysdb, test_ctx->domain, username,
+                              attrs_bogus, SYSDB_MOD_REP);
+    fail_if(ret != EOK, "Could not store the bogus gid list\n");
+
+    ret = sysdb_initgroups_gids(test_ctx, test_ctx->sysdb,
+                                test_ctx->domain, username, &res);
+    fail_if(ret != EOK, "sysdb_initgroups_gids failed\n");
+    fail_if(res->count != 2, "expected 2 groups, got %d\n", res->count);
+    gid = ldb_msg_find_attr_as_uint(res->msgs[1], SYSDB_GIDNUM, 0);
+    fail_unless(gid == _i + 1000,
+                "Did not find the expected GID (found %d expected %d)",
+                gid, _i + 1000);
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST (test_sysdb_remove_group_member)
 {
     struct sysdb_test_ctx *test_ctx;
@@ -3429,6 +3623,344 @@ START_TEST (test_sysdb_memberof_user_cleanup)
 }
 END_TEST
 
+/* Groups form a binary tree, group i being a member of group (i - 1) / 2,
+ * and user i is a member of group i. The detached group is not a member of
+ * its parent. */
+static int graph_parent(int i, int detached)
+{
+    if (i == 0 || i == detached) return -1;
+    return (i - 1) / 2;
+}
+
+static bool graph_is_below(int i, int g, int detached)
+{
+    while (i != -1) {
+        if (i == g) return true;
+        i = graph_parent(i, detached);
+    }
+    return false;
+}
+
+static void test_memberof_graph_check(struct sysdb_test_ctx *test_ctx,
+                                      int detached)
+{
+    const char *mo_attrs[] = { SYSDB_MEMBEROF, NULL };
+    const char *mu_attrs[] = { SYSDB_MEMBERUID, NULL };
+    struct ldb_message_element *el;
+    struct ldb_message *msg;
+    char *name;
+    int expected;
+    int ret;
+    int i, g;
+
+    for (i = 0; i < NUM_GRAPH_GROUPS; i++) {
+        expected = 0;
+        for (g = 0; g < NUM_GRAPH_GROUPS; g++) {
+            if (graph_is_below(i, g, detached)) expected++;
+        }
+
+        name = talloc_asprintf(test_ctx, "graphuser%d", i);
+        fail_if(name == NULL, "Out of memory");
+        ret = sysdb_search_user_by_name(test_ctx, test_ctx->sysdb,
+                                        test_ctx->domain, name,
+                                        mo_attrs, &msg);
+        fail_if(ret != EOK, "Cannot find user %s", name);
+
+        el = ldb_msg_find_element(msg, SYSDB_MEMBEROF);
+        fail_unless(el != NULL && el->num_values == expected,
+                    "User %s has %d memberof values, expected %d",
+                    name, el ? el->num_values : 0, expected);
+        talloc_free(name);
+        talloc_free(msg);
+    }
+
+    for (g = 0; g < NUM_GRAPH_GROUPS; g++) {
+        expected = 0;
+        for (i = 0; i < NUM_GRAPH_GROUPS; i++) {
+            if (graph_is_below(i, g, detached)) expected++;
+        }
+
+        name = talloc_asprintf(test_ctx, "graphgroup%d", g);
+        fail_if(name == NULL, "Out of memory");
+        ret = sysdb_search_group_by_name(test_ctx, test_ctx->sysdb,
+                                         test_ctx->domain, name,
+                                         mu_attrs, &msg);
+        fail_if(ret != EOK, "Cannot find group %s", name);
+
+        el = ldb_msg_find_element(msg, SYSDB_MEMBERUID);
+        fail_unless(el != NULL && el->num_values == expected,
+                    "Group %s has %d memberuid values, expected %d",
+                    name, el ? el->num_values : 0, expected);
+        talloc_free(name);
+        talloc_free(msg);
+    }
+}
+
+/* _i == 1 runs the same steps without the memberof group graph */
+START_TEST (test_sysdb_memberof_graph_nested)
+{
+    struct sysdb_test_ctx *test_ctx;
+    const char *groups[NUM_GRAPH_GROUPS];
+    const char *users[NUM_GRAPH_GROUPS];
+    int ret;
+    int i;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up the test");
+        return;
+    }
+
+    if (_i) {
+        ret = ldb_set_opaque(sysdb_ctx_get_ldb(test_ctx->sysdb),
+                             SYSDB_MEMBEROF_NOGRAPH, test_ctx);
+        fail_unless(ret == LDB_SUCCESS, "Cannot disable the graph");
+    }
+
+    for (i = 0; i < NUM_GRAPH_GROUPS; i++) {
+        groups[i] = talloc_asprintf(test_ctx, "graphgroup%d", i);
+        users[i] = talloc_asprintf(test_ctx, "graphuser%d", i);
+        fail_if(groups[i] == NULL || users[i] == NULL, "Out of memory");
+
+        ret = sysdb_add_group(test_ctx->sysdb, test_ctx->domain,
+                              groups[i], MBO_GRAPH_BASE + i, NULL, 0, 0);
+        fail_unless(ret == EOK, "Cannot add group %s", groups[i]);
+
+        ret = sysdb_add_user(test_ctx->sysdb, test_ctx->domain, users[i],
+                             MBO_GRAPH_BASE + i, 0, users[i], "/", "/bin/sh",
+                             NULL, NULL, 0, 0);
+        fail_unless(ret == EOK, "Cannot add user %s", users[i]);
+
+        ret = sysdb_add_group_member(test_ctx->sysdb, test_ctx->domain,
+                                     groups[i], users[i], SYSDB_MEMBER_USER);
+        fail_unless(ret == EOK, "Cannot add %s to %s", users[i], groups[i]);
+    }
+
+    /* link from the leaves up so that whole subtrees get new parents */
+    for (i = NUM_GRAPH_GROUPS - 1; i > 0; i--) {
+        ret = sysdb_add_group_member(test_ctx->sysdb, test_ctx->domain,
+                                     groups[graph_parent(i, -1)], groups[i],
+                                     SYSDB_MEMBER_GROUP);
+        fail_unless(ret == EOK, "Cannot nest %s", groups[i]);
+    }
+    test_memberof_graph_check(test_ctx, -1);
+
+    ret = sysdb_remove_group_member(test_ctx->sysdb, test_ctx->domain,
+                                    groups[0], groups[1], SYSDB_MEMBER_GROUP);
+    fail_unless(ret == EOK, "Cannot remove %s", groups[1]);
+    test_memberof_graph_check(test_ctx, 1);
+
+    ret = sysdb_add_group_member(test_ctx->sysdb, test_ctx->domain,
+                                 groups[0], groups[1], SYSDB_MEMBER_GROUP);
+    fail_unless(ret == EOK, "Cannot add back %s", groups[1]);
+    test_memberof_graph_check(test_ctx, -1);
+
+    for (i = 0; i < NUM_GRAPH_GROUPS; i++) {
+        ret = sysdb_delete_user(test_ctx->sysdb, test_ctx->domain,
+                                users[i], 0);
+        fail_unless(ret == EOK, "Cannot delete user %s", users[i]);
+    }
+    for (i = 0; i < NUM_GRAPH_GROUPS; i++) {
+        ret = sysdb_delete_group(test_ctx->sysdb, test_ctx->domain,
+                                 groups[i], 0);
+        fail_unless(ret == EOK, "Cannot delete group %s", groups[i]);
+    }
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
+static void test_bulk_check(struct sysdb_test_ctx *test_ctx,
+                            const char *name, bool is_user,
+                            int expected, bool ghosts)
+{
+    const char *attrs[] = { SYSDB_MEMBEROF, SYSDB_MEMBERUID, SYSDB_GHOST,
+                            NULL };
+    struct ldb_message_element *el;
+    struct ldb_message *msg;
+    const char *attr;
+    int ret;
+
+    if (is_user) {
+        attr = SYSDB_MEMBEROF;
+        ret = sysdb_search_user_by_name(test_ctx, test_ctx->sysdb,
+                                        test_ctx->domain, name, attrs, &msg);
+    } else {
+        attr = SYSDB_MEMBERUID;
+        ret = sysdb_search_group_by_name(test_ctx, test_ctx->sysdb,
+                                         test_ctx->domain, name, attrs, &msg);
+    }
+    fail_if(ret != EOK, "Cannot find %s", name);
+
+    /* -1 when the count depends on the order of the stores */
+    el = ldb_msg_find_element(msg, attr);
+    fail_unless(expected == -1 || (el ? el->num_values : 0) == expected,
+                "%s has %d %s values, expected %d",
+                name, el ? el->num_values : 0, attr, expected);
+
+    el = ldb_msg_find_element(msg, SYSDB_GHOST);
+    fail_unless((el != NULL && el->num_values > 0) == ghosts,
+                "%s has %d ghost values", name, el ? el->num_values : 0);
+
+    talloc_free(msg);
+}
+
+static void test_bulk_batch_start(struct sysdb_test_ctx *test_ctx)
+{
+    int ret;
+
+    ret = sysdb_transaction_start(test_ctx->sysdb);
+    fail_unless(ret == EOK, "Cannot start transaction");
+    ret = sysdb_bulk_batch_start(test_ctx->sysdb);
+    fail_unless(ret == EOK, "Cannot start batch");
+}
+
+static void test_bulk_batch_end(struct sysdb_test_ctx *test_ctx)
+{
+    int ret;
+
+    sysdb_bulk_batch_end(test_ctx->sysdb);
+    ret = sysdb_transaction_commit(test_ctx->sysdb);
+    fail_unless(ret == EOK, "Cannot commit transaction");
+}
+
+/* Group i is a member of group i - 1 and bulkuser i of group i. Entries
+ * stored in the batches of a bulk session get their memberships when the
+ * session ends, a user stored outside of them right away. */
+START_TEST (test_sysdb_bulk_session)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct sysdb_attrs *attrs;
+    struct sysdb_bulk *bulk;
+    struct sysdb_bulk_stats stats;
+    const char *groups[NUM_BULK_GROUPS];
+    const char *users[NUM_BULK_GROUPS - 1];
+    int ret;
+    int i;
+
+    /* Setup */
+    ret = setup_sysdb_tests(&test_ctx);
+    if (ret != EOK) {
+        fail("Could not set up the test");
+        return;
+    }
+
+    ret = sysdb_bulk_start(test_ctx, test_ctx->sysdb, &bulk);
+    fail_unless(ret == EOK, "Cannot start bulk session");
+
+    /* a batch needs the transaction it is stored in */
+    ret = sysdb_bulk_batch_start(test_ctx->sysdb);
+    fail_unless(ret == EINVAL, "Batch started without a transaction");
+
+    test_bulk_batch_start(test_ctx);
+    for (i = 0; i < NUM_BULK_GROUPS; i++) {
+        groups[i] = talloc_asprintf(test_ctx, "bulkgroup%d", i);
+        fail_if(groups[i] == NULL, "Out of memory");
+
+        attrs = sysdb_new_attrs(test_ctx);
+        fail_if(attrs == NULL, "Out of memory");
+        if (i == 0) {
+            ret = sysdb_attrs_add_string(attrs, SYSDB_GHOST, "bulklate");
+            fail_unless(ret == EOK, "Cannot add ghost");
+        } else if (i == 1) {
+            ret = sysdb_attrs_add_string(attrs, SYSDB_GHOST, "bulkplain");
+            fail_unless(ret == EOK, "Cannot add ghost");
+        }
+
+        ret = sysdb_store_group(test_ctx->sysdb, test_ctx->domain, groups[i],
+                                MBO_BULK_BASE + i, attrs, 0, 0);
+        fail_unless(ret == EOK, "Cannot store group %s", groups[i]);
+        talloc_free(attrs);
+
+        if (i > 0) {
+            ret = sysdb_add_group_member(test_ctx->sysdb, test_ctx->domain,
+                                         groups[i - 1], groups[i],
+                                         SYSDB_MEMBER_GROUP);
+            fail_unless(ret == EOK, "Cannot nest %s", groups[i]);
+        }
+    }
+
+    for (i = 0; i < NUM_BULK_GROUPS - 1; i++) {
+        users[i] = talloc_asprintf(test_ctx, "bulkuser%d", i);
+        fail_if(users[i] == NULL, "Out of memory");
+
+        ret = sysdb_store_user(test_ctx->sysdb, test_ctx->domain, users[i],
+                               NULL, MBO_BULK_BASE + i, MBO_BULK_BASE + i,
+                               users[i], "/", "/bin/sh", NULL, NULL, NULL,
+                               0, 0);
+        fail_unless(ret == EOK, "Cannot store user %s", users[i]);
+
+        ret = sysdb_add_group_member(test_ctx->sysdb, test_ctx->domain,
+                                     groups[i], users[i], SYSDB_MEMBER_USER);
+        fail_unless(ret == EOK, "Cannot add %s to %s", users[i], groups[i]);
+    }
+    test_bulk_batch_end(test_ctx);
+
+    /* deferred until the session ends */
+    test_bulk_check(test_ctx, users[1], true, 0, false);
+
+    /* stored by another request while the session is active */
+    ret = sysdb_store_user(test_ctx->sysdb, test_ctx->domain, "bulkplain",
+                           NULL, MBO_BULK_BASE + 10, MBO_BULK_BASE + 10,
+                           "bulkplain", "/", "/bin/sh", NULL, NULL, NULL,
+                           0, 0);
+    fail_unless(ret == EOK, "Cannot store user bulkplain");
+    test_bulk_check(test_ctx, groups[1], false, 1, false);
+
+    /* ghosts of users stored in a batch are replaced at the end */
+    test_bulk_batch_start(test_ctx);
+    ret = sysdb_store_user(test_ctx->sysdb, test_ctx->domain, "bulklate",
+                           NULL, MBO_BULK_BASE + 11, MBO_BULK_BASE + 11,
+                           "bulklate", "/", "/bin/sh", NULL, NULL, NULL,
+                           0, 0);
+    fail_unless(ret == EOK, "Cannot store user bulklate");
+    test_bulk_batch_end(test_ctx);
+    test_bulk_check(test_ctx, groups[0], false, -1, true);
+
+    sysdb_bulk_get_stats(bulk, &stats);
+    fail_unless(stats.batches == 2, "Expected 2 batches, got %llu",
+                (unsigned long long) stats.batches);
+    /* the bulkusers and bulklate, bulkplain was not stored in a batch */
+    fail_unless(stats.staged_users == NUM_BULK_GROUPS,
+                "Expected %d staged users, got %llu", NUM_BULK_GROUPS,
+                (unsigned long long) stats.staged_users);
+
+    ret = sysdb_bulk_finish(bulk);
+    fail_unless(ret == EOK, "Cannot finish bulk session");
+    talloc_free(bulk);
+
+    for (i = 0; i < NUM_BULK_GROUPS - 1; i++) {
+        test_bulk_check(test_ctx, users[i], true, i + 1, false);
+    }
+    test_bulk_check(test_ctx, "bulkplain", true, 2, false);
+    test_bulk_check(test_ctx, "bulklate", true, 1, false);
+
+    /* the users below the group, members or former ghosts */
+    test_bulk_check(test_ctx, groups[0], false, 5, false);
+    test_bulk_check(test_ctx, groups[1], false, 3, false);
+    test_bulk_check(test_ctx, groups[2], false, 1, false);
+    test_bulk_check(test_ctx, groups[3], false, 0, false);
+
+    for (i = 0; i < NUM_BULK_GROUPS - 1; i++) {
+        ret = sysdb_delete_user(test_ctx->sysdb, test_ctx->domain,
+                                users[i], 0);
+        fail_unless(ret == EOK, "Cannot delete user %s", users[i]);
+    }
+    ret = sysdb_delete_user(test_ctx->sysdb, test_ctx->domain, "bulkplain", 0);
+    fail_unless(ret == EOK, "Cannot delete user bulkplain");
+    ret = sysdb_delete_user(test_ctx->sysdb, test_ctx->domain, "bulklate", 0);
+    fail_unless(ret == EOK, "Cannot delete user bulklate");
+    for (i = 0; i < NUM_BULK_GROUPS; i++) {
+        ret = sysdb_delete_group(test_ctx->sysdb, test_ctx->domain,
+                                 groups[i], 0);
+        fail_unless(ret == EOK, "Cannot delete group %s", groups[i]);
+    }
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 START_TEST (test_sysdb_attrs_to_list)
 {
     struct sysdb_attrs *attrs_list[3];
@@ -4893,6 +5425,228 @@ END_TEST
 
 #endif /* BUILD_AUTOFS */
 
+/* Stores a sudo rule the way sysdb_save_sudorule() does. netgroup_user is
+ * the value of sudoNetgroupUser, NULL for rules cached before it existed. */
+static errno_t store_sudo_rule(struct sysdb_test_ctx *test_ctx,
+                               const char *name, const char *user,
+                               const char *netgroup_user)
+{
+    struct sysdb_attrs *attrs;
+    errno_t ret;
+
+    attrs = sysdb_new_attrs(test_ctx);
+    if (attrs == NULL) return ENOMEM;
+
+    ret = sysdb_attrs_add_string(attrs, SYSDB_OBJECTCLASS,
+                                 SYSDB_SUDO_CACHE_OC);
+    if (ret == EOK) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_NAME, name);
+    }
+    if (ret == EOK) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_USER, user);
+    }
+    if (ret == EOK && netgroup_user != NULL) {
+        ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_NETGROUP_USER,
+                                     netgroup_user);
+    }
+    if (ret == EOK) {
+        ret = sysdb_store_custom(test_ctx->sysdb, test_ctx->domain, name,
+                                 SUDORULE_SUBDIR, attrs);
+    }
+
+    talloc_free(attrs);
+    return ret;
+}
+
+static size_t count_sudo_rules(struct sysdb_test_ctx *test_ctx,
+                               const char *filter, const char *name)
+{
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct ldb_message **msgs;
+    const char *rule;
+    size_t count;
+    size_t found = 0;
+    size_t i;
+    errno_t ret;
+
+    ret = sysdb_search_custom(test_ctx, test_ctx->sysdb, test_ctx->domain,
+                              filter, SUDORULE_SUBDIR, attrs, &count, &msgs);
+    if (ret == ENOENT) return 0;
+    fail_if(ret != EOK, "Could not search sudo rules [%d]: %s",
+            ret, strerror(ret));
+
+    for (i = 0; i < count; i++) {
+        rule = ldb_msg_find_attr_as_string(msgs[i], SYSDB_NAME, NULL);
+        if (rule != NULL && strcmp(rule, name) == 0) {
+            found++;
+        }
+    }
+
+    talloc_free(msgs);
+    return found;
+}
+
+#ifdef BUILD_SUDO
+START_TEST(test_sysdb_sudo_netgroup_filter)
+{
+    struct sysdb_test_ctx *test_ctx;
+    char *filter;
+    errno_t ret;
+
+    ret = setup_sysdb_tests(&test_ctx);
+    fail_if(ret != EOK, "Could not set up the test");
+
+    ret = store_sudo_rule(test_ctx, "sudo_ngr_rule", "+sudo_netgroup",
+                          "TRUE");
+    fail_if(ret != EOK, "Could not store netgroup rule");
+    ret = store_sudo_rule(test_ctx, "sudo_user_rule", TEST_SUDO_USER,
+                          "FALSE");
+    fail_if(ret != EOK, "Could not store user rule");
+    ret = store_sudo_rule(test_ctx, "sudo_other_rule", "otheruser",
+                          "FALSE");
+    fail_if(ret != EOK, "Could not store rule of another user");
+
+    /* netgroup rules are candidates for every user */
+    ret = sysdb_get_sudo_filter(test_ctx, TEST_SUDO_USER, TEST_SUDO_UID,
+                                NULL, SYSDB_SUDO_FILTER_USERINFO, &filter);
+    fail_if(ret != EOK, "Could not build the sudo filter");
+    fail_if(strstr(filter, SYSDB_SUDO_CACHE_AT_NETGROUP_USER"=TRUE") == NULL,
+            "Netgroup rules are not matched by sudoNetgroupUser: %s", filter);
+
+    fail_unless(count_sudo_rules(test_ctx, filter, "sudo_ngr_rule") == 1,
+                "Netgroup rule not found");
+    fail_unless(count_sudo_rules(test_ctx, filter, "sudo_user_rule") == 1,
+                "User rule not found");
+    fail_unless(count_sudo_rules(test_ctx, filter, "sudo_other_rule") == 0,
+                "Rule of another user found");
+
+    /* without the netgroup flag only the rule of the user matches */
+    ret = sysdb_get_sudo_filter(test_ctx, TEST_SUDO_USER, TEST_SUDO_UID,
+                                NULL, SYSDB_SUDO_FILTER_USERNAME, &filter);
+    fail_if(ret != EOK, "Could not build the sudo filter");
+
+    fail_unless(count_sudo_rules(test_ctx, filter, "sudo_ngr_rule") == 0,
+                "Netgroup rule found without SYSDB_SUDO_FILTER_NGRS");
+    fail_unless(count_sudo_rules(test_ctx, filter, "sudo_user_rule") == 1,
+                "User rule not found");
+
+    ret = sysdb_delete_custom(test_ctx->sysdb, test_ctx->domain,
+                              "sudo_ngr_rule", SUDORULE_SUBDIR);
+    fail_if(ret != EOK, "Could not delete netgroup rule");
+    ret = sysdb_delete_custom(test_ctx->sysdb, test_ctx->domain,
+                              "sudo_user_rule", SUDORULE_SUBDIR);
+    fail_if(ret != EOK, "Could not delete user rule");
+    ret = sysdb_delete_custom(test_ctx->sysdb, test_ctx->domain,
+                              "sudo_other_rule", SUDORULE_SUBDIR);
+    fail_if(ret != EOK, "Could not delete rule of another user");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+#endif /* BUILD_SUDO */
+
+/* Turns the cache back into a 0.15 one: no sudoNetgroupUser index and
+ * netgroup rules without the flag, then runs the upgrade */
+START_TEST(test_sysdb_upgrade_15)
+{
+    struct sysdb_test_ctx *test_ctx;
+    struct ldb_message *msg;
+    struct ldb_result *res;
+    struct ldb_message_element *el;
+    const char *version;
+    const char *filter;
+    errno_t ret;
+    int lret;
+    bool indexed;
+    int i;
+
+    ret = setup_sysdb_tests(&test_ctx);
+    fail_if(ret != EOK, "Could not set up the test");
+
+    ret = store_sudo_rule(test_ctx, "upgrade_ngr_rule", "+sudo_netgroup",
+                          NULL);
+    fail_if(ret != EOK, "Could not store netgroup rule");
+    ret = store_sudo_rule(test_ctx, "upgrade_user_rule", TEST_SUDO_USER,
+                          NULL);
+    fail_if(ret != EOK, "Could not store user rule");
+
+    msg = ldb_msg_new(test_ctx);
+    fail_if(msg == NULL, "Out of memory");
+    msg->dn = ldb_dn_new(msg, test_ctx->sysdb->ldb, "@INDEXLIST");
+    fail_if(msg->dn == NULL, "Out of memory");
+    lret = ldb_msg_add_empty(msg, "@IDXATTR", LDB_FLAG_MOD_DELETE, NULL);
+    fail_if(lret != LDB_SUCCESS, "Out of memory");
+    lret = ldb_msg_add_string(msg, "@IDXATTR",
+                              SYSDB_SUDO_CACHE_AT_NETGROUP_USER);
+    fail_if(lret != LDB_SUCCESS, "Out of memory");
+    lret = ldb_modify(test_ctx->sysdb->ldb, msg);
+    fail_if(lret != LDB_SUCCESS, "Could not drop the index: %s",
+            ldb_errstring(test_ctx->sysdb->ldb));
+    talloc_free(msg);
+
+    msg = ldb_msg_new(test_ctx);
+    fail_if(msg == NULL, "Out of memory");
+    msg->dn = ldb_dn_new(msg, test_ctx->sysdb->ldb, SYSDB_BASE);
+    fail_if(msg->dn == NULL, "Out of memory");
+    lret = ldb_msg_add_empty(msg, "version", LDB_FLAG_MOD_REPLACE, NULL);
+    fail_if(lret != LDB_SUCCESS, "Out of memory");
+    lret = ldb_msg_add_string(msg, "version", SYSDB_VERSION_0_15);
+    fail_if(lret != LDB_SUCCESS, "Out of memory");
+    lret = ldb_modify(test_ctx->sysdb->ldb, msg);
+    fail_if(lret != LDB_SUCCESS, "Could not set the version: %s",
+            ldb_errstring(test_ctx->sysdb->ldb));
+    talloc_free(msg);
+
+    ret = sysdb_upgrade_15(test_ctx->sysdb, &version);
+    fail_if(ret != EOK, "Upgrade failed [%d]: %s", ret, strerror(ret));
+    fail_if(strcmp(version, SYSDB_VERSION_0_16) != 0,
+            "Upgrade returned version %s", version);
+
+    lret = ldb_search(test_ctx->sysdb->ldb, test_ctx, &res,
+                      ldb_dn_new(test_ctx, test_ctx->sysdb->ldb, SYSDB_BASE),
+                      LDB_SCOPE_BASE, NULL, NULL);
+    fail_if(lret != LDB_SUCCESS || res->count != 1,
+            "Could not read the version");
+    version = ldb_msg_find_attr_as_string(res->msgs[0], "version", NULL);
+    fail_if(version == NULL || strcmp(version, SYSDB_VERSION_0_16) != 0,
+            "Version was not updated");
+    talloc_free(res);
+
+    lret = ldb_search(test_ctx->sysdb->ldb, test_ctx, &res,
+                      ldb_dn_new(test_ctx, test_ctx->sysdb->ldb, "@INDEXLIST"),
+                      LDB_SCOPE_BASE, NULL, NULL);
+    fail_if(lret != LDB_SUCCESS || res->count != 1,
+            "Could not read the index list");
+    el = ldb_msg_find_element(res->msgs[0], "@IDXATTR");
+    fail_if(el == NULL, "No indexed attributes");
+    indexed = false;
+    for (i = 0; i < el->num_values; i++) {
+        if (strcmp((const char *)el->values[i].data,
+                   SYSDB_SUDO_CACHE_AT_NETGROUP_USER) == 0) {
+            indexed = true;
+        }
+    }
+    fail_unless(indexed, "sudoNetgroupUser is not indexed");
+    talloc_free(res);
+
+    /* only the cached netgroup rule was flagged */
+    filter = "("SYSDB_SUDO_CACHE_AT_NETGROUP_USER"=TRUE)";
+    fail_unless(count_sudo_rules(test_ctx, filter, "upgrade_ngr_rule") == 1,
+                "Netgroup rule was not flagged");
+    fail_unless(count_sudo_rules(test_ctx, filter, "upgrade_user_rule") == 0,
+                "User rule was flagged");
+
+    ret = sysdb_delete_custom(test_ctx->sysdb, test_ctx->domain,
+                              "upgrade_ngr_rule", SUDORULE_SUBDIR);
+    fail_if(ret != EOK, "Could not delete netgroup rule");
+    ret = sysdb_delete_custom(test_ctx->sysdb, test_ctx->domain,
+                              "upgrade_user_rule", SUDORULE_SUBDIR);
+    fail_if(ret != EOK, "Could not delete user rule");
+
+    talloc_free(test_ctx);
+}
+END_TEST
+
 Suite *create_sysdb_suite(void)
 {
     Suite *s = suite_create("sysdb");
@@ -4943,6 +5697,7 @@ Suite *create_sysdb_suite(void)
 
     /* Enumerate the users */
     tcase_add_test(tc_sysdb, test_sysdb_enumpwent);
+    tcase_add_test(tc_sysdb, test_sysdb_enumpwent_cursor);
 
     /* Change their attribute */
     tcase_add_loop_test(tc_sysdb, test_sysdb_set_user_attr, 27010, 27020);
@@ -4969,12 +5724,14 @@ Suite *create_sysdb_suite(void)
 
     /* Enumerate the groups */
     tcase_add_test(tc_sysdb, test_sysdb_enumgrent);
+    tcase_add_test(tc_sysdb, test_sysdb_enumgrent_cursor);
 
     /* Add some members to the groups */
     tcase_add_loop_test(tc_sysdb, test_sysdb_add_group_member, 28010, 28020);
 
     /* Test that sysdb_initgroups() works */
     tcase_add_loop_test(tc_sysdb, test_sysdb_initgroups, 27010, 27020);
+    tcase_add_loop_test(tc_sysdb, test_sysdb_initgroups_gids, 27010, 27020);
 
     /* Authenticate with missing cached password */
     tcase_add_loop_test(tc_sysdb, test_sysdb_cached_authentication_missing_password,
@@ -5042,6 +5799,12 @@ Suite *create_sysdb_suite(void)
     tcase_add_test(tc_sysdb, test_group_rename);
     tcase_add_test(tc_sysdb, test_user_rename);
 
+    /* Test the sudoNetgroupUser flag of sudo rules */
+#ifdef BUILD_SUDO
+    tcase_add_test(tc_sysdb, test_sysdb_sudo_netgroup_filter);
+#endif
+    tcase_add_test(tc_sysdb, test_sysdb_upgrade_15);
+
 /* ===== NETGROUP TESTS ===== */
 
     /* Create a new netgroup */
@@ -5191,6 +5954,12 @@ Suite *create_sysdb_suite(void)
     tcase_add_loop_test(tc_memberof, test_sysdb_remove_local_group_by_gid,
                         MBO_GROUP_BASE , MBO_GROUP_BASE + 10);
 
+    /* nested hierarchy, with and without the memberof group graph */
+    tcase_add_loop_test(tc_memberof, test_sysdb_memberof_graph_nested, 0, 2);
+
+    /* bulk ingest with a store outside of its batches */
+    tcase_add_test(tc_memberof, test_sysdb_bulk_session);
+
     suite_add_tcase(s, tc_memberof);
 
     TCase *tc_subdomain = tcase_create("SYSDB sub-domain Tests");
@@ -0,0 +1,480 @@
+/*
+   SSSD
+
+   sysdb bulk ingest benchmark
+
+   Stores a synthetic directory of users and (nested) groups the way a
+   full LDAP enumeration does, once entry by entry as before and once
+   inside a bulk session, and compares the time it takes and the resulting
+   memberships.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <talloc.h>
+#include <tevent.h>
+#include <popt.h>
+
+#include "util/util.h"
+#include "confdb/confdb.h"
+#include "db/sysdb.h"
+
+#define BENCH_PATH "bench_sysdb_bulk"
+#define BENCH_CONF_FILE "bench_conf.ldb"
+
+#define DEFAULT_USERS   10000
+#define DEFAULT_GROUPS  3000
+#define DEFAULT_MEMBERS 20
+#define DEFAULT_FANOUT  10
+
+#define UID_BASE 20000
+#define GID_BASE 200000
+
+/* users stored only after the groups, the groups list them as ghosts */
+#define LATE_USERS_PERCENT 5
+
+struct bench_dir {
+    int num_users;
+    int num_groups;
+    int members;
+    int fanout;
+    int num_late;
+};
+
+struct bench_result {
+    double users;
+    double groups;
+    double late_users;
+    double finish;
+    uint64_t memberofs;
+    uint64_t memberuids;
+    uint64_t ghosts;
+};
+
+static double elapsed_sec(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+           (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static int bench_setup_confdb(TALLOC_CTX *mem_ctx, struct confdb_ctx **_cdb)
+{
+    const char *val[2] = { NULL, NULL };
+    const char *domains[] = { "plain", "bulk", NULL };
+    char *conf_db;
+    char *section;
+    int ret;
+    int i;
+
+    conf_db = talloc_asprintf(mem_ctx, "%s/%s", BENCH_PATH, BENCH_CONF_FILE);
+    if (!conf_db) return ENOMEM;
+
+    ret = confdb_init(mem_ctx, _cdb, conf_db);
+    if (ret != EOK) return ret;
+
+    val[0] = "plain, bulk";
+    ret = confdb_add_param(*_cdb, true, "config/sssd", "domains", val);
+    if (ret != EOK) return ret;
+
+    for (i = 0; domains[i]; i++) {
+        section = talloc_asprintf(mem_ctx, "config/domain/%s", domains[i]);
+        if (!section) return ENOMEM;
+
+        val[0] = "ldap";
+        ret = confdb_add_param(*_cdb, true, section, "id_provider", val);
+        if (ret != EOK) return ret;
+
+        val[0] = "TRUE";
+        ret = confdb_add_param(*_cdb, true, section, "enumerate", val);
+        if (ret != EOK) return ret;
+    }
+
+    return EOK;
+}
+
+static int bench_store_user(struct sss_domain_info *dom, int i, time_t now)
+{
+    char name[32];
+    char homedir[48];
+
+    snprintf(name, sizeof(name), "user%d", i);
+    snprintf(homedir, sizeof(homedir), "/home/user%d", i);
+
+    return sysdb_store_user(dom->sysdb, dom, name, NULL,
+                            UID_BASE + i, UID_BASE + i, name, homedir,
+                            "/bin/bash", NULL, NULL, NULL, 0, now);
+}
+
+static int bench_store_users(struct sss_domain_info *dom,
+                             int first, int last)
+{
+    time_t now = time(NULL);
+    int ret;
+    int i;
+
+    ret = sysdb_transaction_start(dom->sysdb);
+    if (ret != EOK) return ret;
+
+    /* as sdap_save_users() does */
+    ret = sysdb_bulk_batch_start(dom->sysdb);
+    if (ret != EOK) {
+        sysdb_transaction_cancel(dom->sysdb);
+        return ret;
+    }
+
+    for (i = first; i < last; i++) {
+        ret = bench_store_user(dom, i, now);
+        if (ret != EOK) {
+            sysdb_bulk_batch_end(dom->sysdb);
+            sysdb_transaction_cancel(dom->sysdb);
+            return ret;
+        }
+    }
+
+    sysdb_bulk_batch_end(dom->sysdb);
+    return sysdb_transaction_commit(dom->sysdb);
+}
+
+/* Group g has dir->members users, is a member of group (g - 1) / fanout
+ * and every tenth group lists one of the late users as a ghost */
+static int bench_group_attrs(TALLOC_CTX *mem_ctx, struct sss_domain_info *dom,
+                             struct bench_dir *dir, int g,
+                             struct sysdb_attrs **_attrs)
+{
+    struct sysdb_attrs *attrs;
+    char *dn;
+    char name[32];
+    int early;
+    int child;
+    int ret;
+    int i;
+
+    attrs = sysdb_new_attrs(mem_ctx);
+    if (!attrs) return ENOMEM;
+
+    early = dir->num_users - dir->num_late;
+    for (i = 0; i < dir->members && early > 0; i++) {
+        snprintf(name, sizeof(name), "user%d",
+                 (g * dir->members + i) % early);
+        dn = sysdb_user_strdn(attrs, dom->name, name);
+        if (!dn) return ENOMEM;
+
+        ret = sysdb_attrs_steal_string(attrs, SYSDB_MEMBER, dn);
+        if (ret != EOK) return ret;
+    }
+
+    for (i = 1; i <= dir->fanout; i++) {
+        child = g * dir->fanout + i;
+        if (child >= dir->num_groups) break;
+
+        snprintf(name, sizeof(name), "group%d", child);
+        dn = sysdb_group_strdn(attrs, dom->name, name);
+        if (!dn) return ENOMEM;
+
+        ret = sysdb_attrs_steal_string(attrs, SYSDB_MEMBER, dn);
+        if (ret != EOK) return ret;
+    }
+
+    if (g % 10 == 0 && dir->num_late > 0) {
+        snprintf(name, sizeof(name), "user%d",
+                 early + (g / 10) % dir->num_late);
+        ret = sysdb_attrs_add_string(attrs, SYSDB_GHOST, name);
+        if (ret != EOK) return ret;
+    }
+
+    *_attrs = attrs;
+    return EOK;
+}
+
+/* Saves the groups in two passes, first without and then with members,
+ * as sdap_save_groups() does for schemas that allow nesting */
+static int bench_store_groups(TALLOC_CTX *mem_ctx,
+                              struct sss_domain_info *dom,
+                              struct bench_dir *dir)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *attrs;
+    time_t now = time(NULL);
+    char name[32];
+    int ret;
+    int g;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (!tmp_ctx) return ENOMEM;
+
+    ret = sysdb_transaction_start(dom->sysdb);
+    if (ret != EOK) goto done;
+
+    ret = sysdb_bulk_batch_start(dom->sysdb);
+    if (ret != EOK) goto fail;
+
+    for (g = 0; g < dir->num_groups; g++) {
+        snprintf(name, sizeof(name), "group%d", g);
+        ret = sysdb_store_group(dom->sysdb, dom, name, GID_BASE + g,
+                                NULL, 0, now);
+        if (ret != EOK) goto fail;
+    }
+
+    for (g = 0; g < dir->num_groups; g++) {
+        ret = bench_group_attrs(tmp_ctx, dom, dir, g, &attrs);
+        if (ret != EOK) goto fail;
+
+        snprintf(name, sizeof(name), "group%d", g);
+        ret = sysdb_store_group(dom->sysdb, dom, name, 0, attrs, 0, now);
+        if (ret != EOK) goto fail;
+
+        talloc_zfree(attrs);
+    }
+
+    sysdb_bulk_batch_end(dom->sysdb);
+    ret = sysdb_transaction_commit(dom->sysdb);
+    goto done;
+
+fail:
+    sysdb_bulk_batch_end(dom->sysdb);
+    sysdb_transaction_cancel(dom->sysdb);
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static int bench_count_values(TALLOC_CTX *mem_ctx, struct sss_domain_info *dom,
+                              const char *filter, const char *attr,
+                              uint64_t *_count)
+{
+    const char *attrs[] = { attr, NULL };
+    struct ldb_message_element *el;
+    struct ldb_message **msgs;
+    struct ldb_dn *basedn;
+    size_t count;
+    size_t i;
+    int ret;
+
+    basedn = ldb_dn_new_fmt(mem_ctx, sysdb_ctx_get_ldb(dom->sysdb),
+                            SYSDB_DOM_BASE, dom->name);
+    if (!basedn) return ENOMEM;
+
+    ret = sysdb_search_entry(mem_ctx, dom->sysdb, basedn, LDB_SCOPE_SUBTREE,
+                             filter, attrs, &count, &msgs);
+    if (ret == ENOENT) {
+        count = 0;
+    } else if (ret != EOK) {
+        return ret;
+    }
+
+    *_count = 0;
+    for (i = 0; i < count; i++) {
+        el = ldb_msg_find_element(msgs[i], attr);
+        if (el) {
+            *_count += el->num_values;
+        }
+    }
+
+    talloc_free(basedn);
+    return EOK;
+}
+
+static int bench_run(TALLOC_CTX *mem_ctx, struct confdb_ctx *cdb,
+                     const char *domain_name, bool use_bulk,
+                     struct bench_dir *dir, struct bench_result *res)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sss_domain_info *dom;
+    struct sysdb_bulk *bulk = NULL;
+    struct timeval start;
+    char *db_file;
+    int ret;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (!tmp_ctx) return ENOMEM;
+
+    /* always start from an empty cache */
+    db_file = talloc_asprintf(tmp_ctx, "%s/"CACHE_SYSDB_FILE,
+                              BENCH_PATH, domain_name);
+    if (!db_file) {
+        ret = ENOMEM;
+        goto done;
+    }
+    unlink(db_file);
+
+    ret = sssd_domain_init(tmp_ctx, cdb, domain_name, BENCH_PATH, &dom);
+    if (ret != EOK) goto done;
+
+    if (use_bulk) {
+        ret = sysdb_bulk_start(tmp_ctx, dom->sysdb, &bulk);
+        if (ret != EOK) goto done;
+    }
+
+    gettimeofday(&start, NULL);
+    ret = bench_store_users(dom, 0, dir->num_users - dir->num_late);
+    if (ret != EOK) goto done;
+    res->users = elapsed_sec(&start);
+
+    gettimeofday(&start, NULL);
+    ret = bench_store_groups(tmp_ctx, dom, dir);
+    if (ret != EOK) goto done;
+    res->groups = elapsed_sec(&start);
+
+    gettimeofday(&start, NULL);
+    ret = bench_store_users(dom, dir->num_users - dir->num_late,
+                            dir->num_users);
+    if (ret != EOK) goto done;
+    res->late_users = elapsed_sec(&start);
+
+    gettimeofday(&start, NULL);
+    if (use_bulk) {
+        ret = sysdb_bulk_finish(bulk);
+        if (ret != EOK) goto done;
+    }
+    res->finish = elapsed_sec(&start);
+
+    ret = bench_count_values(tmp_ctx, dom, "("SYSDB_UC")", SYSDB_MEMBEROF,
+                             &res->memberofs);
+    if (ret != EOK) goto done;
+
+    ret = bench_count_values(tmp_ctx, dom, "("SYSDB_GC")", SYSDB_MEMBERUID,
+                             &res->memberuids);
+    if (ret != EOK) goto done;
+
+    ret = bench_count_values(tmp_ctx, dom, "("SYSDB_GC")", SYSDB_GHOST,
+                             &res->ghosts);
+    if (ret != EOK) goto done;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static void bench_print(const char *mode, struct bench_result *res)
+{
+    printf("%-6s %8.2f %8.2f %8.2f %8.2f %8.2f   %10llu %10llu %6llu\n",
+           mode, res->users, res->groups, res->late_users, res->finish,
+           res->users + res->groups + res->late_users + res->finish,
+           (unsigned long long)res->memberofs,
+           (unsigned long long)res->memberuids,
+           (unsigned long long)res->ghosts);
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_users = DEFAULT_USERS;
+    int pc_groups = DEFAULT_GROUPS;
+    int pc_members = DEFAULT_MEMBERS;
+    int pc_fanout = DEFAULT_FANOUT;
+    struct bench_result plain = { 0 };
+    struct bench_result bulk = { 0 };
+    struct bench_dir dir;
+    struct confdb_ctx *cdb;
+    TALLOC_CTX *ctx;
+    int ret;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "users", 'u', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_users, 0, "Number of users", NULL },
+        { "groups", 'g', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_groups, 0, "Number of groups", NULL },
+        { "members", 'm', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_members, 0, "User members per group", NULL },
+        { "fanout", 'f', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_fanout, 0, "Nested groups per group", NULL },
+        SSSD_MAIN_OPTS
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                poptBadOption(pc, 0), poptStrerror(opt));
+        poptPrintUsage(pc, stderr, 0);
+        return 1;
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    if (pc_users <= 0 || pc_groups <= 0 || pc_members < 0 ||
+        pc_fanout < 0) {
+        fprintf(stderr, "invalid directory size\n");
+        return 1;
+    }
+
+    dir.num_users = pc_users;
+    dir.num_groups = pc_groups;
+    dir.members = pc_members;
+    dir.fanout = pc_fanout;
+    dir.num_late = pc_users * LATE_USERS_PERCENT / 100;
+
+    ret = mkdir(BENCH_PATH, 0775);
+    if (ret == -1 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s directory\n", BENCH_PATH);
+        return 1;
+    }
+
+    ctx = talloc_new(NULL);
+    if (!ctx) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    ret = bench_setup_confdb(ctx, &cdb);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not set up the confdb [%d]: %s\n",
+                ret, strerror(ret));
+        return 1;
+    }
+
+    printf("%d users, %d groups, %d user members and %d nested groups "
+           "per group, %d users stored last\n",
+           dir.num_users, dir.num_groups, dir.members, dir.fanout,
+           dir.num_late);
+    printf("mode   users(s) groups(s)  late(s) finish(s) total(s)"
+           "    memberof  memberuid ghosts\n");
+
+    ret = bench_run(ctx, cdb, "plain", false, &dir, &plain);
+    if (ret == EOK) {
+        bench_print("plain", &plain);
+        ret = bench_run(ctx, cdb, "bulk", true, &dir, &bulk);
+    }
+    if (ret != EOK) {
+        fprintf(stderr, "benchmark failed [%d]: %s\n", ret, strerror(ret));
+        return 1;
+    }
+    bench_print("bulk", &bulk);
+
+    talloc_free(ctx);
+
+    if (plain.memberofs != bulk.memberofs ||
+        plain.memberuids != bulk.memberuids ||
+        plain.ghosts != bulk.ghosts) {
+        fprintf(stderr, "The bulk session computed different memberships\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,382 @@
+/*
+   SSSD
+
+   sysdb sudo rule lookup benchmark
+
+   Caches a synthetic set of sudo rules and looks up the rules of many
+   users, once with the filter the sudo responder builds and once with
+   the former substring match on +netgroup sudoUser values, which made
+   ldb evaluate every cached rule. Both must return the same rules.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <talloc.h>
+#include <popt.h>
+
+#include "util/util.h"
+#include "confdb/confdb.h"
+#include "db/sysdb.h"
+#include "db/sysdb_sudo.h"
+
+#define BENCH_PATH "bench_sysdb_sudo"
+#define BENCH_CONF_FILE "bench_conf.ldb"
+#define BENCH_DOMAIN "sudo"
+
+#define DEFAULT_RULES   50000
+#define DEFAULT_USERS   5000
+#define DEFAULT_GROUPS  500
+#define DEFAULT_LOOKUPS 200
+
+#define UID_BASE 20000
+
+struct bench_result {
+    double lookup;
+    uint64_t rules;
+};
+
+static double elapsed_sec(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+           (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static int bench_setup_domain(TALLOC_CTX *mem_ctx,
+                              struct sss_domain_info **_dom)
+{
+    const char *val[2] = { NULL, NULL };
+    struct confdb_ctx *cdb;
+    char *conf_db;
+    char *db_file;
+    int ret;
+
+    conf_db = talloc_asprintf(mem_ctx, "%s/%s", BENCH_PATH, BENCH_CONF_FILE);
+    if (!conf_db) return ENOMEM;
+
+    ret = confdb_init(mem_ctx, &cdb, conf_db);
+    if (ret != EOK) return ret;
+
+    val[0] = BENCH_DOMAIN;
+    ret = confdb_add_param(cdb, true, "config/sssd", "domains", val);
+    if (ret != EOK) return ret;
+
+    val[0] = "ldap";
+    ret = confdb_add_param(cdb, true, "config/domain/"BENCH_DOMAIN,
+                           "id_provider", val);
+    if (ret != EOK) return ret;
+
+    /* always start from an empty cache */
+    db_file = talloc_asprintf(mem_ctx, "%s/"CACHE_SYSDB_FILE,
+                              BENCH_PATH, BENCH_DOMAIN);
+    if (!db_file) return ENOMEM;
+    unlink(db_file);
+
+    return sssd_domain_init(mem_ctx, cdb, BENCH_DOMAIN, BENCH_PATH, _dom);
+}
+
+/* Every 1000th rule applies to ALL, every 100th to a netgroup, a quarter
+ * to a group and the rest to a single user */
+static const char *bench_rule_user(char *buf, size_t len, int i,
+                                   int num_users, int num_groups)
+{
+    if (i % 1000 == 0) {
+        snprintf(buf, len, "ALL");
+    } else if (i % 100 == 1) {
+        snprintf(buf, len, "+netgroup%d", i / 100);
+    } else if (i % 4 == 2) {
+        snprintf(buf, len, "%%group%d", (i / 4) % num_groups);
+    } else {
+        snprintf(buf, len, "user%d", i % num_users);
+    }
+
+    return buf;
+}
+
+static int bench_store_rules(TALLOC_CTX *mem_ctx, struct sss_domain_info *dom,
+                             int num_rules, int num_users, int num_groups)
+{
+    TALLOC_CTX *tmp_ctx;
+    struct sysdb_attrs *attrs;
+    time_t now = time(NULL);
+    char user[32];
+    char name[32];
+    int ret;
+    int i;
+
+    tmp_ctx = talloc_new(mem_ctx);
+    if (!tmp_ctx) return ENOMEM;
+
+    ret = sysdb_transaction_start(dom->sysdb);
+    if (ret != EOK) goto done;
+
+    for (i = 0; i < num_rules; i++) {
+        attrs = sysdb_new_attrs(tmp_ctx);
+        if (!attrs) {
+            ret = ENOMEM;
+            goto fail;
+        }
+
+        snprintf(name, sizeof(name), "rule%d", i);
+        bench_rule_user(user, sizeof(user), i, num_users, num_groups);
+
+        ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_CN, name);
+        if (ret == EOK) {
+            ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_USER,
+                                         user);
+        }
+        if (ret == EOK) {
+            ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_HOST,
+                                         "ALL");
+        }
+        if (ret == EOK) {
+            ret = sysdb_attrs_add_string(attrs, SYSDB_SUDO_CACHE_AT_COMMAND,
+                                         "/bin/true");
+        }
+        if (ret == EOK) {
+            ret = sysdb_attrs_add_uint32(attrs, SYSDB_SUDO_CACHE_AT_ORDER, i);
+        }
+        if (ret == EOK) {
+            ret = sysdb_attrs_add_time_t(attrs, SYSDB_CACHE_EXPIRE,
+                                         now + 5400);
+        }
+        if (ret == EOK) {
+            /* as sdap_save_native_sudorule() does */
+            ret = sysdb_attrs_add_bool(attrs,
+                                       SYSDB_SUDO_CACHE_AT_NETGROUP_USER,
+                                       user[0] == '+');
+        }
+        if (ret == EOK) {
+            ret = sysdb_save_sudorule(dom->sysdb, dom, name, attrs);
+        }
+        if (ret != EOK) goto fail;
+
+        talloc_zfree(attrs);
+    }
+
+    ret = sysdb_transaction_commit(dom->sysdb);
+    goto done;
+
+fail:
+    sysdb_transaction_cancel(dom->sysdb);
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+/* The filter of the sudo responder before netgroup rules were flagged */
+static char *bench_legacy_filter(TALLOC_CTX *mem_ctx, const char *filter)
+{
+    const char *term = "("SYSDB_SUDO_CACHE_AT_NETGROUP_USER"=TRUE)";
+    const char *pos;
+
+    pos = strstr(filter, term);
+    if (!pos) return NULL;
+
+    return talloc_asprintf(mem_ctx, "%.*s(%s=+*)%s",
+                           (int)(pos - filter), filter,
+                           SYSDB_SUDO_CACHE_AT_USER, pos + strlen(term));
+}
+
+static int bench_lookup(TALLOC_CTX *mem_ctx, struct sss_domain_info *dom,
+                        bool legacy, int num_lookups,
+                        int num_users, int num_groups,
+                        struct bench_result *res)
+{
+    TALLOC_CTX *tmp_ctx;
+    const char *attrs[] = { SYSDB_NAME, NULL };
+    struct ldb_message **msgs;
+    struct timeval start;
+    char *groupnames[3];
+    char *filter;
+    char *username;
+    size_t count;
+    int u;
+    int i;
+    int ret = EOK;
+
+    res->rules = 0;
+    res->lookup = 0;
+
+    for (i = 0; i < num_lookups; i++) {
+        tmp_ctx = talloc_new(mem_ctx);
+        if (!tmp_ctx) return ENOMEM;
+
+        u = (i * 7919) % num_users;
+        username = talloc_asprintf(tmp_ctx, "user%d", u);
+        groupnames[0] = talloc_asprintf(tmp_ctx, "group%d", u % num_groups);
+        groupnames[1] = talloc_asprintf(tmp_ctx, "group%d",
+                                        (u / 7) % num_groups);
+        groupnames[2] = NULL;
+        if (!username || !groupnames[0] || !groupnames[1]) {
+            ret = ENOMEM;
+            goto done;
+        }
+
+        ret = sysdb_get_sudo_filter(tmp_ctx, username, UID_BASE + u,
+                                    groupnames,
+                                    SYSDB_SUDO_FILTER_USERINFO
+                                    | SYSDB_SUDO_FILTER_INCLUDE_ALL,
+                                    &filter);
+        if (ret != EOK) goto done;
+
+        if (legacy) {
+            filter = bench_legacy_filter(tmp_ctx, filter);
+            if (!filter) {
+                ret = EINVAL;
+                goto done;
+            }
+        }
+
+        gettimeofday(&start, NULL);
+        ret = sysdb_search_custom(tmp_ctx, dom->sysdb, dom, filter,
+                                  SUDORULE_SUBDIR, attrs, &count, &msgs);
+        res->lookup += elapsed_sec(&start);
+        if (ret == ENOENT) {
+            count = 0;
+        } else if (ret != EOK) {
+            goto done;
+        }
+
+        res->rules += count;
+        talloc_free(tmp_ctx);
+    }
+
+    return EOK;
+
+done:
+    talloc_free(tmp_ctx);
+    return ret;
+}
+
+static void bench_print(const char *mode, int num_lookups,
+                        struct bench_result *res)
+{
+    printf("%-8s %10.2f %12.3f %10llu\n",
+           mode, res->lookup, res->lookup * 1000 / num_lookups,
+           (unsigned long long)res->rules);
+}
+
+int main(int argc, const char *argv[])
+{
+    int opt;
+    poptContext pc;
+    int pc_rules = DEFAULT_RULES;
+    int pc_users = DEFAULT_USERS;
+    int pc_groups = DEFAULT_GROUPS;
+    int pc_lookups = DEFAULT_LOOKUPS;
+    struct bench_result indexed = { 0 };
+    struct bench_result legacy = { 0 };
+    struct sss_domain_info *dom;
+    struct timeval start;
+    TALLOC_CTX *ctx;
+    int ret;
+
+    struct poptOption long_options[] = {
+        POPT_AUTOHELP
+        { "rules", 'r', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_rules, 0, "Number of sudo rules", NULL },
+        { "users", 'u', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_users, 0, "Number of users", NULL },
+        { "groups", 'g', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_groups, 0, "Number of groups", NULL },
+        { "lookups", 'l', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT,
+                    &pc_lookups, 0, "Number of lookups", NULL },
+        SSSD_MAIN_OPTS
+        POPT_TABLEEND
+    };
+
+    /* Set debug level to invalid value so we can deside if -d 0 was used. */
+    debug_level = SSSDBG_INVALID;
+
+    pc = poptGetContext(argv[0], argc, argv, long_options, 0);
+    while ((opt = poptGetNextOpt(pc)) != -1) {
+        fprintf(stderr, "\nInvalid option %s: %s\n\n",
+                poptBadOption(pc, 0), poptStrerror(opt));
+        poptPrintUsage(pc, stderr, 0);
+        return 1;
+    }
+    poptFreeContext(pc);
+
+    DEBUG_INIT(debug_level);
+
+    if (pc_rules <= 0 || pc_users <= 0 || pc_groups <= 0 ||
+        pc_lookups <= 0) {
+        fprintf(stderr, "invalid rule set size\n");
+        return 1;
+    }
+
+    ret = mkdir(BENCH_PATH, 0775);
+    if (ret == -1 && errno != EEXIST) {
+        fprintf(stderr, "Could not create %s directory\n", BENCH_PATH);
+        return 1;
+    }
+
+    ctx = talloc_new(NULL);
+    if (!ctx) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    ret = bench_setup_domain(ctx, &dom);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not set up the domain [%d]: %s\n",
+                ret, strerror(ret));
+        return 1;
+    }
+
+    gettimeofday(&start, NULL);
+    ret = bench_store_rules(ctx, dom, pc_rules, pc_users, pc_groups);
+    if (ret != EOK) {
+        fprintf(stderr, "Could not store the rules [%d]: %s\n",
+                ret, strerror(ret));
+        return 1;
+    }
+
+    printf("%d rules for %d users and %d groups stored in %.2fs, "
+           "%d lookups\n", pc_rules, pc_users, pc_groups,
+           elapsed_sec(&start), pc_lookups);
+    printf("filter    total(s)  per lookup(ms)    rules\n");
+
+    ret = bench_lookup(ctx, dom, true, pc_lookups, pc_users, pc_groups,
+                       &legacy);
+    if (ret == EOK) {
+        bench_print("substr", pc_lookups, &legacy);
+        ret = bench_lookup(ctx, dom, false, pc_lookups, pc_users, pc_groups,
+                           &indexed);
+    }
+    if (ret != EOK) {
+        fprintf(stderr, "benchmark failed [%d]: %s\n", ret, strerror(ret));
+        return 1;
+    }
+    bench_print("indexed", pc_lookups, &indexed);
+
+    talloc_free(ctx);
+
+    if (legacy.rules != indexed.rules) {
+        fprintf(stderr, "The indexed lookup returned different rules\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -85,3 +85,26 @@ done:
     EVP_MD_CTX_cleanup(&ctx);
     return ret;
 }
+
+int sss_sha1(const unsigned char *in,
+             size_t in_len,
+             unsigned char *out)
+{
+    int ret;
+    EVP_MD_CTX ctx;
+    unsigned int res_len;
+
+    EVP_MD_CTX_init(&ctx);
+
+    if (!EVP_DigestInit_ex(&ctx, EVP_sha1(), NULL)) {
+        ret = EIO;
+        goto done;
+    }
+
+    EVP_DigestUpdate(&ctx, (const unsigned char *)in, in_len);
+    EVP_DigestFinal_ex(&ctx, out, &res_len);
+    ret = EOK;
+done:
+    EVP_MD_CTX_cleanup(&ctx);
+    return ret;
+}
@@ -88,3 +88,30 @@ int sss_hmac_sha1(const unsigned char *key,
 
     return EOK;
 }
+
+int sss_sha1(const unsigned char *in,
+             size_t in_len,
+             unsigned char *out)
+{
+    int ret;
+    HASHContext *sha1;
+    unsigned int res_len;
+
+    ret = nspr_nss_init();
+    if (ret != EOK) {
+        return ret;
+    }
+
+    sha1 = HASH_Create(HASH_AlgSHA1);
+    if (!sha1) {
+        return ENOMEM;
+    }
+
+    HASH_Begin(sha1);
+    HASH_Update(sha1, in, in_len);
+    HASH_End(sha1, out, &res_len, SSS_SHA1_LENGTH);
+
+    HASH_Destroy(sha1);
+
+    return EOK;
+}
@@ -27,6 +27,11 @@ int sss_hmac_sha1(const unsigned char *key,
                   size_t in_len,
                   unsigned char *out);
 
+/* Plain SHA-1 of in, out must hold SSS_SHA1_LENGTH bytes */
+int sss_sha1(const unsigned char *in,
+             size_t in_len,
+             unsigned char *out);
+
 int sss_password_encrypt(TALLOC_CTX *mem_ctx, const char *password, int plen,
                          enum obfmethod meth, char **obfpwd);
 
@@ -54,12 +54,12 @@ typedef uint32_t rel_ptr_t;
 
 /*
  * 32 seem a good compromise for slot size
- * 4 blocks are enough for the average passwd entry of 42 bytes
- * passwd records have 84 bytes of overhead, 128 - 82 = 46 bytes
- * 3 blocks can contain a very minimal entry, 96 - 82 = 14 bytes
+ * 4 blocks are enough for most passwd entries
+ * passwd records have 92 bytes of overhead, 128 - 92 = 36 bytes
+ * 3 blocks can contain a very minimal entry, 96 - 92 = 4 bytes
  *
  * 3 blocks are enough for groups w/o users (private user groups)
- * group records have 68 bytes of overhead, 96 - 66 = 30 bytes
+ * group records have 76 bytes of overhead, 96 - 76 = 20 bytes
  */
 #define MC_SLOT_SIZE 32
 #define MC_SIZE_TO_SLOTS(len) (((len) + (MC_SLOT_SIZE - 1)) / MC_SLOT_SIZE)
@@ -76,7 +76,7 @@ typedef uint32_t rel_ptr_t;
 
 
 #define SSS_MC_MAJOR_VNO    0
-#define SSS_MC_MINOR_VNO    4
+#define SSS_MC_MINOR_VNO    5
 
 #define SSS_MC_HEADER_ALIVE     1   /* current and in use */
 #define SSS_MC_HEADER_RECYCLED  2   /* file was recycled, reopen asap */
@@ -102,10 +102,14 @@ struct sss_mc_rec {
     uint32_t b1;            /* barrier 1 */
     uint32_t len;           /* total record length including record data */
     uint64_t expire;        /* record expiration time (cast to time_t) */
-    rel_ptr_t next;         /* ptr of next record rel to data_table */
+    rel_ptr_t next1;        /* ptr of next record rel to data_table */
+                            /* on the chain of hash1 */
+    rel_ptr_t next2;        /* ptr of next record rel to data_table */
+                            /* on the chain of hash2 */
     uint32_t hash1;         /* val of first hash (usually name of record) */
     uint32_t hash2;         /* val of second hash (usually id of record) */
-    uint32_t b2;            /* barrier 2 - 32 bytes mark, fits a slot */
+    uint32_t padding;       /* padding & reserved for future changes */
+    uint32_t b2;            /* barrier 2 */
     char data[0];
 };
 
@@ -128,7 +132,44 @@ struct sss_mc_grp_data {
                              * string is zero terminated ordered as follows:
                              * name, passwd, member1, member2, ... */
 };
+
+struct sss_mc_initgr_data {
+    rel_ptr_t name;         /* ptr to name string, rel. to struct base addr */
+    uint32_t num_groups;    /* number of gids in gids */
+    uint32_t data_len;      /* length of gids and name string */
+    uint32_t gids[0];       /* array of all gids the user is a member of,
+                             * the zero terminated name string is stored
+                             * right after the last gid */
+};
+
+struct sss_mc_neg_data {
+    rel_ptr_t name;         /* ptr to key string, rel. to struct base addr */
+    uint32_t strs_len;      /* length of strs */
+    char strs[0];           /* zero terminated key string, see below */
+};
 #pragma pack()
 
+/* Each record is linked in the chain of its first hash through next1 and in
+ * the chain of its second hash through next2. If both hashes fall in the
+ * same bucket the record is linked only once, through next1.
+ * Returns the slot of the record following rec in the chain of hash. */
+static inline rel_ptr_t sss_mc_next_slot_with_hash(struct sss_mc_rec *rec,
+                                                   uint32_t hash)
+{
+    if (rec->hash1 == hash) {
+        return rec->next1;
+    } else if (rec->hash2 == hash) {
+        return rec->next2;
+    }
+
+    /* rec does not belong to this chain (probably being invalidated) */
+    return MC_INVALID_VAL;
+}
+
+/* Negative records are keyed by the lookup they answer, a prefix naming the
+ * lookup followed by the name exactly as requested or the decimal id */
+#define SSS_MC_NEG_PWNAM_PREFIX "pwnam:"
+#define SSS_MC_NEG_PWUID_PREFIX "pwuid:"
+
 
 #endif /* _MMAP_CACHE_H_ */
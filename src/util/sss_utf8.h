@@ -40,6 +40,10 @@ void sss_utf8_free(void *ptr);
 /* The result must be freed with sss_utf8_free() */
 uint8_t *sss_utf8_tolower(const uint8_t *s, size_t len, size_t *nlen);
 
+/* The result must be freed with sss_utf8_free(). Two strings that compare
+ * equal with sss_utf8_case_eq() have the same case-folded form. */
+uint8_t *sss_utf8_casefold(const uint8_t *s, size_t len, size_t *nlen);
+
 bool sss_utf8_check(const uint8_t *s, size_t n);
 
 errno_t sss_utf8_case_eq(const uint8_t *s1, const uint8_t *s2);